@@ -0,0 +1,169 @@
+#ifndef ANALYSIS
+#define ANALYSIS
+
+#include "search.h"
+#include "trace.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief What the analysis thread found about one position.
+ */
+struct Analysis {
+  /*!
+   * \brief Grows with every result published; 0 before the first one.
+   */
+  std::uint64_t version = 0;
+  /*!
+   * \brief The GameState::hash() of the position analysed.
+   */
+  std::uint64_t key = 0;
+  int depth = 0;
+  /*!
+   * \brief Nodes searched on the position so far, every depth included.
+   */
+  std::int64_t nodes = 0;
+  /*!
+   * \brief The best actions of the side to move, best first.
+   */
+  std::vector<SearchLine> lines;
+};
+
+/*!
+ * \brief Evaluates a position on a background thread until it changes.
+ *
+ * setPosition() hands the worker a copy of the position and interrupts
+ * whatever it was searching; the worker then runs one iterative-deepening
+ * search of it and publishes the best lines after every completed
+ * iteration, through SearchLimits::onIteration. The caller picks them up
+ * with poll(). Neither call waits for the search, so a render loop can make
+ * them every frame.
+ */
+class Analyzer {
+public:
+  /*!
+   * \brief Constructor for Analyzer with specified parameters.
+   * \param lineCount The number of best actions to score.
+   * \param tableBits The transposition table holds 2^tableBits entries.
+   */
+  explicit Analyzer(int lineCount = 3, int tableBits = 18)
+      : search(tableBits), position(1, 1, 1), lineCount(lineCount),
+        pending(false), quitting(false), interrupt(false), versions(0) {
+    worker = std::thread([this] { run(); });
+  }
+
+  Analyzer(const Analyzer &) = delete;
+  Analyzer &operator=(const Analyzer &) = delete;
+
+  ~Analyzer() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      quitting = true;
+      interrupt.store(true, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+    worker.join();
+  }
+
+  /*!
+   * \brief Starts analysing a position, dropping the one before.
+   * \param state The position; positions outside the battle phase publish
+   * no lines.
+   */
+  void setPosition(const GameState &state) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      position = state;
+      pending = true;
+      interrupt.store(true, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+  }
+
+  /*!
+   * \brief Stops analysing until the next setPosition().
+   */
+  void pause() {
+    std::lock_guard<std::mutex> guard(lock);
+    pending = false;
+    interrupt.store(true, std::memory_order_relaxed);
+  }
+
+  /*!
+   * \brief Copies the latest result if it is newer than the one held.
+   * \param analysis The result held, replaced when a newer one exists.
+   * \return True if analysis was replaced.
+   */
+  bool poll(Analysis &analysis) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (latest.version == analysis.version) {
+      return false;
+    }
+    analysis = latest;
+    return true;
+  }
+
+private:
+  void run() {
+    Trace::setThreadName("analysis");
+    GameState state(1, 1, 1);
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+      wake.wait(guard, [this] { return quitting || pending; });
+      if (quitting) {
+        return;
+      }
+      // The flag is cleared under the lock that setPosition() raises it
+      // under, so a newer position always interrupts this one.
+      state = position;
+      pending = false;
+      interrupt.store(false, std::memory_order_relaxed);
+      guard.unlock();
+      analyse(state);
+      guard.lock();
+    }
+  }
+
+  void analyse(GameState &state) {
+    Analysis found;
+    found.key = state.hash();
+    SearchLimits limits;
+    limits.multiPv = lineCount;
+    limits.interrupt = &interrupt;
+    limits.onIteration = [&](const SearchResult &result) {
+      found.nodes = result.nodes;
+      found.depth = result.depth;
+      found.lines = result.lines;
+      publish(found);
+    };
+    SearchResult result = search.search(state, limits);
+    if (!result.found && !interrupt.load(std::memory_order_relaxed)) {
+      // Nothing to search: say so once.
+      publish(found);
+    }
+  }
+
+  void publish(Analysis &found) {
+    std::lock_guard<std::mutex> guard(lock);
+    found.version = ++versions;
+    latest = found;
+  }
+
+  AlphaBetaSearch search;
+  GameState position;
+  int lineCount;
+  std::mutex lock;
+  std::condition_variable wake;
+  bool pending;
+  bool quitting;
+  std::atomic<bool> interrupt;
+  std::uint64_t versions;
+  Analysis latest;
+  std::thread worker;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "analysis.h"
+#include "doctest.h"
+#include <chrono>
+#include <random>
+#include <thread>
+
+/*!
+ * \brief Deploys both players randomly and plays a few random turns.
+ */
+static GameState battlePosition(std::uint32_t seed) {
+    GameState state(8, 8, 3);
+    state.generateTall(seed, 4);
+    std::mt19937 rng(seed);
+    std::vector<Action> actions;
+    while (state.isPlacement()) {
+        state.generateActions(actions);
+        size_t places = actions.size() - (actions.back().kind == FinishPlacement);
+        state.apply(places > 0 ? actions[rng() % places] : actions.back());
+    }
+    for (int turn = 0; turn < 4 && !state.isFinished(); ++turn) {
+        state.generateActions(actions);
+        state.apply(actions[rng() % actions.size()]);
+    }
+    return state;
+}
+
+/*!
+ * \brief Polls an analyzer until it publishes an analysis of a position at
+ * least a given depth deep, or a few seconds pass.
+ */
+static bool waitForAnalysis(Analyzer &analyzer, Analysis &analysis, std::uint64_t key,
+                            int depth) {
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+        analyzer.poll(analysis);
+        if (analysis.key == key && analysis.depth >= depth) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+TEST_CASE("AlphaBetaSearch Class: Multi-PV Scores The Best Root Actions") {
+    for (std::uint32_t seed = 1; seed <= 4; ++seed) {
+        GameState state = battlePosition(seed);
+        if (state.isFinished()) {
+            continue;
+        }
+        std::uint64_t key = state.hash();
+        AlphaBetaSearch search;
+        SearchLimits limits;
+        limits.depth = 3;
+        limits.multiPv = 3;
+        SearchResult result = search.search(state, limits);
+        REQUIRE(result.found);
+        CHECK(state.hash() == key);
+        CHECK(result.depth == 3);
+        REQUIRE(result.lines.size() == 3);
+        CHECK(result.lines[0].action == result.best);
+        CHECK(result.lines[0].score == result.score);
+        CHECK(result.pv == result.lines[0].pv);
+
+        for (size_t k = 0; k < result.lines.size(); ++k) {
+            const SearchLine &line = result.lines[k];
+            if (k > 0) {
+                CHECK(line.score <= result.lines[k - 1].score);
+                CHECK_FALSE(line.action == result.lines[k - 1].action);
+            }
+            REQUIRE_FALSE(line.pv.empty());
+            CHECK(line.pv[0] == line.action);
+            GameState replay = state;
+            for (const Action &action : line.pv) {
+                CHECK(replay.apply(action));
+            }
+        }
+
+        // Without a table carried over, one line searches like any other.
+        limits.multiPv = 1;
+        AlphaBetaSearch single;
+        SearchResult plain = single.search(state, limits);
+        CHECK(plain.lines.size() == 1);
+        CHECK(plain.lines[0].action == plain.best);
+        CHECK(plain.score == result.score);
+    }
+}
+
+TEST_CASE("AlphaBetaSearch Class: Reports Every Completed Iteration") {
+    GameState state = battlePosition(1);
+    REQUIRE_FALSE(state.isFinished());
+    AlphaBetaSearch search;
+    SearchLimits limits;
+    limits.depth = 4;
+    limits.multiPv = 2;
+    std::vector<SearchResult> reports;
+    limits.onIteration = [&](const SearchResult &report) {
+        reports.push_back(report);
+    };
+    SearchResult result = search.search(state, limits);
+    REQUIRE(reports.size() == static_cast<size_t>(result.depth));
+    for (size_t k = 0; k < reports.size(); ++k) {
+        CHECK(reports[k].depth == static_cast<int>(k) + 1);
+        CHECK(reports[k].lines.size() == 2);
+        if (k > 0) {
+            CHECK(reports[k].nodes > reports[k - 1].nodes);
+        }
+    }
+    // The last report is the result itself.
+    CHECK(reports.back().best == result.best);
+    CHECK(reports.back().score == result.score);
+    CHECK(reports.back().nodes == result.nodes);
+    CHECK(reports.back().pv == result.pv);
+    REQUIRE(reports.back().lines.size() == result.lines.size());
+    for (size_t k = 0; k < result.lines.size(); ++k) {
+        CHECK(reports.back().lines[k].action == result.lines[k].action);
+        CHECK(reports.back().lines[k].pv == result.lines[k].pv);
+    }
+}
+
+TEST_CASE("AlphaBetaSearch Class: An Interrupt Set Early Still Stops") {
+    GameState state = battlePosition(2);
+    AlphaBetaSearch search;
+    std::atomic<bool> interrupt(true);
+    SearchLimits limits;
+    limits.multiPv = 2;
+    limits.interrupt = &interrupt;
+    auto start = std::chrono::steady_clock::now();
+    SearchResult result = search.search(state, limits);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    CHECK(result.found);
+    CHECK_FALSE(result.lines.empty());
+    CHECK(result.depth < 64);
+}
+
+TEST_CASE("Analyzer Class: Publishes Deeper Lines And Follows The Position") {
+    GameState state = battlePosition(3);
+    REQUIRE_FALSE(state.isFinished());
+    Analyzer analyzer(2);
+    Analysis analysis;
+    CHECK_FALSE(analyzer.poll(analysis));
+    analyzer.setPosition(state);
+    REQUIRE(waitForAnalysis(analyzer, analysis, state.hash(), 2));
+    CHECK(analysis.version > 0);
+    CHECK(analysis.nodes > 0);
+    REQUIRE(analysis.lines.size() == 2);
+    CHECK(analysis.lines[0].score >= analysis.lines[1].score);
+    CHECK(state.isLegal(analysis.lines[0].action));
+
+    // The reply analysed is the position after the best action.
+    REQUIRE(state.apply(analysis.lines[0].action));
+    analyzer.setPosition(state);
+    REQUIRE(waitForAnalysis(analyzer, analysis, state.hash(), 1));
+    CHECK(state.isLegal(analysis.lines[0].action));
+
+    // Paused, nothing more is published.
+    analyzer.pause();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    analyzer.poll(analysis);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_FALSE(analyzer.poll(analysis));
+
+    // A deployment has nothing to search.
+    GameState placement(8, 8, 3);
+    analyzer.setPosition(placement);
+    REQUIRE(waitForAnalysis(analyzer, analysis, placement.hash(), 0));
+    CHECK(analysis.lines.empty());
+}
@@ -0,0 +1,337 @@
+#ifndef BALANCE
+#define BALANCE
+
+#include "evaluation.h"
+#include "game.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <vector>
+
+/*!
+ * \brief The statistics of every unit type, the subject of balancing.
+ */
+struct StatTable {
+  UnitStats unit[UNIT_TYPES];
+
+  /*!
+   * \brief Gets the table of defaultUnitStats().
+   */
+  static StatTable defaults() {
+    StatTable table;
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+      table.unit[type] = defaultUnitStats(type);
+    }
+    return table;
+  }
+
+  /*!
+   * \brief Applies the table to a fresh game.
+   * \param state The game, before any unit is placed.
+   */
+  void applyTo(GameState &state) const {
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+      state.setUnitStats(type, unit[type]);
+    }
+  }
+};
+
+/*!
+ * \brief The settings of a balancing tournament.
+ */
+struct TournamentConfig {
+  int rows = 8;
+  int cols = 8;
+  int maxNPC = 3;
+  int number_of_tall = 4;
+  int maxTurns = 300;
+  int games = 2000;
+  /*!
+   * \brief Percentage of moves chosen by one-ply Evaluator search.
+   */
+  int greedyPercent = 0;
+  /*!
+   * \brief Game k uses seed + k, so that two stat tables meet the same
+   * terrain, placements and dice (common random numbers).
+   */
+  std::uint32_t seed = 1;
+  /*!
+   * \brief The number of games a pool task plays.
+   */
+  int gamesPerTask = 64;
+};
+
+/*!
+ * \brief The outcome of a tournament and the weight of every unit type in
+ * it.
+ *
+ * contribution[t] is the mean score, from -1 (always lost) to 1 (always
+ * won), of the side that fielded more units of type t, over the decisive
+ * and drawn games where the sides fielded different numbers of it. A
+ * balanced table keeps every contribution near 0.
+ */
+struct TournamentResult {
+  int games = 0;
+  int wins[2] = {0, 0};
+  int draws = 0;
+  double contribution[UNIT_TYPES] = {};
+  int contested[UNIT_TYPES] = {};
+  std::int64_t turns = 0;
+
+  /*!
+   * \brief Gets the sum of squared contributions and of the draw rate, the
+   * loss of the optimizer. Without the draw term, tables where nobody can
+   * kill anything would look perfectly balanced.
+   */
+  double imbalance() const {
+    double drawn = games > 0 ? static_cast<double>(draws) / games : 0;
+    double sum = drawn * drawn;
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+      sum += contribution[type] * contribution[type];
+    }
+    return sum;
+  }
+};
+
+/*!
+ * \brief Plays one tournament game with a stat table.
+ * \param config The tournament settings.
+ * \param table The unit statistics.
+ * \param seed The seed of the game.
+ * \param evaluator Scores children for greedy moves.
+ * \param fielded Receives the number of units of each type of both players
+ * once placement ends.
+ * \param turns Receives the number of battle turns played.
+ * \return The winner (0 or 1), or -1 for a draw.
+ */
+inline int playBalanceGame(const TournamentConfig &config,
+                           const StatTable &table, std::uint32_t seed,
+                           Evaluator &evaluator,
+                           int fielded[2][UNIT_TYPES], int &turns) {
+  GameState state(config.rows, config.cols, config.maxNPC);
+  table.applyTo(state);
+  state.generateTall(seed, config.number_of_tall);
+  std::mt19937 rng(seed);
+  std::vector<Action> actions;
+  while (state.isPlacement()) {
+    state.generateActions(actions);
+    if (actions.empty()) {
+      break;
+    }
+    size_t places = actions.size();
+    if (actions.back().kind == FinishPlacement) {
+      places -= 1;
+    }
+    state.apply(places > 0 ? actions[rng() % places] : actions.back());
+  }
+  for (int player = 0; player < 2; ++player) {
+    std::fill(fielded[player], fielded[player] + UNIT_TYPES, 0);
+    for (const Unit &unit : state.getUnits(player)) {
+      fielded[player][unit.type] += 1;
+    }
+  }
+  ActionUndo undo;
+  while (!state.isFinished() && state.getTurn() < config.maxTurns) {
+    state.generateActions(actions);
+    if (actions.empty()) {
+      break;
+    }
+    size_t choice = rng() % actions.size();
+    if (static_cast<int>(rng() % 100) < config.greedyPercent) {
+      int best = -Evaluator::WIN_SCORE - 1;
+      for (size_t k = 0; k < actions.size(); ++k) {
+        state.make(actions[k], undo);
+        int score = -evaluator.evaluate(state);
+        state.unmake(undo);
+        if (score > best) {
+          best = score;
+          choice = k;
+        }
+      }
+    }
+    state.apply(actions[choice]);
+  }
+  turns = state.getTurn();
+  return state.getWinner();
+}
+
+/*!
+ * \brief Plays a tournament on a thread pool.
+ *
+ * Games are split into tasks of gamesPerTask games; each task sums its own
+ * tallies, so the result does not depend on the number of workers.
+ * \param config The tournament settings.
+ * \param table The unit statistics.
+ * \param pool The workers.
+ * \return The tallies of all games.
+ */
+inline TournamentResult playTournament(const TournamentConfig &config,
+                                       const StatTable &table,
+                                       ThreadPool &pool) {
+  std::mutex mutex;
+  TournamentResult result;
+  double score[UNIT_TYPES] = {};
+  int step = std::max(config.gamesPerTask, 1);
+  for (int first = 0; first < config.games; first += step) {
+    int last = std::min(first + step, config.games);
+    pool.post([&, first, last] {
+      TournamentResult local;
+      double localScore[UNIT_TYPES] = {};
+      Evaluator evaluator;
+      int fielded[2][UNIT_TYPES];
+      for (int game = first; game < last; ++game) {
+        int turns = 0;
+        int winner = playBalanceGame(config, table,
+                                     config.seed + static_cast<std::uint32_t>(
+                                                       game),
+                                     evaluator, fielded, turns);
+        local.games += 1;
+        local.turns += turns;
+        if (winner == -1) {
+          local.draws += 1;
+        } else {
+          local.wins[winner] += 1;
+        }
+        // Score of player 0: 1 for a win, 0 for a draw, -1 for a loss.
+        int outcome = winner == -1 ? 0 : (winner == 0 ? 1 : -1);
+        for (int type = 0; type < UNIT_TYPES; ++type) {
+          int lead = fielded[0][type] - fielded[1][type];
+          if (lead != 0) {
+            local.contested[type] += 1;
+            localScore[type] += lead > 0 ? outcome : -outcome;
+          }
+        }
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      result.games += local.games;
+      result.turns += local.turns;
+      result.draws += local.draws;
+      for (int player = 0; player < 2; ++player) {
+        result.wins[player] += local.wins[player];
+      }
+      for (int type = 0; type < UNIT_TYPES; ++type) {
+        result.contested[type] += local.contested[type];
+        score[type] += localScore[type];
+      }
+    });
+  }
+  pool.wait();
+  for (int type = 0; type < UNIT_TYPES; ++type) {
+    result.contribution[type] =
+        result.contested[type] > 0 ? score[type] / result.contested[type] : 0;
+  }
+  return result;
+}
+
+/*!
+ * \brief Simultaneous perturbation stochastic approximation over the HP,
+ * range and attack of every unit type.
+ *
+ * Each step plays two tournaments, with all parameters nudged up or down
+ * by random signs, on the same seeds, and moves every parameter against
+ * the measured slope of imbalance(). Two tournaments per step whatever the
+ * number of parameters is what makes it affordable; healAmount is left
+ * alone since the rules have no healing yet.
+ */
+class SpsaBalancer {
+public:
+  static const int PARAMETERS = 3 * UNIT_TYPES;
+
+  /*!
+   * \brief Constructor for SpsaBalancer with specified parameters.
+   * \param start The table to start from.
+   * \param config The tournament of each evaluation.
+   * \param seed The seed of the perturbations.
+   */
+  SpsaBalancer(const StatTable &start, const TournamentConfig &config,
+               std::uint32_t seed = 1)
+      : table(start), config(config), rng(seed), iteration(0) {
+    for (int k = 0; k < PARAMETERS; ++k) {
+      theta[k] = parameter(table, k);
+      scale[k] = std::max(1.0, theta[k]);
+    }
+  }
+
+  /*!
+   * \brief Runs one step.
+   * \param pool The workers of the tournaments.
+   * \return The mean imbalance of the two tournaments.
+   */
+  double step(ThreadPool &pool) {
+    ++iteration;
+    // Standard SPSA gain sequences, in units of each starting value, so
+    // that HP and ranges move by similar fractions.
+    double a = 1.0 / std::pow(iteration + 5.0, 0.602);
+    double c = 0.15 / std::pow(iteration, 0.101);
+    double delta[PARAMETERS];
+    double spread[PARAMETERS];
+    StatTable plus = table;
+    StatTable minus = table;
+    for (int k = 0; k < PARAMETERS; ++k) {
+      delta[k] = rng() % 2 == 0 ? 1.0 : -1.0;
+      // Parameters are integers: a smaller nudge would round to nothing.
+      spread[k] = std::max(1.0, c * scale[k]);
+      setParameter(plus, k, theta[k] + spread[k] * delta[k]);
+      setParameter(minus, k, theta[k] - spread[k] * delta[k]);
+    }
+    TournamentConfig games = config;
+    games.seed = config.seed + iteration * static_cast<std::uint32_t>(
+                                               config.games);
+    last[0] = playTournament(games, plus, pool);
+    last[1] = playTournament(games, minus, pool);
+    double difference = last[0].imbalance() - last[1].imbalance();
+    for (int k = 0; k < PARAMETERS; ++k) {
+      double gradient = difference / (2 * spread[k] * delta[k]);
+      theta[k] = std::max(theta[k] - a * scale[k] * scale[k] * gradient, 1.0);
+      setParameter(table, k, theta[k]);
+    }
+    return (last[0].imbalance() + last[1].imbalance()) / 2;
+  }
+
+  /*!
+   * \brief Gets the current table, parameters rounded.
+   */
+  const StatTable &getTable() const { return table; }
+
+  /*!
+   * \brief Gets the tournament of the upward (0) or downward (1)
+   * perturbation of the last step.
+   */
+  const TournamentResult &lastTournament(int side) const { return last[side]; }
+
+  /*!
+   * \brief Reads one balanced parameter: HP, range or attack of a type.
+   * \param table The table.
+   * \param k The parameter, 3 * type + 0 (HP), 1 (range) or 2 (attack).
+   */
+  static int parameter(const StatTable &table, int k) {
+    const UnitStats &stats = table.unit[k / 3];
+    return k % 3 == 0 ? stats.HP
+                      : (k % 3 == 1 ? stats.attack_diapason : stats.attack);
+  }
+
+  /*!
+   * \brief Writes one balanced parameter, rounded and at least 1.
+   */
+  static void setParameter(StatTable &table, int k, double value) {
+    int rounded = std::max(1, static_cast<int>(std::lround(value)));
+    UnitStats &stats = table.unit[k / 3];
+    (k % 3 == 0 ? stats.HP
+                : (k % 3 == 1 ? stats.attack_diapason : stats.attack)) =
+        rounded;
+  }
+
+private:
+  StatTable table;
+  TournamentConfig config;
+  std::mt19937 rng;
+  int iteration;
+  double theta[PARAMETERS];
+  double scale[PARAMETERS];
+  TournamentResult last[2];
+};
+
+#endif
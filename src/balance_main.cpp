@@ -0,0 +1,163 @@
+/*!
+ * \file balance_main.cpp
+ * \brief Searches unit statistics for which no unit type decides games
+ *
+ * Plays tournaments of self-play games on a thread pool and reports, per
+ * unit type, how much fielding more of it than the enemy wins games (see
+ * TournamentResult). Either sweeps one parameter over a range:
+ *   strateg_balance --mode=grid --grid=archer.attack:1:6:1 --games=4000
+ * or tunes HP, range and attack of every type together with SPSA:
+ *   strateg_balance --mode=spsa --iterations=50 --games=2000 --threads=8
+ */
+
+#include "balance.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+static const char *TYPE_NAMES[UNIT_TYPES] = {"knight", "archer", "cleric"};
+static const char *PARAMETER_NAMES[3] = {"hp", "range", "attack"};
+
+static void printTable(const StatTable &table) {
+  for (int type = 0; type < UNIT_TYPES; ++type) {
+    const UnitStats &stats = table.unit[type];
+    std::cout << "  " << std::setw(6) << TYPE_NAMES[type]
+              << ": HP=" << stats.HP << " range=" << stats.attack_diapason
+              << " attack=" << stats.attack << std::endl;
+  }
+}
+
+static void printResult(const TournamentResult &result) {
+  std::cout << "  games=" << result.games << " P1=" << result.wins[0]
+            << " P2=" << result.wins[1] << " draws=" << result.draws
+            << " turns/game="
+            << (result.games > 0 ? result.turns / result.games : 0)
+            << std::endl;
+  std::cout << "  contribution:";
+  for (int type = 0; type < UNIT_TYPES; ++type) {
+    std::cout << " " << TYPE_NAMES[type] << "=" << std::showpos
+              << std::fixed << std::setprecision(3)
+              << result.contribution[type] << std::noshowpos;
+  }
+  std::cout << " imbalance=" << result.imbalance() << std::endl;
+}
+
+/*!
+ * \brief Parses "type.parameter:lo:hi:step" into a parameter index of
+ * SpsaBalancer and its range.
+ */
+static bool parseGrid(const std::string &text, int &parameter, int &lo,
+                      int &hi, int &step) {
+  size_t dot = text.find('.');
+  size_t colon = text.find(':');
+  if (dot == std::string::npos || colon == std::string::npos || dot > colon) {
+    return false;
+  }
+  std::string type = text.substr(0, dot);
+  std::string name = text.substr(dot + 1, colon - dot - 1);
+  parameter = -1;
+  for (int t = 0; t < UNIT_TYPES; ++t) {
+    for (int p = 0; p < 3; ++p) {
+      if (type == TYPE_NAMES[t] && name == PARAMETER_NAMES[p]) {
+        parameter = 3 * t + p;
+      }
+    }
+  }
+  step = 1;
+  int fields = std::sscanf(text.c_str() + colon, ":%d:%d:%d", &lo, &hi, &step);
+  return parameter >= 0 && fields >= 2 && step > 0 && lo <= hi;
+}
+
+int main(int argc, char **argv) {
+  TournamentConfig config;
+  std::string mode = "spsa";
+  std::string grid = "knight.attack:1:5:1";
+  int iterations = 20;
+  int threads = 0;
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string text = arg.substr(arg.find('=') + 1);
+    int value = std::atoi(text.c_str());
+    if (arg.rfind("--mode=", 0) == 0) {
+      mode = text;
+    } else if (arg.rfind("--grid=", 0) == 0) {
+      grid = text;
+      mode = "grid";
+    } else if (arg.rfind("--games=", 0) == 0) {
+      config.games = value;
+    } else if (arg.rfind("--iterations=", 0) == 0) {
+      iterations = value;
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = value;
+    } else if (arg.rfind("--rows=", 0) == 0) {
+      config.rows = value;
+    } else if (arg.rfind("--cols=", 0) == 0) {
+      config.cols = value;
+    } else if (arg.rfind("--units=", 0) == 0) {
+      config.maxNPC = value;
+    } else if (arg.rfind("--max-turns=", 0) == 0) {
+      config.maxTurns = value;
+    } else if (arg.rfind("--greedy=", 0) == 0) {
+      config.greedyPercent = value;
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      config.seed = static_cast<std::uint32_t>(value);
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  ThreadPool pool(threads);
+  std::cout << "Tournaments of " << config.games << " games on "
+            << pool.size() << " threads" << std::endl;
+  StatTable table = StatTable::defaults();
+  if (mode == "grid") {
+    int parameter = 0;
+    int lo = 0;
+    int hi = 0;
+    int step = 1;
+    if (!parseGrid(grid, parameter, lo, hi, step)) {
+      std::cerr << "Expected --grid=type.(hp|range|attack):lo:hi[:step]"
+                << std::endl;
+      return 2;
+    }
+    int best = lo;
+    double lowest = -1;
+    for (int value = lo; value <= hi; value += step) {
+      SpsaBalancer::setParameter(table, parameter, value);
+      TournamentResult result = playTournament(config, table, pool);
+      std::cout << TYPE_NAMES[parameter / 3] << "."
+                << PARAMETER_NAMES[parameter % 3] << "=" << value
+                << std::endl;
+      printResult(result);
+      if (lowest < 0 || result.imbalance() < lowest) {
+        lowest = result.imbalance();
+        best = value;
+      }
+    }
+    std::cout << "Most balanced: " << TYPE_NAMES[parameter / 3] << "."
+              << PARAMETER_NAMES[parameter % 3] << "=" << best << std::endl;
+    return 0;
+  }
+  if (mode != "spsa") {
+    std::cerr << "Unknown mode " << mode << std::endl;
+    return 2;
+  }
+
+  std::cout << "Start" << std::endl;
+  printTable(table);
+  printResult(playTournament(config, table, pool));
+  SpsaBalancer balancer(table, config, config.seed);
+  for (int iteration = 1; iteration <= iterations; ++iteration) {
+    double imbalance = balancer.step(pool);
+    std::cout << "Iteration " << iteration << ": imbalance " << imbalance
+              << std::endl;
+    printTable(balancer.getTable());
+  }
+  std::cout << "Final" << std::endl;
+  printTable(balancer.getTable());
+  printResult(playTournament(config, balancer.getTable(), pool));
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include "balance.h"
+#include "doctest.h"
+
+TEST_CASE("GameState Class: Unit Stats Can Be Overridden") {
+    GameState state(8, 8, 3);
+    UnitStats knight = defaultUnitStats(0);
+    knight.HP = 70;
+    knight.attack = 45;
+    state.setUnitStats(0, knight);
+    UnitStats archer = defaultUnitStats(1);
+    archer.attack_diapason = 1;
+    state.setUnitStats(1, archer);
+    CHECK(state.getUnitStats(0).HP == 70);
+    CHECK(state.getUnitStats(2).HP == defaultUnitStats(2).HP);
+
+    state.apply(GameState::makeAction(PlaceUnit, 0, 0, -1, state.cellIndex(3, 1)));
+    state.apply(GameState::makeAction(PlaceUnit, 1, 1, -1, state.cellIndex(3, 6)));
+    state.apply(GameState::makeAction(FinishPlacement, 0, 0, -1, -1));
+    CHECK(state.getUnits(0)[0].HP == 70);
+    CHECK(state.getUnits(1)[0].HP == 30);
+
+    // The archer now only reaches adjacent hexes.
+    state.apply(GameState::makeAction(MoveUnit, 0, 0, state.cellIndex(3, 1), state.cellIndex(3, 2)));
+    CHECK_FALSE(state.isLegal(GameState::makeAction(AttackUnit, 1, 0, state.cellIndex(3, 6), state.cellIndex(3, 2))));
+    state.apply(GameState::makeAction(MoveUnit, 1, 0, state.cellIndex(3, 6), state.cellIndex(3, 5)));
+    state.apply(GameState::makeAction(MoveUnit, 0, 0, state.cellIndex(3, 2), state.cellIndex(3, 3)));
+    state.apply(GameState::makeAction(MoveUnit, 1, 0, state.cellIndex(3, 5), state.cellIndex(3, 4)));
+    // One blow of the strengthened knight kills the archer.
+    CHECK(state.apply(GameState::makeAction(AttackUnit, 0, 0, state.cellIndex(3, 3), state.cellIndex(3, 4))));
+    CHECK(state.isFinished());
+    CHECK(state.getWinner() == 0);
+}
+
+TEST_CASE("playTournament Function: Results Do Not Depend On Threads") {
+    TournamentConfig config;
+    config.games = 300;
+    config.gamesPerTask = 16;
+    StatTable table = StatTable::defaults();
+    ThreadPool one(1);
+    ThreadPool four(4);
+    TournamentResult a = playTournament(config, table, one);
+    TournamentResult b = playTournament(config, table, four);
+    CHECK(a.games == 300);
+    CHECK(a.wins[0] + a.wins[1] + a.draws == 300);
+    CHECK(a.wins[0] == b.wins[0]);
+    CHECK(a.draws == b.draws);
+    CHECK(a.turns == b.turns);
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+        CHECK(a.contested[type] == b.contested[type]);
+        CHECK(a.contribution[type] == b.contribution[type]);
+    }
+}
+
+TEST_CASE("playTournament Function: An Overpowered Unit Stands Out") {
+    TournamentConfig config;
+    config.games = 600;
+    ThreadPool pool(2);
+    StatTable table = StatTable::defaults();
+    double before = playTournament(config, table, pool).contribution[0];
+    table.unit[0].HP = 500;
+    table.unit[0].attack = 500;
+    TournamentResult strong = playTournament(config, table, pool);
+    CHECK(strong.contribution[0] > 0.3);
+    CHECK(strong.contribution[0] > before + 0.2);
+    CHECK(strong.imbalance() > 0.09);
+}
+
+TEST_CASE("SpsaBalancer Class: Parameters Stay Valid") {
+    StatTable table = StatTable::defaults();
+    SpsaBalancer::setParameter(table, 4, 3.4);
+    SpsaBalancer::setParameter(table, 8, -7);
+    CHECK(table.unit[1].attack_diapason == 3);
+    CHECK(table.unit[2].attack == 1);
+    CHECK(SpsaBalancer::parameter(table, 0) == defaultUnitStats(0).HP);
+
+    TournamentConfig config;
+    config.games = 64;
+    ThreadPool pool(2);
+    SpsaBalancer balancer(table, config);
+    double imbalance = balancer.step(pool);
+    CHECK(imbalance >= 0);
+    for (int k = 0; k < SpsaBalancer::PARAMETERS; ++k) {
+        CHECK(SpsaBalancer::parameter(balancer.getTable(), k) >= 1);
+    }
+    CHECK(balancer.lastTournament(0).games == 64);
+}
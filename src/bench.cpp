@@ -0,0 +1,447 @@
+/*!
+ * \file bench.cpp
+ * \brief Micro-benchmarks of hit-testing, rules and full-game simulation
+ */
+
+#include "benchmark.h"
+#include "evaluation.h"
+#include "func.h"
+#include "game.h"
+#include "neural.h"
+#include "pathfinding.h"
+#include "placement_book.h"
+#include "protocol.h"
+#include "search.h"
+#include "threat.h"
+
+/*!
+ * \brief Builds the board layout of main.cpp with the given size.
+ */
+static std::vector<std::vector<Circle>> makeBoard(int rows, int cols,
+                                                  float R) {
+  float r = (R * std::sqrt(3)) / 2;
+  std::vector<std::vector<Circle>> circles(rows, std::vector<Circle>(cols));
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      float x = j * (r * 2) + (i % 2 == 1 ? r : 0);
+      float y = i * (R * 1.5f);
+      circles[i][j] =
+          Circle(R, sf::Color(115, 144, 46), sf::Color(0, 90, 50), 2.f);
+      circles[i][j].setPosition(x, y);
+    }
+  }
+  return circles;
+}
+
+/*!
+ * \brief Deploys maxNPC random units per side on a fresh board.
+ */
+static GameState makeDeployedGame(int size, int maxNPC, std::uint32_t seed) {
+  GameState state(size, size, maxNPC);
+  state.generateTall(seed, size * size / 16);
+  std::mt19937 rng(seed);
+  std::vector<Action> actions;
+  while (state.isPlacement()) {
+    state.generateActions(actions);
+    size_t places = actions.size();
+    if (!actions.empty() && actions.back().kind == FinishPlacement) {
+      places -= 1;
+    }
+    state.apply(places > 0 ? actions[rng() % places] : actions.back());
+  }
+  return state;
+}
+
+static void BM_CircleIsClicked(benchmark::State &state) {
+  Circle circle(50, sf::Color::Blue, sf::Color::Yellow, 2, 6);
+  circle.setPosition(100, 150);
+  int k = 0;
+  for (auto _ : state) {
+    sf::Vector2i mouse(100 + (k & 127), 150 + ((k >> 7) & 127));
+    benchmark::DoNotOptimize(circle.isClicked(mouse, 43.3f));
+    ++k;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CircleIsClicked);
+
+static void BM_BoardHitTest(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  float R = 50.f;
+  float r = (R * std::sqrt(3)) / 2;
+  std::vector<std::vector<Circle>> circles = makeBoard(size, size, R);
+  sf::FloatRect last = circles[size - 1][size - 1].getBounds();
+  int width = static_cast<int>(last.left + last.width);
+  int height = static_cast<int>(last.top + last.height);
+  std::mt19937 rng(1);
+  for (auto _ : state) {
+    sf::Vector2i mouse(rng() % width, rng() % height);
+    int hit = -1;
+    for (int i = 0; i < size && hit == -1; ++i) {
+      for (int j = 0; j < size; ++j) {
+        if (circles[i][j].isClicked(mouse, r)) {
+          hit = i * size + j;
+          break;
+        }
+      }
+    }
+    benchmark::DoNotOptimize(hit);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BoardHitTest)->Arg(8)->Arg(32)->Arg(128);
+
+static void BM_DestinationBetweenCircle(benchmark::State &state) {
+  std::vector<std::vector<Circle>> circles = makeBoard(8, 8, 50.f);
+  int k = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(DestinationBetweenCircle(
+        circles[k & 7][(k >> 3) & 7], circles[(k >> 6) & 7][(k >> 9) & 7]));
+    ++k;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DestinationBetweenCircle);
+
+static void BM_CreateCharacter(benchmark::State &state) {
+  int type = static_cast<int>(state.range(0));
+  bool player = true;
+  for (auto _ : state) {
+    NPC npc = createCharacter(type, 43.3f, player);
+    benchmark::DoNotOptimize(npc);
+    player = !player;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CreateCharacter)->DenseRange(0, 2);
+
+static void BM_GenerateActions(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  GameState game = makeDeployedGame(size, std::min(size, 16), 3);
+  std::vector<Action> actions;
+  size_t generated = 0;
+  for (auto _ : state) {
+    game.generateActions(actions);
+    generated += actions.size();
+    benchmark::DoNotOptimize(actions.data());
+  }
+  state.SetItemsProcessed(generated);
+}
+BENCHMARK(BM_GenerateActions)->Arg(8)->Arg(64)->Arg(512);
+
+static void BM_SimulateGame(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  GameState start(size, size, std::min(size, 8));
+  start.generateTall(5, size * size / 16);
+  std::mt19937 rng(5);
+  std::int64_t turns = 0;
+  for (auto _ : state) {
+    GameState game = start;
+    benchmark::DoNotOptimize(simulateRandomGame(game, rng, 2000));
+    turns += game.getTurn();
+  }
+  state.SetItemsProcessed(turns);
+  state.SetLabel("items=turns");
+}
+BENCHMARK(BM_SimulateGame)->Arg(8)->Arg(16)->Arg(32);
+
+/*!
+ * \brief Visits every child of a position the way search without undo has
+ * to: copy the state, then apply.
+ */
+static void BM_CopyApplyChildren(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  GameState game = makeDeployedGame(size, std::min(size, 16), 3);
+  std::vector<Action> actions;
+  game.generateActions(actions);
+  for (auto _ : state) {
+    for (const Action &action : actions) {
+      GameState child = game;
+      child.apply(action);
+      benchmark::DoNotOptimize(child.hash());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * actions.size());
+}
+BENCHMARK(BM_CopyApplyChildren)->Arg(8)->Arg(64)->Arg(512);
+
+static void BM_MakeUnmakeChildren(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  GameState game = makeDeployedGame(size, std::min(size, 16), 3);
+  std::vector<Action> actions;
+  game.generateActions(actions);
+  ActionUndo undo;
+  for (auto _ : state) {
+    for (const Action &action : actions) {
+      game.make(action, undo);
+      benchmark::DoNotOptimize(game.hash());
+      game.unmake(undo);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * actions.size());
+}
+BENCHMARK(BM_MakeUnmakeChildren)->Arg(8)->Arg(64)->Arg(512);
+
+static void BM_FindPath(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  GameState game = makeDeployedGame(size, std::min(size, 16), 3);
+  PathFinder finder;
+  std::vector<int> path;
+  int from = game.getUnits(0)[0].cell;
+  int to = game.cellIndex(size / 2, size - 3);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(finder.findPath(game, from, to, path));
+  }
+  state.SetLabel("steps=" + std::to_string(path.size()));
+}
+BENCHMARK(BM_FindPath)->Arg(8)->Arg(64)->Arg(512);
+
+static void BM_ReachableArea(benchmark::State &state) {
+  GameState game = makeDeployedGame(512, 16, 3);
+  PathFinder finder;
+  std::vector<int> area;
+  int from = game.cellIndex(256, 256);
+  int budget = static_cast<int>(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(finder.reachable(game, from, budget, area));
+  }
+  state.SetItemsProcessed(state.iterations() * area.size());
+}
+BENCHMARK(BM_ReachableArea)->Arg(4)->Arg(16)->Arg(64);
+
+/*!
+ * \brief Plays a deployed game forward and records the undo of every action.
+ */
+static std::vector<ActionUndo> playRecorded(GameState &game, int actions) {
+  std::mt19937 rng(5);
+  std::vector<Action> legal;
+  std::vector<ActionUndo> history;
+  while (static_cast<int>(history.size()) < actions && !game.isFinished()) {
+    game.generateActions(legal);
+    if (legal.empty()) {
+      break;
+    }
+    history.emplace_back();
+    game.make(legal[rng() % legal.size()], history.back());
+  }
+  return history;
+}
+
+static void BM_ThreatRebuild(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  GameState game = makeDeployedGame(size, std::min(size, 16), 3);
+  ThreatMap map;
+  for (auto _ : state) {
+    map.rebuild(game);
+    benchmark::DoNotOptimize(map.influence(0));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreatRebuild)->Arg(8)->Arg(64)->Arg(512);
+
+static void BM_ThreatUpdate(benchmark::State &state) {
+  int size = static_cast<int>(state.range(0));
+  GameState game = makeDeployedGame(size, std::min(size, 16), 3);
+  std::vector<ActionUndo> history = playRecorded(game, 64);
+  for (size_t k = history.size(); k-- > 0;) {
+    game.unmake(history[k]);
+  }
+  ThreatMap map;
+  map.rebuild(game);
+  for (auto _ : state) {
+    for (ActionUndo &undo : history) {
+      game.make(undo.action, undo);
+      map.update(game, undo);
+    }
+    for (size_t k = history.size(); k-- > 0;) {
+      game.unmake(history[k]);
+      map.revert(game, history[k]);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * history.size() * 2);
+}
+BENCHMARK(BM_ThreatUpdate)->Arg(8)->Arg(64)->Arg(512);
+
+/*!
+ * \brief Evaluates battle positions with one kernel: items/s is evaluations
+ * per second on one core. Kernels the CPU lacks fall back to the best one.
+ */
+static void BM_Evaluate(benchmark::State &state) {
+  Evaluator::Kernel kernel = static_cast<Evaluator::Kernel>(state.range(0));
+  int units = static_cast<int>(state.range(1));
+  std::vector<GameState> positions;
+  for (std::uint32_t seed = 0; seed < 16; ++seed) {
+    positions.push_back(makeDeployedGame(16, units, seed));
+    playRecorded(positions.back(), 20);
+  }
+  Evaluator evaluator;
+  evaluator.setKernel(kernel);
+  size_t next = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(evaluator.evaluate(positions[next]));
+    next = (next + 1) % positions.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(Evaluator::kernelName(evaluator.getKernel()));
+}
+BENCHMARK(BM_Evaluate)
+    ->Args({0, 4})
+    ->Args({1, 4})
+    ->Args({2, 4})
+    ->Args({0, 16})
+    ->Args({1, 16})
+    ->Args({2, 16})
+    ->Args({0, 32})
+    ->Args({1, 32})
+    ->Args({2, 32});
+
+/*!
+ * \brief Scores the children of a position with the neural evaluator: the
+ * accumulators follow make() and unmake() and each child is evaluated once.
+ */
+static void BM_NeuralEvaluate(benchmark::State &state) {
+  NeuralEvaluator network;
+  network.randomize(16, 16, 128, 1);
+  network.setKernel(static_cast<Evaluator::Kernel>(state.range(0)));
+  GameState game = makeDeployedGame(16, 16, 3);
+  network.refresh(game);
+  std::vector<Action> actions;
+  game.generateActions(actions);
+  ActionUndo undo;
+  for (auto _ : state) {
+    for (const Action &action : actions) {
+      game.make(action, undo);
+      network.update(game, undo);
+      benchmark::DoNotOptimize(network.evaluate(game));
+      game.unmake(undo);
+      network.revert(game, undo);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * actions.size());
+  state.SetLabel(Evaluator::kernelName(network.getKernel()));
+}
+BENCHMARK(BM_NeuralEvaluate)->Arg(0)->Arg(1)->Arg(2);
+
+/*!
+ * \brief Searches a battle position to a fixed depth from an empty
+ * transposition table: items/s is nodes per second.
+ */
+static void BM_AlphaBetaSearch(benchmark::State &state) {
+  GameState game = makeDeployedGame(8, 3, 5);
+  playRecorded(game, 10);
+  AlphaBetaSearch search;
+  SearchLimits limits;
+  limits.depth = static_cast<int>(state.range(0));
+  std::int64_t nodes = 0;
+  for (auto _ : state) {
+    search.clear();
+    nodes += search.search(game, limits).nodes;
+  }
+  state.SetItemsProcessed(nodes);
+}
+BENCHMARK(BM_AlphaBetaSearch)->Arg(2)->Arg(3)->Arg(4);
+
+/*!
+ * \brief Scores the three best root actions exactly, as the analysis mode
+ * does at each depth.
+ */
+static void BM_MultiPvSearch(benchmark::State &state) {
+  GameState game = makeDeployedGame(8, 3, 5);
+  playRecorded(game, 10);
+  AlphaBetaSearch search;
+  SearchLimits limits;
+  limits.depth = static_cast<int>(state.range(0));
+  limits.multiPv = 3;
+  std::int64_t nodes = 0;
+  for (auto _ : state) {
+    search.clear();
+    nodes += search.search(game, limits).nodes;
+  }
+  state.SetItemsProcessed(nodes);
+}
+BENCHMARK(BM_MultiPvSearch)->Arg(3);
+
+/*!
+ * \brief Looks up the blind deployment of player 0 and the answer of
+ * player 1 in a book of 16 maps.
+ */
+static void BM_PlacementBookLookup(benchmark::State &state) {
+  std::vector<GameState> maps;
+  for (std::uint32_t seed = 1; seed <= 16; ++seed) {
+    maps.emplace_back(8, 8, 3);
+    maps.back().generateTall(seed, 4);
+  }
+  BookSettings settings;
+  settings.depth = 1;
+  ThreadPool pool(1);
+  std::vector<std::uint8_t> bytes;
+  PlacementBook::build(maps, settings, pool, bytes);
+  PlacementBook book;
+  book.assign(bytes);
+  GameState deployed = maps[3];
+  BookEntry first;
+  book.lookup(deployed, 0, first);
+  for (const Action &action : first.actions) {
+    deployed.apply(action);
+  }
+  BookEntry entry;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(book.lookup(maps[3], 0, entry));
+    benchmark::DoNotOptimize(book.lookup(deployed, 1, entry));
+  }
+}
+BENCHMARK(BM_PlacementBookLookup);
+
+/*!
+ * \brief Encodes a batch of random legal actions of deployed games.
+ */
+static std::vector<Action> makeActionBatch(size_t count) {
+  GameState game = makeDeployedGame(16, 8, 11);
+  std::vector<Action> legal;
+  game.generateActions(legal);
+  std::vector<Action> batch;
+  for (size_t k = 0; k < count; ++k) {
+    batch.push_back(legal[k % legal.size()]);
+  }
+  return batch;
+}
+
+static void BM_EncodeActionBatch(benchmark::State &state) {
+  std::vector<Action> batch =
+      makeActionBatch(static_cast<size_t>(state.range(0)));
+  std::vector<std::uint8_t> buffer;
+  buffer.reserve(BATCH_HEADER_SIZE + batch.size() * FRAME_SIZE);
+  for (auto _ : state) {
+    buffer.clear();
+    FrameWriter writer(buffer);
+    for (size_t k = 0; k < batch.size(); ++k) {
+      writer.writeAction(batch[k], static_cast<std::uint8_t>(k));
+    }
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_EncodeActionBatch)->Arg(64)->Arg(4096);
+
+static void BM_ParseActionBatch(benchmark::State &state) {
+  std::vector<Action> batch =
+      makeActionBatch(static_cast<size_t>(state.range(0)));
+  std::vector<std::uint8_t> buffer;
+  FrameWriter writer(buffer);
+  for (const Action &action : batch) {
+    writer.writeAction(action);
+  }
+  for (auto _ : state) {
+    std::int64_t sum = 0;
+    bool error = false;
+    parseBatches(buffer.data(), buffer.size(), [&sum](FrameView frame) {
+      Action action = frame.toAction();
+      sum += action.from + action.to;
+    }, error);
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParseActionBatch)->Arg(64)->Arg(4096);
+
+BENCHMARK_MAIN();
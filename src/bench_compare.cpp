@@ -0,0 +1,158 @@
+/*!
+ * \file bench_compare.cpp
+ * \brief Runs StrategBench and fails when a benchmark regressed against the
+ * committed baseline
+ *
+ * Usage: StrategBenchCompare --bench=<StrategBench> --baseline=<file.json>
+ *        [--repetitions=3] [--min-time=0.2] [--filter=<regex>] [--update]
+ */
+
+#include "bench_compare.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+/*!
+ * \brief Reads a whole file and parses it as JSON.
+ */
+static bool loadJson(const std::string &path, JsonValue &out) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Error with " << path << std::endl;
+    return false;
+  }
+  std::stringstream content;
+  content << in.rdbuf();
+  std::string error;
+  if (!JsonValue::parse(content.str(), out, error)) {
+    std::cerr << "Error with " << path << ": " << error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/*!
+ * \brief Runs the benchmark executable and reads its JSON report.
+ */
+static bool runBenchmarks(const std::string &bench, const std::string &filter,
+                          int repetitions, const std::string &minTime,
+                          std::map<std::string, double> &out) {
+  const std::string report = "bench_current.json";
+  std::string command = "\"" + bench + "\" --benchmark_out=" + report +
+                        " --benchmark_repetitions=" +
+                        std::to_string(repetitions) +
+                        " --benchmark_min_time=" + minTime +
+                        " \"--benchmark_filter=" + filter + "\"";
+  std::cout << command << std::endl;
+  if (std::system(command.c_str()) != 0) {
+    std::cerr << "Error with " << bench << std::endl;
+    return false;
+  }
+  JsonValue document;
+  return loadJson(report, document) && readBenchmarkTimes(document, out);
+}
+
+int main(int argc, char **argv) {
+  std::string bench;
+  std::string baselinePath;
+  std::string filter = ".";
+  std::string minTime = "0.2";
+  int repetitions = 3;
+  bool update = false;
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string value = arg.substr(arg.find('=') + 1);
+    if (arg.rfind("--bench=", 0) == 0) {
+      bench = value;
+    } else if (arg.rfind("--baseline=", 0) == 0) {
+      baselinePath = value;
+    } else if (arg.rfind("--filter=", 0) == 0) {
+      filter = value;
+    } else if (arg.rfind("--min-time=", 0) == 0) {
+      minTime = value;
+    } else if (arg.rfind("--repetitions=", 0) == 0) {
+      repetitions = std::max(1, std::atoi(value.c_str()));
+    } else if (arg == "--update") {
+      update = true;
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+  if (bench.empty() || baselinePath.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " --bench=<StrategBench> --baseline=<file.json> [--update]"
+              << std::endl;
+    return 2;
+  }
+
+  JsonValue baselineDocument;
+  std::vector<BaselineEntry> baseline;
+  double defaultTolerance = 0.25;
+  if (loadJson(baselinePath, baselineDocument)) {
+    readBaseline(baselineDocument, baseline);
+    defaultTolerance = baselineDocument.numberOr("default_tolerance", 0.25);
+  } else if (!update) {
+    return 2;
+  }
+
+  std::map<std::string, double> current;
+  if (!runBenchmarks(bench, filter, repetitions, minTime, current)) {
+    return 2;
+  }
+
+  if (update) {
+    std::ofstream out(baselinePath);
+    out << writeBaseline(baseline, current, defaultTolerance);
+    std::cout << "Baseline written to " << baselinePath << std::endl;
+    return out ? 0 : 2;
+  }
+
+  std::vector<BenchComparison> comparisons =
+      compareToBaseline(baseline, current);
+
+  // Rerun suspected regressions once so that a single noisy run does not
+  // fail the gate; a benchmark fails only if it is slow in both runs.
+  std::string suspects;
+  for (const BenchComparison &comparison : comparisons) {
+    if (comparison.regressed && !comparison.missing) {
+      suspects += (suspects.empty() ? "" : "|") + comparison.name;
+    }
+  }
+  if (!suspects.empty()) {
+    std::map<std::string, double> retry;
+    if (runBenchmarks(bench, "^(" + suspects + ")$", repetitions, minTime,
+                      retry)) {
+      for (const std::pair<const std::string, double> &run : retry) {
+        current[run.first] = std::min(current[run.first], run.second);
+      }
+      comparisons = compareToBaseline(baseline, current);
+    }
+  }
+
+  int regressions = 0;
+  std::printf("\n%-40s %14s %14s %8s %6s\n", "Benchmark", "baseline ns",
+              "current ns", "change", "limit");
+  for (const BenchComparison &comparison : comparisons) {
+    if (comparison.missing) {
+      std::printf("%-40s %14.1f %14s %8s %6s  MISSING\n",
+                  comparison.name.c_str(), comparison.baseline, "-", "-", "-");
+    } else {
+      std::printf("%-40s %14.1f %14.1f %+7.1f%% %+5.0f%%%s\n",
+                  comparison.name.c_str(), comparison.baseline,
+                  comparison.current,
+                  (comparison.current / comparison.baseline - 1.0) * 100.0,
+                  comparison.tolerance * 100.0,
+                  comparison.regressed ? "  REGRESSION" : "");
+    }
+    regressions += comparison.regressed ? 1 : 0;
+  }
+
+  if (regressions > 0) {
+    std::cout << regressions << " benchmark(s) regressed" << std::endl;
+    return 1;
+  }
+  std::cout << "No regressions" << std::endl;
+  return 0;
+}
@@ -0,0 +1,169 @@
+#ifndef BENCH_COMPARE
+#define BENCH_COMPARE
+
+#include "json.h"
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The committed expectation for one benchmark.
+ */
+struct BaselineEntry {
+  std::string name;
+  double realTime;
+  double tolerance;
+};
+
+/*!
+ * \brief The outcome of comparing one benchmark with its baseline.
+ */
+struct BenchComparison {
+  std::string name;
+  double baseline;
+  double current;
+  double tolerance;
+  bool missing;
+  bool regressed;
+};
+
+/*!
+ * \brief Converts a time in a Google Benchmark time_unit to nanoseconds.
+ */
+inline double toNanoseconds(double value, const std::string &unit) {
+  if (unit == "us") {
+    return value * 1e3;
+  } else if (unit == "ms") {
+    return value * 1e6;
+  } else if (unit == "s") {
+    return value * 1e9;
+  }
+  return value;
+}
+
+/*!
+ * \brief Reads per-benchmark wall times from Google Benchmark JSON output.
+ *
+ * Median aggregates are preferred over single repetitions when present.
+ * \param report The parsed --benchmark_out document.
+ * \param out Receives the real time in nanoseconds, keyed by run name.
+ * \return True if the document has a benchmarks array.
+ */
+inline bool readBenchmarkTimes(const JsonValue &report,
+                               std::map<std::string, double> &out) {
+  const JsonValue *benchmarks = report.find("benchmarks");
+  if (benchmarks == nullptr || benchmarks->type != JsonValue::Array) {
+    return false;
+  }
+  std::map<std::string, bool> fromMedian;
+  for (const JsonValue &run : benchmarks->items) {
+    std::string name = run.stringOr("run_name", run.stringOr("name", ""));
+    double realTime = toNanoseconds(run.numberOr("real_time", 0.0),
+                                    run.stringOr("time_unit", "ns"));
+    bool median = run.stringOr("aggregate_name", "") == "median";
+    if (run.stringOr("run_type", "iteration") == "aggregate" && !median) {
+      continue;
+    }
+    if (median) {
+      out[name] = realTime;
+      fromMedian[name] = true;
+    } else if (!fromMedian[name]) {
+      // Without aggregates keep the fastest repetition, the least noisy one.
+      out[name] = out.count(name) ? std::min(out[name], realTime) : realTime;
+    }
+  }
+  return true;
+}
+
+/*!
+ * \brief Reads a committed baseline file.
+ * \param document The parsed baseline.
+ * \param out Receives the entries; a missing tolerance means the default one.
+ * \return True if the document has a benchmarks array.
+ */
+inline bool readBaseline(const JsonValue &document,
+                         std::vector<BaselineEntry> &out) {
+  const JsonValue *benchmarks = document.find("benchmarks");
+  if (benchmarks == nullptr || benchmarks->type != JsonValue::Array) {
+    return false;
+  }
+  double defaultTolerance = document.numberOr("default_tolerance", 0.25);
+  for (const JsonValue &entry : benchmarks->items) {
+    BaselineEntry baseline;
+    baseline.name = entry.stringOr("name", "");
+    baseline.realTime = entry.numberOr("real_time", 0.0);
+    baseline.tolerance = entry.numberOr("tolerance", defaultTolerance);
+    out.push_back(baseline);
+  }
+  return true;
+}
+
+/*!
+ * \brief Compares current timings with a baseline.
+ *
+ * A benchmark regresses when it is slower than baseline * (1 + tolerance) or
+ * when it disappeared from the suite. Benchmarks without a baseline are
+ * ignored until the baseline is updated.
+ * \param baseline The committed expectations.
+ * \param current The measured real times in nanoseconds.
+ * \return One comparison per baseline entry.
+ */
+inline std::vector<BenchComparison>
+compareToBaseline(const std::vector<BaselineEntry> &baseline,
+                  const std::map<std::string, double> &current) {
+  std::vector<BenchComparison> result;
+  for (const BaselineEntry &entry : baseline) {
+    BenchComparison comparison;
+    comparison.name = entry.name;
+    comparison.baseline = entry.realTime;
+    comparison.tolerance = entry.tolerance;
+    std::map<std::string, double>::const_iterator found =
+        current.find(entry.name);
+    comparison.missing = found == current.end();
+    comparison.current = comparison.missing ? 0.0 : found->second;
+    comparison.regressed =
+        comparison.missing ||
+        comparison.current > entry.realTime * (1.0 + entry.tolerance);
+    result.push_back(comparison);
+  }
+  return result;
+}
+
+/*!
+ * \brief Writes a baseline document from current timings.
+ *
+ * Tolerances of benchmarks already in the old baseline are kept.
+ * \param previous The old baseline entries.
+ * \param current The measured real times in nanoseconds.
+ * \param defaultTolerance The tolerance given to new benchmarks.
+ * \return The JSON text of the new baseline.
+ */
+inline std::string writeBaseline(const std::vector<BaselineEntry> &previous,
+                                 const std::map<std::string, double> &current,
+                                 double defaultTolerance) {
+  std::ostringstream out;
+  out << "{\n  \"default_tolerance\": " << defaultTolerance
+      << ",\n  \"benchmarks\": [";
+  bool first = true;
+  for (const std::pair<const std::string, double> &run : current) {
+    double tolerance = defaultTolerance;
+    for (const BaselineEntry &entry : previous) {
+      if (entry.name == run.first) {
+        tolerance = entry.tolerance;
+      }
+    }
+    out << (first ? "" : ",") << "\n    {\"name\": \"" << run.first
+        << "\", \"real_time\": " << run.second;
+    if (tolerance != defaultTolerance) {
+      out << ", \"tolerance\": " << tolerance;
+    }
+    out << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+  return out.str();
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "doctest.h"
+#include "bench_compare.h"
+
+static JsonValue parseOrFail(const std::string &text) {
+    JsonValue value;
+    std::string error;
+    REQUIRE(JsonValue::parse(text, value, error));
+    return value;
+}
+
+TEST_CASE("JsonValue Class: Parses Nested Documents") {
+    JsonValue value = parseOrFail(
+        "{\"name\": \"a\\\"b\", \"list\": [1, 2.5e3, true, null], \"empty\": {}}");
+    REQUIRE(value.type == JsonValue::Object);
+    CHECK(value.stringOr("name", "") == "a\"b");
+    const JsonValue *list = value.find("list");
+    REQUIRE(list != nullptr);
+    REQUIRE(list->items.size() == 4);
+    CHECK(list->items[1].number == 2500);
+    CHECK(list->items[2].boolean);
+    CHECK(list->items[3].type == JsonValue::Null);
+    CHECK(value.numberOr("missing", 7) == 7);
+
+    JsonValue broken;
+    std::string error;
+    CHECK_FALSE(JsonValue::parse("{\"a\": [1, 2}", broken, error));
+    CHECK_FALSE(error.empty());
+}
+
+TEST_CASE("readBenchmarkTimes Function: Prefers Medians") {
+    JsonValue report = parseOrFail(
+        "{\"benchmarks\": ["
+        "{\"name\": \"BM_A\", \"run_name\": \"BM_A\", \"run_type\": \"iteration\", \"real_time\": 12, \"time_unit\": \"ns\"},"
+        "{\"name\": \"BM_A\", \"run_name\": \"BM_A\", \"run_type\": \"iteration\", \"real_time\": 10, \"time_unit\": \"ns\"},"
+        "{\"name\": \"BM_A_median\", \"run_name\": \"BM_A\", \"run_type\": \"aggregate\", \"aggregate_name\": \"median\", \"real_time\": 11, \"time_unit\": \"ns\"},"
+        "{\"name\": \"BM_A_mean\", \"run_name\": \"BM_A\", \"run_type\": \"aggregate\", \"aggregate_name\": \"mean\", \"real_time\": 50, \"time_unit\": \"ns\"},"
+        "{\"name\": \"BM_B\", \"run_type\": \"iteration\", \"real_time\": 3, \"time_unit\": \"us\"},"
+        "{\"name\": \"BM_B\", \"run_type\": \"iteration\", \"real_time\": 2, \"time_unit\": \"us\"}"
+        "]}");
+    std::map<std::string, double> times;
+    REQUIRE(readBenchmarkTimes(report, times));
+    CHECK(times["BM_A"] == 11);
+    CHECK(times["BM_B"] == 2000);
+}
+
+TEST_CASE("compareToBaseline Function: Flags Slow And Missing Benchmarks") {
+    JsonValue document = parseOrFail(
+        "{\"default_tolerance\": 0.1, \"benchmarks\": ["
+        "{\"name\": \"fast\", \"real_time\": 100},"
+        "{\"name\": \"slow\", \"real_time\": 100},"
+        "{\"name\": \"loose\", \"real_time\": 100, \"tolerance\": 1.0},"
+        "{\"name\": \"gone\", \"real_time\": 100}]}");
+    std::vector<BaselineEntry> baseline;
+    REQUIRE(readBaseline(document, baseline));
+
+    std::map<std::string, double> current;
+    current["fast"] = 105;
+    current["slow"] = 120;
+    current["loose"] = 190;
+    current["new"] = 1;
+    std::vector<BenchComparison> result = compareToBaseline(baseline, current);
+    REQUIRE(result.size() == 4);
+    CHECK_FALSE(result[0].regressed);
+    CHECK(result[1].regressed);
+    CHECK_FALSE(result[2].regressed);
+    CHECK(result[3].missing);
+    CHECK(result[3].regressed);
+
+    std::string updated = writeBaseline(baseline, current, 0.1);
+    JsonValue rewritten = parseOrFail(updated);
+    std::vector<BaselineEntry> entries;
+    REQUIRE(readBaseline(rewritten, entries));
+    REQUIRE(entries.size() == 4);
+    for (const BaselineEntry &entry : entries) {
+        CHECK(entry.tolerance == (entry.name == "loose" ? 1.0 : 0.1));
+    }
+}
@@ -0,0 +1,494 @@
+#ifndef BENCHMARK_HARNESS
+#define BENCHMARK_HARNESS
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief A small subset of the Google Benchmark API.
+ *
+ * Benchmarks are written exactly as for Google Benchmark (BENCHMARK(fn)->Arg(),
+ * for (auto _ : state), benchmark::DoNotOptimize) and the JSON written by
+ * --benchmark_out has the same layout, so the real library can be dropped in
+ * without touching the benchmarks or the tools reading their output.
+ */
+namespace benchmark {
+
+/*!
+ * \brief Keeps the compiler from optimizing a value away.
+ * \param value The value to keep alive.
+ */
+template <class T> inline void DoNotOptimize(T const &value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+#endif
+}
+
+/*!
+ * \brief Forces pending writes to memory to be considered observable.
+ */
+inline void ClobberMemory() {
+#if defined(__GNUC__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+/*!
+ * \brief The state passed to a benchmark function: iteration control,
+ * arguments and counters.
+ */
+class State {
+public:
+  /*!
+   * \brief The loop variable of "for (auto _ : state)". The destructor keeps
+   * compilers from warning that it is unused.
+   */
+  struct Value {
+    ~Value() {}
+  };
+
+  /*!
+   * \brief Iterates the timed loop of a benchmark.
+   */
+  class Iterator {
+  public:
+    Iterator(State *parent, std::int64_t remaining)
+        : parent(parent), remaining(remaining) {}
+    Value operator*() const { return Value(); }
+    Iterator &operator++() {
+      --remaining;
+      return *this;
+    }
+    bool operator!=(const Iterator &) {
+      if (remaining > 0) {
+        return true;
+      }
+      parent->finishTiming();
+      return false;
+    }
+
+  private:
+    State *parent;
+    std::int64_t remaining;
+  };
+
+  /*!
+   * \brief Constructor for State with specified parameters.
+   * \param maxIterations The number of iterations of the timed loop.
+   * \param args The arguments of this benchmark instance.
+   */
+  State(std::int64_t maxIterations, const std::vector<std::int64_t> &args)
+      : maxIterations(maxIterations), args(args), items(0), realNs(0),
+        cpuTicks(0), running(false) {}
+
+  Iterator begin() {
+    startTiming();
+    return Iterator(this, maxIterations);
+  }
+  Iterator end() { return Iterator(this, 0); }
+
+  /*!
+   * \brief Gets an argument of the benchmark instance.
+   * \param index The position of the argument.
+   * \return The argument value.
+   */
+  std::int64_t range(size_t index = 0) const { return args.at(index); }
+
+  /*!
+   * \brief Gets the number of iterations of the timed loop.
+   */
+  std::int64_t iterations() const { return maxIterations; }
+
+  /*!
+   * \brief Stops the clock, e.g. around per-iteration setup.
+   */
+  void PauseTiming() { stopClock(); }
+
+  /*!
+   * \brief Restarts the clock after PauseTiming().
+   */
+  void ResumeTiming() { startTiming(); }
+
+  /*!
+   * \brief Sets the number of items processed, reported as items_per_second.
+   */
+  void SetItemsProcessed(std::int64_t value) { items = value; }
+
+  /*!
+   * \brief Sets a free-form label shown next to the result.
+   */
+  void SetLabel(const std::string &value) { label = value; }
+
+  /*!
+   * \brief Gets the measured wall-clock time in seconds.
+   */
+  double realSeconds() const { return realNs / 1e9; }
+
+  /*!
+   * \brief Gets the measured process CPU time in seconds.
+   */
+  double cpuSeconds() const {
+    return static_cast<double>(cpuTicks) / CLOCKS_PER_SEC;
+  }
+
+  /*!
+   * \brief Gets the value given to SetItemsProcessed().
+   */
+  std::int64_t itemsProcessed() const { return items; }
+
+  /*!
+   * \brief Gets the value given to SetLabel().
+   */
+  const std::string &getLabel() const { return label; }
+
+private:
+  void startTiming() {
+    if (!running) {
+      running = true;
+      realStart = std::chrono::steady_clock::now();
+      cpuStart = std::clock();
+    }
+  }
+
+  void stopClock() {
+    if (running) {
+      realNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - realStart)
+                    .count();
+      cpuTicks += std::clock() - cpuStart;
+      running = false;
+    }
+  }
+
+  void finishTiming() { stopClock(); }
+
+  std::int64_t maxIterations;
+  std::vector<std::int64_t> args;
+  std::int64_t items;
+  std::int64_t realNs;
+  std::clock_t cpuTicks;
+  bool running;
+  std::chrono::steady_clock::time_point realStart;
+  std::clock_t cpuStart;
+  std::string label;
+};
+
+/*!
+ * \brief A registered benchmark function and the argument sets to run it with.
+ */
+class Benchmark {
+public:
+  typedef void (*Function)(State &);
+
+  Benchmark(const std::string &name, Function function)
+      : name(name), function(function) {}
+
+  /*!
+   * \brief Adds an instance of the benchmark with one argument.
+   */
+  Benchmark *Arg(std::int64_t value) {
+    argSets.push_back(std::vector<std::int64_t>(1, value));
+    return this;
+  }
+
+  /*!
+   * \brief Adds an instance of the benchmark with several arguments.
+   */
+  Benchmark *Args(const std::vector<std::int64_t> &values) {
+    argSets.push_back(values);
+    return this;
+  }
+
+  /*!
+   * \brief Adds one instance per argument in a list.
+   */
+  Benchmark *DenseRange(std::int64_t first, std::int64_t last,
+                        std::int64_t step = 1) {
+    for (std::int64_t value = first; value <= last; value += step) {
+      Arg(value);
+    }
+    return this;
+  }
+
+  std::string name;
+  Function function;
+  std::vector<std::vector<std::int64_t>> argSets;
+};
+
+/*!
+ * \brief Gets the list of benchmarks registered with BENCHMARK().
+ */
+inline std::vector<std::unique_ptr<Benchmark>> &registry() {
+  static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+  return benchmarks;
+}
+
+/*!
+ * \brief Registers a benchmark function.
+ * \param name The name used in reports and filters.
+ * \param function The benchmark function.
+ * \return The benchmark, for chaining Arg() calls.
+ */
+inline Benchmark *RegisterBenchmark(const char *name,
+                                    Benchmark::Function function) {
+  registry().emplace_back(new Benchmark(name, function));
+  return registry().back().get();
+}
+
+/*!
+ * \brief Command line options understood by RunSpecifiedBenchmarks().
+ */
+struct Options {
+  std::string filter = ".";
+  std::string format = "console";
+  std::string out;
+  double minTime = 0.5;
+  int repetitions = 1;
+};
+
+/*!
+ * \brief Gets the options read by Initialize().
+ */
+inline Options &options() {
+  static Options value;
+  return value;
+}
+
+/*!
+ * \brief Reads --benchmark_* flags from the command line.
+ * \param argc The number of arguments.
+ * \param argv The arguments.
+ */
+inline void Initialize(int *argc, char **argv) {
+  Options &opts = options();
+  for (int k = 1; k < *argc; ++k) {
+    std::string arg = argv[k];
+    std::string value = arg.substr(arg.find('=') + 1);
+    if (arg.rfind("--benchmark_filter=", 0) == 0) {
+      opts.filter = value;
+    } else if (arg.rfind("--benchmark_format=", 0) == 0) {
+      opts.format = value;
+    } else if (arg.rfind("--benchmark_out=", 0) == 0) {
+      opts.out = value;
+    } else if (arg.rfind("--benchmark_min_time=", 0) == 0) {
+      opts.minTime = std::stod(value);
+    } else if (arg.rfind("--benchmark_repetitions=", 0) == 0) {
+      opts.repetitions = std::max(1, std::stoi(value));
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+    }
+  }
+}
+
+/*!
+ * \brief The measurements of one run of a benchmark instance.
+ */
+struct Run {
+  std::string name;
+  std::string runName;
+  std::string aggregate;
+  std::int64_t iterations;
+  double realNs;
+  double cpuNs;
+  double itemsPerSecond;
+  std::string label;
+};
+
+/*!
+ * \brief Runs one benchmark instance, growing the iteration count until the
+ * timed loop lasts at least the minimum time.
+ */
+inline Run runInstance(const Benchmark &benchmark,
+                       const std::vector<std::int64_t> &args,
+                       const std::string &name) {
+  const double minTime = options().minTime;
+  std::int64_t iterations = 1;
+  while (true) {
+    State state(iterations, args);
+    benchmark.function(state);
+    double seconds = state.realSeconds();
+    if (seconds >= minTime || iterations >= 1000000000) {
+      Run run;
+      run.name = name;
+      run.runName = name;
+      run.iterations = iterations;
+      run.realNs = seconds * 1e9 / iterations;
+      run.cpuNs = state.cpuSeconds() * 1e9 / iterations;
+      run.itemsPerSecond =
+          seconds > 0 ? state.itemsProcessed() / seconds : 0.0;
+      run.label = state.getLabel();
+      return run;
+    }
+    double multiplier = seconds <= minTime / 100 ? 10.0 : minTime * 1.4 / seconds;
+    iterations = std::max<std::int64_t>(
+        iterations + 1, static_cast<std::int64_t>(iterations * multiplier));
+    iterations = std::min<std::int64_t>(iterations, 1000000000);
+  }
+}
+
+/*!
+ * \brief Builds the median aggregate of repeated runs.
+ */
+inline Run medianOf(std::vector<Run> runs) {
+  std::sort(runs.begin(), runs.end(),
+            [](const Run &a, const Run &b) { return a.realNs < b.realNs; });
+  Run median = runs[runs.size() / 2];
+  median.name = median.runName + "_median";
+  median.aggregate = "median";
+  return median;
+}
+
+/*!
+ * \brief Writes runs in the Google Benchmark JSON layout.
+ */
+inline void writeJson(std::ostream &out, const std::vector<Run> &runs) {
+  char date[64];
+  std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+  out << "{\n  \"context\": {\n    \"date\": \"" << date
+      << "\",\n    \"num_cpus\": " << std::thread::hardware_concurrency()
+      << ",\n    \"library_build_type\": \""
+#ifdef NDEBUG
+      << "release"
+#else
+      << "debug"
+#endif
+      << "\"\n  },\n  \"benchmarks\": [";
+  for (size_t k = 0; k < runs.size(); ++k) {
+    const Run &run = runs[k];
+    out << (k == 0 ? "" : ",") << "\n    {\n      \"name\": \"" << run.name
+        << "\",\n      \"run_name\": \"" << run.runName
+        << "\",\n      \"run_type\": \""
+        << (run.aggregate.empty() ? "iteration" : "aggregate") << "\",";
+    if (!run.aggregate.empty()) {
+      out << "\n      \"aggregate_name\": \"" << run.aggregate << "\",";
+    }
+    out << "\n      \"iterations\": " << run.iterations
+        << ",\n      \"real_time\": " << run.realNs
+        << ",\n      \"cpu_time\": " << run.cpuNs
+        << ",\n      \"time_unit\": \"ns\"";
+    if (run.itemsPerSecond > 0) {
+      out << ",\n      \"items_per_second\": " << run.itemsPerSecond;
+    }
+    if (!run.label.empty()) {
+      out << ",\n      \"label\": \"" << run.label << "\"";
+    }
+    out << "\n    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+/*!
+ * \brief Writes one run as a line of a human-readable table.
+ */
+inline void writeConsole(std::ostream &out, const Run &run) {
+  char line[256];
+  std::snprintf(line, sizeof(line), "%-44s %14.1f ns %14.1f ns %12lld",
+                run.name.c_str(), run.realNs, run.cpuNs,
+                static_cast<long long>(run.iterations));
+  out << line;
+  if (run.itemsPerSecond > 0) {
+    out << "  items/s=" << run.itemsPerSecond;
+  }
+  if (!run.label.empty()) {
+    out << "  " << run.label;
+  }
+  out << std::endl;
+}
+
+/*!
+ * \brief Runs every registered benchmark instance matching the filter.
+ * \return The number of benchmark instances run.
+ */
+inline size_t RunSpecifiedBenchmarks() {
+  const Options &opts = options();
+  std::regex filter(opts.filter);
+  std::vector<Run> runs;
+  bool console = opts.format != "json";
+  if (console) {
+    std::cout << "Benchmark                                              Time"
+                 "              CPU   Iterations"
+              << std::endl;
+  }
+
+  size_t instances = 0;
+  for (const std::unique_ptr<Benchmark> &benchmark : registry()) {
+    std::vector<std::vector<std::int64_t>> argSets = benchmark->argSets;
+    if (argSets.empty()) {
+      argSets.push_back(std::vector<std::int64_t>());
+    }
+    for (const std::vector<std::int64_t> &args : argSets) {
+      std::string name = benchmark->name;
+      for (std::int64_t arg : args) {
+        name += "/" + std::to_string(arg);
+      }
+      if (!std::regex_search(name, filter)) {
+        continue;
+      }
+      ++instances;
+      std::vector<Run> repeated;
+      for (int k = 0; k < opts.repetitions; ++k) {
+        repeated.push_back(runInstance(*benchmark, args, name));
+        runs.push_back(repeated.back());
+        if (console) {
+          writeConsole(std::cout, repeated.back());
+        }
+      }
+      if (opts.repetitions > 1) {
+        runs.push_back(medianOf(repeated));
+        if (console) {
+          writeConsole(std::cout, runs.back());
+        }
+      }
+    }
+  }
+
+  if (!console) {
+    writeJson(std::cout, runs);
+  }
+  if (!opts.out.empty()) {
+    std::ofstream out(opts.out);
+    writeJson(out, runs);
+    if (!out) {
+      std::cerr << "Error with " << opts.out << std::endl;
+    }
+  }
+  return instances;
+}
+
+} // namespace benchmark
+
+#define BENCHMARK_CONCAT_INNER(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_INNER(a, b)
+
+/*!
+ * \brief Registers a benchmark function: BENCHMARK(BM_Name)->Arg(8);
+ */
+#define BENCHMARK(function)                                                    \
+  static ::benchmark::Benchmark *BENCHMARK_CONCAT(benchmark_, __LINE__) =     \
+      ::benchmark::RegisterBenchmark(#function, function)
+
+/*!
+ * \brief Defines main() running the benchmarks selected on the command line.
+ */
+#define BENCHMARK_MAIN()                                                       \
+  int main(int argc, char **argv) {                                            \
+    ::benchmark::Initialize(&argc, argv);                                      \
+    ::benchmark::RunSpecifiedBenchmarks();                                     \
+    return 0;                                                                  \
+  }
+
+#endif
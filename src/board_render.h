@@ -0,0 +1,265 @@
+#ifndef BOARD_RENDER
+#define BOARD_RENDER
+
+#include "func.h"
+#include <algorithm>
+#include <cmath>
+
+/*!
+ * \brief Draws the board as a grid of cached chunk textures.
+ *
+ * The board is split into blocks of chunkSize x chunkSize cells. Each block is
+ * rendered once into its own render texture and redrawn only after one of its
+ * cells was invalidated, so a frame costs one textured quad per visible chunk
+ * instead of one shape per cell.
+ */
+class BoardChunks {
+public:
+  /*!
+   * \brief Constructor for BoardChunks with specified parameters.
+   * \param rows The number of board rows.
+   * \param cols The number of board columns.
+   * \param chunkSize The number of cells along each side of a chunk.
+   * \param maxCachedChunks The number of chunk textures kept alive at once.
+   */
+  BoardChunks(int rows, int cols, int chunkSize = 16,
+              size_t maxCachedChunks = 64)
+      : rows(rows), cols(cols), chunkSize(chunkSize),
+        chunkRows((rows + chunkSize - 1) / chunkSize),
+        chunkCols((cols + chunkSize - 1) / chunkSize),
+        maxCachedChunks(std::max<size_t>(maxCachedChunks, 1)),
+        chunks(chunkRows * chunkCols), measured(false), frame(0),
+        drawnChunks(0) {}
+
+  /*!
+   * \brief Marks the chunk holding a cell for redraw.
+   * \param i The row of the changed cell.
+   * \param j The column of the changed cell.
+   */
+  void invalidate(int i, int j) {
+    chunks[(i / chunkSize) * chunkCols + j / chunkSize].dirty = true;
+  }
+
+  /*!
+   * \brief Marks every chunk for redraw and forgets the cached layout.
+   */
+  void invalidateAll() {
+    for (Chunk &chunk : chunks) {
+      chunk.dirty = true;
+    }
+    measured = false;
+  }
+
+  /*!
+   * \brief Draws the chunks visible through the target's current view.
+   * \param target The window to draw the board on.
+   * \param circles The board cells, indexed [row][column].
+   */
+  void draw(sf::RenderTarget &target,
+            std::vector<std::vector<Circle>> &circles) {
+    if (!measured) {
+      measure(circles);
+    }
+    ++frame;
+    drawnChunks = 0;
+
+    const sf::View &view = target.getView();
+    sf::Vector2f size = view.getSize();
+    sf::Vector2f topLeft =
+        view.getCenter() - sf::Vector2f(size.x / 2.f, size.y / 2.f);
+
+    int firstRow = firstVisible(rowSpans, topLeft.y);
+    int lastRow = lastVisible(rowSpans, topLeft.y + size.y);
+    int firstCol = firstVisible(colSpans, topLeft.x);
+    int lastCol = lastVisible(colSpans, topLeft.x + size.x);
+
+    for (int ci = firstRow; ci < lastRow; ++ci) {
+      for (int cj = firstCol; cj < lastCol; ++cj) {
+        Chunk &chunk = chunks[ci * chunkCols + cj];
+        if (!chunk.texture) {
+          allocate(ci * chunkCols + cj);
+        }
+        if (chunk.dirty) {
+          render(chunk, ci, cj, circles);
+        }
+        chunk.lastUsed = frame;
+
+        sf::Sprite sprite(chunk.texture->getTexture());
+        sprite.setPosition(colSpans[cj].first, rowSpans[ci].first);
+        target.draw(sprite);
+        ++drawnChunks;
+      }
+    }
+  }
+
+  /*!
+   * \brief Gets the number of chunk quads issued by the last draw call.
+   * \return The number of chunks drawn in the last frame.
+   */
+  int getDrawnChunks() const { return drawnChunks; }
+
+  /*!
+   * \brief Checks if a chunk is redrawn before it is next shown.
+   * \param ci The chunk row.
+   * \param cj The chunk column.
+   */
+  bool isDirty(int ci, int cj) const {
+    return chunks[ci * chunkCols + cj].dirty;
+  }
+
+  /*!
+   * \brief Checks if a chunk holds a texture.
+   * \param ci The chunk row.
+   * \param cj The chunk column.
+   */
+  bool isCached(int ci, int cj) const {
+    return chunks[ci * chunkCols + cj].texture != nullptr;
+  }
+
+  /*!
+   * \brief Gets the number of chunk textures alive, at most the cache size.
+   */
+  size_t getCachedChunks() const { return cached.size(); }
+
+private:
+  struct Chunk {
+    std::unique_ptr<sf::RenderTexture> texture;
+    bool dirty = true;
+    unsigned long lastUsed = 0;
+  };
+
+  /*!
+   * \brief Computes the world-space extent of every chunk row and column.
+   *
+   * The layout is regular, so a chunk row spans the same height at every
+   * column and a chunk column the same width at every row (odd rows included).
+   */
+  void measure(const std::vector<std::vector<Circle>> &circles) {
+    rowSpans.assign(chunkRows, std::make_pair(0.f, 0.f));
+    colSpans.assign(chunkCols, std::make_pair(0.f, 0.f));
+
+    for (int ci = 0; ci < chunkRows; ++ci) {
+      int first = ci * chunkSize;
+      int last = std::min(first + chunkSize, rows) - 1;
+      sf::FloatRect top = circles[first][0].getBounds();
+      sf::FloatRect bottom = circles[last][0].getBounds();
+      rowSpans[ci] = std::make_pair(top.top, bottom.top + bottom.height);
+    }
+    for (int cj = 0; cj < chunkCols; ++cj) {
+      int first = cj * chunkSize;
+      int last = std::min(first + chunkSize, cols) - 1;
+      float left = circles[0][first].getBounds().left;
+      float right = circles[0][last].getBounds().left +
+                    circles[0][last].getBounds().width;
+      if (rows > 1) {
+        sf::FloatRect shiftedLeft = circles[1][first].getBounds();
+        sf::FloatRect shiftedRight = circles[1][last].getBounds();
+        left = std::min(left, shiftedLeft.left);
+        right = std::max(right, shiftedRight.left + shiftedRight.width);
+      }
+      colSpans[cj] = std::make_pair(left, right);
+    }
+
+    for (Chunk &chunk : chunks) {
+      chunk.texture.reset();
+      chunk.dirty = true;
+    }
+    cached.clear();
+    measured = true;
+  }
+
+  /*!
+   * \brief Finds the first span that ends after a coordinate.
+   */
+  static int firstVisible(const std::vector<std::pair<float, float>> &spans,
+                          float from) {
+    return std::partition_point(spans.begin(), spans.end(),
+                                [from](const std::pair<float, float> &span) {
+                                  return span.second <= from;
+                                }) -
+           spans.begin();
+  }
+
+  /*!
+   * \brief Finds one past the last span that starts before a coordinate.
+   */
+  static int lastVisible(const std::vector<std::pair<float, float>> &spans,
+                         float to) {
+    return std::partition_point(spans.begin(), spans.end(),
+                                [to](const std::pair<float, float> &span) {
+                                  return span.first < to;
+                                }) -
+           spans.begin();
+  }
+
+  /*!
+   * \brief Gives a chunk a texture, evicting the least recently drawn one
+   * when the cache is full.
+   */
+  void allocate(int index) {
+    if (cached.size() >= maxCachedChunks) {
+      size_t oldest = 0;
+      for (size_t k = 1; k < cached.size(); ++k) {
+        if (chunks[cached[k]].lastUsed < chunks[cached[oldest]].lastUsed) {
+          oldest = k;
+        }
+      }
+      Chunk &evicted = chunks[cached[oldest]];
+      evicted.texture.reset();
+      evicted.dirty = true;
+      cached[oldest] = cached.back();
+      cached.pop_back();
+    }
+    chunks[index].texture.reset(new sf::RenderTexture());
+    chunks[index].dirty = true;
+    cached.push_back(index);
+  }
+
+  /*!
+   * \brief Redraws the cells of one chunk into its texture.
+   */
+  void render(Chunk &chunk, int ci, int cj,
+              std::vector<std::vector<Circle>> &circles) {
+    float left = colSpans[cj].first;
+    float top = rowSpans[ci].first;
+    unsigned width = static_cast<unsigned>(std::ceil(colSpans[cj].second - left));
+    unsigned height = static_cast<unsigned>(std::ceil(rowSpans[ci].second - top));
+
+    sf::RenderTexture &texture = *chunk.texture;
+    if (texture.getSize().x != width || texture.getSize().y != height) {
+      if (!texture.create(width, height)) {
+        std::cerr << "Error with chunk texture" << std::endl;
+        return;
+      }
+    }
+    texture.setView(sf::View(sf::FloatRect(left, top, static_cast<float>(width),
+                                           static_cast<float>(height))));
+    texture.clear(sf::Color::Transparent);
+
+    int lastRow = std::min((ci + 1) * chunkSize, rows);
+    int lastCol = std::min((cj + 1) * chunkSize, cols);
+    for (int i = ci * chunkSize; i < lastRow; ++i) {
+      for (int j = cj * chunkSize; j < lastCol; ++j) {
+        circles[i][j].draw(texture);
+      }
+    }
+    texture.display();
+    chunk.dirty = false;
+  }
+
+  int rows;
+  int cols;
+  int chunkSize;
+  int chunkRows;
+  int chunkCols;
+  size_t maxCachedChunks;
+  std::vector<Chunk> chunks;
+  std::vector<int> cached;
+  std::vector<std::pair<float, float>> rowSpans;
+  std::vector<std::pair<float, float>> colSpans;
+  bool measured;
+  unsigned long frame;
+  int drawnChunks;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "board_render.h"
+#include "doctest.h"
+
+/*!
+ * \brief Lays out an 8 x 8 board of hexes of radius 50 as main.cpp does.
+ *
+ * Cell (i, j) starts at x = 86.6 j (+ 43.3 on odd rows) and y = 75 i, so
+ * with chunks of 4 cells the second chunk column starts near x = 346 and
+ * the second chunk row at y = 300.
+ */
+static std::vector<std::vector<Circle>> makeBoard() {
+    float R = 50.f;
+    float r = (R * std::sqrt(3.f)) / 2;
+    std::vector<std::vector<Circle>> circles(8, std::vector<Circle>(8));
+    for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            circles[i][j] = Circle(R, sf::Color(115, 144, 46), sf::Color(0, 90, 50), 2.f);
+            circles[i][j].setPosition(j * (r * 2) + (i % 2 == 1 ? r : 0), i * (R * 1.5f));
+        }
+    }
+    return circles;
+}
+
+/*!
+ * \brief Draws the board as seen through a 50 x 50 view at a point.
+ */
+static void drawAt(BoardChunks &board, sf::RenderTexture &target,
+                   std::vector<std::vector<Circle>> &circles, float x, float y) {
+    target.setView(sf::View(sf::FloatRect(x, y, 50.f, 50.f)));
+    board.draw(target, circles);
+}
+
+TEST_CASE("BoardChunks Class: An Action Dirties Only The Chunks It Touches") {
+    std::vector<std::vector<Circle>> circles = makeBoard();
+    sf::RenderTexture target;
+    REQUIRE(target.create(64, 64));
+    BoardChunks board(8, 8, 4);
+    target.setView(sf::View(sf::FloatRect(-100.f, -100.f, 1000.f, 1000.f)));
+    board.draw(target, circles);
+    CHECK(board.getDrawnChunks() == 4);
+    for (int ci = 0; ci < 2; ++ci) {
+        for (int cj = 0; cj < 2; ++cj) {
+            CHECK_FALSE(board.isDirty(ci, cj));
+        }
+    }
+
+    // A unit moving from (1, 2) to (5, 6) touches the two chunks it crosses.
+    board.invalidate(1, 2);
+    board.invalidate(5, 6);
+    CHECK(board.isDirty(0, 0));
+    CHECK_FALSE(board.isDirty(0, 1));
+    CHECK_FALSE(board.isDirty(1, 0));
+    CHECK(board.isDirty(1, 1));
+    board.draw(target, circles);
+    CHECK_FALSE(board.isDirty(0, 0));
+    CHECK_FALSE(board.isDirty(1, 1));
+
+    board.invalidateAll();
+    CHECK(board.isDirty(0, 1));
+    CHECK(board.isDirty(1, 0));
+}
+
+TEST_CASE("BoardChunks Class: Chunks Outside The View Are Not Drawn") {
+    std::vector<std::vector<Circle>> circles = makeBoard();
+    sf::RenderTexture target;
+    REQUIRE(target.create(64, 64));
+    BoardChunks board(8, 8, 4);
+    drawAt(board, target, circles, 0.f, 0.f);
+    CHECK(board.getDrawnChunks() == 1);
+    CHECK(board.isCached(0, 0));
+    CHECK_FALSE(board.isCached(0, 1));
+    CHECK_FALSE(board.isCached(1, 0));
+    CHECK_FALSE(board.isCached(1, 1));
+
+    // Past the board, nothing is drawn and nothing more is cached.
+    drawAt(board, target, circles, 2000.f, 2000.f);
+    CHECK(board.getDrawnChunks() == 0);
+    CHECK(board.getCachedChunks() == 1);
+}
+
+TEST_CASE("BoardChunks Class: Eviction Drops The Least Recently Drawn Chunk") {
+    std::vector<std::vector<Circle>> circles = makeBoard();
+    sf::RenderTexture target;
+    REQUIRE(target.create(64, 64));
+    BoardChunks board(8, 8, 4, 2);
+    drawAt(board, target, circles, 0.f, 0.f);
+    drawAt(board, target, circles, 600.f, 0.f);
+    CHECK(board.getCachedChunks() == 2);
+    drawAt(board, target, circles, 0.f, 0.f);
+
+    // Chunk (0, 1) was drawn longest ago, so chunk (1, 0) takes its texture.
+    drawAt(board, target, circles, 0.f, 500.f);
+    CHECK(board.getCachedChunks() == 2);
+    CHECK(board.isCached(0, 0));
+    CHECK_FALSE(board.isCached(0, 1));
+    CHECK(board.isDirty(0, 1));
+    CHECK(board.isCached(1, 0));
+
+    // More visible chunks than room: all are drawn, the cache stays full.
+    target.setView(sf::View(sf::FloatRect(-100.f, -100.f, 1000.f, 1000.f)));
+    board.draw(target, circles);
+    CHECK(board.getDrawnChunks() == 4);
+    CHECK(board.getCachedChunks() == 2);
+}
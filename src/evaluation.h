@@ -0,0 +1,552 @@
+#ifndef EVALUATION
+#define EVALUATION
+
+#include "game.h"
+#include "threat.h"
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRATEG_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/*!
+ * \brief The weights of the evaluation terms.
+ */
+struct EvalWeights {
+  int unitValue[UNIT_TYPES];
+  int mobility;
+  int threat;
+  int tall;
+};
+
+/*!
+ * \brief Gets the weights Evaluator uses unless told otherwise.
+ *
+ * Material counts HP times a per-type value, so a wounded unit is worth less.
+ * \return The default weights.
+ */
+inline EvalWeights defaultEvalWeights() {
+  return EvalWeights{{2, 4, 3}, 2, 1, 8};
+}
+
+/*!
+ * \brief The raw evaluation terms of both players.
+ */
+struct EvalTerms {
+  int material[2];
+  int mobility[2];
+  int threat[2];
+  int tall[2];
+};
+
+/*!
+ * \brief Static evaluation of positions for search.
+ *
+ * Four terms per player: material (sum of HP times unit value), mobility
+ * (number of legal steps), threat (attack of each unit times the number of
+ * enemies in its range) and tall-terrain control (units standing on tall
+ * hexes). The units are copied into a structure-of-arrays table padded to 8
+ * lanes, and the terrain rules read the bitboards of GameState, so the same
+ * data feeds a scalar, an SSE4.2 and an AVX2 kernel. The best kernel the CPU
+ * supports is picked at run time; all give identical results.
+ *
+ * The threat term is also the sum, over the enemy units, of the influence a
+ * ThreatMap holds on their hexes; a caller that keeps such a map in step
+ * with its state passes it to skip the all-pairs kernels.
+ *
+ * An Evaluator keeps its table between calls and is not thread-safe: use one
+ * per search thread.
+ */
+class Evaluator {
+public:
+  /*!
+   * \brief The implementations of the evaluation terms.
+   */
+  enum Kernel { ScalarKernel = 0, Sse42Kernel = 1, Avx2Kernel = 2 };
+
+  /*!
+   * \brief Score of a won position; evaluations stay far below it.
+   */
+  static const int WIN_SCORE = 1000000;
+
+  /*!
+   * \brief Constructor for Evaluator with specified parameters.
+   * \param weights The weights of the terms.
+   */
+  explicit Evaluator(const EvalWeights &weights = defaultEvalWeights())
+      : weights(weights), active(bestKernel()) {}
+
+  /*!
+   * \brief Checks if the CPU can run a kernel.
+   * \param kernel The kernel.
+   * \return True if the kernel may be selected.
+   */
+  static bool supports(Kernel kernel) {
+    if (kernel == ScalarKernel) {
+      return true;
+    }
+#ifdef STRATEG_X86_KERNELS
+    if (kernel == Sse42Kernel) {
+      return __builtin_cpu_supports("sse4.2") &&
+             __builtin_cpu_supports("popcnt");
+    }
+    if (kernel == Avx2Kernel) {
+      return __builtin_cpu_supports("avx2") &&
+             __builtin_cpu_supports("popcnt");
+    }
+#endif
+    return false;
+  }
+
+  /*!
+   * \brief Gets the fastest kernel the CPU supports.
+   */
+  static Kernel bestKernel() {
+    if (supports(Avx2Kernel)) {
+      return Avx2Kernel;
+    }
+    return supports(Sse42Kernel) ? Sse42Kernel : ScalarKernel;
+  }
+
+  /*!
+   * \brief Gets the name of a kernel, for logs and benchmark labels.
+   */
+  static const char *kernelName(Kernel kernel) {
+    static const char *const names[] = {"scalar", "sse4.2", "avx2"};
+    return names[kernel];
+  }
+
+  /*!
+   * \brief Selects the kernel to use.
+   * \param kernel The kernel.
+   * \return False, keeping the current kernel, if the CPU lacks it.
+   */
+  bool setKernel(Kernel kernel) {
+    if (!supports(kernel)) {
+      return false;
+    }
+    active = kernel;
+    return true;
+  }
+
+  /*!
+   * \brief Gets the kernel in use.
+   */
+  Kernel getKernel() const { return active; }
+
+  /*!
+   * \brief Computes the terms of both players.
+   * \param state The position.
+   * \param terms Receives the terms.
+   */
+  void measure(const GameState &state, EvalTerms &terms) {
+    measureArmies(state, terms, true);
+  }
+
+  /*!
+   * \brief Computes the terms of both players, the threat term from a map.
+   * \param state The position.
+   * \param threats A map in step with state.
+   * \param terms Receives the terms.
+   */
+  void measure(const GameState &state, const ThreatMap &threats,
+               EvalTerms &terms) {
+    measureArmies(state, terms, false);
+    for (int player = 0; player < 2; ++player) {
+      const std::int32_t *influence = threats.influence(player);
+      terms.threat[player] = 0;
+      for (const Unit &enemy : state.getUnits(1 - player)) {
+        terms.threat[player] += influence[enemy.cell];
+      }
+    }
+  }
+
+  /*!
+   * \brief Scores a position for the side to move.
+   * \param state The position.
+   * \return Positive if the side to move stands better; +-WIN_SCORE once the
+   * game is decided.
+   */
+  int evaluate(const GameState &state) {
+    int side = state.getSideToMove();
+    if (state.isFinished()) {
+      return state.getWinner() == side ? WIN_SCORE : -WIN_SCORE;
+    }
+    EvalTerms terms;
+    measure(state, terms);
+    return weigh(side, terms);
+  }
+
+  /*!
+   * \brief Scores a position for the side to move, the threat term from a
+   * map.
+   * \param state The position.
+   * \param threats A map in step with state.
+   * \return The same score as evaluate(state).
+   */
+  int evaluate(const GameState &state, const ThreatMap &threats) {
+    int side = state.getSideToMove();
+    if (state.isFinished()) {
+      return state.getWinner() == side ? WIN_SCORE : -WIN_SCORE;
+    }
+    EvalTerms terms;
+    measure(state, threats, terms);
+    return weigh(side, terms);
+  }
+
+private:
+  static const int LANES = 8;
+  // Padding lanes sit far below the board: never in range, never counted.
+  static const int PAD_ROW = 20000;
+
+  /*!
+   * \brief The units of one player as parallel arrays of LANES multiples.
+   *
+   * x is 2 * col + (row & 1), so that withinRange() becomes
+   * dx * dx + 3 * dy * dy <= reach with reach = (10 * diapason + 1)^2 / 100
+   * rounded down. east is the hex a unit may climb onto, -1 if none.
+   */
+  struct Army {
+    int size = 0;
+    int padded = 0;
+    std::vector<std::int32_t> x, y, cell, east, hp, value, attack, reach;
+  };
+
+  void measureArmies(const GameState &state, EvalTerms &terms,
+                     bool threat) {
+    load(state);
+    for (int player = 0; player < 2; ++player) {
+      const Army &own = armies[player];
+      const Army &enemy = armies[1 - player];
+      switch (active) {
+#ifdef STRATEG_X86_KERNELS
+      case Avx2Kernel:
+        terms.material[player] = materialAvx2(own);
+        terms.threat[player] = threat ? threatAvx2(own, enemy) : 0;
+        terms.mobility[player] = mobilityAvx2(state, own);
+        terms.tall[player] = tallAvx2(state, own);
+        break;
+      case Sse42Kernel:
+        terms.material[player] = materialSse42(own);
+        terms.threat[player] = threat ? threatSse42(own, enemy) : 0;
+        terms.mobility[player] = mobilitySse42(state, own);
+        terms.tall[player] = tallScalar(state, own);
+        break;
+#endif
+      default:
+        terms.material[player] = materialScalar(own);
+        terms.threat[player] = threat ? threatScalar(own, enemy) : 0;
+        terms.mobility[player] = mobilityScalar(state, own);
+        terms.tall[player] = tallScalar(state, own);
+        break;
+      }
+    }
+  }
+
+  int weigh(int side, const EvalTerms &terms) const {
+    int score = 0;
+    for (int player = 0; player < 2; ++player) {
+      int sign = player == side ? 1 : -1;
+      score += sign * (terms.material[player] +
+                       weights.mobility * terms.mobility[player] +
+                       weights.threat * terms.threat[player] +
+                       weights.tall * terms.tall[player]);
+    }
+    return score;
+  }
+
+  void load(const GameState &state) {
+    int sentinel = state.getNeighbors().sentinel();
+    for (int player = 0; player < 2; ++player) {
+      const std::vector<Unit> &units = state.getUnits(player);
+      Army &army = armies[player];
+      army.size = static_cast<int>(units.size());
+      army.padded = (army.size + LANES - 1) / LANES * LANES;
+      if (static_cast<int>(army.x.size()) < army.padded) {
+        for (std::vector<std::int32_t> *field :
+             {&army.x, &army.y, &army.cell, &army.east, &army.hp, &army.value,
+              &army.attack, &army.reach}) {
+          field->resize(army.padded);
+        }
+      }
+      for (int k = 0; k < army.padded; ++k) {
+        if (k >= army.size) {
+          army.x[k] = 0;
+          army.y[k] = PAD_ROW;
+          army.cell[k] = sentinel;
+          army.east[k] = -1;
+          army.hp[k] = army.value[k] = army.attack[k] = 0;
+          army.reach[k] = -1;
+          continue;
+        }
+        const Unit &unit = units[k];
+        UnitStats stats = state.statsOf(unit);
+        int row = state.rowOf(unit.cell);
+        int col = state.colOf(unit.cell);
+        int limit = 10 * stats.attack_diapason + 1;
+        army.x[k] = 2 * col + (row & 1);
+        army.y[k] = row;
+        army.cell[k] = unit.cell;
+        army.east[k] = col + 1 < state.getCols() ? unit.cell + 1 : -1;
+        army.hp[k] = unit.HP;
+        army.value[k] = weights.unitValue[unit.type];
+        army.attack[k] = stats.attack;
+        army.reach[k] = limit * limit / 100;
+      }
+    }
+  }
+
+  static bool testBit(const std::uint32_t *bits, int cell) {
+    return (bits[cell >> 5] >> (cell & 31)) & 1u;
+  }
+
+  static int materialScalar(const Army &army) {
+    int sum = 0;
+    for (int k = 0; k < army.size; ++k) {
+      sum += army.hp[k] * army.value[k];
+    }
+    return sum;
+  }
+
+  static int threatScalar(const Army &own, const Army &enemy) {
+    int sum = 0;
+    for (int k = 0; k < own.size; ++k) {
+      int hits = 0;
+      for (int e = 0; e < enemy.size; ++e) {
+        int dx = enemy.x[e] - own.x[k];
+        int dy = enemy.y[e] - own.y[k];
+        hits += dx * dx + 3 * dy * dy <= own.reach[k];
+      }
+      sum += own.attack[k] * hits;
+    }
+    return sum;
+  }
+
+  static int mobilityScalar(const GameState &state, const Army &army) {
+    const std::uint32_t *occupied = state.getOccupiedBits();
+    const std::uint32_t *tall = state.getTallBits();
+    const NeighborTable &table = state.getNeighbors();
+    int sum = 0;
+    for (int k = 0; k < army.size; ++k) {
+      const std::int32_t *neighbors = table.of(army.cell[k]);
+      bool climbs = testBit(tall, army.cell[k]);
+      for (int n = 0; n < 6; ++n) {
+        int next = neighbors[n];
+        sum += !testBit(occupied, next) &&
+               (climbs || !testBit(tall, next) || next == army.east[k]);
+      }
+    }
+    return sum;
+  }
+
+  static int tallScalar(const GameState &state, const Army &army) {
+    const std::uint32_t *tall = state.getTallBits();
+    int sum = 0;
+    for (int k = 0; k < army.size; ++k) {
+      sum += testBit(tall, army.cell[k]);
+    }
+    return sum;
+  }
+
+#ifdef STRATEG_X86_KERNELS
+  __attribute__((target("sse4.2"))) static int
+  horizontalSum(__m128i value) {
+    value = _mm_add_epi32(value, _mm_shuffle_epi32(value, 0x4E));
+    value = _mm_add_epi32(value, _mm_shuffle_epi32(value, 0xB1));
+    return _mm_cvtsi128_si32(value);
+  }
+
+  __attribute__((target("sse4.2"))) static int materialSse42(const Army &army) {
+    __m128i sum = _mm_setzero_si128();
+    for (int k = 0; k < army.padded; k += 4) {
+      __m128i hp = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(army.hp.data() + k));
+      __m128i value = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(army.value.data() + k));
+      sum = _mm_add_epi32(sum, _mm_mullo_epi32(hp, value));
+    }
+    return horizontalSum(sum);
+  }
+
+  __attribute__((target("sse4.2,popcnt"))) static int
+  threatSse42(const Army &own, const Army &enemy) {
+    int sum = 0;
+    for (int k = 0; k < own.size; ++k) {
+      __m128i x = _mm_set1_epi32(own.x[k]);
+      __m128i y = _mm_set1_epi32(own.y[k]);
+      __m128i bound = _mm_set1_epi32(own.reach[k] + 1);
+      int hits = 0;
+      for (int e = 0; e < enemy.padded; e += 4) {
+        __m128i dx = _mm_sub_epi32(
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(enemy.x.data() + e)),
+            x);
+        __m128i dy = _mm_sub_epi32(
+            _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(enemy.y.data() + e)),
+            y);
+        __m128i dy2 = _mm_mullo_epi32(dy, dy);
+        __m128i distance = _mm_add_epi32(
+            _mm_mullo_epi32(dx, dx),
+            _mm_add_epi32(dy2, _mm_add_epi32(dy2, dy2)));
+        __m128i inside = _mm_cmplt_epi32(distance, bound);
+        hits += _mm_popcnt_u32(_mm_movemask_ps(_mm_castsi128_ps(inside)));
+      }
+      sum += own.attack[k] * hits;
+    }
+    return sum;
+  }
+
+  /*!
+   * \brief Mobility with the six neighbor bits of a unit tested at once.
+   *
+   * SSE has no gather, so the bits are collected into masks first.
+   */
+  __attribute__((target("sse4.2,popcnt"))) static int
+  mobilitySse42(const GameState &state, const Army &army) {
+    const std::uint32_t *occupied = state.getOccupiedBits();
+    const std::uint32_t *tall = state.getTallBits();
+    const NeighborTable &table = state.getNeighbors();
+    int sum = 0;
+    for (int k = 0; k < army.size; ++k) {
+      const std::int32_t *neighbors = table.of(army.cell[k]);
+      unsigned blocked = 0;
+      unsigned high = 0;
+      for (int n = 0; n < 6; ++n) {
+        blocked |= testBit(occupied, neighbors[n]) << n;
+        high |= testBit(tall, neighbors[n]) << n;
+      }
+      __m128i row =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(neighbors));
+      __m128i rest =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(neighbors + 4));
+      __m128i east = _mm_set1_epi32(army.east[k]);
+      unsigned climb =
+          _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(row, east))) |
+          _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(rest, east))) << 4;
+      if (testBit(tall, army.cell[k])) {
+        high = 0;
+      }
+      sum += _mm_popcnt_u32(~blocked & ~(high & ~climb) & 0x3Fu);
+    }
+    return sum;
+  }
+
+  __attribute__((target("avx2"))) static int horizontalSum(__m256i value) {
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(value),
+                                 _mm256_extracti128_si256(value, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+  }
+
+  __attribute__((target("avx2"))) static int materialAvx2(const Army &army) {
+    __m256i sum = _mm256_setzero_si256();
+    for (int k = 0; k < army.padded; k += LANES) {
+      __m256i hp = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(army.hp.data() + k));
+      __m256i value = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(army.value.data() + k));
+      sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(hp, value));
+    }
+    return horizontalSum(sum);
+  }
+
+  __attribute__((target("avx2,popcnt"))) static int
+  threatAvx2(const Army &own, const Army &enemy) {
+    int sum = 0;
+    for (int k = 0; k < own.size; ++k) {
+      __m256i x = _mm256_set1_epi32(own.x[k]);
+      __m256i y = _mm256_set1_epi32(own.y[k]);
+      __m256i reach = _mm256_set1_epi32(own.reach[k]);
+      int hits = 0;
+      for (int e = 0; e < enemy.padded; e += LANES) {
+        __m256i dx = _mm256_sub_epi32(
+            _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(enemy.x.data() + e)),
+            x);
+        __m256i dy = _mm256_sub_epi32(
+            _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(enemy.y.data() + e)),
+            y);
+        __m256i dy2 = _mm256_mullo_epi32(dy, dy);
+        __m256i distance = _mm256_add_epi32(
+            _mm256_mullo_epi32(dx, dx),
+            _mm256_add_epi32(dy2, _mm256_add_epi32(dy2, dy2)));
+        __m256i outside = _mm256_cmpgt_epi32(distance, reach);
+        hits += LANES - _mm_popcnt_u32(_mm256_movemask_ps(
+                            _mm256_castsi256_ps(outside)));
+      }
+      sum += own.attack[k] * hits;
+    }
+    return sum;
+  }
+
+  /*!
+   * \brief Gathers the bits of eight hexes from a bitboard into lanes.
+   */
+  __attribute__((target("avx2"))) static __m256i
+  gatherBits(const std::uint32_t *bits, __m256i cells) {
+    __m256i words = _mm256_i32gather_epi32(
+        reinterpret_cast<const int *>(bits), _mm256_srli_epi32(cells, 5), 4);
+    __m256i shifted = _mm256_srlv_epi32(
+        words, _mm256_and_si256(cells, _mm256_set1_epi32(31)));
+    return _mm256_and_si256(shifted, _mm256_set1_epi32(1));
+  }
+
+  /*!
+   * \brief Mobility with one neighbor row, six hexes and two padding lanes,
+   * per iteration.
+   */
+  __attribute__((target("avx2,popcnt"))) static int
+  mobilityAvx2(const GameState &state, const Army &army) {
+    const std::uint32_t *occupied = state.getOccupiedBits();
+    const std::uint32_t *tall = state.getTallBits();
+    const NeighborTable &table = state.getNeighbors();
+    // Lanes 6 and 7 hold the sentinel and the count: point them at the
+    // sentinel hex, which is occupied.
+    __m256i padding = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, -1, -1);
+    __m256i sentinel = _mm256_set1_epi32(table.sentinel());
+    int sum = 0;
+    for (int k = 0; k < army.size; ++k) {
+      __m256i row = _mm256_blendv_epi8(
+          _mm256_load_si256(
+              reinterpret_cast<const __m256i *>(table.of(army.cell[k]))),
+          sentinel, padding);
+      __m256i blocked = gatherBits(occupied, row);
+      __m256i high = gatherBits(tall, row);
+      if (testBit(tall, army.cell[k])) {
+        high = _mm256_setzero_si256();
+      }
+      __m256i climb = _mm256_cmpeq_epi32(row, _mm256_set1_epi32(army.east[k]));
+      __m256i stuck =
+          _mm256_or_si256(blocked, _mm256_andnot_si256(climb, high));
+      __m256i free = _mm256_cmpeq_epi32(stuck, _mm256_setzero_si256());
+      sum += _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(free)));
+    }
+    return sum;
+  }
+
+  __attribute__((target("avx2,popcnt"))) static int
+  tallAvx2(const GameState &state, const Army &army) {
+    const std::uint32_t *tall = state.getTallBits();
+    int sum = 0;
+    for (int k = 0; k < army.padded; k += LANES) {
+      __m256i cells = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(army.cell.data() + k));
+      __m256i high = gatherBits(tall, cells);
+      sum += _mm_popcnt_u32(_mm256_movemask_ps(
+          _mm256_castsi256_ps(_mm256_slli_epi32(high, 31))));
+    }
+    return sum;
+  }
+#endif
+
+  EvalWeights weights;
+  Kernel active;
+  Army armies[2];
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "doctest.h"
+#include "evaluation.h"
+
+/*!
+ * \brief Computes the evaluation terms straight from the rules.
+ */
+static EvalTerms naiveTerms(const GameState &state, const EvalWeights &weights) {
+    EvalTerms terms;
+    for (int player = 0; player < 2; ++player) {
+        terms.material[player] = terms.mobility[player] = 0;
+        terms.threat[player] = terms.tall[player] = 0;
+        for (const Unit &unit : state.getUnits(player)) {
+            UnitStats stats = state.statsOf(unit);
+            terms.material[player] += unit.HP * weights.unitValue[unit.type];
+            terms.tall[player] += state.isTall(unit.cell);
+            int out[6];
+            int count = state.neighbors(unit.cell, out);
+            for (int k = 0; k < count; ++k) {
+                terms.mobility[player] +=
+                    !state.isOccupied(out[k]) && state.canStep(unit.cell, out[k]);
+            }
+            for (const Unit &enemy : state.getUnits(1 - player)) {
+                if (withinRange(state.rowOf(unit.cell), state.colOf(unit.cell),
+                                state.rowOf(enemy.cell), state.colOf(enemy.cell),
+                                stats.attack_diapason)) {
+                    terms.threat[player] += stats.attack;
+                }
+            }
+        }
+    }
+    return terms;
+}
+
+static void checkTerms(const EvalTerms &a, const EvalTerms &b) {
+    for (int player = 0; player < 2; ++player) {
+        REQUIRE(a.material[player] == b.material[player]);
+        REQUIRE(a.mobility[player] == b.mobility[player]);
+        REQUIRE(a.threat[player] == b.threat[player]);
+        REQUIRE(a.tall[player] == b.tall[player]);
+    }
+}
+
+TEST_CASE("Evaluator Class: Every Kernel Matches The Rules") {
+    const Evaluator::Kernel kernels[] = {Evaluator::ScalarKernel,
+                                         Evaluator::Sse42Kernel,
+                                         Evaluator::Avx2Kernel};
+    Evaluator evaluator;
+    CHECK(evaluator.getKernel() == Evaluator::bestKernel());
+    int positions = 0;
+    for (std::uint32_t seed = 0; seed < 20; ++seed) {
+        int size = 6 + static_cast<int>(seed % 4) * 5;
+        GameState state(size, size, 3 + static_cast<int>(seed % 11));
+        state.generateTall(seed, size * size / 4);
+        std::mt19937 rng(seed);
+        std::vector<Action> actions;
+        while (!state.isFinished() && state.getTurn() < 60) {
+            state.generateActions(actions);
+            if (actions.empty()) {
+                break;
+            }
+            state.apply(actions[rng() % actions.size()]);
+            EvalTerms expected = naiveTerms(state, defaultEvalWeights());
+            for (Evaluator::Kernel kernel : kernels) {
+                if (!evaluator.setKernel(kernel)) {
+                    MESSAGE("kernel not supported: " << Evaluator::kernelName(kernel));
+                    continue;
+                }
+                EvalTerms terms;
+                evaluator.measure(state, terms);
+                checkTerms(terms, expected);
+            }
+            ++positions;
+        }
+    }
+    CHECK(positions > 500);
+}
+
+TEST_CASE("Evaluator Class: A ThreatMap Gives The Same Threat Term") {
+    Evaluator evaluator;
+    for (std::uint32_t seed = 0; seed < 6; ++seed) {
+        GameState state(16, 16, 30);
+        state.generateTall(seed, 40);
+        ThreatMap map;
+        map.rebuild(state);
+        std::mt19937 rng(seed);
+        std::vector<Action> actions;
+        ActionUndo undo;
+        while (!state.isFinished() && state.getTurn() < 80) {
+            state.generateActions(actions);
+            if (actions.empty()) {
+                break;
+            }
+            REQUIRE(state.make(actions[rng() % actions.size()], undo));
+            map.update(state, undo);
+            EvalTerms terms;
+            evaluator.measure(state, map, terms);
+            checkTerms(terms, naiveTerms(state, defaultEvalWeights()));
+            REQUIRE(evaluator.evaluate(state, map) == evaluator.evaluate(state));
+        }
+    }
+}
+
+TEST_CASE("Evaluator Class: Scores Are From The Side To Move") {
+    GameState state(8, 8, 2);
+    REQUIRE(state.apply(GameState::makeAction(PlaceUnit, 0, 1, -1, state.cellIndex(3, 0))));
+    REQUIRE(state.apply(GameState::makeAction(PlaceUnit, 1, 0, -1, state.cellIndex(3, 7))));
+    REQUIRE(state.apply(GameState::makeAction(FinishPlacement, 0, 0, -1, -1)));
+    Evaluator evaluator;
+    int score = evaluator.evaluate(state);
+    // The archer outvalues the knight and reaches it from across the board.
+    CHECK(score > 0);
+    REQUIRE(state.apply(GameState::makeAction(MoveUnit, 0, 0, state.cellIndex(3, 0),
+                                              state.cellIndex(2, 0))));
+    CHECK(evaluator.evaluate(state) < 0);
+
+    std::vector<Unit> armies[2];
+    armies[0].push_back(Unit{0, 5, state.cellIndex(4, 4)});
+    GameState won(8, 8, 2);
+    won.restore(armies, 1, false, 10);
+    CHECK(won.getWinner() == 0);
+    CHECK(evaluator.evaluate(won) == -Evaluator::WIN_SCORE);
+}
@@ -6,6 +6,7 @@
 #include <SFML/System.hpp>
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
+#include "game.h"
 #include <cmath>
 #include <iostream>
 #include <memory>
@@ -48,10 +49,10 @@ public:
   }
 
   /*!
-   * \brief Draws the circle to the window.
-   * \param window The window to draw the circle on.
+   * \brief Draws the circle to a render target.
+   * \param window The window (or render texture) to draw the circle on.
    */
-  void draw(sf::RenderWindow &window) {
+  void draw(sf::RenderTarget &window) {
     if (tall) {
       circle.setFillColor(sf::Color(255, 165, 0));
     } else {
@@ -94,6 +95,12 @@ public:
            sf::Vector2f(circle.getRadius(), circle.getRadius());
   }
 
+  /*!
+   * \brief Gets the area covered by the circle, outline included.
+   * \return The bounding rectangle of the circle in world coordinates.
+   */
+  sf::FloatRect getBounds() const { return circle.getGlobalBounds(); }
+
   /*!
    * \brief Checks if the circle is occupied.
    * \return True if the circle is occupied, false otherwise.
@@ -194,6 +201,18 @@ public:
    */
   int getAttack() const { return attack; }
 
+  /*!
+   * \brief Gets the unit type of the NPC.
+   * \return The type given to createCharacter(), 0 if it was built directly.
+   */
+  int getType() const { return type; }
+
+  /*!
+   * \brief Sets the unit type of the NPC.
+   * \param newType The unit type (0: Knight, 1: Archer, 2: Cleric).
+   */
+  void setType(int newType) { type = newType; }
+
   /*!
    * \brief Checks if two NPCs are at the same position.
    * \param other The other NPC to compare with.
@@ -211,6 +230,7 @@ protected:
   int HP;
   int attack_diapason;
   int attack;
+  int type = 0;
 };
 
 /*!
@@ -353,7 +373,8 @@ private:
  * \param circle2 The second circle.
  * \return The distance between the centers of the two circles.
  */
-float DestinationBetweenCircle(const Circle &circle1, const Circle &circle2) {
+inline float DestinationBetweenCircle(const Circle &circle1,
+                                      const Circle &circle2) {
   sf::Vector2f center1 = circle1.getCenter();
   sf::Vector2f center2 = circle2.getCenter();
   return sqrt(pow(center1.x - center2.x, 2) + pow(center1.y - center2.y, 2));
@@ -366,8 +387,8 @@ float DestinationBetweenCircle(const Circle &circle1, const Circle &circle2) {
  * \return True if the previous circle position is valid for healing, false
  * otherwise.
  */
-bool PositionBetweenTallandnotTall(const Circle &circle1,
-                                   const Circle &circle2) {
+inline bool PositionBetweenTallandnotTall(const Circle &circle1,
+                                          const Circle &circle2) {
   sf::Vector2f previouscenter1 = circle1.getCenter();
   sf::Vector2f center2 = circle2.getCenter();
   if (previouscenter1.y == center2.y && previouscenter1.x >= center2.x) {
@@ -385,19 +406,28 @@ bool PositionBetweenTallandnotTall(const Circle &circle1,
  * Indicates whether the character belongs to the player or the opponent.
  * \return The newly created NPC character.
  */
-NPC createCharacter(int type, float R, bool Player) {
-  NPC character(R, Player ? sf::Color::Blue : sf::Color::Red, 50, 2, 1, 4);
+inline NPC createCharacter(int type, float R, bool Player) {
+  // The combat statistics come from the rules, so a balance change made in
+  // defaultUnitStats() reaches the UI as well.
+  UnitStats stats = defaultUnitStats(type);
+  NPC character(R, Player ? sf::Color::Blue : sf::Color::Red, stats.HP,
+                stats.attack_diapason, stats.attack, 4);
+  character.setType(type);
   if (type == 0) {
-    Knight character(R, Player ? sf::Color::Blue : sf::Color::Red, 50, 2, 20,
-                     4);
+    Knight character(R, Player ? sf::Color::Blue : sf::Color::Red, stats.HP,
+                     stats.attack_diapason, stats.attack, 4);
+    character.setType(type);
     return character;
   } else if (type == 1) {
-    Archer character(R, Player ? sf::Color::Blue : sf::Color::Red, 30, 10, 15,
-                     3);
+    Archer character(R, Player ? sf::Color::Blue : sf::Color::Red, stats.HP,
+                     stats.attack_diapason, stats.attack, 3);
+    character.setType(type);
     return character;
   } else if (type == 2) {
-    Cleric character(R, Player ? sf::Color::Blue : sf::Color::Red, 40, 8, 10,
-                     15, 100);
+    Cleric character(R, Player ? sf::Color::Blue : sf::Color::Red, stats.HP,
+                     stats.attack_diapason, stats.attack, stats.healAmount,
+                     100);
+    character.setType(type);
     return character;
   }
   return character;
@@ -408,7 +438,7 @@ NPC createCharacter(int type, float R, bool Player) {
  * \param choice The current player's turn.
  * \return The next player's turn.
  */
-bool ChangePlayermove(bool choice) {
+inline bool ChangePlayermove(bool choice) {
   if (choice) {
     return false;
   } else {
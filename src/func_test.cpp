@@ -131,6 +131,7 @@ TEST_CASE("createCharacter Function: Create Knight") {
     REQUIRE(knight.getHP() == 50);
     REQUIRE(knight.getAttackDiapason() == 2);
     REQUIRE(knight.getAttack() == 20);
+    REQUIRE(knight.getType() == 0);
 }
 
 TEST_CASE("createCharacter Function: Create Archer") {
@@ -138,6 +139,7 @@ TEST_CASE("createCharacter Function: Create Archer") {
     REQUIRE(archer.getHP() == 30);
     REQUIRE(archer.getAttackDiapason() == 10);
     REQUIRE(archer.getAttack() == 15);
+    REQUIRE(archer.getType() == 1);
 }
 
 TEST_CASE("createCharacter Function: Create Cleric") {
@@ -145,6 +147,7 @@ TEST_CASE("createCharacter Function: Create Cleric") {
     REQUIRE(cleric.getHP() == 40);
     REQUIRE(cleric.getAttackDiapason() == 8);
     REQUIRE(cleric.getAttack() == 10);
+    REQUIRE(cleric.getType() == 2);
 }
 
 TEST_CASE("ChangePlayermove Function: Toggle Player Turn") {
@@ -0,0 +1,915 @@
+#ifndef GAME
+#define GAME
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+/*!
+ * \brief Number of unit types (0: Knight, 1: Archer, 2: Cleric).
+ */
+const int UNIT_TYPES = 3;
+
+/*!
+ * \brief The combat statistics of a unit type.
+ */
+struct UnitStats {
+  int HP;
+  int attack_diapason;
+  int attack;
+  int healAmount;
+};
+
+/*!
+ * \brief Gets the statistics createCharacter() gives to a unit type.
+ * \param type The type of unit (0: Knight, 1: Archer, 2: Cleric).
+ * \return The statistics of the unit type.
+ */
+inline UnitStats defaultUnitStats(int type) {
+  if (type == 0) {
+    return UnitStats{50, 2, 20, 0};
+  } else if (type == 1) {
+    return UnitStats{30, 10, 15, 0};
+  } else if (type == 2) {
+    return UnitStats{40, 8, 10, 15};
+  }
+  return UnitStats{50, 2, 1, 0};
+}
+
+/*!
+ * \brief A unit on the board.
+ */
+struct Unit {
+  int type;
+  int HP;
+  int cell;
+};
+
+/*!
+ * \brief The kinds of player actions.
+ */
+enum ActionKind : std::uint8_t {
+  PlaceUnit = 0,
+  MoveUnit = 1,
+  AttackUnit = 2,
+  FinishPlacement = 3
+};
+
+/*!
+ * \brief A single player action. Cells are indices row * cols + col.
+ *
+ * PlaceUnit uses player, unitType and to; MoveUnit and AttackUnit use player,
+ * from and to; FinishPlacement uses nothing.
+ */
+struct Action {
+  std::uint8_t kind;
+  std::uint8_t player;
+  std::uint8_t unitType;
+  std::int32_t from;
+  std::int32_t to;
+
+  bool operator==(const Action &other) const {
+    return kind == other.kind && player == other.player &&
+           unitType == other.unitType && from == other.from && to == other.to;
+  }
+};
+
+/*!
+ * \brief What GameState::unmake() needs to take an action back.
+ *
+ * A few integers instead of a copy of the board: the turn state before the
+ * action and, for attacks, the slot and former state of the hit unit.
+ */
+struct ActionUndo {
+  Action action;
+  int sideToMove;
+  int turn;
+  int winner;
+  int victimIndex;
+  Unit victim;
+  bool killed;
+};
+
+/*!
+ * \brief Checks if a cell lies within an attack range of another.
+ *
+ * Integer form of the check in main.cpp: the distance between the cell
+ * centers must not exceed diapason * r + r / 10, where r is the inner radius
+ * of a hex. Centers sit 2r apart along a row and r * sqrt(3) apart between
+ * rows, with odd rows shifted by r.
+ * \param rowA The row of the first cell.
+ * \param colA The column of the first cell.
+ * \param rowB The row of the second cell.
+ * \param colB The column of the second cell.
+ * \param diapason The range in units of r.
+ * \return True if the second cell is within range of the first.
+ */
+inline bool withinRange(int rowA, int colA, int rowB, int colB, int diapason) {
+  std::int64_t dx = (2 * colB + (rowB & 1)) - (2 * colA + (rowA & 1));
+  std::int64_t dy = rowB - rowA;
+  std::int64_t limit = 10 * diapason + 1;
+  return 100 * (dx * dx + 3 * dy * dy) <= limit * limit;
+}
+
+/*!
+ * \brief The neighbors of every hex of a board size, computed once.
+ *
+ * Odd rows are shifted right, so the neighbor offsets depend on the row
+ * parity. The table resolves that once: each cell owns a row of ROW_SIZE
+ * entries holding its neighbors packed first (west, east, then the two above
+ * and the two below), sentinel() for missing ones, and the count in the last
+ * entry. Rows are 32 bytes and the table is 64-byte aligned, so a lookup
+ * touches one cache line. Tables are shared by every state of a board size
+ * and live until the program exits.
+ */
+class NeighborTable {
+public:
+  static const int ROW_SIZE = 8;
+
+  /*!
+   * \brief Gets the table of a board size, building it on first use.
+   * \param rows The number of board rows.
+   * \param cols The number of board columns.
+   * \return The shared table.
+   */
+  static const NeighborTable &forBoard(int rows, int cols) {
+    static std::mutex mutex;
+    static std::map<std::pair<int, int>, std::unique_ptr<NeighborTable>> tables;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<NeighborTable> &table = tables[std::make_pair(rows, cols)];
+    if (!table) {
+      table.reset(new NeighborTable(rows, cols));
+    }
+    return *table;
+  }
+
+  /*!
+   * \brief Gets the neighbor row of a hex.
+   * \param cell The index of the hex.
+   * \return Six neighbor indices, padded with sentinel().
+   */
+  const std::int32_t *of(int cell) const { return base + cell * ROW_SIZE; }
+
+  /*!
+   * \brief Gets the number of neighbors of a hex.
+   */
+  int count(int cell) const { return base[cell * ROW_SIZE + 7]; }
+
+  /*!
+   * \brief Gets the index used for missing neighbors: one past the last hex.
+   */
+  int sentinel() const { return rows * cols; }
+
+  /*!
+   * \brief Checks if two hexes share an edge without branching per entry.
+   */
+  bool adjacent(int a, int b) const {
+    const std::int32_t *row = of(a);
+    return ((row[0] == b) | (row[1] == b) | (row[2] == b) | (row[3] == b) |
+            (row[4] == b) | (row[5] == b)) != 0;
+  }
+
+private:
+  NeighborTable(int rows, int cols)
+      : rows(rows), cols(cols),
+        storage(static_cast<size_t>(rows) * cols * ROW_SIZE + 16) {
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(storage.data());
+    base = storage.data() + ((64 - address % 64) % 64) / sizeof(std::int32_t);
+    for (int i = 0; i < rows; ++i) {
+      int shift = i & 1;
+      const int dr[6] = {0, 0, -1, -1, 1, 1};
+      const int dc[6] = {-1, 1, shift - 1, shift, shift - 1, shift};
+      for (int j = 0; j < cols; ++j) {
+        std::int32_t *row = base + (i * cols + j) * ROW_SIZE;
+        int count = 0;
+        for (int k = 0; k < 6; ++k) {
+          int ni = i + dr[k];
+          int nj = j + dc[k];
+          if (ni >= 0 && ni < rows && nj >= 0 && nj < cols) {
+            row[count++] = ni * cols + nj;
+          }
+        }
+        for (int k = count; k < ROW_SIZE - 1; ++k) {
+          row[k] = sentinel();
+        }
+        row[ROW_SIZE - 1] = count;
+      }
+    }
+  }
+
+  NeighborTable(const NeighborTable &) = delete;
+  NeighborTable &operator=(const NeighborTable &) = delete;
+
+  int rows;
+  int cols;
+  std::vector<std::int32_t> storage;
+  std::int32_t *base;
+};
+
+/*!
+ * \brief The rules of the game without any rendering.
+ *
+ * Mirrors main.cpp: players deploy units into their two edge columns, then
+ * take turns either moving a unit to an adjacent free hex or attacking an
+ * enemy within range. A unit may only climb onto a tall hex from a flat one
+ * by moving right along its row. The player who removes the last enemy unit
+ * wins. Player 0 is "Player 1" of the UI.
+ */
+class GameState {
+public:
+  /*!
+   * \brief Constructor for GameState with specified parameters.
+   * \param rows The number of board rows.
+   * \param cols The number of board columns.
+   * \param maxNPC The maximum number of units per player.
+   */
+  GameState(int rows = 8, int cols = 8, int maxNPC = 3)
+      : rows(rows), cols(cols), maxNPC(maxNPC),
+        adjacency(&NeighborTable::forBoard(rows, cols)),
+        tall(rows * cols + 1, 0), occupant(rows * cols + 1, -1),
+        tallBits(bitWords(rows * cols + 1), 0),
+        occupiedBits(bitWords(rows * cols + 1), 0), sideToMove(0),
+        placement(true), winner(-1), turn(0), key(PLACEMENT_KEY) {
+    // The sentinel hex of the neighbor table is never free.
+    place(rows * cols, OFF_BOARD);
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+      stats[type] = defaultUnitStats(type);
+    }
+  }
+
+  /*!
+   * \brief Replaces the statistics of a unit type, e.g. to try a balance
+   * change. Set them before units are placed: units already on the board
+   * keep their HP.
+   * \param type The type of unit.
+   * \param value The new statistics.
+   */
+  void setUnitStats(int type, const UnitStats &value) { stats[type] = value; }
+
+  /*!
+   * \brief Gets the statistics of a unit type.
+   * \param type The type of unit.
+   * \return defaultUnitStats(type) unless changed with setUnitStats().
+   */
+  const UnitStats &getUnitStats(int type) const { return stats[type]; }
+
+  /*!
+   * \brief Raises random interior hexes the way main.cpp does.
+   * \param seed The seed of the random generator.
+   * \param number_of_tall The maximum number of tall hexes.
+   */
+  void generateTall(std::uint32_t seed, int number_of_tall = 4) {
+    std::mt19937 rng(seed);
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        if (rng() % 2 == 0 && j != 0 && j != cols - 1 && i != 0 &&
+            i != rows - 1 && number_of_tall != 0) {
+          setTall(cellIndex(i, j), true);
+          number_of_tall -= 1;
+        }
+      }
+    }
+  }
+
+  /*!
+   * \brief Sets the tall status of a hex.
+   * \param cell The index of the hex.
+   * \param value The new tall status.
+   */
+  void setTall(int cell, bool value) {
+    if (isTall(cell) != value) {
+      key ^= tallKey(cell);
+    }
+    tall[cell] = value ? 1 : 0;
+    writeBit(tallBits, cell, value);
+  }
+
+  /*!
+   * \brief Gets the number of board rows.
+   * \return The number of rows.
+   */
+  int getRows() const { return rows; }
+
+  /*!
+   * \brief Gets the number of board columns.
+   * \return The number of columns.
+   */
+  int getCols() const { return cols; }
+
+  /*!
+   * \brief Gets the maximum number of units per player.
+   * \return The deployment limit.
+   */
+  int getMaxNPC() const { return maxNPC; }
+
+  /*!
+   * \brief Converts a row and a column to a cell index.
+   * \param row The row of the hex.
+   * \param col The column of the hex.
+   * \return The index row * cols + col.
+   */
+  int cellIndex(int row, int col) const { return row * cols + col; }
+
+  /*!
+   * \brief Gets the row of a cell index.
+   */
+  int rowOf(int cell) const { return cell / cols; }
+
+  /*!
+   * \brief Gets the column of a cell index.
+   */
+  int colOf(int cell) const { return cell % cols; }
+
+  /*!
+   * \brief Gets the neighbor table of the board.
+   *
+   * Its sentinel hex may be passed to isTall(), isOccupied() and canStep():
+   * it is flat and never free.
+   */
+  const NeighborTable &getNeighbors() const { return *adjacency; }
+
+  /*!
+   * \brief Checks if a hex is tall.
+   * \param cell The index of the hex.
+   * \return True if the hex is tall, false otherwise.
+   */
+  bool isTall(int cell) const { return tall[cell] != 0; }
+
+  /*!
+   * \brief Checks if a hex holds a unit.
+   * \param cell The index of the hex.
+   * \return True if the hex is occupied, false otherwise.
+   */
+  bool isOccupied(int cell) const { return occupant[cell] != -1; }
+
+  /*!
+   * \brief Gets the tall hexes as a bitboard.
+   *
+   * Bit cell % 32 of word cell / 32 is set for every tall hex. The words
+   * cover the sentinel hex of the neighbor table, which is flat.
+   * \return The words of the bitboard.
+   */
+  const std::uint32_t *getTallBits() const { return tallBits.data(); }
+
+  /*!
+   * \brief Gets the occupied hexes as a bitboard, laid out as getTallBits().
+   *
+   * The sentinel hex of the neighbor table is marked occupied.
+   * \return The words of the bitboard.
+   */
+  const std::uint32_t *getOccupiedBits() const { return occupiedBits.data(); }
+
+  /*!
+   * \brief Gets the owner of the unit standing on a hex.
+   * \param cell The index of the hex.
+   * \return 0 or 1, or -1 if the hex is free.
+   */
+  int ownerAt(int cell) const {
+    return occupant[cell] == -1 ? -1 : occupant[cell] & 1;
+  }
+
+  /*!
+   * \brief Gets the index of the unit standing on a hex.
+   * \param cell The index of the hex.
+   * \return The index in getUnits(ownerAt(cell)), or -1 if the hex is free.
+   */
+  int unitIndexAt(int cell) const {
+    return occupant[cell] == -1 ? -1 : occupant[cell] >> 1;
+  }
+
+  /*!
+   * \brief Gets the units of a player. Order changes when units die.
+   * \param player The player (0 or 1).
+   * \return The units of the player.
+   */
+  const std::vector<Unit> &getUnits(int player) const { return units[player]; }
+
+  /*!
+   * \brief Checks if the game is still in the deployment phase.
+   * \return True until FinishPlacement is applied.
+   */
+  bool isPlacement() const { return placement; }
+
+  /*!
+   * \brief Checks if one player has lost all units.
+   * \return True if the game is over.
+   */
+  bool isFinished() const { return winner != -1; }
+
+  /*!
+   * \brief Gets the player whose turn it is.
+   * \return 0 or 1.
+   */
+  int getSideToMove() const { return sideToMove; }
+
+  /*!
+   * \brief Gets the winner of the game.
+   * \return 0 or 1, or -1 while the game is running.
+   */
+  int getWinner() const { return winner; }
+
+  /*!
+   * \brief Gets the number of battle turns played.
+   * \return The number of moves and attacks applied.
+   */
+  int getTurn() const { return turn; }
+
+  /*!
+   * \brief Replaces the units and the turn state, e.g. from a snapshot.
+   *
+   * The winner is derived from the armies; the terrain is kept.
+   * \param armies The units of both players.
+   * \param side The player whose turn it is.
+   * \param inPlacement True while the game is in the deployment phase.
+   * \param turnCount The number of battle turns played.
+   * \return False if a unit is invalid, off the board or shares a hex.
+   */
+  bool restore(const std::vector<Unit> armies[2], int side, bool inPlacement,
+               int turnCount) {
+    std::fill(occupant.begin(), occupant.end() - 1, -1);
+    std::fill(occupiedBits.begin(), occupiedBits.end(), 0);
+    place(rows * cols, OFF_BOARD);
+    units[0].clear();
+    units[1].clear();
+    bool valid = side == 0 || side == 1;
+    for (int player = 0; player < 2; ++player) {
+      for (const Unit &unit : armies[player]) {
+        if (!isCell(unit.cell) || isOccupied(unit.cell) || unit.type < 0 ||
+            unit.type >= UNIT_TYPES || unit.HP <= 0 ||
+            static_cast<int>(units[player].size()) >= maxNPC) {
+          valid = false;
+          continue;
+        }
+        place(unit.cell, player + 2 * static_cast<int>(units[player].size()));
+        units[player].push_back(unit);
+      }
+    }
+    sideToMove = side == 1 ? 1 : 0;
+    placement = inPlacement;
+    turn = turnCount;
+    winner = -1;
+    if (!placement && units[0].empty() != units[1].empty()) {
+      winner = units[0].empty() ? 1 : 0;
+    }
+    key = computeHash();
+    return valid;
+  }
+
+  /*!
+   * \brief Gets the hash of the position.
+   *
+   * A Zobrist-style key over terrain, units with their HP, the side to move
+   * and the phase, updated incrementally by every change. It only depends on
+   * integer state, so clients replaying the same actions get the same value
+   * on every platform.
+   * \return The 64-bit hash.
+   */
+  std::uint64_t hash() const { return key; }
+
+  /*!
+   * \brief Recomputes the hash of the position from scratch.
+   * \return The value hash() must have.
+   */
+  std::uint64_t computeHash() const {
+    std::uint64_t value = placement ? PLACEMENT_KEY : 0;
+    if (sideToMove == 1) {
+      value ^= SIDE_KEY;
+    }
+    for (int cell = 0; cell < rows * cols; ++cell) {
+      if (isTall(cell)) {
+        value ^= tallKey(cell);
+      }
+    }
+    for (int player = 0; player < 2; ++player) {
+      for (const Unit &unit : units[player]) {
+        value ^= unitKey(player, unit);
+      }
+    }
+    return value;
+  }
+
+  /*!
+   * \brief Checks if a player may deploy units into a column.
+   * \param player The player (0 or 1).
+   * \param col The column.
+   * \return True if the column belongs to the player's deployment zone.
+   */
+  bool isDeploymentColumn(int player, int col) const {
+    return player == 0 ? col < 2 : col >= cols - 2;
+  }
+
+  /*!
+   * \brief Lists the hexes adjacent to a hex.
+   * \param cell The index of the hex.
+   * \param out Receives up to 6 neighbor indices.
+   * \return The number of neighbors written.
+   */
+  int neighbors(int cell, int out[6]) const {
+    const std::int32_t *row = adjacency->of(cell);
+    std::copy(row, row + 6, out);
+    return adjacency->count(cell);
+  }
+
+  /*!
+   * \brief Checks if two hexes are adjacent.
+   * \param a The index of the first hex.
+   * \param b The index of the second hex.
+   * \return True if the hexes share an edge.
+   */
+  bool isAdjacent(int a, int b) const { return adjacency->adjacent(a, b); }
+
+  /*!
+   * \brief Checks the tall-terrain rule for a step between adjacent hexes.
+   *
+   * Same outcome as the PositionBetweenTallandnotTall() check in main.cpp.
+   * \param from The index of the hex the unit leaves.
+   * \param to The index of the hex the unit enters.
+   * \return True if the step is allowed by the terrain.
+   */
+  bool canStep(int from, int to) const {
+    if (!isTall(to) || isTall(from)) {
+      return true;
+    }
+    return rowOf(from) == rowOf(to) && colOf(to) > colOf(from);
+  }
+
+  /*!
+   * \brief Checks if an action is allowed in the current state.
+   * \param action The action to check.
+   * \return True if apply() would accept the action.
+   */
+  bool isLegal(const Action &action) const {
+    if (isFinished() || action.player > 1) {
+      return false;
+    }
+    switch (action.kind) {
+    case PlaceUnit:
+      return placement && action.unitType < UNIT_TYPES &&
+             isCell(action.to) && !isOccupied(action.to) &&
+             static_cast<int>(units[action.player].size()) < maxNPC &&
+             isDeploymentColumn(action.player, colOf(action.to));
+    case FinishPlacement:
+      return placement && !units[0].empty() && !units[1].empty();
+    case MoveUnit:
+      return !placement && action.player == sideToMove &&
+             isCell(action.from) && isCell(action.to) &&
+             ownerAt(action.from) == sideToMove && !isOccupied(action.to) &&
+             isAdjacent(action.from, action.to) &&
+             canStep(action.from, action.to);
+    case AttackUnit:
+      if (placement || action.player != sideToMove || !isCell(action.from) ||
+          !isCell(action.to) || ownerAt(action.from) != sideToMove ||
+          ownerAt(action.to) != 1 - sideToMove) {
+        return false;
+      }
+      return withinRange(
+          rowOf(action.from), colOf(action.from), rowOf(action.to),
+          colOf(action.to),
+          statsOf(units[sideToMove][unitIndexAt(action.from)])
+              .attack_diapason);
+    }
+    return false;
+  }
+
+  /*!
+   * \brief Performs an action if it is legal.
+   * \param action The action to perform.
+   * \return True if the action was performed, false if it was illegal.
+   */
+  bool apply(const Action &action) {
+    ActionUndo undo;
+    return make(action, undo);
+  }
+
+  /*!
+   * \brief Performs an action if it is legal and records how to revert it.
+   *
+   * Neither make() nor unmake() allocates, so search can walk a tree on one
+   * state with an ActionUndo per ply.
+   * \param action The action to perform.
+   * \param undo Receives what unmake() needs.
+   * \return True if the action was performed, false if it was illegal.
+   */
+  bool make(const Action &action, ActionUndo &undo) {
+    if (!isLegal(action)) {
+      return false;
+    }
+    undo.action = action;
+    undo.sideToMove = sideToMove;
+    undo.turn = turn;
+    undo.winner = winner;
+    undo.victimIndex = -1;
+    undo.killed = false;
+    switch (action.kind) {
+    case PlaceUnit:
+      addUnit(action.player, action.unitType, action.to);
+      break;
+    case FinishPlacement:
+      placement = false;
+      if (sideToMove != 0) {
+        // A restored deployment may have player 1 to move.
+        sideToMove = 0;
+        key ^= SIDE_KEY;
+      }
+      key ^= PLACEMENT_KEY;
+      break;
+    case MoveUnit: {
+      int code = occupant[action.from];
+      Unit &unit = units[sideToMove][code >> 1];
+      key ^= unitKey(sideToMove, unit);
+      unit.cell = action.to;
+      key ^= unitKey(sideToMove, unit);
+      place(action.from, -1);
+      place(action.to, code);
+      endTurn();
+      break;
+    }
+    case AttackUnit: {
+      int enemy = 1 - sideToMove;
+      int attacker = unitIndexAt(action.from);
+      int target = unitIndexAt(action.to);
+      Unit &victim = units[enemy][target];
+      undo.victimIndex = target;
+      undo.victim = victim;
+      key ^= unitKey(enemy, victim);
+      victim.HP -= statsOf(units[sideToMove][attacker]).attack;
+      key ^= unitKey(enemy, victim);
+      if (victim.HP <= 0) {
+        undo.killed = true;
+        removeUnit(enemy, target);
+        if (units[enemy].empty()) {
+          winner = sideToMove;
+        }
+      }
+      endTurn();
+      break;
+    }
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Reverts the last action performed with make().
+   *
+   * Actions must be reverted in the reverse order they were made. Unit
+   * order, and therefore unit indices, are restored as well.
+   * \param undo The record filled by make().
+   */
+  void unmake(const ActionUndo &undo) {
+    const Action &action = undo.action;
+    switch (action.kind) {
+    case PlaceUnit:
+      removeUnit(action.player,
+                 static_cast<int>(units[action.player].size()) - 1);
+      break;
+    case FinishPlacement:
+      placement = true;
+      key ^= PLACEMENT_KEY;
+      break;
+    case MoveUnit: {
+      int code = occupant[action.to];
+      Unit &unit = units[undo.sideToMove][code >> 1];
+      key ^= unitKey(undo.sideToMove, unit);
+      unit.cell = action.from;
+      key ^= unitKey(undo.sideToMove, unit);
+      place(action.to, -1);
+      place(action.from, code);
+      break;
+    }
+    case AttackUnit: {
+      int enemy = 1 - undo.sideToMove;
+      std::vector<Unit> &army = units[enemy];
+      if (undo.killed) {
+        // Undo the swap-remove: the unit moved into the slot goes back last.
+        if (undo.victimIndex < static_cast<int>(army.size())) {
+          army.push_back(army[undo.victimIndex]);
+          occupant[army.back().cell] =
+              enemy + 2 * (static_cast<int>(army.size()) - 1);
+          army[undo.victimIndex] = undo.victim;
+        } else {
+          army.push_back(undo.victim);
+        }
+        place(undo.victim.cell, enemy + 2 * undo.victimIndex);
+        key ^= unitKey(enemy, undo.victim);
+      } else {
+        Unit &victim = army[undo.victimIndex];
+        key ^= unitKey(enemy, victim);
+        victim.HP = undo.victim.HP;
+        key ^= unitKey(enemy, victim);
+      }
+      break;
+    }
+    }
+    if (sideToMove != undo.sideToMove) {
+      key ^= SIDE_KEY;
+    }
+    sideToMove = undo.sideToMove;
+    turn = undo.turn;
+    winner = undo.winner;
+  }
+
+  /*!
+   * \brief Lists every legal action.
+   *
+   * During deployment this includes placements for both players and, when
+   * both have units, FinishPlacement. Afterwards it lists the moves and
+   * attacks of the side to move.
+   * \param out Cleared and filled with the legal actions.
+   */
+  void generateActions(std::vector<Action> &out) const {
+    out.clear();
+    if (isFinished()) {
+      return;
+    }
+    if (placement) {
+      for (int player = 0; player < 2; ++player) {
+        if (static_cast<int>(units[player].size()) >= maxNPC) {
+          continue;
+        }
+        for (int i = 0; i < rows; ++i) {
+          for (int j = 0; j < cols; ++j) {
+            int cell = cellIndex(i, j);
+            if (!isDeploymentColumn(player, j) || isOccupied(cell)) {
+              continue;
+            }
+            for (int type = 0; type < UNIT_TYPES; ++type) {
+              out.push_back(makeAction(PlaceUnit, player, type, -1, cell));
+            }
+          }
+        }
+      }
+      if (!units[0].empty() && !units[1].empty()) {
+        out.push_back(makeAction(FinishPlacement, 0, 0, -1, -1));
+      }
+      return;
+    }
+
+    const std::vector<Unit> &own = units[sideToMove];
+    const std::vector<Unit> &enemies = units[1 - sideToMove];
+    for (const Unit &unit : own) {
+      // Missing neighbors are the sentinel hex, which is never free.
+      const std::int32_t *adjacent = adjacency->of(unit.cell);
+      for (int k = 0; k < 6; ++k) {
+        if (!isOccupied(adjacent[k]) && canStep(unit.cell, adjacent[k])) {
+          out.push_back(
+              makeAction(MoveUnit, sideToMove, 0, unit.cell, adjacent[k]));
+        }
+      }
+      int diapason = statsOf(unit).attack_diapason;
+      int row = rowOf(unit.cell);
+      int col = colOf(unit.cell);
+      for (const Unit &enemy : enemies) {
+        if (withinRange(row, col, rowOf(enemy.cell), colOf(enemy.cell),
+                        diapason)) {
+          out.push_back(
+              makeAction(AttackUnit, sideToMove, 0, unit.cell, enemy.cell));
+        }
+      }
+    }
+  }
+
+  /*!
+   * \brief Gets the statistics of a unit.
+   * \param unit The unit.
+   * \return The statistics of the unit's type.
+   */
+  UnitStats statsOf(const Unit &unit) const { return stats[unit.type]; }
+
+  /*!
+   * \brief Builds an action from its fields.
+   */
+  static Action makeAction(int kind, int player, int unitType, int from,
+                           int to) {
+    Action action;
+    action.kind = static_cast<std::uint8_t>(kind);
+    action.player = static_cast<std::uint8_t>(player);
+    action.unitType = static_cast<std::uint8_t>(unitType);
+    action.from = from;
+    action.to = to;
+    return action;
+  }
+
+private:
+  static const std::int32_t OFF_BOARD = -2;
+  static constexpr std::uint64_t PLACEMENT_KEY = 0x9E3779B97F4A7C15ull;
+  static constexpr std::uint64_t SIDE_KEY = 0xC2B2AE3D27D4EB4Full;
+
+  /*!
+   * \brief The splitmix64 finalizer, used to derive hash keys on demand.
+   */
+  static std::uint64_t mixKey(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  static std::uint64_t tallKey(int cell) {
+    return mixKey(static_cast<std::uint64_t>(cell) + 1);
+  }
+
+  static std::uint64_t unitKey(int player, const Unit &unit) {
+    std::uint64_t code = (static_cast<std::uint64_t>(unit.cell) << 24) |
+                         (static_cast<std::uint64_t>(unit.type) << 18) |
+                         (static_cast<std::uint64_t>(player) << 17) |
+                         (static_cast<std::uint32_t>(unit.HP) & 0xFFFF);
+    return mixKey(code + SIDE_KEY);
+  }
+
+  bool isCell(int cell) const { return cell >= 0 && cell < rows * cols; }
+
+  static size_t bitWords(int cells) { return (cells + 31) / 32; }
+
+  static void writeBit(std::vector<std::uint32_t> &bits, int cell, bool value) {
+    std::uint32_t mask = 1u << (cell & 31);
+    bits[cell >> 5] = value ? bits[cell >> 5] | mask : bits[cell >> 5] & ~mask;
+  }
+
+  /*!
+   * \brief Sets the occupant code of a hex and its occupancy bit.
+   */
+  void place(int cell, std::int32_t code) {
+    occupant[cell] = code;
+    writeBit(occupiedBits, cell, code != -1);
+  }
+
+  void addUnit(int player, int type, int cell) {
+    Unit unit;
+    unit.type = type;
+    unit.HP = stats[type].HP;
+    unit.cell = cell;
+    place(cell, player + 2 * static_cast<int>(units[player].size()));
+    units[player].push_back(unit);
+    key ^= unitKey(player, unit);
+  }
+
+  void removeUnit(int player, int index) {
+    key ^= unitKey(player, units[player][index]);
+    place(units[player][index].cell, -1);
+    units[player][index] = units[player].back();
+    units[player].pop_back();
+    if (index < static_cast<int>(units[player].size())) {
+      occupant[units[player][index].cell] = player + 2 * index;
+    }
+  }
+
+  void endTurn() {
+    sideToMove = 1 - sideToMove;
+    key ^= SIDE_KEY;
+    ++turn;
+  }
+
+  int rows;
+  int cols;
+  int maxNPC;
+  const NeighborTable *adjacency;
+  std::vector<std::uint8_t> tall;
+  std::vector<std::int32_t> occupant;
+  std::vector<std::uint32_t> tallBits;
+  std::vector<std::uint32_t> occupiedBits;
+  std::vector<Unit> units[2];
+  UnitStats stats[UNIT_TYPES];
+  int sideToMove;
+  bool placement;
+  int winner;
+  int turn;
+  std::uint64_t key;
+};
+
+/*!
+ * \brief Plays a game to the end with uniformly random legal actions.
+ *
+ * Both players fill their deployment zones up to maxNPC before the battle.
+ * \param state The game to play, modified in place.
+ * \param rng The random generator.
+ * \param maxTurns The number of battle turns after which the game is drawn.
+ * \return The winner (0 or 1), or -1 for a draw or a blocked position.
+ */
+inline int simulateRandomGame(GameState &state, std::mt19937 &rng,
+                              int maxTurns = 1000) {
+  std::vector<Action> actions;
+  while (state.isPlacement()) {
+    state.generateActions(actions);
+    if (actions.empty()) {
+      return -1;
+    }
+    size_t places = actions.size();
+    if (actions.back().kind == FinishPlacement) {
+      places -= 1;
+    }
+    state.apply(places > 0 ? actions[rng() % places] : actions.back());
+  }
+  while (!state.isFinished() && state.getTurn() < maxTurns) {
+    state.generateActions(actions);
+    if (actions.empty()) {
+      return -1;
+    }
+    state.apply(actions[rng() % actions.size()]);
+  }
+  return state.getWinner();
+}
+
+#endif
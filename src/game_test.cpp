@@ -0,0 +1,298 @@
+#include "doctest.h"
+#include "game.h"
+
+static GameState deployedGame() {
+    GameState state(8, 8, 3);
+    state.apply(GameState::makeAction(PlaceUnit, 0, 0, -1, state.cellIndex(3, 1)));
+    state.apply(GameState::makeAction(PlaceUnit, 1, 1, -1, state.cellIndex(3, 6)));
+    state.apply(GameState::makeAction(FinishPlacement, 0, 0, -1, -1));
+    return state;
+}
+
+TEST_CASE("withinRange Function: Matches Hex Adjacency") {
+    // Even row neighbors lean left, odd row neighbors lean right.
+    CHECK(withinRange(2, 3, 2, 4, 2));
+    CHECK(withinRange(2, 3, 1, 2, 2));
+    CHECK(withinRange(2, 3, 1, 3, 2));
+    CHECK_FALSE(withinRange(2, 3, 1, 4, 2));
+    CHECK(withinRange(3, 3, 2, 4, 2));
+    CHECK_FALSE(withinRange(3, 3, 2, 2, 2));
+    CHECK_FALSE(withinRange(2, 3, 2, 5, 2));
+    CHECK(withinRange(2, 3, 2, 8, 10));
+    CHECK_FALSE(withinRange(2, 3, 2, 9, 10));
+}
+
+TEST_CASE("GameState Class: Deployment Zones And Limits") {
+    GameState state(8, 8, 1);
+    CHECK_FALSE(state.apply(GameState::makeAction(PlaceUnit, 0, 0, -1, state.cellIndex(0, 2))));
+    CHECK(state.apply(GameState::makeAction(PlaceUnit, 0, 0, -1, state.cellIndex(0, 1))));
+    CHECK_FALSE(state.apply(GameState::makeAction(PlaceUnit, 0, 0, -1, state.cellIndex(1, 1))));
+    CHECK_FALSE(state.apply(GameState::makeAction(FinishPlacement, 0, 0, -1, -1)));
+    CHECK_FALSE(state.apply(GameState::makeAction(PlaceUnit, 1, 0, -1, state.cellIndex(0, 5))));
+    CHECK(state.apply(GameState::makeAction(PlaceUnit, 1, 2, -1, state.cellIndex(0, 6))));
+    CHECK(state.apply(GameState::makeAction(FinishPlacement, 0, 0, -1, -1)));
+    CHECK_FALSE(state.isPlacement());
+    CHECK(state.getUnits(1)[0].HP == 40);
+}
+
+TEST_CASE("GameState Class: Moves Follow Turns And Terrain") {
+    GameState state = deployedGame();
+    int knight = state.cellIndex(3, 1);
+    CHECK_FALSE(state.apply(GameState::makeAction(MoveUnit, 1, 0, state.cellIndex(3, 6), state.cellIndex(3, 5))));
+    CHECK_FALSE(state.apply(GameState::makeAction(MoveUnit, 0, 0, knight, state.cellIndex(3, 3))));
+
+    state.setTall(state.cellIndex(2, 1), true);
+    state.setTall(state.cellIndex(3, 2), true);
+    CHECK_FALSE(state.isLegal(GameState::makeAction(MoveUnit, 0, 0, knight, state.cellIndex(2, 1))));
+    CHECK(state.apply(GameState::makeAction(MoveUnit, 0, 0, knight, state.cellIndex(3, 2))));
+    CHECK(state.getSideToMove() == 1);
+    CHECK(state.ownerAt(state.cellIndex(3, 2)) == 0);
+    CHECK_FALSE(state.isOccupied(knight));
+}
+
+TEST_CASE("GameState Class: Attacks Remove Units And End The Game") {
+    GameState state = deployedGame();
+    int archer = state.cellIndex(3, 6);
+    int knight = state.cellIndex(3, 1);
+    // The knight only reaches adjacent hexes, the archer five hexes along a row.
+    CHECK_FALSE(state.isLegal(GameState::makeAction(AttackUnit, 0, 0, knight, archer)));
+    state.apply(GameState::makeAction(MoveUnit, 0, 0, knight, state.cellIndex(3, 2)));
+    CHECK(state.apply(GameState::makeAction(AttackUnit, 1, 0, archer, state.cellIndex(3, 2))));
+    CHECK(state.getUnits(0)[0].HP == 35);
+
+    state.apply(GameState::makeAction(MoveUnit, 0, 0, state.cellIndex(3, 2), state.cellIndex(3, 3)));
+    state.apply(GameState::makeAction(MoveUnit, 1, 0, archer, state.cellIndex(3, 5)));
+    state.apply(GameState::makeAction(MoveUnit, 0, 0, state.cellIndex(3, 3), state.cellIndex(3, 4)));
+    CHECK(state.getSideToMove() == 1);
+    state.apply(GameState::makeAction(AttackUnit, 1, 0, state.cellIndex(3, 5), state.cellIndex(3, 4)));
+    CHECK(state.apply(GameState::makeAction(AttackUnit, 0, 0, state.cellIndex(3, 4), state.cellIndex(3, 5))));
+    CHECK(state.getUnits(1)[0].HP == 10);
+    CHECK_FALSE(state.isFinished());
+    state.apply(GameState::makeAction(AttackUnit, 1, 0, state.cellIndex(3, 5), state.cellIndex(3, 4)));
+    CHECK(state.apply(GameState::makeAction(AttackUnit, 0, 0, state.cellIndex(3, 4), state.cellIndex(3, 5))));
+    CHECK(state.isFinished());
+    CHECK(state.getWinner() == 0);
+    CHECK(state.getUnits(1).empty());
+    CHECK_FALSE(state.isOccupied(state.cellIndex(3, 5)));
+}
+
+TEST_CASE("GameState Class: Generated Actions Are Legal") {
+    std::mt19937 rng(7);
+    GameState state(8, 8, 3);
+    state.generateTall(7);
+    std::vector<Action> actions;
+    for (int step = 0; step < 200 && !state.isFinished(); ++step) {
+        state.generateActions(actions);
+        if (actions.empty()) {
+            break;
+        }
+        for (const Action &action : actions) {
+            REQUIRE(state.isLegal(action));
+        }
+        REQUIRE(state.apply(actions[rng() % actions.size()]));
+    }
+}
+
+TEST_CASE("simulateRandomGame Function: Deterministic For A Seed") {
+    GameState first(8, 8, 3);
+    GameState second(8, 8, 3);
+    std::mt19937 rngA(42);
+    std::mt19937 rngB(42);
+    int winnerA = simulateRandomGame(first, rngA);
+    int winnerB = simulateRandomGame(second, rngB);
+    CHECK(winnerA == winnerB);
+    CHECK(first.getTurn() == second.getTurn());
+}
+
+TEST_CASE("GameState Class: Incremental Hash Matches Recomputation") {
+    GameState state(8, 8, 3);
+    state.generateTall(9, 4);
+    GameState replay = state;
+    CHECK(state.hash() == state.computeHash());
+    std::mt19937 rng(9);
+    std::vector<Action> actions;
+    std::vector<Action> played;
+    std::vector<std::uint64_t> hashes;
+    while (!state.isFinished() && state.getTurn() < 200) {
+        state.generateActions(actions);
+        if (actions.empty()) {
+            break;
+        }
+        played.push_back(actions[rng() % actions.size()]);
+        state.apply(played.back());
+        REQUIRE(state.hash() == state.computeHash());
+        hashes.push_back(state.hash());
+    }
+    CHECK(played.size() > 10);
+
+    // A lockstep peer replaying the actions sees the same hashes.
+    for (size_t k = 0; k < played.size(); ++k) {
+        REQUIRE(replay.apply(played[k]));
+        REQUIRE(replay.hash() == hashes[k]);
+    }
+
+    GameState other(8, 8, 3);
+    other.generateTall(10, 4);
+    CHECK(other.hash() != GameState(8, 8, 3).hash());
+}
+
+static bool bitboardsMatch(const GameState &state) {
+    int cells = state.getRows() * state.getCols();
+    for (int cell = 0; cell <= cells; ++cell) {
+        bool occupied = (state.getOccupiedBits()[cell / 32] >> (cell % 32)) & 1;
+        bool tall = (state.getTallBits()[cell / 32] >> (cell % 32)) & 1;
+        if (occupied != state.isOccupied(cell) || tall != state.isTall(cell)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("GameState Class: Bitboards Follow The Board") {
+    GameState state(11, 9, 6);
+    state.generateTall(4, 20);
+    CHECK(bitboardsMatch(state));
+    std::mt19937 rng(4);
+    std::vector<Action> actions;
+    std::vector<ActionUndo> history;
+    while (!state.isFinished() && state.getTurn() < 200) {
+        state.generateActions(actions);
+        if (actions.empty()) {
+            break;
+        }
+        history.emplace_back();
+        REQUIRE(state.make(actions[rng() % actions.size()], history.back()));
+        REQUIRE(bitboardsMatch(state));
+    }
+    CHECK(history.size() > 20);
+    while (!history.empty()) {
+        state.unmake(history.back());
+        history.pop_back();
+        REQUIRE(bitboardsMatch(state));
+    }
+    std::vector<Unit> armies[2];
+    armies[0].push_back(Unit{1, 10, 12});
+    armies[1].push_back(Unit{2, 10, 40});
+    state.restore(armies, 0, false, 0);
+    CHECK(bitboardsMatch(state));
+}
+
+TEST_CASE("GameState Class: Finishing A Restored Deployment Keeps The Hash") {
+    GameState state(8, 8, 3);
+    std::vector<Unit> armies[2];
+    armies[0].push_back(Unit{1, 10, 2});
+    armies[1].push_back(Unit{2, 10, 60});
+    // A deployment saved with player 1 to move.
+    REQUIRE(state.restore(armies, 1, true, 0));
+    REQUIRE(state.getSideToMove() == 1);
+    std::uint64_t before = state.hash();
+    CHECK(before == state.computeHash());
+
+    ActionUndo undo;
+    REQUIRE(state.make(GameState::makeAction(FinishPlacement, 0, 0, -1, -1), undo));
+    CHECK(state.getSideToMove() == 0);
+    CHECK(state.hash() == state.computeHash());
+    state.unmake(undo);
+    CHECK(state.getSideToMove() == 1);
+    CHECK(state.hash() == before);
+}
+
+static bool sameUnits(const GameState &a, const GameState &b) {
+    for (int player = 0; player < 2; ++player) {
+        const std::vector<Unit> &left = a.getUnits(player);
+        const std::vector<Unit> &right = b.getUnits(player);
+        if (left.size() != right.size()) {
+            return false;
+        }
+        for (size_t k = 0; k < left.size(); ++k) {
+            if (left[k].type != right[k].type || left[k].HP != right[k].HP ||
+                left[k].cell != right[k].cell ||
+                a.unitIndexAt(left[k].cell) != static_cast<int>(k)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST_CASE("GameState Class: Unmake Restores Every Child Position") {
+    for (std::uint32_t seed = 0; seed < 20; ++seed) {
+        GameState state(8, 8, 3);
+        state.generateTall(seed, 4);
+        std::mt19937 rng(seed);
+        std::vector<Action> actions;
+        std::vector<ActionUndo> history;
+        std::vector<GameState> positions;
+        while (!state.isFinished() && state.getTurn() < 300) {
+            state.generateActions(actions);
+            if (actions.empty()) {
+                break;
+            }
+            // Every child of the position leads back to it.
+            for (const Action &action : actions) {
+                GameState before = state;
+                ActionUndo undo;
+                REQUIRE(state.make(action, undo));
+                state.unmake(undo);
+                REQUIRE(state.hash() == before.hash());
+                REQUIRE(sameUnits(state, before));
+                REQUIRE(state.getTurn() == before.getTurn());
+                REQUIRE(state.isPlacement() == before.isPlacement());
+            }
+            positions.push_back(state);
+            history.emplace_back();
+            REQUIRE(state.make(actions[rng() % actions.size()], history.back()));
+        }
+
+        // Taking the whole game back passes through the same positions.
+        while (!history.empty()) {
+            state.unmake(history.back());
+            history.pop_back();
+            REQUIRE(state.hash() == positions.back().hash());
+            REQUIRE(state.hash() == state.computeHash());
+            REQUIRE(sameUnits(state, positions.back()));
+            REQUIRE(state.getSideToMove() == positions.back().getSideToMove());
+            REQUIRE(state.getWinner() == positions.back().getWinner());
+            positions.pop_back();
+        }
+        CHECK(state.getUnits(0).empty());
+        CHECK(state.isPlacement());
+    }
+}
+
+TEST_CASE("GameState Class: Make Rejects Illegal Actions") {
+    GameState state = deployedGame();
+    ActionUndo undo;
+    CHECK_FALSE(state.make(GameState::makeAction(MoveUnit, 1, 0, state.cellIndex(3, 6),
+                                                 state.cellIndex(3, 5)), undo));
+    CHECK(state.getSideToMove() == 0);
+}
+
+TEST_CASE("NeighborTable Class: Matches Hex Distance Adjacency") {
+    const int sizes[][2] = {{1, 1}, {2, 3}, {8, 8}, {7, 13}};
+    for (const auto &size : sizes) {
+        int rows = size[0];
+        int cols = size[1];
+        const NeighborTable &table = NeighborTable::forBoard(rows, cols);
+        CHECK(&table == &NeighborTable::forBoard(rows, cols));
+        CHECK(reinterpret_cast<std::uintptr_t>(table.of(0)) % 64 == 0);
+        for (int a = 0; a < rows * cols; ++a) {
+            int count = 0;
+            for (int b = 0; b < rows * cols; ++b) {
+                bool expected = a != b && withinRange(a / cols, a % cols, b / cols, b % cols, 2);
+                REQUIRE(table.adjacent(a, b) == expected);
+                count += expected ? 1 : 0;
+            }
+            REQUIRE(table.count(a) == count);
+            for (int k = count; k < 6; ++k) {
+                REQUIRE(table.of(a)[k] == table.sentinel());
+            }
+        }
+    }
+
+    // The sentinel is never free, so move generation needs no bounds check.
+    GameState state(3, 3, 3);
+    CHECK(&state.getNeighbors() == &NeighborTable::forBoard(3, 3));
+    CHECK(state.isOccupied(state.getNeighbors().sentinel()));
+    CHECK_FALSE(state.isTall(state.getNeighbors().sentinel()));
+}
@@ -0,0 +1,223 @@
+#ifndef JSON
+#define JSON
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*!
+ * \brief A parsed JSON document node.
+ *
+ * Only what the tools in this repository read is supported: objects, arrays,
+ * strings with simple escapes, numbers, booleans and null.
+ */
+class JsonValue {
+public:
+  enum Type { Null, Bool, Number, String, Array, Object };
+
+  JsonValue() : type(Null), number(0.0), boolean(false) {}
+
+  /*!
+   * \brief Parses a JSON document.
+   * \param text The document.
+   * \param out Receives the root value.
+   * \param error Receives a description of the first syntax error.
+   * \return True if the document was parsed, false otherwise.
+   */
+  static bool parse(const std::string &text, JsonValue &out,
+                    std::string &error) {
+    size_t pos = 0;
+    if (!parseValue(text, pos, out, error)) {
+      return false;
+    }
+    skipSpace(text, pos);
+    if (pos != text.size()) {
+      error = "trailing characters at " + std::to_string(pos);
+      return false;
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Finds a member of an object.
+   * \param key The member name.
+   * \return The member, or nullptr if this is not an object or has no such key.
+   */
+  const JsonValue *find(const std::string &key) const {
+    for (const std::pair<std::string, JsonValue> &member : members) {
+      if (member.first == key) {
+        return &member.second;
+      }
+    }
+    return nullptr;
+  }
+
+  /*!
+   * \brief Gets a numeric member of an object.
+   * \param key The member name.
+   * \param fallback The value returned if the member is missing.
+   * \return The member value or the fallback.
+   */
+  double numberOr(const std::string &key, double fallback) const {
+    const JsonValue *value = find(key);
+    return value != nullptr && value->type == Number ? value->number
+                                                     : fallback;
+  }
+
+  /*!
+   * \brief Gets a string member of an object.
+   * \param key The member name.
+   * \param fallback The value returned if the member is missing.
+   * \return The member value or the fallback.
+   */
+  std::string stringOr(const std::string &key,
+                       const std::string &fallback) const {
+    const JsonValue *value = find(key);
+    return value != nullptr && value->type == String ? value->string
+                                                     : fallback;
+  }
+
+  Type type;
+  double number;
+  bool boolean;
+  std::string string;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+private:
+  static void skipSpace(const std::string &text, size_t &pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' ||
+                                 text[pos] == '\r' || text[pos] == '\t')) {
+      ++pos;
+    }
+  }
+
+  static bool parseString(const std::string &text, size_t &pos,
+                          std::string &out, std::string &error) {
+    ++pos;
+    out.clear();
+    while (pos < text.size() && text[pos] != '"') {
+      char c = text[pos++];
+      if (c == '\\' && pos < text.size()) {
+        char escaped = text[pos++];
+        if (escaped == 'n') {
+          c = '\n';
+        } else if (escaped == 't') {
+          c = '\t';
+        } else {
+          c = escaped;
+        }
+      }
+      out += c;
+    }
+    if (pos >= text.size()) {
+      error = "unterminated string";
+      return false;
+    }
+    ++pos;
+    return true;
+  }
+
+  static bool parseValue(const std::string &text, size_t &pos, JsonValue &out,
+                         std::string &error) {
+    skipSpace(text, pos);
+    if (pos >= text.size()) {
+      error = "unexpected end of document";
+      return false;
+    }
+    char c = text[pos];
+    if (c == '{') {
+      out.type = Object;
+      ++pos;
+      skipSpace(text, pos);
+      if (pos < text.size() && text[pos] == '}') {
+        ++pos;
+        return true;
+      }
+      while (true) {
+        skipSpace(text, pos);
+        if (pos >= text.size() || text[pos] != '"') {
+          error = "expected member name at " + std::to_string(pos);
+          return false;
+        }
+        std::pair<std::string, JsonValue> member;
+        if (!parseString(text, pos, member.first, error)) {
+          return false;
+        }
+        skipSpace(text, pos);
+        if (pos >= text.size() || text[pos] != ':') {
+          error = "expected ':' at " + std::to_string(pos);
+          return false;
+        }
+        ++pos;
+        if (!parseValue(text, pos, member.second, error)) {
+          return false;
+        }
+        out.members.push_back(std::move(member));
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == ',') {
+          ++pos;
+        } else if (pos < text.size() && text[pos] == '}') {
+          ++pos;
+          return true;
+        } else {
+          error = "expected ',' or '}' at " + std::to_string(pos);
+          return false;
+        }
+      }
+    } else if (c == '[') {
+      out.type = Array;
+      ++pos;
+      skipSpace(text, pos);
+      if (pos < text.size() && text[pos] == ']') {
+        ++pos;
+        return true;
+      }
+      while (true) {
+        out.items.push_back(JsonValue());
+        if (!parseValue(text, pos, out.items.back(), error)) {
+          return false;
+        }
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == ',') {
+          ++pos;
+        } else if (pos < text.size() && text[pos] == ']') {
+          ++pos;
+          return true;
+        } else {
+          error = "expected ',' or ']' at " + std::to_string(pos);
+          return false;
+        }
+      }
+    } else if (c == '"') {
+      out.type = String;
+      return parseString(text, pos, out.string, error);
+    } else if (text.compare(pos, 4, "true") == 0) {
+      out.type = Bool;
+      out.boolean = true;
+      pos += 4;
+      return true;
+    } else if (text.compare(pos, 5, "false") == 0) {
+      out.type = Bool;
+      pos += 5;
+      return true;
+    } else if (text.compare(pos, 4, "null") == 0) {
+      pos += 4;
+      return true;
+    }
+
+    const char *begin = text.c_str() + pos;
+    char *end = nullptr;
+    out.number = std::strtod(begin, &end);
+    if (end == begin) {
+      error = "unexpected character at " + std::to_string(pos);
+      return false;
+    }
+    out.type = Number;
+    pos += end - begin;
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,599 @@
+/*!
+ * \file loadgen.cpp
+ * \brief Plays many bot clients against strateg_server over TCP
+ *
+ * Every bot joins the lobby and plays random legal actions until its match
+ * ends. Spectators follow the first match through its snapshot and delta
+ * feed. With --think-ms a bot waits a random time, uniform in [0, 2 * think]
+ * milliseconds, before each action. Without --port an in-process server on an
+ * ephemeral port is used and its CPU time per match is reported:
+ *   strateg_loadgen --clients=10000 --threads=2
+ *   strateg_loadgen --clients=10000 --port=7777 --think-ms=50
+ *   strateg_loadgen --clients=2 --spectators=10000
+ */
+
+#include "reactor.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+
+/*!
+ * \brief Log-linear histogram of latencies in microseconds.
+ *
+ * Every power of two is split into SUB_BUCKETS buckets, so any recorded
+ * value is known within 1 / SUB_BUCKETS of itself.
+ */
+class LatencyHistogram {
+public:
+  LatencyHistogram() : counts(BUCKETS, 0), total(0), maximum(0) {}
+
+  /*!
+   * \brief Records one latency.
+   * \param micros The latency in microseconds.
+   */
+  void record(std::uint64_t micros) {
+    ++counts[bucket(micros)];
+    ++total;
+    maximum = std::max(maximum, micros);
+  }
+
+  /*!
+   * \brief Adds the samples of another histogram.
+   */
+  void merge(const LatencyHistogram &other) {
+    for (size_t k = 0; k < BUCKETS; ++k) {
+      counts[k] += other.counts[k];
+    }
+    total += other.total;
+    maximum = std::max(maximum, other.maximum);
+  }
+
+  /*!
+   * \brief Computes the upper bound of a percentile.
+   * \param p The percentile in the range [0, 100].
+   * \return The latency in microseconds, 0 if there are no samples.
+   */
+  std::uint64_t percentile(double p) const {
+    std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * total + 0.5);
+    std::uint64_t seen = 0;
+    for (size_t k = 0; k < BUCKETS; ++k) {
+      seen += counts[k];
+      if (seen >= std::max<std::uint64_t>(rank, 1) && counts[k] > 0) {
+        return std::min(upperBound(k), maximum);
+      }
+    }
+    return 0;
+  }
+
+  /*!
+   * \brief Prints the percentiles and one line per power of two.
+   */
+  void print(std::ostream &out) const {
+    out << "Latency (us): p50 " << percentile(50) << ", p90 "
+        << percentile(90) << ", p99 " << percentile(99) << ", p99.9 "
+        << percentile(99.9) << ", max " << maximum << std::endl;
+    for (size_t power = 0; power * SUB_BUCKETS < BUCKETS; ++power) {
+      std::uint64_t count = 0;
+      for (size_t k = power * SUB_BUCKETS; k < (power + 1) * SUB_BUCKETS; ++k) {
+        count += counts[k];
+      }
+      if (count > 0) {
+        out << "  < " << std::setw(9) << upperBound((power + 1) * SUB_BUCKETS - 1)
+            << " us: " << std::setw(9) << count << " "
+            << std::string(static_cast<size_t>(50.0 * count / total), '#')
+            << std::endl;
+      }
+    }
+  }
+
+  std::uint64_t count() const { return total; }
+
+private:
+  static const size_t SUB_BUCKETS = 8;
+  static const size_t BUCKETS = 40 * SUB_BUCKETS;
+
+  static size_t bucket(std::uint64_t micros) {
+    if (micros < SUB_BUCKETS) {
+      return static_cast<size_t>(micros);
+    }
+    size_t power = 63 - __builtin_clzll(micros);
+    size_t sub = static_cast<size_t>(micros >> (power - 3)) - SUB_BUCKETS;
+    return std::min(BUCKETS - 1, (power - 2) * SUB_BUCKETS + sub);
+  }
+
+  static std::uint64_t upperBound(size_t index) {
+    if (index < SUB_BUCKETS) {
+      return index + 1;
+    }
+    size_t power = index / SUB_BUCKETS + 2;
+    std::uint64_t sub = index % SUB_BUCKETS + SUB_BUCKETS + 1;
+    return sub << (power - 3);
+  }
+
+  std::vector<std::uint64_t> counts;
+  std::uint64_t total;
+  std::uint64_t maximum;
+};
+
+/*!
+ * \brief Gets the CPU time the calling thread used so far.
+ */
+static double threadSeconds() {
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/*!
+ * \brief Gets the CPU time the whole process used so far.
+ */
+static double processSeconds() {
+  timespec time;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/*!
+ * \brief One simulated player.
+ */
+struct Bot {
+  Bot(size_t bufferSize, std::uint32_t index, bool spectator)
+      : fd(-1), in(bufferSize), out(bufferSize), index(index), seat(-1),
+        sequence(0), spectator(spectator), pending(false), thinking(false),
+        finished(false), tag(0) {}
+
+  int fd;
+  ByteRing in;
+  ByteRing out;
+  GameState mirror;
+  std::mt19937 rng;
+  std::chrono::steady_clock::time_point sentAt;
+  std::uint32_t index;
+  int seat;
+  std::uint32_t sequence;
+  bool spectator;
+  bool pending;
+  bool thinking;
+  bool finished;
+  std::uint8_t tag;
+};
+
+/*!
+ * \brief Drives a share of the bots on one thread with its own epoll loop.
+ */
+class BotDriver {
+public:
+  /*!
+   * \brief Constructor for BotDriver with specified parameters.
+   * \param address The server address.
+   * \param config The settings of lobby matches on the server.
+   * \param bots The number of bots of this driver.
+   * \param spectators The number of spectators of this driver.
+   * \param thinkMs The mean think time before each action in milliseconds.
+   * \param seed The seed of the first bot's random choices.
+   */
+  BotDriver(const sockaddr_in &address, const MatchConfig &config, int bots,
+            int spectators, int thinkMs, std::uint32_t seed)
+      : address(address), config(config), epollFd(epoll_create1(0)),
+        thinkMs(thinkMs), connected(0), done(0), actions(0), rejected(0),
+        errors(0), desyncs(0), bytes(0), cpuSeconds(0), scratch(BUFFER_SIZE) {
+    // Players connect first so that the watched match exists.
+    for (int k = 0; k < bots + spectators; ++k) {
+      this->bots.emplace_back(
+          new Bot(BUFFER_SIZE, static_cast<std::uint32_t>(k), k >= bots));
+      this->bots.back()->rng.seed(seed + k);
+    }
+  }
+
+  ~BotDriver() { ::close(epollFd); }
+
+  /*!
+   * \brief Connects the bots and plays until every match ended.
+   * \param deadline The time to give up at.
+   */
+  void run(std::chrono::steady_clock::time_point deadline) {
+    epoll_event events[256];
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (done < bots.size() && now < deadline) {
+      // Connect gradually so that the listen backlog never overflows.
+      for (int k = 0; k < 256 && connected < bots.size(); ++k) {
+        connect(connected++);
+      }
+      int wait = 100;
+      if (!timers.empty()) {
+        wait = static_cast<int>(std::min<std::int64_t>(
+            wait, std::chrono::duration_cast<std::chrono::milliseconds>(
+                      timers.top().first - now)
+                          .count()));
+        wait = std::max(0, wait);
+      }
+      int count = epoll_wait(epollFd, events, 256, wait);
+      now = std::chrono::steady_clock::now();
+      while (!timers.empty() && timers.top().first <= now) {
+        Bot &bot = *bots[timers.top().second];
+        timers.pop();
+        bot.thinking = false;
+        if (!bot.finished) {
+          send(bot);
+          flush(bot);
+        }
+      }
+      for (int k = 0; k < count; ++k) {
+        Bot &bot = *bots[events[k].data.u32];
+        if (events[k].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+          receive(bot);
+        }
+        if (bot.fd >= 0) {
+          flush(bot);
+        }
+      }
+      now = std::chrono::steady_clock::now();
+    }
+    cpuSeconds = threadSeconds();
+  }
+
+  size_t finishedBots() const { return done; }
+  std::uint64_t actionsSent() const { return actions; }
+  std::uint64_t actionsRejected() const { return rejected; }
+  std::uint64_t failures() const { return errors; }
+  std::uint64_t desyncCount() const { return desyncs; }
+  std::uint64_t bytesReceived() const { return bytes; }
+  double cpuTime() const { return cpuSeconds; }
+  const LatencyHistogram &latencies() const { return histogram; }
+
+private:
+  static const size_t BUFFER_SIZE = 4096;
+
+  void connect(size_t index) {
+    Bot &bot = *bots[index];
+    bot.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int on = 1;
+    setsockopt(bot.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (bot.fd < 0 ||
+        (::connect(bot.fd, reinterpret_cast<const sockaddr *>(&address),
+                   sizeof(address)) < 0 &&
+         errno != EINPROGRESS)) {
+      fail(bot);
+      return;
+    }
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u32 = static_cast<std::uint32_t>(index);
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, bot.fd, &event);
+    frame.clear();
+    FrameWriter writer(frame);
+    writer.writeJoin(bot.spectator ? 0 : -1, -1);
+    bot.out.push(frame.data(), frame.size());
+  }
+
+  void receive(Bot &bot) {
+    while (bot.fd >= 0) {
+      iovec free[2];
+      int spans = bot.in.writable(free);
+      ssize_t received = spans == 0 ? -1 : ::readv(bot.fd, free, spans);
+      if (received <= 0) {
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+          fail(bot);
+        }
+        return;
+      }
+      bot.in.produce(received);
+      bytes += received;
+      auto handle = [this, &bot](FrameView view) { onFrame(bot, view); };
+      if (!parseRing(bot.in, scratch, handle)) {
+        fail(bot);
+      }
+    }
+  }
+
+  void onFrame(Bot &bot, FrameView view) {
+    if (bot.finished) {
+      return;
+    }
+    if (bot.spectator) {
+      watch(bot, view);
+      return;
+    }
+    if (view.type() == JoinFrame) {
+      if (!view.accepted()) {
+        fail(bot);
+        return;
+      }
+      bot.seat = view.player();
+      bot.mirror = GameState(config.rows, config.cols, config.maxNPC);
+      bot.mirror.generateTall(view.second(), config.number_of_tall);
+    } else if (view.isResult()) {
+      Action action = view.toAction();
+      if (view.accepted()) {
+        if (!bot.mirror.apply(action)) {
+          fail(bot);
+          return;
+        }
+        ++bot.sequence;
+      }
+      if (action.player == bot.seat && bot.pending) {
+        bot.pending = false;
+        rejected += view.accepted() ? 0 : 1;
+        histogram.record(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - bot.sentAt)
+                .count()));
+      }
+    } else if (view.type() == HashFrame) {
+      std::uint64_t hash = bot.mirror.hash();
+      if ((bot.sequence & NO_ARGUMENT) != view.first() ||
+          foldHash(hash) != view.checksum()) {
+        // Report the desync so that the server can count it.
+        ++desyncs;
+        frame.clear();
+        FrameWriter writer(frame);
+        writer.writeHash(bot.sequence, hash);
+        bot.out.push(frame.data(), frame.size());
+      }
+      return;
+    } else if (view.type() == GameOverFrame) {
+      bot.finished = true;
+      ++done;
+      ::close(bot.fd);
+      bot.fd = -1;
+      return;
+    }
+    act(bot);
+  }
+
+  void watch(Bot &bot, FrameView view) {
+    if (view.type() == JoinFrame && !view.accepted()) {
+      fail(bot);
+    } else if (view.type() == PayloadFrame) {
+      bool decoded =
+          view.tag() == SnapshotPayload
+              ? StateCodec::decodeSnapshot(view.payload(), view.first(),
+                                           bot.mirror)
+              : StateCodec::applyDelta(view.payload(), view.first(),
+                                       bot.mirror);
+      if (!decoded) {
+        fail(bot);
+      }
+    } else if (view.type() == HashFrame &&
+               foldHash(bot.mirror.hash()) != view.checksum()) {
+      ++desyncs;
+    } else if (view.type() == GameOverFrame) {
+      bot.finished = true;
+      ++done;
+      ::close(bot.fd);
+      bot.fd = -1;
+    }
+  }
+
+  void act(Bot &bot) {
+    if (bot.thinking) {
+      return;
+    }
+    if (thinkMs <= 0) {
+      send(bot);
+      return;
+    }
+    // Think only when it is this bot's move; the choice is made afterwards.
+    Action action;
+    if (bot.seat < 0 || bot.pending ||
+        !chooseSeatAction(bot.mirror, bot.seat, bot.rng, candidates, action)) {
+      return;
+    }
+    std::uniform_int_distribution<int> think(0, 2000 * thinkMs);
+    bot.thinking = true;
+    timers.emplace(std::chrono::steady_clock::now() +
+                       std::chrono::microseconds(think(bot.rng)),
+                   bot.index);
+  }
+
+  void send(Bot &bot) {
+    Action action;
+    if (bot.seat < 0 || bot.pending || bot.fd < 0 ||
+        !chooseSeatAction(bot.mirror, bot.seat, bot.rng, candidates, action)) {
+      return;
+    }
+    frame.clear();
+    FrameWriter writer(frame);
+    writer.writeAction(action, ++bot.tag);
+    if (bot.out.push(frame.data(), frame.size()) == frame.size()) {
+      bot.pending = true;
+      bot.sentAt = std::chrono::steady_clock::now();
+      ++actions;
+    }
+  }
+
+  void flush(Bot &bot) {
+    while (bot.out.size() > 0) {
+      iovec stored[2];
+      int spans = bot.out.readable(stored);
+      ssize_t sent = ::writev(bot.fd, stored, spans);
+      if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          fail(bot);
+        }
+        return;
+      }
+      bot.out.consume(sent);
+    }
+  }
+
+  void fail(Bot &bot) {
+    if (bot.fd >= 0) {
+      ::close(bot.fd);
+      bot.fd = -1;
+    }
+    if (!bot.finished) {
+      bot.finished = true;
+      ++done;
+      ++errors;
+    }
+  }
+
+  typedef std::pair<std::chrono::steady_clock::time_point, std::uint32_t> Timer;
+
+  sockaddr_in address;
+  MatchConfig config;
+  int epollFd;
+  int thinkMs;
+  std::vector<std::unique_ptr<Bot>> bots;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+  size_t connected;
+  size_t done;
+  std::uint64_t actions;
+  std::uint64_t rejected;
+  std::uint64_t errors;
+  std::uint64_t desyncs;
+  std::uint64_t bytes;
+  double cpuSeconds;
+  LatencyHistogram histogram;
+  std::vector<std::uint8_t> scratch;
+  std::vector<std::uint8_t> frame;
+  std::vector<Action> candidates;
+};
+
+int main(int argc, char **argv) {
+  int clients = 1000;
+  int spectators = 0;
+  int thinkMs = 0;
+  int threads = 1;
+  int port = 0;
+  int reactors = 0;
+  int workers = 0;
+  int timeout = 120;
+  std::string host = "127.0.0.1";
+  MatchConfig config;
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string text = arg.substr(arg.find('=') + 1);
+    int value = std::atoi(text.c_str());
+    if (arg.rfind("--clients=", 0) == 0) {
+      clients = value;
+    } else if (arg.rfind("--spectators=", 0) == 0) {
+      spectators = value;
+    } else if (arg.rfind("--think-ms=", 0) == 0) {
+      thinkMs = value;
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = std::max(1, value);
+    } else if (arg.rfind("--host=", 0) == 0) {
+      host = text;
+    } else if (arg.rfind("--port=", 0) == 0) {
+      port = value;
+    } else if (arg.rfind("--reactors=", 0) == 0) {
+      reactors = value;
+    } else if (arg.rfind("--workers=", 0) == 0) {
+      workers = value;
+    } else if (arg.rfind("--hash-interval=", 0) == 0) {
+      config.hashInterval = value;
+    } else if (arg.rfind("--timeout=", 0) == 0) {
+      timeout = value;
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  // Each bot needs a socket, and the embedded server one more per bot.
+  rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  std::unique_ptr<MatchServer> server;
+  std::unique_ptr<NetServer> net;
+  if (port == 0) {
+    server.reset(new MatchServer(workers));
+    net.reset(new NetServer(*server, config, reactors));
+    if (!net->listen(0)) {
+      std::cerr << "Error with the embedded server" << std::endl;
+      return 2;
+    }
+    port = net->port();
+  }
+
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<std::uint16_t>(port));
+  if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+    std::cerr << "Error with host " << host << std::endl;
+    return 2;
+  }
+
+  std::vector<std::unique_ptr<BotDriver>> drivers;
+  for (int k = 0; k < threads; ++k) {
+    int share = clients / threads + (k < clients % threads ? 1 : 0);
+    int watchers = spectators / threads + (k < spectators % threads ? 1 : 0);
+    drivers.emplace_back(
+        new BotDriver(address, config, share, watchers, thinkMs, k * 1000003u));
+  }
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  double cpuStart = processSeconds() - threadSeconds();
+  std::chrono::steady_clock::time_point deadline =
+      start + std::chrono::seconds(timeout);
+  std::vector<std::thread> running;
+  for (std::unique_ptr<BotDriver> &driver : drivers) {
+    BotDriver *pointer = driver.get();
+    running.emplace_back([pointer, deadline] { pointer->run(deadline); });
+  }
+  for (std::thread &thread : running) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  // Other threads than the drivers and this one belong to the server.
+  double serverSeconds = processSeconds() - threadSeconds() - cpuStart;
+
+  size_t finished = 0;
+  std::uint64_t actions = 0;
+  std::uint64_t rejected = 0;
+  std::uint64_t errors = 0;
+  std::uint64_t desyncs = 0;
+  std::uint64_t received = 0;
+  LatencyHistogram latencies;
+  for (std::unique_ptr<BotDriver> &driver : drivers) {
+    serverSeconds -= driver->cpuTime();
+    latencies.merge(driver->latencies());
+    finished += driver->finishedBots();
+    actions += driver->actionsSent();
+    rejected += driver->actionsRejected();
+    errors += driver->failures();
+    desyncs += driver->desyncCount();
+    received += driver->bytesReceived();
+  }
+  std::cout << "Clients: " << clients << " and " << spectators
+            << " spectators on " << threads << " threads" << std::endl;
+  std::cout << "Finished: " << finished - errors << " (errors: " << errors
+            << ")" << std::endl;
+  std::cout << "Actions: " << actions << " in " << elapsed.count() << " s ("
+            << actions / elapsed.count() << " actions/s, rejected: "
+            << rejected << ")" << std::endl;
+  // Every accepted action reaches both seats of its match.
+  std::cout << "Received: " << received / std::max<double>(1.0, actions * 2.0)
+            << " bytes per client per action, desyncs: " << desyncs
+            << std::endl;
+  latencies.print(std::cout);
+  if (net) {
+    net->stop();
+    std::cout << "Server: " << net->getReactorCount() << " reactors, "
+              << server->workerCount() << " workers, " << net->bytesWritten()
+              << " bytes in " << net->writeCalls() << " writev calls, "
+              << server->feedBatches() << " feed encodes" << std::endl;
+    std::uint64_t matches = std::max<std::uint64_t>(1, server->matchesFinished());
+    std::cout << "Server CPU: " << serverSeconds << " s for "
+              << server->matchesFinished() << " matches ("
+              << serverSeconds * 1e3 / matches << " ms per match, "
+              << serverSeconds / elapsed.count() * 100 << "% of one core)"
+              << std::endl;
+  }
+  return errors == 0 && desyncs == 0 &&
+                 finished == static_cast<size_t>(clients + spectators)
+             ? 0
+             : 1;
+}
@@ -4,7 +4,71 @@
  * \author Sagiev Vanillov
  */
 
-#include "func.h"
+#include "board_render.h"
+#include "game.h"
+#include "overlay.h"
+#include "pathfinding.h"
+#include "threat.h"
+#include "time_control.h"
+#include <chrono>
+#include <future>
+
+/*!
+ * \brief Rebuilds the drawn units and the occupied hexes from the rules state.
+ */
+static void showGame(const GameState &game,
+                     std::vector<std::vector<Circle>> &circles,
+                     std::vector<NPC> &first, std::vector<NPC> &second,
+                     BoardChunks &board, float r) {
+  std::vector<NPC> *drawn[2] = {&first, &second};
+  for (int player = 0; player < 2; ++player) {
+    drawn[player]->clear();
+    for (const Unit &unit : game.getUnits(player)) {
+      NPC npc = createCharacter(unit.type, r, player == 0);
+      sf::Vector2f center =
+          circles[game.rowOf(unit.cell)][game.colOf(unit.cell)].getCenter();
+      npc.setPosition(center.x - r, center.y - r);
+      npc.setHP(unit.HP);
+      drawn[player]->push_back(npc);
+    }
+  }
+  for (int i = 0; i < game.getRows(); ++i) {
+    for (int j = 0; j < game.getCols(); ++j) {
+      bool occupied = game.isOccupied(game.cellIndex(i, j));
+      if (circles[i][j].isOccupied() != occupied) {
+        circles[i][j].setOccupied(occupied);
+        board.invalidate(i, j);
+      }
+    }
+  }
+}
+
+/*!
+ * \brief Rebuilds the rules state from the drawn units, e.g. after an edit
+ * the rules do not know.
+ */
+static void readGame(GameState &game,
+                     const std::vector<std::vector<Circle>> &circles,
+                     const std::vector<NPC> &first,
+                     const std::vector<NPC> &second, bool placement,
+                     bool Player1move, float r) {
+  const std::vector<NPC> *drawn[2] = {&first, &second};
+  std::vector<Unit> armies[2];
+  for (int player = 0; player < 2; ++player) {
+    for (const NPC &npc : *drawn[player]) {
+      for (int i = 0; i < game.getRows(); ++i) {
+        for (int j = 0; j < game.getCols(); ++j) {
+          if (npc.getPosition() ==
+              circles[i][j].getCenter() - sf::Vector2f(r, r)) {
+            armies[player].push_back(
+                Unit{npc.getType(), npc.getHP(), game.cellIndex(i, j)});
+          }
+        }
+      }
+    }
+  }
+  game.restore(armies, Player1move ? 0 : 1, placement, game.getTurn());
+}
 
 int main() {
   srand(time(0));
@@ -36,6 +100,10 @@ int main() {
 
   Button finishButton("Finish the selection", 10.f, window.getSize().y - 50.f, 150.f,
                       30.f, sf::Color(0, 255, 0), sf::Color(0, 0, 0));
+  Button undoButton("Undo", 170.f, window.getSize().y - 50.f, 80.f, 30.f,
+                    sf::Color(255, 255, 0), sf::Color(0, 0, 0));
+  Button redoButton("Redo", 260.f, window.getSize().y - 50.f, 80.f, 30.f,
+                    sf::Color(255, 255, 0), sf::Color(0, 0, 0));
 
   bool selectNPC = false;
   int positionNPC = -1;
@@ -89,19 +157,154 @@ int main() {
     }
   }
 
+  BoardChunks board(rows, cols);
+
+  // The rules state follows the board so that undo only reverts one action
+  // instead of keeping copies of the board.
+  GameState game(rows, cols, maxNPC);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      game.setTall(game.cellIndex(i, j), circles[i][j].isTall());
+    }
+  }
+  std::vector<ActionUndo> history;
+  // Actions undone, last undone on top; any new action drops them.
+  std::vector<Action> redoable;
+
+  // Path preview from the selected unit to the hovered hex, one step a turn.
+  PathFinder pathFinder;
+  std::vector<int> hoverPath;
+  int hoverFrom = -1;
+  int hoverTo = -1;
+  sf::CircleShape pathMarker(r / 5.f);
+  pathMarker.setFillColor(sf::Color(255, 255, 255, 160));
+
+  // Danger overlay (D): enemy damage that reaches each hex, updated per action.
+  ThreatMap threats;
+  threats.rebuild(game);
+  bool showDanger = false;
+  sf::CircleShape dangerMarker(r);
+
+  // Analysis mode (A): a background search suggests the best actions of the
+  // side to move, drawn as arrows once it has searched the current position.
+  Analyzer analyzer;
+  Analysis analysis;
+  AnalysisOverlay analysisOverlay(font, r);
+  std::uint64_t analysedKey = 0;
+
+  // Computer opponent (C): plays Player 2 once deployment is over, searching
+  // on a background thread within its clock and pondering on Player 1's time.
+  bool computerPlays = false;
+  PonderingSearch computer;
+  TimeControl computerTime;
+  parseTimeControl("60000+1000", computerTime);
+  GameClock clock(TimeControl(), computerTime);
+  std::future<SearchResult> thinking;
+  std::uint64_t thinkingKey = 0;
+  std::chrono::steady_clock::time_point thinkingStart;
+
+  auto record = [&](const Action &action) {
+    redoable.clear();
+    history.emplace_back();
+    if (game.make(action, history.back())) {
+      threats.update(game, history.back());
+    } else {
+      // The board changed in a way the rules reject: follow it, but the
+      // earlier history no longer leads back to it.
+      history.clear();
+      readGame(game, circles, NPC_Player1, NPC_Player2, !gameStart,
+               Player1move, r);
+      threats.rebuild(game);
+    }
+  };
+  auto showRules = [&]() {
+    showGame(game, circles, NPC_Player1, NPC_Player2, board, r);
+    gameStart = !game.isPlacement();
+    Finish = game.isFinished();
+    Player1move = game.getSideToMove() == 0;
+    selectNPC = false;
+    positionNPC = -1;
+  };
+  auto undo = [&]() {
+    if (history.empty()) {
+      return;
+    }
+    game.unmake(history.back());
+    threats.revert(game, history.back());
+    redoable.push_back(history.back().action);
+    history.pop_back();
+    showRules();
+    std::cout << "Undo!" << std::endl;
+  };
+  auto redo = [&]() {
+    if (redoable.empty()) {
+      return;
+    }
+    history.emplace_back();
+    if (!game.make(redoable.back(), history.back())) {
+      history.pop_back();
+      redoable.clear();
+      return;
+    }
+    threats.update(game, history.back());
+    redoable.pop_back();
+    showRules();
+    std::cout << "Redo!" << std::endl;
+  };
+
+  Profiler profiler;
+  int frameSection = profiler.section("frame");
+  int eventsSection = profiler.section("input.events");
+  int placementSection = profiler.section("rules.placement");
+  int gameSection = profiler.section("rules.game");
+  int boardSection = profiler.section("render.board");
+  int unitsSection = profiler.section("render.units");
+  int uiSection = profiler.section("render.ui");
+  int displaySection = profiler.section("render.display");
+  ProfilerOverlay profilerOverlay(profiler, font);
+
+  const char *tracePath = std::getenv("STRATEG_TRACE");
+  if (tracePath != nullptr) {
+    Trace::enable();
+    Trace::setThreadName("main");
+  }
+
   while (window.isOpen()) {
+    ScopedTimer frameTimer(profiler, frameSection);
     window.clear(sf::Color(249, 173, 170));
     sf::Event event;
+    ScopedTimer eventsTimer(profiler, eventsSection);
     while (window.pollEvent(event)) {
       if (event.type == sf::Event::Closed) {
+        // Leaving must not wait for the computer: stop its search, again if
+        // it had not started yet, and start no other.
+        computerPlays = false;
+        while (thinking.valid() &&
+               thinking.wait_for(std::chrono::milliseconds(1)) !=
+                   std::future_status::ready) {
+          computer.engine().stop();
+        }
         window.close();
       }
-      if (event.type == sf::Event::MouseButtonPressed && !Finish) {
+      if (event.type == sf::Event::MouseButtonPressed &&
+          event.mouseButton.button == sf::Mouse::Left &&
+          undoButton.isClicked(sf::Mouse::getPosition(window))) {
+        undo();
+      } else if (event.type == sf::Event::MouseButtonPressed &&
+                 event.mouseButton.button == sf::Mouse::Left &&
+                 !redoable.empty() &&
+                 redoButton.isClicked(sf::Mouse::getPosition(window))) {
+        redo();
+      } else if (event.type == sf::Event::MouseButtonPressed && !Finish) {
         sf::Vector2i mousePosition = sf::Mouse::getPosition(window);
         if (event.mouseButton.button == sf::Mouse::Left &&
             finishButton.isClicked(mousePosition)) {
-          gameStart = true;
+          if (!gameStart) {
+            gameStart = true;
+            record(GameState::makeAction(FinishPlacement, 0, 0, -1, -1));
+          }
         } else if (!gameStart) {
+          ScopedTimer rulesTimer(profiler, placementSection);
           for (int i = 0; i < rows; ++i) {
             for (int j = 0; j < cols; ++j) {
               if (circles[i][j].isClicked(mousePosition, r)) {
@@ -119,11 +322,17 @@ int main() {
                         NPC_Player1.push_back(
                             npc); 
                         circles[i][j].setOccupied(true);
+                        board.invalidate(i, j);
+                        record(GameState::makeAction(
+                            PlaceUnit, 0, typeNPC, -1, game.cellIndex(i, j)));
                         std::cout << "Cell: (" << center.x << ", " << center.y
                                   << ")" << std::endl;
                       } else if (!Player1_choice && j > 5) {
                         NPC_Player2.push_back(npc);
                         circles[i][j].setOccupied(true);
+                        board.invalidate(i, j);
+                        record(GameState::makeAction(
+                            PlaceUnit, 1, typeNPC, -1, game.cellIndex(i, j)));
                         std::cout << "Cell: (" << center.x << ", " << center.y
                                   << ")" << std::endl;
                       }
@@ -153,6 +362,12 @@ int main() {
                         }
 
                         circles[i][j].setOccupied(false);
+                        board.invalidate(i, j);
+                        history.clear();
+                        redoable.clear();
+                        readGame(game, circles, NPC_Player1, NPC_Player2, true,
+                                 Player1move, r);
+                        threats.rebuild(game);
 
                         std::cout << "NPC deleted!" << std::endl;
 
@@ -165,7 +380,8 @@ int main() {
               }
             }
           }
-        } else if (gameStart) {
+        } else if (gameStart && !(computerPlays && !Player1move)) {
+          ScopedTimer rulesTimer(profiler, gameSection);
           for (int i = 0; i < rows; ++i) {
             for (int j = 0; j < cols; ++j) {
               if (circles[i][j].isClicked(mousePosition, r)) {
@@ -209,6 +425,7 @@ int main() {
                             std::cout << NPC_Player2[k].getHP() << std::endl;
                             NPC_Player2.erase(NPC_Player2.begin() + k);
                             circles[i][j].setOccupied(false);
+                            board.invalidate(i, j);
                           }
                           std::cout << "Damage received!" << std::endl;
                           break;
@@ -226,6 +443,7 @@ int main() {
                             std::cout << NPC_Player1[k].getHP() << std::endl;
                             NPC_Player1.erase(NPC_Player1.begin() + k);
                             circles[i][j].setOccupied(false);
+                            board.invalidate(i, j);
                           }
                           break;
                         }
@@ -237,13 +455,17 @@ int main() {
                     selectNPC = false;
                     positionNPC = -1;
                     Player1move = !Player1move;
+                    record(GameState::makeAction(
+                        AttackUnit, Player1move ? 1 : 0, 0,
+                        game.cellIndex(previousCircle.first,
+                                       previousCircle.second),
+                        game.cellIndex(i, j)));
                   }
                 } else if (!circles[i][j].isOccupied() &&
                            event.mouseButton.button == sf::Mouse::Right) {
-                  if (DestinationBetweenCircle(
-                          circles[i][j],
-                          circles[previousCircle.first]
-                                 [previousCircle.second]) <= 2 * r + r / 10 &&
+                  if (game.isAdjacent(game.cellIndex(previousCircle.first,
+                                                     previousCircle.second),
+                                      game.cellIndex(i, j)) &&
                       positionNPC != -1) {
                     if ((circles[i][j].isTall() == false &&
                          circles[previousCircle.first][previousCircle.second]
@@ -269,11 +491,19 @@ int main() {
 
                       circles[previousCircle.first][previousCircle.second]
                           .setOccupied(false);
+                      board.invalidate(previousCircle.first,
+                                       previousCircle.second);
                       circles[i][j].setOccupied(true);
+                      board.invalidate(i, j);
 
                       selectNPC = false;
                       positionNPC = -1;
                       Player1move = !Player1move;
+                      record(GameState::makeAction(
+                          MoveUnit, Player1move ? 1 : 0, 0,
+                          game.cellIndex(previousCircle.first,
+                                         previousCircle.second),
+                          game.cellIndex(i, j)));
 
                       std::cout << "NPC move!" << std::endl;
                     }
@@ -291,16 +521,135 @@ int main() {
         } else if (event.key.code == sf::Keyboard::Tab) {
           typeNPC = (typeNPC + 1) % 3;
           std::cout << "Change type" << typeNPC << std::endl;
+        } else if (event.key.code == sf::Keyboard::F3) {
+          profilerOverlay.toggle();
+        } else if (event.key.code == sf::Keyboard::BackSpace) {
+          undo();
+        } else if (event.key.code == sf::Keyboard::R) {
+          redo();
+        } else if (event.key.code == sf::Keyboard::D) {
+          showDanger = !showDanger;
+        } else if (event.key.code == sf::Keyboard::A) {
+          analysisOverlay.toggle();
+        } else if (event.key.code == sf::Keyboard::C) {
+          computerPlays = !computerPlays;
+          selectNPC = false;
+          positionNPC = -1;
+          std::cout << "Computer plays Player 2: "
+                    << (computerPlays ? "on" : "off") << std::endl;
+        }
+      }
+    }
+
+    eventsTimer.stop();
+
+    // The computer answers once its search is done; a result for a position
+    // undone meanwhile is dropped.
+    if (thinking.valid() && thinking.wait_for(std::chrono::seconds(0)) ==
+                                std::future_status::ready) {
+      SearchResult result = thinking.get();
+      std::int64_t used =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - thinkingStart)
+              .count();
+      if (computerPlays && result.found && game.hash() == thinkingKey) {
+        if (!clock.punch(1, used)) {
+          std::cout << "Computer out of time!" << std::endl;
+        }
+        record(result.best);
+        showRules();
+        if (!Finish) {
+          computer.ponder(game);
         }
       }
     }
+    if (!thinking.valid()) {
+      bool computerTurn = computerPlays && !game.isPlacement() &&
+                          !game.isFinished() && game.getSideToMove() == 1;
+      if (computerTurn) {
+        TimeBudget budget = allocateTime(clock.remaining(1),
+                                         clock.control(1).incrementMs);
+        thinkingKey = game.hash();
+        thinkingStart = std::chrono::steady_clock::now();
+        thinking = std::async(std::launch::async,
+                              [&computer, position = game, budget]() mutable {
+                                return computer.think(position, SearchLimits(),
+                                                      budget);
+                              });
+      } else if (computer.isPondering() &&
+                 (!computerPlays || game.isFinished())) {
+        computer.cancel();
+      }
+    }
 
-    for (int i = 0; i < rows; ++i) {
-      for (int j = 0; j < cols; ++j) {
-        circles[i][j].draw(window);
+    // Follow the rules state, whichever way it changed this frame.
+    bool analysing = analysisOverlay.isVisible() && !game.isPlacement() &&
+                     !game.isFinished();
+    if (!analysing && analysedKey != 0) {
+      analyzer.pause();
+      analysedKey = 0;
+    } else if (analysing && game.hash() != analysedKey) {
+      analysedKey = game.hash();
+      analyzer.setPosition(game);
+    }
+    analyzer.poll(analysis);
+
+    ScopedTimer boardTimer(profiler, boardSection);
+    board.draw(window, circles);
+    if (showDanger) {
+      // Shade by the damage the opponent of the side to move can deal.
+      int enemy = 1 - game.getSideToMove();
+      const std::int32_t *danger = threats.influence(enemy);
+      int strongest = 1;
+      for (int cell = 0; cell < rows * cols; ++cell) {
+        strongest = std::max(strongest, static_cast<int>(danger[cell]));
+      }
+      for (int cell = 0; cell < rows * cols; ++cell) {
+        if (danger[cell] > 0) {
+          sf::Vector2f center =
+              circles[game.rowOf(cell)][game.colOf(cell)].getCenter();
+          dangerMarker.setFillColor(
+              sf::Color(220, 40, 40, 40 + 140 * danger[cell] / strongest));
+          dangerMarker.setPosition(center.x - r, center.y - r);
+          window.draw(dangerMarker);
+        }
+      }
+    }
+    boardTimer.stop();
+
+    int selectedCell = gameStart && selectNPC
+                           ? game.cellIndex(previousCircle.first,
+                                            previousCircle.second)
+                           : -1;
+    int hoveredCell = -1;
+    if (selectedCell != -1) {
+      sf::Vector2i mousePosition = sf::Mouse::getPosition(window);
+      for (int i = 0; i < rows && hoveredCell == -1; ++i) {
+        for (int j = 0; j < cols; ++j) {
+          if (circles[i][j].isClicked(mousePosition, r)) {
+            hoveredCell = game.cellIndex(i, j);
+            break;
+          }
+        }
+      }
+    }
+    if (selectedCell != hoverFrom || hoveredCell != hoverTo) {
+      hoverFrom = selectedCell;
+      hoverTo = hoveredCell;
+      hoverPath.clear();
+      if (hoverFrom != -1 && hoverTo != -1) {
+        pathFinder.findPath(game, hoverFrom, hoverTo, hoverPath);
       }
     }
+    for (size_t k = 1; k < hoverPath.size(); ++k) {
+      sf::Vector2f center =
+          circles[game.rowOf(hoverPath[k])][game.colOf(hoverPath[k])]
+              .getCenter();
+      pathMarker.setPosition(center.x - r / 5.f, center.y - r / 5.f);
+      window.draw(pathMarker);
+    }
 
+    ScopedTimer unitsTimer(profiler, unitsSection);
     for (const auto &npc : NPC_Player1) { 
       npc.draw(window);
     }
@@ -308,10 +657,20 @@ int main() {
     for (const auto &npc : NPC_Player2) {
       npc.draw(window);
     }
+    unitsTimer.stop();
+
+    ScopedTimer uiTimer(profiler, uiSection);
+    analysisOverlay.draw(window, game, analysis, circles);
 
     if (!gameStart) {
       finishButton.draw(window);
     }
+    if (!history.empty()) {
+      undoButton.draw(window);
+    }
+    if (!redoable.empty()) {
+      redoButton.draw(window);
+    }
     if (Player1move) {
       turnText.setString("Motion: Player 1");
     } else {
@@ -328,9 +687,19 @@ int main() {
     if (gameStart) {
       window.draw(turnText);
     }
+    profilerOverlay.draw(window);
+    uiTimer.stop();
 
+    ScopedTimer displayTimer(profiler, displaySection);
     window.display();
   }
 
+  if (!profiler.writeCsv("profile.csv")) {
+    std::cerr << "Error with profile.csv" << std::endl;
+  }
+  if (tracePath != nullptr && !Trace::writeChromeTrace(tracePath)) {
+    std::cerr << "Error with " << tracePath << std::endl;
+  }
+
   return 0;
 }
@@ -0,0 +1,175 @@
+#ifndef MAPPED_FILE
+#define MAPPED_FILE
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STRATEG_MMAP 1
+#endif
+
+/*!
+ * \brief Writes the low bytes of a value, least significant first.
+ * \param out Receives the bytes.
+ * \param value The value.
+ * \param bytes The number of bytes, at most 8.
+ */
+inline void putLE(std::uint8_t *out, std::uint64_t value, int bytes) {
+  for (int k = 0; k < bytes; ++k) {
+    out[k] = static_cast<std::uint8_t>((value >> (8 * k)) & 0xFF);
+  }
+}
+
+/*!
+ * \brief Appends the low bytes of a value, least significant first.
+ * \param out Grows by the bytes.
+ * \param value The value.
+ * \param bytes The number of bytes, at most 8.
+ */
+inline void appendLE(std::vector<std::uint8_t> &out, std::uint64_t value,
+                     int bytes) {
+  for (int k = 0; k < bytes; ++k) {
+    out.push_back(static_cast<std::uint8_t>((value >> (8 * k)) & 0xFF));
+  }
+}
+
+/*!
+ * \brief Reads an unsigned value stored least significant byte first.
+ * \param data The first byte.
+ * \param bytes The number of bytes, at most 8.
+ */
+inline std::uint64_t getLE(const std::uint8_t *data, int bytes) {
+  std::uint64_t value = 0;
+  for (int k = 0; k < bytes; ++k) {
+    value |= static_cast<std::uint64_t>(data[k]) << (8 * k);
+  }
+  return value;
+}
+
+/*!
+ * \brief The read-only contents of a file, or of bytes held in memory.
+ *
+ * On POSIX systems open() maps the file, so opening costs nothing and only
+ * the pages read are loaded; elsewhere it reads the file into memory.
+ */
+class MappedFile {
+public:
+  MappedFile() : base(nullptr), length(0), mapped(false) {}
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept : MappedFile() { swap(other); }
+
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      swap(other);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { close(); }
+
+  /*!
+   * \brief Opens a file, releasing the contents held before.
+   * \param path The path of the file.
+   * \return False if the file is missing, unreadable or empty.
+   */
+  bool open(const std::string &path) {
+    close();
+#ifdef STRATEG_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void *address = mmap(nullptr, static_cast<size_t>(info.st_size),
+                           PROT_READ, MAP_SHARED, fd, 0);
+      if (address != MAP_FAILED) {
+        base = static_cast<const std::uint8_t *>(address);
+        length = static_cast<size_t>(info.st_size);
+        mapped = true;
+      }
+    }
+    ::close(fd);
+    return mapped;
+#else
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    std::vector<std::uint8_t> bytes;
+    std::uint8_t chunk[1 << 16];
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+      bytes.insert(bytes.end(), chunk, chunk + got);
+    }
+    std::fclose(file);
+    assign(std::move(bytes));
+    return length > 0;
+#endif
+  }
+
+  /*!
+   * \brief Holds contents from memory, releasing those held before.
+   * \param bytes The contents.
+   */
+  void assign(std::vector<std::uint8_t> bytes) {
+    close();
+    storage = std::move(bytes);
+    base = storage.data();
+    length = storage.size();
+  }
+
+  /*!
+   * \brief Releases the contents.
+   */
+  void close() {
+#ifdef STRATEG_MMAP
+    if (mapped) {
+      munmap(const_cast<std::uint8_t *>(base), length);
+    }
+#endif
+    storage.clear();
+    base = nullptr;
+    length = 0;
+    mapped = false;
+  }
+
+  /*!
+   * \brief Gets the first byte, or nullptr when nothing is held.
+   */
+  const std::uint8_t *data() const { return base; }
+
+  size_t size() const { return length; }
+
+  /*!
+   * \brief Checks if the contents are a mapping of a file.
+   */
+  bool isMapped() const { return mapped; }
+
+private:
+  void swap(MappedFile &other) {
+    std::swap(base, other.base);
+    std::swap(length, other.length);
+    std::swap(mapped, other.mapped);
+    // Swapping keeps the elements in place, so base stays valid.
+    storage.swap(other.storage);
+  }
+
+  const std::uint8_t *base;
+  size_t length;
+  bool mapped;
+  std::vector<std::uint8_t> storage;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "doctest.h"
+#include "mapped_file.h"
+#include <algorithm>
+
+static const char *TEST_FILE = "mapped_file_test.bin";
+
+TEST_CASE("Little-Endian Helpers: Values Round Trip") {
+    std::uint8_t bytes[8] = {};
+    putLE(bytes, 0x0123456789ABCDEFull, 8);
+    CHECK(bytes[0] == 0xEF);
+    CHECK(bytes[7] == 0x01);
+    CHECK(getLE(bytes, 8) == 0x0123456789ABCDEFull);
+    CHECK(getLE(bytes, 2) == 0xCDEF);
+
+    std::vector<std::uint8_t> out;
+    appendLE(out, 0x1234, 2);
+    appendLE(out, 0xFFFFFFFFu, 4);
+    REQUIRE(out.size() == 6);
+    CHECK(getLE(out.data(), 2) == 0x1234);
+    CHECK(getLE(out.data() + 2, 4) == 0xFFFFFFFFu);
+}
+
+TEST_CASE("MappedFile Class: Opens, Assigns And Moves") {
+    std::vector<std::uint8_t> contents = {'S', 'T', 'R', 'A', 'T', 'E', 'G'};
+    std::FILE *file = std::fopen(TEST_FILE, "wb");
+    REQUIRE(file != nullptr);
+    std::fwrite(contents.data(), 1, contents.size(), file);
+    std::fclose(file);
+
+    MappedFile mapped;
+    CHECK(mapped.data() == nullptr);
+    REQUIRE(mapped.open(TEST_FILE));
+    REQUIRE(mapped.size() == contents.size());
+    CHECK(std::equal(contents.begin(), contents.end(), mapped.data()));
+
+    // A move hands the contents over, mapped or held in memory alike.
+    MappedFile moved(std::move(mapped));
+    CHECK(mapped.data() == nullptr);
+    CHECK(mapped.size() == 0);
+    REQUIRE(moved.size() == contents.size());
+    CHECK(std::equal(contents.begin(), contents.end(), moved.data()));
+    MappedFile held;
+    held.assign(std::vector<std::uint8_t>(3, 9));
+    CHECK_FALSE(held.isMapped());
+    moved = std::move(held);
+    REQUIRE(moved.size() == 3);
+    CHECK(moved.data()[2] == 9);
+
+    moved.close();
+    CHECK(moved.data() == nullptr);
+    CHECK_FALSE(moved.open("mapped_file_test_missing.bin"));
+    std::remove(TEST_FILE);
+
+    // An empty file has nothing to map.
+    file = std::fopen(TEST_FILE, "wb");
+    REQUIRE(file != nullptr);
+    std::fclose(file);
+    CHECK_FALSE(moved.open(TEST_FILE));
+    std::remove(TEST_FILE);
+}
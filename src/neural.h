@@ -0,0 +1,493 @@
+#ifndef NEURAL
+#define NEURAL
+
+#include "evaluation.h"
+#include "game.h"
+#include "mapped_file.h"
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief A small quantized network that scores positions, updated
+ * incrementally as actions are made and unmade.
+ *
+ * Inputs are one-hot (owner, unit type, hex) features seen from each
+ * player: owner is "own" or "enemy", and player 1 sees the board mirrored
+ * left to right so that both deploy on the left. The first layer sums the
+ * int16 weight rows of the active features into one accumulator per player.
+ * An action only changes the features of the unit placed, moved or killed,
+ * so update() and revert() add or subtract two rows per player instead of
+ * summing every unit again. int16 arithmetic wraps, so revert() restores
+ * the accumulators exactly.
+ *
+ * The output clips both accumulators to [0, 127], side to move first, and
+ * takes their dot product with int8 weights. Scalar, SSE4.2 and AVX2
+ * kernels give identical results; the best one is picked as for Evaluator.
+ *
+ * Weights file, little-endian: "SNN1", u16 rows, cols, hidden and output
+ * shift, i16 bias[hidden], i16 weights[2 * UNIT_TYPES * rows * cols][hidden]
+ * ordered by owner, type, then hex, i8 output[2 * hidden], i32 output bias.
+ * The score is (dot product + output bias) / 2^shift.
+ */
+class NeuralEvaluator {
+public:
+  /*!
+   * \brief The largest value a clipped accumulator lane takes.
+   */
+  static constexpr int CLIP = 127;
+
+  /*!
+   * \brief Hidden sizes are multiples of this, one AVX2 register of int16.
+   */
+  static constexpr int HIDDEN_STEP = 16;
+
+  /*!
+   * \brief The largest accumulator a weights file may ask for.
+   */
+  static constexpr int MAX_HIDDEN = 1024;
+
+  NeuralEvaluator()
+      : rows(0), cols(0), hidden(0), shift(0), outputBias(0),
+        active(Evaluator::bestKernel()) {}
+
+  /*!
+   * \brief Reads the weights from a file.
+   * \param path The path of the weights file.
+   * \return False if the file is missing or malformed; the evaluator is
+   * then left unusable.
+   */
+  bool load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      hidden = 0;
+      return false;
+    }
+    std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                   std::istreambuf_iterator<char>());
+    return loadFromMemory(data.data(), data.size());
+  }
+
+  /*!
+   * \brief Reads the weights from a buffer in the file format.
+   * \param data The bytes of the weights file.
+   * \param size The number of bytes.
+   * \return False if the buffer is malformed.
+   */
+  bool loadFromMemory(const std::uint8_t *data, size_t size) {
+    hidden = 0;
+    if (size < HEADER_SIZE || data[0] != 'S' || data[1] != 'N' ||
+        data[2] != 'N' || data[3] != '1') {
+      return false;
+    }
+    int fileRows = static_cast<int>(getLE(data + 4, 2));
+    int fileCols = static_cast<int>(getLE(data + 6, 2));
+    int fileHidden = static_cast<int>(getLE(data + 8, 2));
+    int fileShift = static_cast<int>(getLE(data + 10, 2));
+    if (fileRows <= 0 || fileCols <= 0 || fileHidden <= 0 ||
+        fileHidden > MAX_HIDDEN || fileHidden % HIDDEN_STEP != 0 ||
+        fileShift > 30) {
+      return false;
+    }
+    size_t features = featureCount(fileRows, fileCols);
+    size_t expected = HEADER_SIZE + 2 * fileHidden +
+                      2 * features * fileHidden + 2 * fileHidden + 4;
+    if (size != expected) {
+      return false;
+    }
+    const std::uint8_t *cursor = data + HEADER_SIZE;
+    bias.resize(fileHidden);
+    for (std::int16_t &value : bias) {
+      value = static_cast<std::int16_t>(getLE(cursor, 2));
+      cursor += 2;
+    }
+    weights.resize(features * fileHidden);
+    for (std::int16_t &value : weights) {
+      value = static_cast<std::int16_t>(getLE(cursor, 2));
+      cursor += 2;
+    }
+    output.resize(2 * fileHidden);
+    for (std::int16_t &value : output) {
+      value = static_cast<std::int8_t>(*cursor++);
+    }
+    outputBias = static_cast<std::int32_t>(getLE(cursor, 4));
+    rows = fileRows;
+    cols = fileCols;
+    shift = fileShift;
+    hidden = fileHidden;
+    accumulator[0].assign(hidden, 0);
+    accumulator[1].assign(hidden, 0);
+    return true;
+  }
+
+  /*!
+   * \brief Writes the weights in the file format.
+   * \param out Receives the bytes.
+   */
+  void serialize(std::vector<std::uint8_t> &out) const {
+    out.clear();
+    out.push_back('S');
+    out.push_back('N');
+    out.push_back('N');
+    out.push_back('1');
+    appendLE(out, rows, 2);
+    appendLE(out, cols, 2);
+    appendLE(out, hidden, 2);
+    appendLE(out, shift, 2);
+    for (std::int16_t value : bias) {
+      appendLE(out, static_cast<std::uint16_t>(value), 2);
+    }
+    for (std::int16_t value : weights) {
+      appendLE(out, static_cast<std::uint16_t>(value), 2);
+    }
+    for (std::int16_t value : output) {
+      out.push_back(static_cast<std::uint8_t>(value));
+    }
+    appendLE(out, static_cast<std::uint32_t>(outputBias), 4);
+  }
+
+  /*!
+   * \brief Writes the weights to a file.
+   * \param path The path of the file to write.
+   * \return True if the file was written, false otherwise.
+   */
+  bool save(const std::string &path) const {
+    std::vector<std::uint8_t> data;
+    serialize(data);
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(data.data()),
+              static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(out);
+  }
+
+  /*!
+   * \brief Fills the network with small random weights, the starting point
+   * of a training run.
+   * \param boardRows The number of board rows.
+   * \param boardCols The number of board columns.
+   * \param hiddenSize The accumulator size, a multiple of HIDDEN_STEP.
+   * \param seed The seed of the random generator.
+   */
+  void randomize(int boardRows, int boardCols, int hiddenSize,
+                 std::uint32_t seed) {
+    std::mt19937 rng(seed);
+    rows = boardRows;
+    cols = boardCols;
+    hidden = (std::max(hiddenSize, 1) + HIDDEN_STEP - 1) / HIDDEN_STEP *
+             HIDDEN_STEP;
+    shift = 4;
+    bias.resize(hidden);
+    for (std::int16_t &value : bias) {
+      value = static_cast<std::int16_t>(rng() % 64);
+    }
+    weights.resize(featureCount(rows, cols) * hidden);
+    for (std::int16_t &value : weights) {
+      value = static_cast<std::int16_t>(static_cast<int>(rng() % 65) - 32);
+    }
+    output.resize(2 * hidden);
+    for (std::int16_t &value : output) {
+      value = static_cast<std::int16_t>(static_cast<int>(rng() % 255) - 127);
+    }
+    outputBias = 0;
+    accumulator[0].assign(hidden, 0);
+    accumulator[1].assign(hidden, 0);
+  }
+
+  /*!
+   * \brief Checks if the network was trained for the board of a state.
+   * \param state The position.
+   * \return True if weights are loaded and match the board size.
+   */
+  bool fits(const GameState &state) const {
+    return hidden > 0 && state.getRows() == rows && state.getCols() == cols;
+  }
+
+  /*!
+   * \brief Gets the accumulator size, 0 until weights are loaded.
+   */
+  int getHidden() const { return hidden; }
+
+  /*!
+   * \brief Selects the kernel to use.
+   * \param kernel The kernel.
+   * \return False, keeping the current kernel, if the CPU lacks it.
+   */
+  bool setKernel(Evaluator::Kernel kernel) {
+    if (!Evaluator::supports(kernel)) {
+      return false;
+    }
+    active = kernel;
+    return true;
+  }
+
+  /*!
+   * \brief Gets the kernel in use.
+   */
+  Evaluator::Kernel getKernel() const { return active; }
+
+  /*!
+   * \brief Recomputes both accumulators from every unit of a state.
+   * \param state The position to follow; fits() must hold.
+   */
+  void refresh(const GameState &state) {
+    for (int view = 0; view < 2; ++view) {
+      accumulator[view].assign(bias.begin(), bias.end());
+    }
+    for (int player = 0; player < 2; ++player) {
+      for (const Unit &unit : state.getUnits(player)) {
+        change(player, unit.type, unit.cell, -1);
+      }
+    }
+  }
+
+  /*!
+   * \brief Follows an action performed with GameState::make().
+   * \param state The state after the action.
+   * \param undo The record make() filled.
+   */
+  void update(const GameState &state, const ActionUndo &undo) {
+    const Action &action = undo.action;
+    if (action.kind == PlaceUnit) {
+      change(action.player, action.unitType, action.to, -1);
+    } else if (action.kind == MoveUnit) {
+      int type = state.getUnits(undo.sideToMove)[state.unitIndexAt(action.to)]
+                     .type;
+      change(undo.sideToMove, type, action.to, action.from);
+    } else if (action.kind == AttackUnit && undo.killed) {
+      change(1 - undo.sideToMove, undo.victim.type, -1, undo.victim.cell);
+    }
+  }
+
+  /*!
+   * \brief Follows an action taken back with GameState::unmake().
+   * \param state The state after unmake().
+   * \param undo The record of the reverted action.
+   */
+  void revert(const GameState &state, const ActionUndo &undo) {
+    const Action &action = undo.action;
+    if (action.kind == PlaceUnit) {
+      change(action.player, action.unitType, -1, action.to);
+    } else if (action.kind == MoveUnit) {
+      int type =
+          state.getUnits(undo.sideToMove)[state.unitIndexAt(action.from)]
+              .type;
+      change(undo.sideToMove, type, action.from, action.to);
+    } else if (action.kind == AttackUnit && undo.killed) {
+      change(1 - undo.sideToMove, undo.victim.type, undo.victim.cell, -1);
+    }
+  }
+
+  /*!
+   * \brief Scores the followed position for the side to move.
+   * \param state The position the accumulators follow.
+   * \return Positive if the side to move stands better; +-WIN_SCORE of
+   * Evaluator once the game is decided.
+   */
+  int evaluate(const GameState &state) const {
+    int side = state.getSideToMove();
+    if (state.isFinished()) {
+      return state.getWinner() == side ? Evaluator::WIN_SCORE
+                                       : -Evaluator::WIN_SCORE;
+    }
+    const std::int16_t *own = accumulator[side].data();
+    const std::int16_t *enemy = accumulator[1 - side].data();
+    std::int32_t sum;
+    switch (active) {
+#ifdef STRATEG_X86_KERNELS
+    case Evaluator::Avx2Kernel:
+      sum = dotAvx2(own, output.data(), hidden) +
+            dotAvx2(enemy, output.data() + hidden, hidden);
+      break;
+    case Evaluator::Sse42Kernel:
+      sum = dotSse42(own, output.data(), hidden) +
+            dotSse42(enemy, output.data() + hidden, hidden);
+      break;
+#endif
+    default:
+      sum = dotScalar(own, output.data(), hidden) +
+            dotScalar(enemy, output.data() + hidden, hidden);
+      break;
+    }
+    return (sum + outputBias) / (1 << shift);
+  }
+
+private:
+  static constexpr size_t HEADER_SIZE = 12;
+
+  static size_t featureCount(int boardRows, int boardCols) {
+    return static_cast<size_t>(2 * UNIT_TYPES) * boardRows * boardCols;
+  }
+
+  /*!
+   * \brief Gets the weight row of a unit feature as seen by a player.
+   */
+  const std::int16_t *featureRow(int view, int owner, int type,
+                                 int cell) const {
+    int seen = view == 0 ? cell : cell + cols - 1 - 2 * (cell % cols);
+    size_t feature = static_cast<size_t>(
+        ((owner == view ? 0 : 1) * UNIT_TYPES + type) * rows * cols + seen);
+    return weights.data() + feature * hidden;
+  }
+
+  /*!
+   * \brief Moves the features of a unit in both accumulators: adds it on
+   * hex added and removes it from hex removed, either may be -1. One kernel
+   * call does all rows, so the per-call cost of the dispatch is paid once.
+   */
+  void change(int owner, int type, int added, int removed) {
+    std::int16_t *sums[2] = {accumulator[0].data(), accumulator[1].data()};
+    const std::int16_t *plus[2] = {nullptr, nullptr};
+    const std::int16_t *minus[2] = {nullptr, nullptr};
+    for (int view = 0; view < 2; ++view) {
+      if (added != -1) {
+        plus[view] = featureRow(view, owner, type, added);
+      }
+      if (removed != -1) {
+        minus[view] = featureRow(view, owner, type, removed);
+      }
+    }
+    switch (active) {
+#ifdef STRATEG_X86_KERNELS
+    case Evaluator::Avx2Kernel:
+      changeAvx2(sums, plus, minus, hidden);
+      break;
+    case Evaluator::Sse42Kernel:
+      changeSse42(sums, plus, minus, hidden);
+      break;
+#endif
+    default:
+      changeScalar(sums, plus, minus, hidden);
+      break;
+    }
+  }
+
+  static void changeScalar(std::int16_t *const sums[2],
+                           const std::int16_t *const plus[2],
+                           const std::int16_t *const minus[2], int size) {
+    for (int view = 0; view < 2; ++view) {
+      std::int16_t *sum = sums[view];
+      if (plus[view] != nullptr) {
+        const std::int16_t *row = plus[view];
+        for (int k = 0; k < size; ++k) {
+          sum[k] = static_cast<std::int16_t>(sum[k] + row[k]);
+        }
+      }
+      if (minus[view] != nullptr) {
+        const std::int16_t *row = minus[view];
+        for (int k = 0; k < size; ++k) {
+          sum[k] = static_cast<std::int16_t>(sum[k] - row[k]);
+        }
+      }
+    }
+  }
+
+  static std::int32_t dotScalar(const std::int16_t *values,
+                                const std::int16_t *weights, int size) {
+    std::int32_t sum = 0;
+    for (int k = 0; k < size; ++k) {
+      int clipped = std::min(std::max(static_cast<int>(values[k]), 0), CLIP);
+      sum += clipped * weights[k];
+    }
+    return sum;
+  }
+
+#ifdef STRATEG_X86_KERNELS
+  __attribute__((target("sse4.2"))) static void
+  changeSse42(std::int16_t *const sums[2], const std::int16_t *const plus[2],
+              const std::int16_t *const minus[2], int size) {
+    for (int view = 0; view < 2; ++view) {
+      for (int k = 0; k < size; k += 8) {
+        __m128i *lane = reinterpret_cast<__m128i *>(sums[view] + k);
+        __m128i value = _mm_loadu_si128(lane);
+        if (plus[view] != nullptr) {
+          value = _mm_add_epi16(
+              value, _mm_loadu_si128(
+                         reinterpret_cast<const __m128i *>(plus[view] + k)));
+        }
+        if (minus[view] != nullptr) {
+          value = _mm_sub_epi16(
+              value, _mm_loadu_si128(
+                         reinterpret_cast<const __m128i *>(minus[view] + k)));
+        }
+        _mm_storeu_si128(lane, value);
+      }
+    }
+  }
+
+  __attribute__((target("sse4.2"))) static std::int32_t
+  dotSse42(const std::int16_t *values, const std::int16_t *weights, int size) {
+    __m128i total = _mm_setzero_si128();
+    __m128i low = _mm_setzero_si128();
+    __m128i high = _mm_set1_epi16(CLIP);
+    for (int k = 0; k < size; k += 8) {
+      __m128i value =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + k));
+      value = _mm_min_epi16(_mm_max_epi16(value, low), high);
+      __m128i weight =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + k));
+      total = _mm_add_epi32(total, _mm_madd_epi16(value, weight));
+    }
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4E));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xB1));
+    return _mm_cvtsi128_si32(total);
+  }
+
+  __attribute__((target("avx2"))) static void
+  changeAvx2(std::int16_t *const sums[2], const std::int16_t *const plus[2],
+             const std::int16_t *const minus[2], int size) {
+    for (int view = 0; view < 2; ++view) {
+      for (int k = 0; k < size; k += HIDDEN_STEP) {
+        __m256i *lane = reinterpret_cast<__m256i *>(sums[view] + k);
+        __m256i value = _mm256_loadu_si256(lane);
+        if (plus[view] != nullptr) {
+          value = _mm256_add_epi16(
+              value, _mm256_loadu_si256(
+                         reinterpret_cast<const __m256i *>(plus[view] + k)));
+        }
+        if (minus[view] != nullptr) {
+          value = _mm256_sub_epi16(
+              value, _mm256_loadu_si256(
+                         reinterpret_cast<const __m256i *>(minus[view] + k)));
+        }
+        _mm256_storeu_si256(lane, value);
+      }
+    }
+  }
+
+  __attribute__((target("avx2"))) static std::int32_t
+  dotAvx2(const std::int16_t *values, const std::int16_t *weights, int size) {
+    __m256i total = _mm256_setzero_si256();
+    __m256i low = _mm256_setzero_si256();
+    __m256i high = _mm256_set1_epi16(CLIP);
+    for (int k = 0; k < size; k += HIDDEN_STEP) {
+      __m256i value =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + k));
+      value = _mm256_min_epi16(_mm256_max_epi16(value, low), high);
+      __m256i weight =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + k));
+      total = _mm256_add_epi32(total, _mm256_madd_epi16(value, weight));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(total),
+                                 _mm256_extracti128_si256(total, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    return _mm_cvtsi128_si32(half);
+  }
+#endif
+
+  int rows;
+  int cols;
+  int hidden;
+  int shift;
+  std::int32_t outputBias;
+  Evaluator::Kernel active;
+  std::vector<std::int16_t> bias;
+  std::vector<std::int16_t> weights;
+  std::vector<std::int16_t> output;
+  std::vector<std::int16_t> accumulator[2];
+};
+
+#endif
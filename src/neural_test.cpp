@@ -0,0 +1,111 @@
+#include "doctest.h"
+#include "neural.h"
+#include <cstdio>
+
+TEST_CASE("NeuralEvaluator Class: Reads The Weights File Format") {
+    // 2x2 board, 16 hidden lanes: only "own knight on hex 1" has weights.
+    const int hidden = 16;
+    const int features = 2 * UNIT_TYPES * 4;
+    std::vector<std::uint8_t> data = {'S', 'N', 'N', '1'};
+    appendLE(data, 2, 2);
+    appendLE(data, 2, 2);
+    appendLE(data, hidden, 2);
+    appendLE(data, 1, 2);
+    for (int k = 0; k < hidden; ++k) {
+        appendLE(data, 0, 2);
+    }
+    for (int feature = 0; feature < features; ++feature) {
+        for (int k = 0; k < hidden; ++k) {
+            appendLE(data, feature == 1 ? 10 : 0, 2);
+        }
+    }
+    for (int k = 0; k < 2 * hidden; ++k) {
+        data.push_back(k < hidden ? 3 : static_cast<std::uint8_t>(-1));
+    }
+    appendLE(data, 4, 4);
+
+    NeuralEvaluator network;
+    REQUIRE(network.loadFromMemory(data.data(), data.size()));
+    CHECK(network.getHidden() == hidden);
+
+    GameState state(2, 2, 1);
+    CHECK(network.fits(state));
+    CHECK_FALSE(network.fits(GameState(3, 2, 1)));
+    std::vector<Unit> armies[2];
+    armies[0].push_back(Unit{0, 50, 1});
+    armies[1].push_back(Unit{1, 30, 2});
+    REQUIRE(state.restore(armies, 0, false, 0));
+    network.refresh(state);
+    // Player 0: 16 lanes of 10 times 3, plus the bias, halved.
+    CHECK(network.evaluate(state) == (16 * 10 * 3 + 4) / 2);
+    // Player 1 sees the same lanes as the enemy's.
+    REQUIRE(state.restore(armies, 1, false, 0));
+    CHECK(network.evaluate(state) == (16 * 10 * -1 + 4) / 2);
+    // Player 1 sees hex 0 of the board as its hex 1.
+    armies[0][0].cell = 3;
+    armies[1][0].cell = 0;
+    armies[1][0].type = 0;
+    REQUIRE(state.restore(armies, 1, false, 0));
+    network.refresh(state);
+    CHECK(network.evaluate(state) == (16 * 10 * 3 + 4) / 2);
+
+    std::vector<std::uint8_t> copy;
+    network.serialize(copy);
+    CHECK(copy == data);
+    CHECK_FALSE(network.loadFromMemory(data.data(), data.size() - 1));
+    data[8] = 15;
+    CHECK_FALSE(network.loadFromMemory(data.data(), data.size()));
+    CHECK(network.getHidden() == 0);
+    CHECK_FALSE(network.load("missing_weights.snn"));
+}
+
+TEST_CASE("NeuralEvaluator Class: Incremental Updates Match Refresh") {
+    const Evaluator::Kernel kernels[] = {Evaluator::ScalarKernel,
+                                         Evaluator::Sse42Kernel,
+                                         Evaluator::Avx2Kernel};
+    NeuralEvaluator trained;
+    trained.randomize(9, 9, 48, 7);
+    REQUIRE(trained.save("neural_test.snn"));
+    NeuralEvaluator network;
+    REQUIRE(network.load("neural_test.snn"));
+    std::remove("neural_test.snn");
+    CHECK(network.getHidden() == 48);
+    NeuralEvaluator reference = network;
+    reference.setKernel(Evaluator::ScalarKernel);
+
+    for (Evaluator::Kernel kernel : kernels) {
+        if (!network.setKernel(kernel)) {
+            MESSAGE("kernel not supported: " << Evaluator::kernelName(kernel));
+            continue;
+        }
+        for (std::uint32_t seed = 0; seed < 5; ++seed) {
+            GameState state(9, 9, 4);
+            state.generateTall(seed, 8);
+            network.refresh(state);
+            std::mt19937 rng(seed);
+            std::vector<Action> actions;
+            std::vector<ActionUndo> history;
+            std::vector<int> scores;
+            while (!state.isFinished() && state.getTurn() < 120) {
+                state.generateActions(actions);
+                if (actions.empty()) {
+                    break;
+                }
+                history.emplace_back();
+                REQUIRE(state.make(actions[rng() % actions.size()], history.back()));
+                network.update(state, history.back());
+                reference.refresh(state);
+                scores.push_back(reference.evaluate(state));
+                REQUIRE(network.evaluate(state) == scores.back());
+            }
+            CHECK(history.size() > 10);
+            while (!history.empty()) {
+                REQUIRE(network.evaluate(state) == scores.back());
+                state.unmake(history.back());
+                network.revert(state, history.back());
+                history.pop_back();
+                scores.pop_back();
+            }
+        }
+    }
+}
@@ -0,0 +1,229 @@
+#ifndef OVERLAY
+#define OVERLAY
+
+#include "analysis.h"
+#include "func.h"
+#include "profiler.h"
+#include <SFML/Graphics.hpp>
+#include <cmath>
+#include <cstdio>
+
+/*!
+ * \brief A toggleable on-screen table with the p50/p99 of every profiler
+ * section.
+ */
+class ProfilerOverlay {
+public:
+  /*!
+   * \brief Constructor for ProfilerOverlay with specified parameters.
+   * \param profiler The profiler whose sections are displayed.
+   * \param font The font used for the table.
+   * \param refreshFrames The number of frames between text updates.
+   */
+  ProfilerOverlay(const Profiler &profiler, const sf::Font &font,
+                  int refreshFrames = 15)
+      : profiler(profiler), refreshFrames(refreshFrames), framesLeft(0),
+        visible(false) {
+    text.setFont(font);
+    text.setCharacterSize(16);
+    text.setFillColor(sf::Color::White);
+    text.setPosition(15.f, 15.f);
+    background.setFillColor(sf::Color(0, 0, 0, 170));
+    background.setPosition(10.f, 10.f);
+  }
+
+  /*!
+   * \brief Shows the overlay if hidden and hides it otherwise.
+   */
+  void toggle() {
+    visible = !visible;
+    framesLeft = 0;
+  }
+
+  /*!
+   * \brief Checks if the overlay is shown.
+   * \return True if the overlay is drawn, false otherwise.
+   */
+  bool isVisible() const { return visible; }
+
+  /*!
+   * \brief Draws the overlay, refreshing its text every few frames.
+   * \param window The window to draw the overlay on.
+   */
+  void draw(sf::RenderTarget &window) {
+    if (!visible) {
+      return;
+    }
+    if (framesLeft-- <= 0) {
+      refresh();
+      framesLeft = refreshFrames;
+    }
+    window.draw(background);
+    window.draw(text);
+  }
+
+private:
+  /*!
+   * \brief Rebuilds the table text from the current statistics.
+   */
+  void refresh() {
+    std::string table = "section            p50 ms    p99 ms\n";
+    char line[96];
+    for (int k = 0; k < profiler.sectionCount(); ++k) {
+      std::snprintf(line, sizeof(line), "%-16s %8.3f  %8.3f\n",
+                    profiler.sectionName(k).c_str(), profiler.percentile(k, 50),
+                    profiler.percentile(k, 99));
+      table += line;
+    }
+    text.setString(table);
+    sf::FloatRect bounds = text.getLocalBounds();
+    background.setSize(
+        sf::Vector2f(bounds.width + 20.f, bounds.top + bounds.height + 20.f));
+  }
+
+  const Profiler &profiler;
+  int refreshFrames;
+  int framesLeft;
+  bool visible;
+  sf::Text text;
+  sf::RectangleShape background;
+};
+
+/*!
+ * \brief Draws the lines of an Analysis as arrows over the board: moves in
+ * blue, attacks in red, the best line boldest, each labelled with its score
+ * for the side to move.
+ */
+class AnalysisOverlay {
+public:
+  /*!
+   * \brief Constructor for AnalysisOverlay with specified parameters.
+   * \param font The font used for the scores.
+   * \param r The inner radius of a hex.
+   */
+  AnalysisOverlay(const sf::Font &font, float r)
+      : r(r), arrows(sf::Triangles), visible(false) {
+    label.setFont(font);
+    label.setCharacterSize(18);
+    label.setFillColor(sf::Color::White);
+    label.setOutlineColor(sf::Color::Black);
+    label.setOutlineThickness(2.f);
+    status.setFont(font);
+    status.setCharacterSize(16);
+    status.setFillColor(sf::Color::Black);
+  }
+
+  /*!
+   * \brief Shows the overlay if hidden and hides it otherwise.
+   */
+  void toggle() { visible = !visible; }
+
+  /*!
+   * \brief Checks if the overlay is shown.
+   * \return True if the overlay is drawn, false otherwise.
+   */
+  bool isVisible() const { return visible; }
+
+  /*!
+   * \brief Draws the arrows of an analysis of the current position; one of
+   * an earlier position draws nothing.
+   * \param window The window to draw the overlay on.
+   * \param game The position on the board.
+   * \param analysis The latest analysis.
+   * \param circles The hexes of the board.
+   */
+  void draw(sf::RenderTarget &window, const GameState &game,
+            const Analysis &analysis,
+            const std::vector<std::vector<Circle>> &circles) {
+    if (!visible || analysis.key != game.hash() || analysis.lines.empty()) {
+      return;
+    }
+    arrows.clear();
+    for (size_t k = 0; k < analysis.lines.size(); ++k) {
+      const Action &action = analysis.lines[k].action;
+      if (action.from < 0 || action.to < 0) {
+        continue;
+      }
+      sf::Uint8 alpha = static_cast<sf::Uint8>(k == 0 ? 230 : 150);
+      sf::Color color = action.kind == AttackUnit
+                            ? sf::Color(210, 30, 30, alpha)
+                            : sf::Color(30, 70, 210, alpha);
+      addArrow(centerOf(game, circles, action.from),
+               centerOf(game, circles, action.to),
+               r / (k == 0 ? 5.f : 8.f), color);
+    }
+    window.draw(arrows);
+    for (const SearchLine &line : analysis.lines) {
+      if (line.action.to < 0) {
+        continue;
+      }
+      label.setString(formatScore(line.score));
+      sf::FloatRect bounds = label.getLocalBounds();
+      sf::Vector2f tip = centerOf(game, circles, line.action.to);
+      label.setPosition(tip.x - bounds.width / 2.f, tip.y + r / 3.f);
+      window.draw(label);
+    }
+    char text[64];
+    std::snprintf(text, sizeof(text), "Analysis: depth %d, %lld nodes",
+                  analysis.depth, static_cast<long long>(analysis.nodes));
+    status.setString(text);
+    status.setPosition(10.f, window.getSize().y - 80.f);
+    window.draw(status);
+  }
+
+  /*!
+   * \brief Writes a score in evaluation units, or a win or loss as the
+   * plies it takes, e.g. "+W3".
+   */
+  static std::string formatScore(int score) {
+    char text[16];
+    if (isWinScore(score)) {
+      std::snprintf(text, sizeof(text), "%cW%d", score > 0 ? '+' : '-',
+                    Evaluator::WIN_SCORE - std::abs(score));
+    } else {
+      std::snprintf(text, sizeof(text), "%+d", score);
+    }
+    return text;
+  }
+
+private:
+  static sf::Vector2f centerOf(const GameState &game,
+                               const std::vector<std::vector<Circle>> &circles,
+                               int cell) {
+    return circles[game.rowOf(cell)][game.colOf(cell)].getCenter();
+  }
+
+  /*!
+   * \brief Appends a shaft and a head, from just off the center of one hex
+   * to just short of the center of the other.
+   */
+  void addArrow(sf::Vector2f from, sf::Vector2f to, float width,
+                sf::Color color) {
+    sf::Vector2f delta = to - from;
+    float length = std::sqrt(delta.x * delta.x + delta.y * delta.y);
+    if (length <= 0.f) {
+      return;
+    }
+    sf::Vector2f along = delta * (1.f / length);
+    sf::Vector2f across(-along.y, along.x);
+    sf::Vector2f start = from + along * (r / 3.f);
+    sf::Vector2f tip = to - along * (r / 4.f);
+    sf::Vector2f neck = tip - along * (width * 3.f);
+    sf::Vector2f side = across * (width / 2.f);
+    sf::Vector2f wing = across * (width * 1.8f);
+    const sf::Vector2f corners[] = {start + side, start - side, neck + side,
+                                    neck + side,  start - side, neck - side,
+                                    neck + wing,  neck - wing,  tip};
+    for (const sf::Vector2f &corner : corners) {
+      arrows.append(sf::Vertex(corner, color));
+    }
+  }
+
+  float r;
+  sf::VertexArray arrows;
+  sf::Text label;
+  sf::Text status;
+  bool visible;
+};
+
+#endif
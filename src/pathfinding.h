@@ -0,0 +1,263 @@
+#ifndef PATHFINDING
+#define PATHFINDING
+
+#include "game.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+/*!
+ * \brief Shortest paths and reachable areas for moving units.
+ *
+ * Steps follow the movement rule of GameState: one step enters a free
+ * adjacent hex, and a unit climbs onto a tall hex from a flat one only by
+ * moving right along its row (PositionBetweenTallandnotTall() in main.cpp),
+ * so the graph is directed. A step costs 1, a climb costs climbCost.
+ *
+ * All per-cell storage is kept between searches and invalidated by bumping
+ * a generation counter, so a search only touches the cells it visits. After
+ * the first search on a board size no search allocates.
+ */
+class PathFinder {
+public:
+  /*!
+   * \brief Constructor for PathFinder with specified parameters.
+   * \param climbCost The cost of stepping from a flat onto a tall hex.
+   */
+  explicit PathFinder(int climbCost = 1)
+      : climbCost(std::max(1, climbCost)), generation(0) {}
+
+  /*!
+   * \brief Gets the distance between two hexes in steps, ignoring terrain
+   * and units.
+   * \param state The board.
+   * \param a The index of the first hex.
+   * \param b The index of the second hex.
+   * \return The number of steps between the hexes on an empty board.
+   */
+  static int hexDistance(const GameState &state, int a, int b) {
+    // Odd rows are shifted right: convert to cube coordinates.
+    int rowA = state.rowOf(a);
+    int rowB = state.rowOf(b);
+    int xA = state.colOf(a) - (rowA - (rowA & 1)) / 2;
+    int xB = state.colOf(b) - (rowB - (rowB & 1)) / 2;
+    int dx = xB - xA;
+    int dz = rowB - rowA;
+    return std::max(std::max(std::abs(dx), std::abs(dz)), std::abs(dx + dz));
+  }
+
+  /*!
+   * \brief Finds a cheapest path with A*.
+   *
+   * Occupied hexes block the way; the start hex may hold the moving unit.
+   * \param state The board.
+   * \param from The index of the start hex.
+   * \param to The index of the goal hex.
+   * \param path Receives the hexes from start to goal, both included.
+   * \return The cost of the path, or -1 if the goal cannot be reached.
+   */
+  int findPath(const GameState &state, int from, int to,
+               std::vector<int> &path) {
+    path.clear();
+    int cells = state.getRows() * state.getCols();
+    if (from < 0 || from >= cells || to < 0 || to >= cells ||
+        (to != from && state.isOccupied(to))) {
+      return -1;
+    }
+    begin(cells);
+    open.clear();
+    visit(from, 0, -1);
+    pushOpen(0, hexDistance(state, from, to), from);
+    const NeighborTable &table = state.getNeighbors();
+    while (!open.empty()) {
+      std::pop_heap(open.begin(), open.end(), std::greater<Entry>());
+      int cell = open.back().cell;
+      open.pop_back();
+      if (closed[cell] == generation) {
+        continue;
+      }
+      closed[cell] = generation;
+      if (cell == to) {
+        for (int step = to; step != -1; step = parent[step]) {
+          path.push_back(step);
+        }
+        std::reverse(path.begin(), path.end());
+        return cost[to];
+      }
+      // Missing neighbors are the sentinel hex, which stepCost() rejects.
+      const std::int32_t *neighbors = table.of(cell);
+      for (int k = 0; k < 6; ++k) {
+        int next = neighbors[k];
+        int step = stepCost(state, cell, next);
+        if (step < 0 || closed[next] == generation) {
+          continue;
+        }
+        int g = cost[cell] + step;
+        if (seen[next] != generation || g < cost[next]) {
+          visit(next, g, cell);
+          pushOpen(g, hexDistance(state, next, to), next);
+        }
+      }
+    }
+    return -1;
+  }
+
+  /*!
+   * \brief Lists the hexes a unit can reach within a movement budget.
+   *
+   * A Dijkstra flood fill with a bucket queue, since step costs are small
+   * integers. Afterwards costTo() and pathTo() answer for any listed hex.
+   * \param state The board.
+   * \param from The index of the start hex.
+   * \param budget The largest total cost allowed.
+   * \param out Receives the reachable hexes in order of cost, without the
+   * start hex.
+   * \return The number of reachable hexes.
+   */
+  int reachable(const GameState &state, int from, int budget,
+                std::vector<int> &out) {
+    out.clear();
+    int cells = state.getRows() * state.getCols();
+    if (from < 0 || from >= cells || budget < 0) {
+      return 0;
+    }
+    begin(cells);
+    // Costs pushed at once differ by at most climbCost, so climbCost + 1
+    // buckets used as a ring hold every pending cost.
+    buckets.resize(climbCost + 1);
+    for (std::vector<int> &bucket : buckets) {
+      bucket.clear();
+    }
+    visit(from, 0, -1);
+    buckets[0].push_back(from);
+    size_t pending = 1;
+    const NeighborTable &table = state.getNeighbors();
+    for (int current = 0; pending > 0 && current <= budget; ++current) {
+      std::vector<int> &bucket = buckets[current % buckets.size()];
+      for (size_t k = 0; k < bucket.size(); ++k) {
+        int cell = bucket[k];
+        if (closed[cell] == generation || cost[cell] != current) {
+          continue;
+        }
+        closed[cell] = generation;
+        if (cell != from) {
+          out.push_back(cell);
+        }
+        const std::int32_t *neighbors = table.of(cell);
+        for (int n = 0; n < 6; ++n) {
+          int next = neighbors[n];
+          int step = stepCost(state, cell, next);
+          int g = current + step;
+          if (step < 0 || g > budget || closed[next] == generation ||
+              (seen[next] == generation && cost[next] <= g)) {
+            continue;
+          }
+          visit(next, g, cell);
+          buckets[g % buckets.size()].push_back(next);
+          ++pending;
+        }
+      }
+      pending -= bucket.size();
+      bucket.clear();
+    }
+    return static_cast<int>(out.size());
+  }
+
+  /*!
+   * \brief Gets the cost of a hex settled by the last search.
+   * \param cell The index of the hex.
+   * \return The cost, or -1 if the hex was not reached.
+   */
+  int costTo(int cell) const {
+    return cell >= 0 && cell < static_cast<int>(closed.size()) &&
+                   closed[cell] == generation
+               ? cost[cell]
+               : -1;
+  }
+
+  /*!
+   * \brief Rebuilds the path to a hex found by the last search.
+   * \param cell The index of the hex.
+   * \param path Receives the hexes from start to the hex, both included, or
+   * nothing if the hex was not reached.
+   */
+  void pathTo(int cell, std::vector<int> &path) const {
+    path.clear();
+    if (costTo(cell) < 0) {
+      return;
+    }
+    for (int step = cell; step != -1; step = parent[step]) {
+      path.push_back(step);
+    }
+    std::reverse(path.begin(), path.end());
+  }
+
+private:
+  /*!
+   * \brief An open hex; among equal totals the one closer to the goal comes
+   * first, which keeps A* from widening over equally good paths.
+   */
+  struct Entry {
+    int priority;
+    int remaining;
+    int cell;
+
+    bool operator>(const Entry &other) const {
+      return priority != other.priority ? priority > other.priority
+                                        : remaining > other.remaining;
+    }
+  };
+
+  /*!
+   * \brief Starts a search: new generation, storage sized to the board.
+   */
+  void begin(int cells) {
+    if (static_cast<int>(seen.size()) != cells) {
+      seen.assign(cells, 0);
+      closed.assign(cells, 0);
+      cost.resize(cells);
+      parent.resize(cells);
+      generation = 0;
+    }
+    if (++generation == 0) {
+      std::fill(seen.begin(), seen.end(), 0);
+      std::fill(closed.begin(), closed.end(), 0);
+      generation = 1;
+    }
+  }
+
+  void visit(int cell, int g, int from) {
+    seen[cell] = generation;
+    cost[cell] = g;
+    parent[cell] = from;
+  }
+
+  void pushOpen(int g, int remaining, int cell) {
+    open.push_back(Entry{g + remaining, remaining, cell});
+    std::push_heap(open.begin(), open.end(), std::greater<Entry>());
+  }
+
+  /*!
+   * \brief Gets the cost of a step between adjacent hexes, -1 if the rules
+   * forbid it.
+   */
+  int stepCost(const GameState &state, int from, int to) const {
+    if (state.isOccupied(to) || !state.canStep(from, to)) {
+      return -1;
+    }
+    return state.isTall(to) && !state.isTall(from) ? climbCost : 1;
+  }
+
+  int climbCost;
+  std::uint32_t generation;
+  std::vector<std::uint32_t> seen;
+  std::vector<std::uint32_t> closed;
+  std::vector<int> cost;
+  std::vector<int> parent;
+  std::vector<Entry> open;
+  std::vector<std::vector<int>> buckets;
+};
+
+#endif
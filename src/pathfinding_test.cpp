@@ -0,0 +1,142 @@
+#include "doctest.h"
+#include "pathfinding.h"
+#include <deque>
+
+/*!
+ * \brief Reference costs from every hex to the start by Bellman-Ford style
+ * relaxation over the same step rules.
+ */
+static std::vector<int> referenceCosts(const GameState &state, int from, int climbCost) {
+    int cells = state.getRows() * state.getCols();
+    std::vector<int> cost(cells, -1);
+    cost[from] = 0;
+    bool changed = true;
+    int neighbors[6];
+    while (changed) {
+        changed = false;
+        for (int cell = 0; cell < cells; ++cell) {
+            if (cost[cell] < 0) {
+                continue;
+            }
+            int count = state.neighbors(cell, neighbors);
+            for (int k = 0; k < count; ++k) {
+                int next = neighbors[k];
+                if (state.isOccupied(next) || !state.canStep(cell, next)) {
+                    continue;
+                }
+                int step = state.isTall(next) && !state.isTall(cell) ? climbCost : 1;
+                if (cost[next] < 0 || cost[cell] + step < cost[next]) {
+                    cost[next] = cost[cell] + step;
+                    changed = true;
+                }
+            }
+        }
+    }
+    return cost;
+}
+
+static GameState randomBoard(int size, std::uint32_t seed) {
+    GameState state(size, size, size * size);
+    state.generateTall(seed, size * size / 3);
+    std::mt19937 rng(seed);
+    for (int cell = 0; cell < size * size; ++cell) {
+        if (rng() % 6 == 0) {
+            std::vector<Unit> armies[2];
+            for (int player = 0; player < 2; ++player) {
+                armies[player] = state.getUnits(player);
+            }
+            armies[rng() % 2].push_back(Unit{0, 10, cell});
+            state.restore(armies, 0, false, 0);
+        }
+    }
+    return state;
+}
+
+TEST_CASE("PathFinder Class: Hex Distance Counts Steps") {
+    GameState state(6, 6, 3);
+    int neighbors[6];
+    for (int cell = 0; cell < 36; ++cell) {
+        CHECK(PathFinder::hexDistance(state, cell, cell) == 0);
+        int count = state.neighbors(cell, neighbors);
+        for (int k = 0; k < count; ++k) {
+            REQUIRE(PathFinder::hexDistance(state, cell, neighbors[k]) == 1);
+        }
+    }
+    // On an empty flat board the distance is the length of a shortest path.
+    PathFinder finder;
+    std::vector<int> path;
+    for (int to = 0; to < 36; ++to) {
+        REQUIRE(finder.findPath(state, 0, to, path) == PathFinder::hexDistance(state, 0, to));
+    }
+}
+
+TEST_CASE("PathFinder Class: Paths Are Cheapest And Legal") {
+    for (int climbCost = 1; climbCost <= 3; ++climbCost) {
+        PathFinder finder(climbCost);
+        for (std::uint32_t seed = 0; seed < 10; ++seed) {
+            GameState state = randomBoard(12, seed);
+            int from = 0;
+            while (state.isOccupied(from)) {
+                ++from;
+            }
+            std::vector<int> expected = referenceCosts(state, from, climbCost);
+            std::vector<int> path;
+            for (int to = 0; to < 144; ++to) {
+                int cost = finder.findPath(state, from, to, path);
+                if (to != from && state.isOccupied(to)) {
+                    REQUIRE(cost == -1);
+                    continue;
+                }
+                REQUIRE(cost == expected[to]);
+                if (cost < 0) {
+                    REQUIRE(path.empty());
+                    continue;
+                }
+                REQUIRE(path.front() == from);
+                REQUIRE(path.back() == to);
+                for (size_t k = 1; k < path.size(); ++k) {
+                    REQUIRE(state.isAdjacent(path[k - 1], path[k]));
+                    REQUIRE(state.canStep(path[k - 1], path[k]));
+                    REQUIRE_FALSE(state.isOccupied(path[k]));
+                }
+            }
+
+            std::vector<int> area;
+            int budget = 4 + static_cast<int>(seed % 3);
+            finder.reachable(state, from, budget, area);
+            size_t within = 0;
+            for (int cell = 0; cell < 144; ++cell) {
+                if (cell != from && expected[cell] >= 0 && expected[cell] <= budget) {
+                    ++within;
+                    REQUIRE(finder.costTo(cell) == expected[cell]);
+                    finder.pathTo(cell, path);
+                    REQUIRE(path.size() >= 2);
+                    REQUIRE(path.front() == from);
+                }
+            }
+            REQUIRE(area.size() == within);
+            for (size_t k = 1; k < area.size(); ++k) {
+                REQUIRE(finder.costTo(area[k - 1]) <= finder.costTo(area[k]));
+            }
+        }
+    }
+}
+
+TEST_CASE("PathFinder Class: Tall Hexes Are Climbed Only Rightwards") {
+    GameState state(3, 5, 3);
+    for (int row = 0; row < 3; ++row) {
+        state.setTall(state.cellIndex(row, 2), true);
+    }
+    PathFinder finder;
+    std::vector<int> path;
+    // From the left the wall is climbed in one step; from the right it is not.
+    CHECK(finder.findPath(state, state.cellIndex(1, 1), state.cellIndex(1, 2), path) == 1);
+    CHECK(finder.findPath(state, state.cellIndex(1, 3), state.cellIndex(1, 2), path) == -1);
+    CHECK(finder.findPath(state, state.cellIndex(1, 3), state.cellIndex(1, 1), path) == -1);
+    CHECK(finder.findPath(state, state.cellIndex(1, 0), state.cellIndex(1, 4), path) == 4);
+
+    std::vector<int> area;
+    finder.reachable(state, state.cellIndex(1, 4), 10, area);
+    CHECK(area.size() == 5);
+    CHECK(finder.costTo(state.cellIndex(1, 2)) == -1);
+}
@@ -0,0 +1,561 @@
+#ifndef PLACEMENT_BOOK
+#define PLACEMENT_BOOK
+
+#include "evaluation.h"
+#include "game.h"
+#include "mapped_file.h"
+#include "search.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/*!
+ * \brief The settings of PlacementBook::build().
+ */
+struct BookSettings {
+  /*!
+   * \brief The partial deployments kept after placing each unit.
+   */
+  int beam = 16;
+  /*!
+   * \brief The complete deployments searched for each entry; as many blind
+   * deployments of each side get an answer in the book.
+   */
+  int candidates = 4;
+  /*!
+   * \brief The random enemy deployments a blind deployment is screened
+   * against.
+   */
+  int samples = 8;
+  /*!
+   * \brief The alpha-beta depth of the battle starting positions.
+   */
+  int depth = 2;
+  std::uint32_t seed = 1;
+};
+
+/*!
+ * \brief A deployment found in a placement book.
+ */
+struct BookEntry {
+  /*!
+   * \brief The PlaceUnit actions of the deployment.
+   */
+  std::vector<Action> actions;
+  /*!
+   * \brief The alpha-beta score of the battle start for the deploying
+   * player, against the enemy deployment of a reply or the enemy's best
+   * answer of a blind deployment.
+   */
+  int score = 0;
+  /*!
+   * \brief True if the entry answers the enemy deployment on the board,
+   * false for the blind deployment of the map.
+   */
+  bool reply = false;
+};
+
+/*!
+ * \brief The layout of placement book files.
+ *
+ * File, little-endian: "SPB1", u16 record size, u16 units per record, u32
+ * record count, u32 reserved; then fixed-size records sorted by map key,
+ * unit limit, player and enemy key. A record: u64 map key, u8 unit limit
+ * (maxNPC), u8 player, u8 unit count, u8 reserved, i32 score, u64 enemy
+ * deployment key (0 for a blind deployment), then per unit a u16 hex * 4
+ * + type, unused ones 0.
+ */
+struct BookFormat {
+  static const int MAX_UNITS = 8;
+  static const size_t HEADER_SIZE = 16;
+  static const size_t RECORD_SIZE = 24 + 2 * MAX_UNITS;
+};
+
+/*!
+ * \brief Precomputed deployments, so that an AI deploys without searching.
+ *
+ * Entries are keyed by the map (board size, tall hexes and unit
+ * statistics), the unit limit, the deploying player and the enemy units
+ * already deployed. build() gives each map a blind deployment per player
+ * and, for the strongest blind deployments of each player, the best answer
+ * of the other. lookup() is a binary search over a mapped file, falling
+ * back to the blind deployment when the enemy deployment is not in the
+ * book.
+ */
+class PlacementBook {
+public:
+  PlacementBook() : count(0) {}
+
+  PlacementBook(const PlacementBook &) = delete;
+  PlacementBook &operator=(const PlacementBook &) = delete;
+
+  ~PlacementBook() { close(); }
+
+  /*!
+   * \brief Gets the key of the map of a state; units are ignored.
+   */
+  static std::uint64_t mapKey(const GameState &board) {
+    std::uint64_t key = mix((static_cast<std::uint64_t>(board.getRows())
+                             << 16) |
+                            static_cast<std::uint64_t>(board.getCols()));
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+      const UnitStats &stats = board.getUnitStats(type);
+      key = mix(key ^ static_cast<std::uint32_t>(stats.HP));
+      key = mix(key ^ static_cast<std::uint32_t>(stats.attack_diapason));
+      key = mix(key ^ static_cast<std::uint32_t>(stats.attack));
+      key = mix(key ^ static_cast<std::uint32_t>(stats.healAmount));
+    }
+    for (int cell = 0; cell < board.getRows() * board.getCols(); ++cell) {
+      if (board.isTall(cell)) {
+        key = mix(key ^ static_cast<std::uint64_t>(cell + 1));
+      }
+    }
+    return key;
+  }
+
+  /*!
+   * \brief Gets the key of a deployment: its hexes and types, in any
+   * order. 0 only for no units.
+   */
+  static std::uint64_t deploymentKey(const std::vector<Unit> &units) {
+    std::uint64_t key = 0;
+    for (const Unit &unit : units) {
+      key ^= mix(static_cast<std::uint64_t>(unitCode(unit.cell, unit.type)) +
+                 0x9E3779B97F4A7C15ull);
+    }
+    return key;
+  }
+
+  /*!
+   * \brief Builds the book of a set of maps, one pool task per map.
+   * \param maps Deployment-phase states giving the maps and unit limits;
+   * their units are ignored. Limits above BookFormat::MAX_UNITS are
+   * skipped.
+   * \param settings The search settings.
+   * \param pool The workers.
+   * \param out Receives the file contents.
+   */
+  static void build(const std::vector<GameState> &maps,
+                    const BookSettings &settings, ThreadPool &pool,
+                    std::vector<std::uint8_t> &out) {
+    std::vector<std::vector<Record>> perMap(maps.size());
+    for (size_t k = 0; k < maps.size(); ++k) {
+      if (maps[k].getMaxNPC() < 1 ||
+          maps[k].getMaxNPC() > BookFormat::MAX_UNITS) {
+        continue;
+      }
+      pool.post([&maps, &settings, &perMap, k] {
+        Builder builder(maps[k], settings);
+        builder.run(perMap[k]);
+      });
+    }
+    pool.wait();
+
+    std::vector<Record> records;
+    for (std::vector<Record> &part : perMap) {
+      records.insert(records.end(), part.begin(), part.end());
+    }
+    // Maps drawn twice keep their first entries.
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record &a, const Record &b) {
+                       return a.sortKey() < b.sortKey();
+                     });
+    records.erase(std::unique(records.begin(), records.end(),
+                              [](const Record &a, const Record &b) {
+                                return a.sortKey() == b.sortKey();
+                              }),
+                  records.end());
+
+    out.assign(BookFormat::HEADER_SIZE +
+                   records.size() * BookFormat::RECORD_SIZE,
+               0);
+    std::memcpy(out.data(), "SPB1", 4);
+    putLE(out.data() + 4, BookFormat::RECORD_SIZE, 2);
+    putLE(out.data() + 6, BookFormat::MAX_UNITS, 2);
+    putLE(out.data() + 8, records.size(), 4);
+    std::uint8_t *field = out.data() + BookFormat::HEADER_SIZE;
+    for (const Record &record : records) {
+      putLE(field, record.map, 8);
+      field[8] = static_cast<std::uint8_t>(record.limit);
+      field[9] = static_cast<std::uint8_t>(record.player);
+      field[10] = static_cast<std::uint8_t>(record.codes.size());
+      putLE(field + 12, static_cast<std::uint32_t>(record.score), 4);
+      putLE(field + 16, record.enemy, 8);
+      for (size_t k = 0; k < record.codes.size(); ++k) {
+        putLE(field + 24 + 2 * k, record.codes[k], 2);
+      }
+      field += BookFormat::RECORD_SIZE;
+    }
+  }
+
+  /*!
+   * \brief Writes built contents to a file.
+   * \param bytes The contents from build().
+   * \param path The path of the file.
+   * \return False if the file cannot be written.
+   */
+  static bool save(const std::vector<std::uint8_t> &bytes,
+                   const std::string &path) {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    bool written =
+        std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && written;
+  }
+
+  /*!
+   * \brief Maps a book file.
+   * \param path The path of the file.
+   * \return False if the file is missing or malformed.
+   */
+  bool open(const std::string &path) {
+    close();
+    return file.open(path) && readHeader();
+  }
+
+  /*!
+   * \brief Uses contents held in memory, e.g. straight from build().
+   * \param bytes The contents.
+   * \return False if they are malformed.
+   */
+  bool assign(std::vector<std::uint8_t> bytes) {
+    close();
+    file.assign(std::move(bytes));
+    return readHeader();
+  }
+
+  /*!
+   * \brief Releases the book.
+   */
+  void close() {
+    file.close();
+    count = 0;
+  }
+
+  /*!
+   * \brief Gets the size of the contents in bytes.
+   */
+  size_t bytes() const { return file.size(); }
+
+  /*!
+   * \brief Gets the number of deployments in the book.
+   */
+  size_t entries() const { return count; }
+
+  /*!
+   * \brief Finds the deployment of a player.
+   * \param state A deployment-phase position where the player has no unit
+   * yet.
+   * \param player The deploying player.
+   * \param entry Receives the deployment.
+   * \return False if the book has neither an answer to the enemy units on
+   * the board nor a blind deployment for the map and unit limit.
+   */
+  bool lookup(const GameState &state, int player, BookEntry &entry) const {
+    if (file.data() == nullptr || !state.isPlacement() || player < 0 ||
+        player > 1 || !state.getUnits(player).empty()) {
+      return false;
+    }
+    std::uint64_t map = mapKey(state);
+    std::uint64_t enemy = deploymentKey(state.getUnits(1 - player));
+    int limit = state.getMaxNPC();
+    size_t index = 0;
+    entry.reply = enemy != 0 && find(map, limit, player, enemy, index);
+    if (!entry.reply && !find(map, limit, player, 0, index)) {
+      return false;
+    }
+    const std::uint8_t *record = file.data() + BookFormat::HEADER_SIZE +
+                                 index * BookFormat::RECORD_SIZE;
+    entry.score = static_cast<std::int32_t>(
+        static_cast<std::uint32_t>(getLE(record + 12, 4)));
+    entry.actions.clear();
+    for (int k = 0; k < record[10]; ++k) {
+      int code = static_cast<int>(getLE(record + 24 + 2 * k, 2));
+      entry.actions.push_back(GameState::makeAction(
+          PlaceUnit, player, code & 3, -1, code >> 2));
+    }
+    return true;
+  }
+
+private:
+  /*!
+   * \brief A deployment as sorted unit codes.
+   */
+  typedef std::vector<std::uint16_t> Deployment;
+
+  struct Record {
+    std::uint64_t map;
+    int limit;
+    int player;
+    std::uint64_t enemy;
+    int score;
+    Deployment codes;
+
+    std::tuple<std::uint64_t, int, int, std::uint64_t> sortKey() const {
+      return std::make_tuple(map, limit, player, enemy);
+    }
+  };
+
+  static_assert(UNIT_TYPES <= 4, "unit codes keep the type in 2 bits");
+
+  static std::uint16_t unitCode(int cell, int type) {
+    return static_cast<std::uint16_t>(cell * 4 + type);
+  }
+
+  /*!
+   * \brief The splitmix64 finalizer.
+   */
+  static std::uint64_t mix(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+
+  /*!
+   * \brief Binary-searches the records for a key.
+   * \param index Receives the index of the record when found.
+   */
+  bool find(std::uint64_t map, int limit, int player, std::uint64_t enemy,
+            size_t &index) const {
+    auto wanted = std::make_tuple(map, limit, player, enemy);
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      if (keyAt(middle) < wanted) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    index = low;
+    return low < count && keyAt(low) == wanted;
+  }
+
+  std::tuple<std::uint64_t, int, int, std::uint64_t>
+  keyAt(size_t index) const {
+    const std::uint8_t *record = file.data() + BookFormat::HEADER_SIZE +
+                                 index * BookFormat::RECORD_SIZE;
+    return std::make_tuple(getLE(record, 8),
+                           static_cast<int>(record[8]),
+                           static_cast<int>(record[9]),
+                           getLE(record + 16, 8));
+  }
+
+  bool readHeader() {
+    const std::uint8_t *base = file.data();
+    size_t size = file.size();
+    if (size < BookFormat::HEADER_SIZE ||
+        std::memcmp(base, "SPB1", 4) != 0 ||
+        getLE(base + 4, 2) != BookFormat::RECORD_SIZE ||
+        getLE(base + 6, 2) != BookFormat::MAX_UNITS) {
+      close();
+      return false;
+    }
+    size_t records = getLE(base + 8, 4);
+    if (size != BookFormat::HEADER_SIZE + records * BookFormat::RECORD_SIZE) {
+      close();
+      return false;
+    }
+    count = records;
+    return true;
+  }
+
+  /*!
+   * \brief The search behind build() for one map.
+   *
+   * Deployments grow one unit at a time in a beam ranked by the static
+   * evaluation of the battle start; the survivors are ranked by alpha-beta.
+   * A blind deployment is screened against random enemy deployments and
+   * chosen by the score of the enemy's best answer.
+   */
+  class Builder {
+  public:
+    Builder(const GameState &board, const BookSettings &settings)
+        : board(board), settings(settings), map(mapKey(board)), state(board),
+          search(14) {
+      limits.depth = std::max(settings.depth, 1);
+      for (int cell = 0; cell < board.getRows() * board.getCols(); ++cell) {
+        for (int player = 0; player < 2; ++player) {
+          if (board.isDeploymentColumn(player, board.colOf(cell))) {
+            zone[player].push_back(cell);
+          }
+        }
+      }
+    }
+
+    void run(std::vector<Record> &out) {
+      std::mt19937 rng(settings.seed ^ static_cast<std::uint32_t>(map));
+      std::vector<Deployment> samples[2];
+      for (int player = 0; player < 2; ++player) {
+        for (int k = 0; k < std::max(settings.samples, 1); ++k) {
+          samples[player].push_back(randomDeployment(player, rng));
+        }
+      }
+      for (int player = 0; player < 2; ++player) {
+        int other = 1 - player;
+        Deployment best;
+        int bestScore = 0;
+        for (const Deployment &candidate : grow(player, samples[other])) {
+          int answerScore = 0;
+          Deployment answer = bestAnswer(other, candidate, answerScore);
+          out.push_back(Record{map, board.getMaxNPC(), other,
+                               deploymentKey(unitsOf(candidate)), answerScore,
+                               answer});
+          if (best.empty() || -answerScore > bestScore) {
+            best = candidate;
+            bestScore = -answerScore;
+          }
+        }
+        if (!best.empty()) {
+          out.push_back(
+              Record{map, board.getMaxNPC(), player, 0, bestScore, best});
+        }
+      }
+    }
+
+  private:
+    struct Scored {
+      Deployment codes;
+      long long score;
+    };
+
+    std::vector<Unit> unitsOf(const Deployment &codes) const {
+      std::vector<Unit> units;
+      for (std::uint16_t code : codes) {
+        int type = code & 3;
+        units.push_back(Unit{type, board.getUnitStats(type).HP, code >> 2});
+      }
+      return units;
+    }
+
+    /*!
+     * \brief Scores the battle start for a player, statically or with
+     * alpha-beta; player 0 moves first.
+     */
+    int scoreOf(int player, const Deployment &own, const Deployment &enemy,
+                bool searched) {
+      std::vector<Unit> armies[2];
+      armies[player] = unitsOf(own);
+      armies[1 - player] = unitsOf(enemy);
+      state = board;
+      state.restore(armies, 0, false, 0);
+      int score = searched ? search.search(state, limits).score
+                           : evaluator.evaluate(state);
+      return player == 0 ? score : -score;
+    }
+
+    Deployment randomDeployment(int player, std::mt19937 &rng) const {
+      std::vector<int> cells = zone[player];
+      Deployment codes;
+      int units = std::min(board.getMaxNPC(), static_cast<int>(cells.size()));
+      for (int k = 0; k < units; ++k) {
+        std::swap(cells[k], cells[k + rng() % (cells.size() - k)]);
+        int type = static_cast<int>(rng() % UNIT_TYPES);
+        codes.push_back(unitCode(cells[k], type));
+      }
+      std::sort(codes.begin(), codes.end());
+      return codes;
+    }
+
+    /*!
+     * \brief Grows deployments of a player in a beam.
+     * \param enemies The enemy deployments a deployment is scored against.
+     * \return The best settings.candidates complete deployments.
+     */
+    std::vector<Deployment> grow(int player,
+                                 const std::vector<Deployment> &enemies) {
+      std::vector<Scored> beam(1);
+      int units = std::min(board.getMaxNPC(),
+                           static_cast<int>(zone[player].size()));
+      for (int placed = 0; placed < units; ++placed) {
+        std::vector<Scored> next;
+        for (const Scored &partial : beam) {
+          for (int cell : zone[player]) {
+            if (std::any_of(partial.codes.begin(), partial.codes.end(),
+                            [cell](std::uint16_t code) {
+                              return code >> 2 == cell;
+                            })) {
+              continue;
+            }
+            for (int type = 0; type < UNIT_TYPES; ++type) {
+              Scored grown{partial.codes, 0};
+              grown.codes.push_back(unitCode(cell, type));
+              std::sort(grown.codes.begin(), grown.codes.end());
+              next.push_back(grown);
+            }
+          }
+        }
+        std::sort(next.begin(), next.end(),
+                  [](const Scored &a, const Scored &b) {
+                    return a.codes < b.codes;
+                  });
+        next.erase(std::unique(next.begin(), next.end(),
+                               [](const Scored &a, const Scored &b) {
+                                 return a.codes == b.codes;
+                               }),
+                   next.end());
+        for (Scored &grown : next) {
+          for (const Deployment &enemy : enemies) {
+            grown.score += scoreOf(player, grown.codes, enemy, false);
+          }
+        }
+        std::stable_sort(next.begin(), next.end(),
+                         [](const Scored &a, const Scored &b) {
+                           return a.score > b.score;
+                         });
+        next.resize(std::min(next.size(),
+                             static_cast<size_t>(std::max(settings.beam, 1))));
+        beam.swap(next);
+      }
+      std::vector<Deployment> best;
+      for (size_t k = 0;
+           k < beam.size() &&
+           k < static_cast<size_t>(std::max(settings.candidates, 1));
+           ++k) {
+        best.push_back(beam[k].codes);
+      }
+      return best;
+    }
+
+    /*!
+     * \brief Finds a player's best answer to an enemy deployment.
+     * \param score Receives its alpha-beta score.
+     */
+    Deployment bestAnswer(int player, const Deployment &enemy, int &score) {
+      Deployment best;
+      for (const Deployment &candidate :
+           grow(player, std::vector<Deployment>(1, enemy))) {
+        int value = scoreOf(player, candidate, enemy, true);
+        if (best.empty() || value > score) {
+          best = candidate;
+          score = value;
+        }
+      }
+      return best;
+    }
+
+    GameState board;
+    BookSettings settings;
+    std::uint64_t map;
+    std::vector<int> zone[2];
+    GameState state;
+    Evaluator evaluator;
+    AlphaBetaSearch search;
+    SearchLimits limits;
+  };
+
+  MappedFile file;
+  size_t count;
+};
+
+#endif
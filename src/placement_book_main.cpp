@@ -0,0 +1,120 @@
+/*!
+ * \file placement_book_main.cpp
+ * \brief Builds the placement book of a range of seeded maps
+ *
+ * Map k is the one GameState::generateTall() raises for seed + k, as in
+ * tournament pair k, so a book for a tournament's seeds is built with
+ *   strateg_book --seed=1 --maps=200 --units=3 --out=book.spb --threads=8
+ * and used with "ab:depth=3,book=book.spb".
+ */
+
+#include "placement_book.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+  int rows = 8;
+  int cols = 8;
+  int units = 3;
+  int tall = 4;
+  int maps = 100;
+  std::uint32_t seed = 1;
+  int threads = 0;
+  BookSettings settings;
+  std::string out = "placements.spb";
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string text = arg.substr(arg.find('=') + 1);
+    int value = std::atoi(text.c_str());
+    if (arg.rfind("--rows=", 0) == 0) {
+      rows = value;
+    } else if (arg.rfind("--cols=", 0) == 0) {
+      cols = value;
+    } else if (arg.rfind("--units=", 0) == 0) {
+      units = value;
+    } else if (arg.rfind("--tall=", 0) == 0) {
+      tall = value;
+    } else if (arg.rfind("--maps=", 0) == 0) {
+      maps = value;
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      seed = static_cast<std::uint32_t>(value);
+    } else if (arg.rfind("--beam=", 0) == 0) {
+      settings.beam = value;
+    } else if (arg.rfind("--candidates=", 0) == 0) {
+      settings.candidates = value;
+    } else if (arg.rfind("--samples=", 0) == 0) {
+      settings.samples = value;
+    } else if (arg.rfind("--depth=", 0) == 0) {
+      settings.depth = value;
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = value;
+    } else if (arg.rfind("--out=", 0) == 0) {
+      out = text;
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+  if (rows <= 0 || cols <= 0 || maps <= 0 || units < 1 ||
+      units > BookFormat::MAX_UNITS) {
+    std::cerr << "Expected positive sizes and 1 to " << BookFormat::MAX_UNITS
+              << " units" << std::endl;
+    return 2;
+  }
+
+  std::vector<GameState> boards;
+  for (int k = 0; k < maps; ++k) {
+    boards.emplace_back(rows, cols, units);
+    boards.back().generateTall(seed + static_cast<std::uint32_t>(k), tall);
+  }
+  ThreadPool pool(threads);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::uint8_t> bytes;
+  PlacementBook::build(boards, settings, pool, bytes);
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  if (!PlacementBook::save(bytes, out)) {
+    std::cerr << "Cannot write " << out << std::endl;
+    return 1;
+  }
+  PlacementBook book;
+  if (!book.open(out)) {
+    std::cerr << "Cannot read back " << out << std::endl;
+    return 1;
+  }
+
+  // Deploy both players from the book on every map, as a tournament does.
+  int answered = 0;
+  long long total = 0;
+  start = std::chrono::steady_clock::now();
+  for (const GameState &board : boards) {
+    GameState state = board;
+    for (int player = 0; player < 2; ++player) {
+      BookEntry entry;
+      if (!book.lookup(state, player, entry)) {
+        std::cerr << "No deployment for map " << &board - &boards[0]
+                  << std::endl;
+        return 1;
+      }
+      for (const Action &action : entry.actions) {
+        state.apply(action);
+      }
+      answered += entry.reply ? 1 : 0;
+      total += player == 0 ? entry.score : 0;
+    }
+  }
+  double lookup = std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count() /
+                  (2 * maps);
+  std::cout << "Built " << out << " in " << seconds << " s on "
+            << pool.size() << " threads: " << book.entries()
+            << " deployments in " << book.bytes() << " bytes" << std::endl;
+  std::cout << "Player 1 answers found on " << answered << " of " << maps
+            << " maps; mean player 0 score " << total / maps
+            << "; lookup and deploy " << lookup << " us" << std::endl;
+  return answered == maps ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include "doctest.h"
+#include "placement_book.h"
+#include "tournament.h"
+#include <cstdio>
+
+static const char *TEST_FILE = "placement_book_test.spb";
+
+static std::vector<GameState> seededMaps(int count, int maxNPC) {
+    std::vector<GameState> maps;
+    for (int seed = 1; seed <= count; ++seed) {
+        maps.emplace_back(8, 8, maxNPC);
+        maps.back().generateTall(static_cast<std::uint32_t>(seed), 4);
+    }
+    return maps;
+}
+
+static BookSettings quickSettings() {
+    BookSettings settings;
+    settings.beam = 6;
+    settings.candidates = 3;
+    settings.samples = 3;
+    settings.depth = 1;
+    return settings;
+}
+
+static void applyEntry(GameState &state, const BookEntry &entry) {
+    for (const Action &action : entry.actions) {
+        REQUIRE(state.apply(action));
+    }
+}
+
+TEST_CASE("PlacementBook Class: Keys Ignore Order And Follow The Map") {
+    std::vector<Unit> units = {Unit{0, 50, 8}, Unit{2, 40, 17}, Unit{1, 30, 1}};
+    std::vector<Unit> shuffled = {units[2], units[0], units[1]};
+    CHECK(PlacementBook::deploymentKey(units) == PlacementBook::deploymentKey(shuffled));
+    CHECK(PlacementBook::deploymentKey(std::vector<Unit>()) == 0);
+    units[1].type = 1;
+    CHECK(PlacementBook::deploymentKey(units) != PlacementBook::deploymentKey(shuffled));
+
+    GameState board(8, 8, 3);
+    board.generateTall(5, 4);
+    GameState same(8, 8, 3);
+    same.generateTall(5, 4);
+    CHECK(PlacementBook::mapKey(board) == PlacementBook::mapKey(same));
+    same.setTall(same.cellIndex(0, 0), !same.isTall(same.cellIndex(0, 0)));
+    CHECK(PlacementBook::mapKey(board) != PlacementBook::mapKey(same));
+    GameState stronger = board;
+    UnitStats archer = defaultUnitStats(1);
+    archer.attack += 1;
+    stronger.setUnitStats(1, archer);
+    CHECK(PlacementBook::mapKey(board) != PlacementBook::mapKey(stronger));
+}
+
+TEST_CASE("PlacementBook Class: Answers The Deployments It Plays") {
+    std::vector<GameState> maps = seededMaps(3, 3);
+    ThreadPool pool(2);
+    std::vector<std::uint8_t> bytes;
+    BookSettings settings = quickSettings();
+    PlacementBook::build(maps, settings, pool, bytes);
+    PlacementBook book;
+    REQUIRE(book.assign(bytes));
+    // Per map and player, a blind deployment and answers to 3 of the other.
+    CHECK(book.entries() == 3 * 2 * (1 + 3));
+
+    for (const GameState &map : maps) {
+        GameState state = map;
+        BookEntry first;
+        REQUIRE(book.lookup(state, 0, first));
+        CHECK_FALSE(first.reply);
+        CHECK(first.actions.size() == 3);
+        BookEntry again;
+        REQUIRE(book.lookup(state, 1, again));
+        CHECK_FALSE(again.reply);
+        applyEntry(state, first);
+        CHECK_FALSE(book.lookup(state, 0, again));
+
+        BookEntry answer;
+        REQUIRE(book.lookup(state, 1, answer));
+        CHECK(answer.reply);
+        // The blind deployment is scored by the best answer to it.
+        CHECK(answer.score == -first.score);
+        applyEntry(state, answer);
+        CHECK(state.apply(GameState::makeAction(FinishPlacement, 0, 0, -1, -1)));
+    }
+
+    // An enemy deployment outside the book falls back to the blind one.
+    GameState state = maps[0];
+    state.apply(GameState::makeAction(PlaceUnit, 0, 2, -1, state.cellIndex(7, 1)));
+    BookEntry fallback;
+    REQUIRE(book.lookup(state, 1, fallback));
+    CHECK_FALSE(fallback.reply);
+
+    GameState unknown(8, 8, 3);
+    unknown.generateTall(99, 4);
+    BookEntry none;
+    CHECK_FALSE(book.lookup(unknown, 0, none));
+    CHECK_FALSE(book.lookup(seededMaps(1, 2)[0], 0, none));
+}
+
+TEST_CASE("PlacementBook Class: Files Map And Agents Deploy From Them") {
+    std::vector<GameState> maps = seededMaps(2, 2);
+    ThreadPool pool(1);
+    std::vector<std::uint8_t> bytes;
+    PlacementBook::build(maps, quickSettings(), pool, bytes);
+    REQUIRE(PlacementBook::save(bytes, TEST_FILE));
+    PlacementBook mapped;
+    REQUIRE(mapped.open(TEST_FILE));
+    CHECK(mapped.bytes() == bytes.size());
+
+    AgentConfig config;
+    REQUIRE(parseAgent(std::string("greedy:book=") + TEST_FILE, config));
+    Agent agent(config);
+    REQUIRE(agent.isReady());
+    GameState state = maps[1];
+    BookEntry entry;
+    REQUIRE(mapped.lookup(state, 0, entry));
+    REQUIRE(agent.deploy(state, 0));
+    REQUIRE(state.getUnits(0).size() == entry.actions.size());
+    for (size_t k = 0; k < entry.actions.size(); ++k) {
+        CHECK(state.getUnits(0)[k].cell == entry.actions[k].to);
+        CHECK(state.getUnits(0)[k].type == entry.actions[k].unitType);
+    }
+    CHECK_FALSE(agent.deploy(state, 0));
+
+    CHECK_FALSE(mapped.open("missing.spb"));
+    bytes[0] = 'X';
+    CHECK_FALSE(mapped.assign(bytes));
+    config.book = "missing.spb";
+    CHECK_FALSE(Agent(config).isReady());
+    std::remove(TEST_FILE);
+}
@@ -0,0 +1,194 @@
+#ifndef PROFILER
+#define PROFILER
+
+#include "trace.h"
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Collects named timing samples and keeps rolling statistics for them.
+ *
+ * Every section keeps the last windowSize samples for percentiles plus
+ * running totals for the whole session. A Profiler is meant to be fed from
+ * one thread (the game loop).
+ */
+class Profiler {
+public:
+  /*!
+   * \brief Constructor for Profiler with specified parameters.
+   * \param windowSize The number of recent samples used for percentiles.
+   */
+  explicit Profiler(size_t windowSize = 256)
+      : windowSize(std::max<size_t>(windowSize, 1)) {}
+
+  /*!
+   * \brief Finds a section by name, registering it on first use.
+   * \param name The name of the section.
+   * \return The index of the section, to be passed to record().
+   */
+  int section(const std::string &name) {
+    for (size_t k = 0; k < sections.size(); ++k) {
+      if (sections[k].name == name) {
+        return static_cast<int>(k);
+      }
+    }
+    sections.push_back(Section{name, Trace::intern(name), {}, 0, 0, 0.0, 0.0});
+    sections.back().window.reserve(windowSize);
+    return static_cast<int>(sections.size() - 1);
+  }
+
+  /*!
+   * \brief Adds one timing sample to a section.
+   * \param index The index of the section.
+   * \param ms The measured duration in milliseconds.
+   */
+  void record(int index, double ms) {
+    Section &s = sections[index];
+    if (s.window.size() < windowSize) {
+      s.window.push_back(static_cast<float>(ms));
+    } else {
+      s.window[s.next] = static_cast<float>(ms);
+    }
+    s.next = (s.next + 1) % windowSize;
+    s.count += 1;
+    s.total += ms;
+    s.max = std::max(s.max, ms);
+  }
+
+  /*!
+   * \brief Computes a percentile over the recent samples of a section.
+   * \param index The index of the section.
+   * \param p The percentile in the range [0, 100].
+   * \return The percentile in milliseconds, 0 if there are no samples.
+   */
+  double percentile(int index, double p) const {
+    const std::vector<float> &window = sections[index].window;
+    if (window.empty()) {
+      return 0.0;
+    }
+    scratch.assign(window.begin(), window.end());
+    size_t rank = static_cast<size_t>(p / 100.0 * (scratch.size() - 1) + 0.5);
+    std::nth_element(scratch.begin(), scratch.begin() + rank, scratch.end());
+    return scratch[rank];
+  }
+
+  /*!
+   * \brief Gets the mean of all samples recorded for a section.
+   * \param index The index of the section.
+   * \return The session mean in milliseconds.
+   */
+  double mean(int index) const {
+    const Section &s = sections[index];
+    return s.count == 0 ? 0.0 : s.total / s.count;
+  }
+
+  /*!
+   * \brief Gets the number of samples recorded for a section.
+   * \param index The index of the section.
+   * \return The number of samples since the section was registered.
+   */
+  unsigned long sampleCount(int index) const { return sections[index].count; }
+
+  /*!
+   * \brief Gets the number of registered sections.
+   * \return The number of sections.
+   */
+  int sectionCount() const { return static_cast<int>(sections.size()); }
+
+  /*!
+   * \brief Gets the name of a section.
+   * \param index The index of the section.
+   * \return The name the section was registered with.
+   */
+  const std::string &sectionName(int index) const {
+    return sections[index].name;
+  }
+
+  /*!
+   * \brief Gets the name of a section as recorded in the trace.
+   * \param index The index of the section.
+   * \return The interned name, valid for the whole run.
+   */
+  const char *traceName(int index) const { return sections[index].traceName; }
+
+  /*!
+   * \brief Writes the statistics of every section to a CSV file.
+   * \param path The path of the file to write.
+   * \return True if the file was written, false otherwise.
+   */
+  bool writeCsv(const std::string &path) const {
+    std::ofstream out(path);
+    if (!out) {
+      return false;
+    }
+    out << "section,count,mean_ms,p50_ms,p99_ms,max_ms\n";
+    for (int k = 0; k < sectionCount(); ++k) {
+      out << sections[k].name << ',' << sections[k].count << ',' << mean(k)
+          << ',' << percentile(k, 50) << ',' << percentile(k, 99) << ','
+          << sections[k].max << '\n';
+    }
+    return static_cast<bool>(out);
+  }
+
+private:
+  struct Section {
+    std::string name;
+    const char *traceName;
+    std::vector<float> window;
+    size_t next;
+    unsigned long count;
+    double total;
+    double max;
+  };
+
+  size_t windowSize;
+  std::vector<Section> sections;
+  mutable std::vector<float> scratch;
+};
+
+/*!
+ * \brief Measures the time between its construction and stop() or
+ * destruction and records it in a Profiler section.
+ *
+ * While tracing is on the scope is also recorded in the Chrome trace under
+ * the section name.
+ */
+class ScopedTimer {
+public:
+  /*!
+   * \brief Constructor for ScopedTimer, starts measuring.
+   * \param profiler The profiler to record the sample in.
+   * \param index The index of the section to record.
+   */
+  ScopedTimer(Profiler &profiler, int index)
+      : profiler(&profiler), index(index), start(Trace::now()) {}
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+  ~ScopedTimer() { stop(); }
+
+  /*!
+   * \brief Records the elapsed time now instead of at destruction.
+   */
+  void stop() {
+    if (profiler == nullptr) {
+      return;
+    }
+    std::int64_t end = Trace::now();
+    profiler->record(index, (end - start) / 1e6);
+    if (Trace::isEnabled()) {
+      Trace::record(profiler->traceName(index), start, end);
+    }
+    profiler = nullptr;
+  }
+
+private:
+  Profiler *profiler;
+  int index;
+  std::int64_t start;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "doctest.h"
+#include "profiler.h"
+
+TEST_CASE("Profiler Class: Sections Are Registered Once") {
+    Profiler profiler;
+    int events = profiler.section("events");
+    int draw = profiler.section("draw");
+    REQUIRE(profiler.section("events") == events);
+    REQUIRE(draw != events);
+    REQUIRE(profiler.sectionCount() == 2);
+    REQUIRE(profiler.sectionName(draw) == "draw");
+}
+
+TEST_CASE("Profiler Class: Rolling Percentiles") {
+    Profiler profiler(100);
+    int section = profiler.section("rules");
+    CHECK(profiler.percentile(section, 50) == 0.0);
+
+    for (int k = 1; k <= 100; ++k) {
+        profiler.record(section, k);
+    }
+    CHECK(profiler.percentile(section, 50) == doctest::Approx(50).epsilon(0.02));
+    CHECK(profiler.percentile(section, 99) == doctest::Approx(99).epsilon(0.02));
+
+    // Older samples fall out of the window but stay in the session mean.
+    for (int k = 0; k < 100; ++k) {
+        profiler.record(section, 1000);
+    }
+    CHECK(profiler.percentile(section, 50) == 1000);
+    CHECK(profiler.mean(section) == doctest::Approx((5050 + 100000) / 200.0));
+}
+
+TEST_CASE("ScopedTimer Class: Records Once") {
+    Profiler profiler;
+    int section = profiler.section("scope");
+    {
+        ScopedTimer timer(profiler, section);
+        timer.stop();
+    }
+    REQUIRE(profiler.sampleCount(section) == 1);
+    REQUIRE(profiler.mean(section) >= 0.0);
+}
@@ -0,0 +1,382 @@
+#ifndef PROTOCOL
+#define PROTOCOL
+
+#include "game.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief The binary wire format between clients and the server.
+ *
+ * Data travels in batches: a 4-byte header (magic, version, little-endian
+ * 16-bit frame count) followed by that many 8-byte frames. Every frame has
+ * the same size, so a receiver can find frame k at header + 8 * k without
+ * parsing the ones before it and read fields straight from its receive
+ * buffer.
+ *
+ * Frame layout:
+ *   byte 0     low nibble: FrameType, for results ResultFrame | action kind;
+ *              bit 4: player; bits 5-6: unit type; bit 7: accepted
+ *   bytes 1-3  first argument, 24-bit little-endian (from cell, match id)
+ *   bytes 4-6  second argument, 24-bit little-endian (to cell, seat, winner)
+ *   byte 7     client tag, echoed back in results
+ *
+ * Cell arguments are row * cols + col and must stay below NO_ARGUMENT, so
+ * boards of up to 2^24 - 1 cells fit, e.g. 4096 x 4095; the writers refuse
+ * actions on cells beyond.
+ *
+ * The server answers a JoinFrame with a JoinFrame of its own: accepted bit
+ * set if granted, player bit = seat, unit type 1 for a spectator, first =
+ * match id and second = the seed of the board.
+ *
+ * For lockstep play the server follows every hashInterval-th accepted action
+ * with a HashFrame: first = the match sequence number after the action and
+ * second plus the tag byte = 32 bits of GameState::hash(). A client whose
+ * replayed state hashes differently sends the same frame back to report the
+ * desync.
+ *
+ * Variable-length data such as spectator snapshots travels as a PayloadFrame
+ * (first = length in bytes, second = match sequence, tag = payload kind)
+ * followed, in the same batch, by ceil(length / 8) frames of raw bytes, so
+ * a payload holds at most MAX_PAYLOAD_SIZE bytes. parseBatches() skips those
+ * raw frames; FrameView::payload() points at them.
+ */
+const std::uint8_t PROTOCOL_MAGIC = 0x53;
+const std::uint8_t PROTOCOL_VERSION = 1;
+const size_t BATCH_HEADER_SIZE = 4;
+const size_t FRAME_SIZE = 8;
+const size_t MAX_BATCH_FRAMES = 0xFFFF;
+const std::uint32_t NO_ARGUMENT = 0xFFFFFF;
+const size_t MAX_PAYLOAD_SIZE = (MAX_BATCH_FRAMES - 1) * FRAME_SIZE;
+
+/*!
+ * \brief The frame types. Action frames equal ActionKind; a result frame is
+ * ResultFrame combined with the kind of the action it answers.
+ */
+enum FrameType : std::uint8_t {
+  PlaceFrame = PlaceUnit,
+  MoveFrame = MoveUnit,
+  AttackFrame = AttackUnit,
+  FinishPlacementFrame = FinishPlacement,
+  JoinFrame = 4,
+  GameOverFrame = 5,
+  HashFrame = 6,
+  PayloadFrame = 7,
+  ResultFrame = 8
+};
+
+/*!
+ * \brief Folds a state hash to the 32 bits carried by a HashFrame.
+ */
+inline std::uint32_t foldHash(std::uint64_t hash) {
+  return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+/*!
+ * \brief A read-only view of one frame inside a receive buffer.
+ */
+class FrameView {
+public:
+  /*!
+   * \brief Constructor for FrameView.
+   * \param bytes The first of the FRAME_SIZE bytes of the frame.
+   */
+  explicit FrameView(const std::uint8_t *bytes) : bytes(bytes) {}
+
+  /*!
+   * \brief Gets the frame type (the low nibble of byte 0).
+   */
+  std::uint8_t type() const { return bytes[0] & 0x0F; }
+
+  /*!
+   * \brief Gets the player bit.
+   */
+  int player() const { return (bytes[0] >> 4) & 1; }
+
+  /*!
+   * \brief Gets the unit type of a placement.
+   */
+  int unitType() const { return (bytes[0] >> 5) & 3; }
+
+  /*!
+   * \brief Gets the accepted bit of a result.
+   */
+  bool accepted() const { return (bytes[0] & 0x80) != 0; }
+
+  /*!
+   * \brief Gets the first 24-bit argument, NO_ARGUMENT if unused.
+   */
+  std::uint32_t first() const { return read24(bytes + 1); }
+
+  /*!
+   * \brief Gets the second 24-bit argument, NO_ARGUMENT if unused.
+   */
+  std::uint32_t second() const { return read24(bytes + 4); }
+
+  /*!
+   * \brief Gets the client tag.
+   */
+  std::uint8_t tag() const { return bytes[7]; }
+
+  /*!
+   * \brief Gets the folded state hash of a HashFrame.
+   */
+  std::uint32_t checksum() const {
+    return second() | static_cast<std::uint32_t>(tag()) << 24;
+  }
+
+  /*!
+   * \brief Gets the raw bytes following a PayloadFrame.
+   */
+  const std::uint8_t *payload() const { return bytes + FRAME_SIZE; }
+
+  /*!
+   * \brief Gets the number of raw frames following a PayloadFrame.
+   */
+  size_t payloadFrames() const {
+    return type() == PayloadFrame ? (first() + FRAME_SIZE - 1) / FRAME_SIZE
+                                  : 0;
+  }
+
+  /*!
+   * \brief Checks if the frame is a player action.
+   */
+  bool isAction() const { return type() <= FinishPlacementFrame; }
+
+  /*!
+   * \brief Checks if the frame is the server's answer to an action.
+   */
+  bool isResult() const { return (type() & ResultFrame) != 0; }
+
+  /*!
+   * \brief Decodes the action of an action or result frame.
+   * \return The decoded action.
+   */
+  Action toAction() const {
+    std::uint32_t from = first();
+    std::uint32_t to = second();
+    return GameState::makeAction(
+        type() & 3, player(), unitType(),
+        from == NO_ARGUMENT ? -1 : static_cast<int>(from),
+        to == NO_ARGUMENT ? -1 : static_cast<int>(to));
+  }
+
+  /*!
+   * \brief Reads a 24-bit little-endian value.
+   */
+  static std::uint32_t read24(const std::uint8_t *p) {
+    return p[0] | (static_cast<std::uint32_t>(p[1]) << 8) |
+           (static_cast<std::uint32_t>(p[2]) << 16);
+  }
+
+private:
+  const std::uint8_t *bytes;
+};
+
+/*!
+ * \brief Appends frames to a byte buffer, grouping them into batches.
+ *
+ * The count in the open batch header is patched as frames are added; a new
+ * batch starts automatically after MAX_BATCH_FRAMES frames.
+ */
+class FrameWriter {
+public:
+  /*!
+   * \brief Constructor for FrameWriter.
+   * \param out The buffer frames are appended to.
+   */
+  explicit FrameWriter(std::vector<std::uint8_t> &out)
+      : out(out), header(NO_HEADER) {}
+
+  /*!
+   * \brief Appends a player action.
+   * \param action The action.
+   * \param tag A value the server echoes in the result.
+   * \return False, writing nothing, if a cell does not fit an argument.
+   */
+  bool writeAction(const Action &action, std::uint8_t tag = 0) {
+    if (!fits(action)) {
+      return false;
+    }
+    write(action.kind, action.player, action.unitType, false, action.from,
+          action.to, tag);
+    return true;
+  }
+
+  /*!
+   * \brief Appends a request to take a seat in a match.
+   * \param matchId The id of the match.
+   * \param seat The seat (0 or 1), or -1 to spectate.
+   */
+  void writeJoin(int matchId, int seat) {
+    write(JoinFrame, 0, 0, false, matchId, seat < 0 ? -1 : seat, 0);
+  }
+
+  /*!
+   * \brief Appends the server's answer to a join request.
+   * \param matchId The id of the match, -1 if the request was refused.
+   * \param seat The granted seat (0 or 1), or -1 for a spectator.
+   * \param seed The seed the board of the match was generated with.
+   */
+  void writeJoined(int matchId, int seat, std::uint32_t seed) {
+    write(JoinFrame, seat < 0 ? 0 : seat, seat < 0 ? 1 : 0, matchId >= 0,
+          matchId, seed & NO_ARGUMENT, 0);
+  }
+
+  /*!
+   * \brief Appends the server's answer to an action.
+   * \param action The processed action.
+   * \param accepted True if the action was applied.
+   * \param tag The tag of the request, 0 for actions of other seats.
+   * \return False, writing nothing, if a cell does not fit an argument.
+   */
+  bool writeResult(const Action &action, bool accepted, std::uint8_t tag) {
+    if (!fits(action)) {
+      return false;
+    }
+    write(ResultFrame | action.kind, action.player, action.unitType, accepted,
+          action.from, action.to, tag);
+    return true;
+  }
+
+  /*!
+   * \brief Appends a state hash for lockstep verification.
+   * \param sequence The number of accepted actions the hash covers.
+   * \param hash The GameState::hash() after those actions.
+   */
+  void writeHash(std::uint32_t sequence, std::uint64_t hash) {
+    std::uint32_t folded = foldHash(hash);
+    write(HashFrame, 0, 0, false, sequence & NO_ARGUMENT, folded & NO_ARGUMENT,
+          static_cast<std::uint8_t>(folded >> 24));
+  }
+
+  /*!
+   * \brief Appends variable-length data.
+   *
+   * The data is kept in one batch, which limits it to MAX_PAYLOAD_SIZE.
+   * \param kind The kind of payload, passed as the tag.
+   * \param sequence The match sequence number the data describes.
+   * \param data The bytes.
+   * \param size The number of bytes.
+   * \return False, writing nothing, if the data is larger than a batch.
+   */
+  bool writePayload(std::uint8_t kind, std::uint32_t sequence,
+                    const std::uint8_t *data, size_t size) {
+    if (size > MAX_PAYLOAD_SIZE) {
+      return false;
+    }
+    size_t frames = (size + FRAME_SIZE - 1) / FRAME_SIZE;
+    if (header != NO_HEADER && count() + 1 + frames > MAX_BATCH_FRAMES) {
+      flush();
+    }
+    write(PayloadFrame, 0, 0, false, static_cast<std::int64_t>(size),
+          sequence & NO_ARGUMENT, kind);
+    out.insert(out.end(), data, data + size);
+    out.resize(out.size() + frames * FRAME_SIZE - size, 0);
+    size_t total = count() + frames;
+    out[header + 2] = static_cast<std::uint8_t>(total & 0xFF);
+    out[header + 3] = static_cast<std::uint8_t>(total >> 8);
+    return true;
+  }
+
+  /*!
+   * \brief Appends the end-of-match notice.
+   * \param winner The winner (0 or 1), or -1 for a draw.
+   */
+  void writeGameOver(int winner) {
+    write(GameOverFrame, 0, 0, false, -1, winner < 0 ? -1 : winner, 0);
+  }
+
+  /*!
+   * \brief Closes the current batch so the next frame starts a new one.
+   */
+  void flush() { header = NO_HEADER; }
+
+private:
+  static const size_t NO_HEADER = static_cast<size_t>(-1);
+
+  /*!
+   * \brief Checks that the cells of an action can be told from NO_ARGUMENT.
+   */
+  static bool fits(const Action &action) {
+    const std::int64_t LIMIT = NO_ARGUMENT;
+    return action.from < LIMIT && action.to < LIMIT;
+  }
+
+  void write(int type, int player, int unitType, bool accepted,
+             std::int64_t first, std::int64_t second, std::uint8_t tag) {
+    if (header == NO_HEADER || count() == MAX_BATCH_FRAMES) {
+      header = out.size();
+      out.push_back(PROTOCOL_MAGIC);
+      out.push_back(PROTOCOL_VERSION);
+      out.push_back(0);
+      out.push_back(0);
+    }
+    out.push_back(static_cast<std::uint8_t>((type & 0x0F) | (player & 1) << 4 |
+                                            (unitType & 3) << 5 |
+                                            (accepted ? 0x80 : 0)));
+    write24(first < 0 ? NO_ARGUMENT : static_cast<std::uint32_t>(first));
+    write24(second < 0 ? NO_ARGUMENT : static_cast<std::uint32_t>(second));
+    out.push_back(tag);
+    size_t frames = count() + 1;
+    out[header + 2] = static_cast<std::uint8_t>(frames & 0xFF);
+    out[header + 3] = static_cast<std::uint8_t>(frames >> 8);
+  }
+
+  size_t count() const { return out[header + 2] | out[header + 3] << 8; }
+
+  void write24(std::uint32_t value) {
+    out.push_back(static_cast<std::uint8_t>(value & 0xFF));
+    out.push_back(static_cast<std::uint8_t>((value >> 8) & 0xFF));
+    out.push_back(static_cast<std::uint8_t>((value >> 16) & 0xFF));
+  }
+
+  std::vector<std::uint8_t> &out;
+  size_t header;
+};
+
+/*!
+ * \brief Walks the complete batches at the start of a receive buffer.
+ *
+ * Frames are handed to the handler as views into the buffer, nothing is
+ * copied. A batch cut off at the end of the buffer is left for the next call.
+ * \param data The received bytes.
+ * \param size The number of received bytes.
+ * \param onFrame Called with a FrameView for every frame, in order.
+ * \param error Set to true if a header has the wrong magic or version.
+ * \return The number of bytes consumed, always a whole number of batches.
+ */
+template <class Handler>
+size_t parseBatches(const std::uint8_t *data, size_t size, Handler &&onFrame,
+                    bool &error) {
+  error = false;
+  size_t pos = 0;
+  while (size - pos >= BATCH_HEADER_SIZE) {
+    if (data[pos] != PROTOCOL_MAGIC || data[pos + 1] != PROTOCOL_VERSION) {
+      error = true;
+      return pos;
+    }
+    size_t frames = data[pos + 2] | data[pos + 3] << 8;
+    size_t length = BATCH_HEADER_SIZE + frames * FRAME_SIZE;
+    if (size - pos < length) {
+      break;
+    }
+    const std::uint8_t *frame = data + pos + BATCH_HEADER_SIZE;
+    for (size_t k = 0; k < frames; ++k, frame += FRAME_SIZE) {
+      FrameView view(frame);
+      size_t skipped = view.payloadFrames();
+      if (skipped > frames - k - 1) {
+        error = true;
+        return pos;
+      }
+      onFrame(view);
+      k += skipped;
+      frame += skipped * FRAME_SIZE;
+    }
+    pos += length;
+  }
+  return pos;
+}
+
+#endif
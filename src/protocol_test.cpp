@@ -0,0 +1,184 @@
+#include "doctest.h"
+#include "protocol.h"
+#include "snapshot.h"
+
+TEST_CASE("FrameWriter Class: Actions Round Trip") {
+    std::vector<std::uint8_t> buffer;
+    FrameWriter writer(buffer);
+    Action place = GameState::makeAction(PlaceUnit, 1, 2, -1, 4000);
+    Action move = GameState::makeAction(MoveUnit, 0, 0, 17, 18);
+    Action finish = GameState::makeAction(FinishPlacement, 0, 0, -1, -1);
+    writer.writeAction(place, 7);
+    writer.writeAction(move, 8);
+    writer.writeAction(finish);
+    CHECK(buffer.size() == BATCH_HEADER_SIZE + 3 * FRAME_SIZE);
+
+    std::vector<Action> decoded;
+    std::vector<int> tags;
+    bool error = true;
+    size_t used = parseBatches(buffer.data(), buffer.size(), [&](FrameView frame) {
+        CHECK(frame.isAction());
+        decoded.push_back(frame.toAction());
+        tags.push_back(frame.tag());
+    }, error);
+    CHECK_FALSE(error);
+    CHECK(used == buffer.size());
+    REQUIRE(decoded.size() == 3);
+    CHECK(decoded[0] == place);
+    CHECK(decoded[1] == move);
+    CHECK(decoded[2] == finish);
+    CHECK(tags[0] == 7);
+    CHECK(tags[1] == 8);
+}
+
+TEST_CASE("FrameWriter Class: Server Frames Keep Their Fields") {
+    std::vector<std::uint8_t> buffer;
+    FrameWriter writer(buffer);
+    Action attack = GameState::makeAction(AttackUnit, 1, 0, 30, 22);
+    writer.writeJoin(12345, -1);
+    writer.writeResult(attack, true, 9);
+    writer.writeGameOver(1);
+
+    std::vector<std::uint8_t> bytes;
+    bool error = false;
+    parseBatches(buffer.data(), buffer.size(), [&](FrameView frame) {
+        bytes.push_back(frame.type());
+        if (frame.type() == JoinFrame) {
+            CHECK(frame.first() == 12345);
+            CHECK(frame.second() == NO_ARGUMENT);
+        } else if (frame.isResult()) {
+            CHECK_FALSE(frame.isAction());
+            CHECK(frame.accepted());
+            CHECK(frame.tag() == 9);
+            CHECK(frame.toAction() == attack);
+        } else {
+            CHECK(frame.type() == GameOverFrame);
+            CHECK(frame.second() == 1);
+        }
+    }, error);
+    CHECK(bytes.size() == 3);
+}
+
+TEST_CASE("parseBatches Function: Leaves Partial Batches") {
+    std::vector<std::uint8_t> buffer;
+    FrameWriter writer(buffer);
+    writer.writeAction(GameState::makeAction(MoveUnit, 0, 0, 1, 2));
+    writer.flush();
+    writer.writeAction(GameState::makeAction(MoveUnit, 1, 0, 3, 4));
+    size_t first = BATCH_HEADER_SIZE + FRAME_SIZE;
+
+    int frames = 0;
+    bool error = false;
+    auto count = [&](FrameView) { ++frames; };
+    CHECK(parseBatches(buffer.data(), buffer.size() - 1, count, error) == first);
+    CHECK(frames == 1);
+    CHECK(parseBatches(buffer.data(), 2, count, error) == 0);
+    CHECK(parseBatches(buffer.data() + first, buffer.size() - first, count,
+                       error) == buffer.size() - first);
+    CHECK(frames == 2);
+    CHECK_FALSE(error);
+
+    buffer[first] = 0;
+    CHECK(parseBatches(buffer.data(), buffer.size(), count, error) == first);
+    CHECK(error);
+}
+
+TEST_CASE("FrameWriter Class: Splits Large Batches") {
+    std::vector<std::uint8_t> buffer;
+    FrameWriter writer(buffer);
+    Action move = GameState::makeAction(MoveUnit, 0, 0, 1, 2);
+    for (size_t k = 0; k < MAX_BATCH_FRAMES + 2; ++k) {
+        writer.writeAction(move);
+    }
+    CHECK(buffer.size() == 2 * BATCH_HEADER_SIZE + (MAX_BATCH_FRAMES + 2) * FRAME_SIZE);
+    size_t frames = 0;
+    bool error = false;
+    CHECK(parseBatches(buffer.data(), buffer.size(), [&](FrameView) { ++frames; },
+                       error) == buffer.size());
+    CHECK(frames == MAX_BATCH_FRAMES + 2);
+}
+
+TEST_CASE("FrameWriter Class: Hash Frames Carry 32 Bits") {
+    std::vector<std::uint8_t> buffer;
+    FrameWriter writer(buffer);
+    std::uint64_t hash = 0x0123456789ABCDEFull;
+    writer.writeHash(70000, hash);
+    bool error = false;
+    int frames = 0;
+    parseBatches(buffer.data(), buffer.size(), [&](FrameView frame) {
+        CHECK(frame.type() == HashFrame);
+        CHECK(frame.first() == 70000);
+        CHECK(frame.checksum() == foldHash(hash));
+        ++frames;
+    }, error);
+    CHECK(frames == 1);
+}
+
+TEST_CASE("FrameWriter Class: Payloads Are Skipped By The Parser") {
+    std::vector<std::uint8_t> buffer;
+    FrameWriter writer(buffer);
+    std::vector<std::uint8_t> data(13);
+    for (size_t k = 0; k < data.size(); ++k) {
+        data[k] = static_cast<std::uint8_t>(PROTOCOL_MAGIC + k);
+    }
+    writer.writeAction(GameState::makeAction(MoveUnit, 0, 0, 1, 2));
+    writer.writePayload(DeltaPayload, 77, data.data(), data.size());
+    writer.writeGameOver(-1);
+    CHECK(buffer.size() == BATCH_HEADER_SIZE + 5 * FRAME_SIZE);
+
+    std::vector<std::uint8_t> types;
+    bool error = false;
+    parseBatches(buffer.data(), buffer.size(), [&](FrameView frame) {
+        types.push_back(frame.type());
+        if (frame.type() == PayloadFrame) {
+            CHECK(frame.first() == 13);
+            CHECK(frame.second() == 77);
+            CHECK(frame.tag() == DeltaPayload);
+            CHECK(std::equal(data.begin(), data.end(), frame.payload()));
+        }
+    }, error);
+    CHECK_FALSE(error);
+    CHECK(types == std::vector<std::uint8_t>{MoveFrame, PayloadFrame, GameOverFrame});
+
+    // A payload longer than its batch is a protocol error.
+    buffer[2] = 2;
+    buffer.resize(BATCH_HEADER_SIZE + 2 * FRAME_SIZE);
+    CHECK(parseBatches(buffer.data(), buffer.size(), [](FrameView) {}, error) == 0);
+    CHECK(error);
+}
+
+TEST_CASE("FrameWriter Class: Refuses What The Format Cannot Carry") {
+    std::vector<std::uint8_t> buffer;
+    FrameWriter writer(buffer);
+    // The last cell of a 4096 x 4096 board would decode as no argument.
+    Action last = GameState::makeAction(MoveUnit, 0, 0, 1, static_cast<int>(NO_ARGUMENT));
+    CHECK_FALSE(writer.writeAction(last));
+    CHECK_FALSE(writer.writeResult(last, true, 1));
+    CHECK(buffer.empty());
+    Action highest = GameState::makeAction(MoveUnit, 0, 0, static_cast<int>(NO_ARGUMENT) - 1, 0);
+    REQUIRE(writer.writeAction(highest));
+
+    std::vector<std::uint8_t> data(MAX_PAYLOAD_SIZE + 1, 0x5A);
+    size_t before = buffer.size();
+    CHECK_FALSE(writer.writePayload(SnapshotPayload, 1, data.data(), data.size()));
+    CHECK(buffer.size() == before);
+    // The largest payload takes a batch of its own, without overflowing the count.
+    REQUIRE(writer.writePayload(SnapshotPayload, 1, data.data(), MAX_PAYLOAD_SIZE));
+
+    std::vector<Action> actions;
+    size_t payloads = 0;
+    bool error = false;
+    size_t used = parseBatches(buffer.data(), buffer.size(), [&](FrameView frame) {
+        if (frame.type() == PayloadFrame) {
+            CHECK(frame.first() == MAX_PAYLOAD_SIZE);
+            ++payloads;
+        } else {
+            actions.push_back(frame.toAction());
+        }
+    }, error);
+    CHECK_FALSE(error);
+    CHECK(used == buffer.size());
+    CHECK(payloads == 1);
+    REQUIRE(actions.size() == 1);
+    CHECK(actions[0] == highest);
+}
@@ -0,0 +1,980 @@
+#ifndef REACTOR
+#define REACTOR
+
+#include "protocol.h"
+#include "server.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*!
+ * \brief A fixed-size byte ring buffer allocated once per connection.
+ *
+ * Free and stored bytes are exposed as at most two spans so that a single
+ * readv() or writev() call fills or drains the ring across its wrap point.
+ */
+class ByteRing {
+public:
+  /*!
+   * \brief Constructor for ByteRing.
+   * \param capacity The minimum capacity, rounded up to a power of two.
+   */
+  explicit ByteRing(size_t capacity) : mask(0), head(0), tail(0) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    data.resize(size);
+    mask = size - 1;
+  }
+
+  /*!
+   * \brief Gets the capacity in bytes.
+   */
+  size_t capacity() const { return data.size(); }
+
+  /*!
+   * \brief Gets the number of stored bytes.
+   */
+  size_t size() const { return tail - head; }
+
+  /*!
+   * \brief Gets the number of free bytes.
+   */
+  size_t space() const { return capacity() - size(); }
+
+  /*!
+   * \brief Describes the stored bytes, oldest first.
+   * \param out Receives up to two spans.
+   * \return The number of spans used.
+   */
+  int readable(iovec out[2]) { return spans(head, size(), out); }
+
+  /*!
+   * \brief Describes the free bytes in the order they are filled.
+   * \param out Receives up to two spans.
+   * \return The number of spans used.
+   */
+  int writable(iovec out[2]) { return spans(tail, space(), out); }
+
+  /*!
+   * \brief Marks bytes written into the writable spans as stored.
+   */
+  void produce(size_t count) { tail += count; }
+
+  /*!
+   * \brief Drops the oldest stored bytes.
+   */
+  void consume(size_t count) {
+    head += count;
+    if (head == tail) {
+      // Restart at offset 0 so that the next data does not wrap.
+      head = tail = 0;
+    }
+  }
+
+  /*!
+   * \brief Appends as many bytes as fit.
+   * \return The number of bytes appended.
+   */
+  size_t push(const std::uint8_t *bytes, size_t count) {
+    iovec free[2];
+    int spanCount = writable(free);
+    size_t copied = 0;
+    for (int k = 0; k < spanCount && copied < count; ++k) {
+      size_t part = std::min(count - copied, free[k].iov_len);
+      std::memcpy(free[k].iov_base, bytes + copied, part);
+      copied += part;
+    }
+    produce(copied);
+    return copied;
+  }
+
+  /*!
+   * \brief Copies the stored bytes into a linear buffer.
+   * \param out Receives size() bytes.
+   */
+  void copyOut(std::uint8_t *out) const {
+    size_t begin = head & mask;
+    size_t first = std::min(size(), capacity() - begin);
+    std::memcpy(out, data.data() + begin, first);
+    std::memcpy(out + first, data.data(), size() - first);
+  }
+
+private:
+  int spans(size_t start, size_t length, iovec out[2]) {
+    if (length == 0) {
+      return 0;
+    }
+    size_t begin = start & mask;
+    size_t first = std::min(length, capacity() - begin);
+    out[0].iov_base = data.data() + begin;
+    out[0].iov_len = first;
+    if (first == length) {
+      return 1;
+    }
+    out[1].iov_base = data.data();
+    out[1].iov_len = length - first;
+    return 2;
+  }
+
+  std::vector<std::uint8_t> data;
+  size_t mask;
+  size_t head;
+  size_t tail;
+};
+
+/*!
+ * \brief Handles the complete batches stored in a read ring.
+ *
+ * Frames are read in place; only a batch crossing the wrap point is copied to
+ * the scratch buffer first. Handled batches are consumed.
+ * \param in The read ring.
+ * \param scratch A buffer of at least the ring's capacity.
+ * \param onFrame Called with a FrameView for every frame, in order.
+ * \return False on a protocol error.
+ */
+template <class Handler>
+bool parseRing(ByteRing &in, std::vector<std::uint8_t> &scratch,
+               Handler &&onFrame) {
+  while (in.size() > 0) {
+    iovec stored[2];
+    int spans = in.readable(stored);
+    bool error = false;
+    size_t used =
+        parseBatches(static_cast<const std::uint8_t *>(stored[0].iov_base),
+                     stored[0].iov_len, onFrame, error);
+    if (error) {
+      return false;
+    }
+    if (used == 0 && spans == 2) {
+      in.copyOut(scratch.data());
+      used = parseBatches(scratch.data(), in.size(), onFrame, error);
+      if (error) {
+        return false;
+      }
+    }
+    if (used == 0) {
+      return true;
+    }
+    in.consume(used);
+  }
+  return true;
+}
+
+class Reactor;
+
+/*!
+ * \brief One client connection of a reactor.
+ *
+ * The rings belong to the reactor thread. Match workers append frames to the
+ * staged buffer, or spectator batches to the shared queue, under the mutex
+ * and ask the owning reactor to send them. Shared batches are written
+ * straight from the match's buffer, never copied per connection. The staged
+ * bytes before stagedOffset are already in the write ring.
+ */
+struct NetConnection {
+  NetConnection(int fd, size_t bufferSize, Reactor *owner)
+      : fd(fd), owner(owner), in(bufferSize), out(bufferSize),
+        writer(staged), stagedOffset(0), matchId(-1), seat(-1),
+        hashedSequence(0), reportedSequence(0), sharedOffset(0),
+        overflowed(false), readPaused(false), queued(false), closed(false) {}
+
+  /*!
+   * \brief Gets the number of staged bytes still to send; callers hold the
+   * mutex.
+   */
+  size_t stagedBytes() const { return staged.size() - stagedOffset; }
+
+  /*!
+   * \brief Gets the staged bytes plus the results of the submitted actions
+   * still in the match queue; callers hold the mutex.
+   */
+  size_t pendingBytes() const {
+    return stagedBytes() + tags.size() * FRAME_SIZE;
+  }
+
+  int fd;
+  Reactor *owner;
+  ByteRing in;
+  ByteRing out;
+
+  std::mutex mutex;
+  std::vector<std::uint8_t> staged;
+  FrameWriter writer;
+  size_t stagedOffset;
+  std::deque<std::uint8_t> tags;
+  int matchId;
+  int seat;
+  /*!
+   * \brief The sequence of the last hash sent to the player, and of the
+   * last desync it reported.
+   */
+  std::uint32_t hashedSequence;
+  std::uint32_t reportedSequence;
+  std::deque<SharedBatch> shared;
+  size_t sharedOffset;
+  bool overflowed;
+  /*!
+   * \brief Set while the client's actions are left unread because it does
+   * not read the results of the earlier ones.
+   */
+  bool readPaused;
+
+  bool queued;
+  std::atomic<bool> closed;
+};
+
+/*!
+ * \brief Pairs connections waiting for an opponent into new matches.
+ *
+ * Lobby matches use the given config with a fresh seed per match, which the
+ * players receive in their join answer to build the same board.
+ */
+struct NetLobby {
+  NetLobby(MatchServer &server, const MatchConfig &config)
+      : server(server), config(config), created(0) {}
+
+  MatchServer &server;
+  MatchConfig config;
+  std::mutex mutex;
+  std::shared_ptr<NetConnection> waiting;
+  std::uint32_t created;
+};
+
+/*!
+ * \brief An edge-triggered epoll loop serving clients on one thread.
+ *
+ * Every reactor has its own listening socket bound with SO_REUSEPORT, so the
+ * kernel spreads new connections over the reactors without a shared accept
+ * lock. Sockets are non-blocking and read and written until EAGAIN; updates
+ * produced by match workers are coalesced per connection and sent with one
+ * writev() per wake-up. A client whose unsent results outgrow its write ring
+ * is not read from until they are sent, and one that falls MAX_STAGED_RINGS
+ * rings behind is dropped, as is a spectator MAX_SHARED_BATCHES behind. A
+ * seated player who disconnects forfeits the match. Linux only.
+ */
+class Reactor {
+public:
+  /*!
+   * \brief Constructor for Reactor with specified parameters.
+   * \param lobby The lobby shared by the reactors of a server.
+   * \param bufferSize The size of each connection's read and write ring.
+   */
+  Reactor(NetLobby &lobby, size_t bufferSize)
+      : lobby(lobby), bufferSize(bufferSize), listenFd(-1), epollFd(-1),
+        wakeFd(-1), running(false), connections(0), bytesRead(0),
+        bytesWritten(0), writeCalls(0), scratch(bufferSize) {}
+
+  Reactor(const Reactor &) = delete;
+  Reactor &operator=(const Reactor &) = delete;
+
+  /*!
+   * \brief Stops the loop and closes every socket.
+   */
+  ~Reactor() {
+    stop();
+    for (int fd : {listenFd, epollFd, wakeFd}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  /*!
+   * \brief Opens the listening socket and the epoll instance.
+   * \param port The TCP port, 0 for an ephemeral one.
+   * \return True on success, false otherwise.
+   */
+  bool listen(std::uint16_t port) {
+    listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int on = 1;
+    if (listenFd < 0 ||
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+      return false;
+    }
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (::bind(listenFd, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) < 0 ||
+        ::listen(listenFd, SOMAXCONN) < 0) {
+      return false;
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+      return false;
+    }
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLET;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    return true;
+  }
+
+  /*!
+   * \brief Starts the loop thread.
+   */
+  void start() {
+    running = true;
+    thread = std::thread([this] { loop(); });
+  }
+
+  /*!
+   * \brief Stops the loop thread and closes the client connections.
+   */
+  void stop() {
+    if (!thread.joinable()) {
+      return;
+    }
+    running = false;
+    signal();
+    thread.join();
+    for (size_t fd = 0; fd < byFd.size(); ++fd) {
+      std::shared_ptr<NetConnection> connection = byFd[fd];
+      if (connection) {
+        close(connection);
+      }
+    }
+  }
+
+  /*!
+   * \brief Gets the port of the listening socket.
+   */
+  std::uint16_t port() const {
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (getsockname(listenFd, reinterpret_cast<sockaddr *>(&address),
+                    &length) < 0) {
+      return 0;
+    }
+    return ntohs(address.sin_port);
+  }
+
+  /*!
+   * \brief Gets the number of open client connections.
+   */
+  size_t connectionCount() const { return connections.load(); }
+
+  /*!
+   * \brief Gets the number of bytes received since start.
+   */
+  std::uint64_t getBytesRead() const { return bytesRead.load(); }
+
+  /*!
+   * \brief Gets the number of bytes sent since start.
+   */
+  std::uint64_t getBytesWritten() const { return bytesWritten.load(); }
+
+  /*!
+   * \brief Gets the number of writev() calls since start.
+   */
+  std::uint64_t getWriteCalls() const { return writeCalls.load(); }
+
+  /*!
+   * \brief Asks the reactor to send the staged frames of a connection.
+   *
+   * Thread-safe; the reactor thread is woken only if it has nothing queued.
+   * \param connection A connection of this reactor.
+   */
+  void markDirty(const std::shared_ptr<NetConnection> &connection) {
+    bool wake = false;
+    {
+      std::lock_guard<std::mutex> lock(dirtyMutex);
+      if (connection->queued) {
+        return;
+      }
+      connection->queued = true;
+      wake = dirty.empty();
+      dirty.push_back(connection);
+    }
+    if (wake) {
+      signal();
+    }
+  }
+
+private:
+  void loop() {
+    Trace::setThreadName("reactor");
+    epoll_event events[256];
+    while (running) {
+      int count = epoll_wait(epollFd, events, 256, -1);
+      if (count < 0 && errno != EINTR) {
+        break;
+      }
+      TraceScope scope("net.reactor");
+      for (int k = 0; k < count; ++k) {
+        int fd = events[k].data.fd;
+        if (fd == listenFd) {
+          acceptAll();
+        } else if (fd == wakeFd) {
+          std::uint64_t value;
+          while (::read(wakeFd, &value, sizeof(value)) > 0) {
+          }
+        } else if (static_cast<size_t>(fd) < byFd.size() && byFd[fd]) {
+          std::shared_ptr<NetConnection> connection = byFd[fd];
+          if (events[k].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            receive(connection);
+          }
+          if (!connection->closed && (events[k].events & EPOLLOUT)) {
+            flush(connection);
+          }
+        }
+      }
+      flushDirty();
+    }
+  }
+
+  void signal() {
+    std::uint64_t one = 1;
+    if (::write(wakeFd, &one, sizeof(one)) < 0) {
+      // The counter is saturated, so the reactor is already awake.
+    }
+  }
+
+  void acceptAll() {
+    while (true) {
+      int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        return;
+      }
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      if (static_cast<size_t>(fd) >= byFd.size()) {
+        byFd.resize(fd + 1);
+      }
+      byFd[fd] = std::make_shared<NetConnection>(fd, bufferSize, this);
+      epoll_event event;
+      event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+      event.data.fd = fd;
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+      connections.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /*!
+   * \brief Reads until EAGAIN and handles every complete batch.
+   */
+  void receive(const std::shared_ptr<NetConnection> &connection) {
+    while (!connection->closed) {
+      {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        if (connection->pendingBytes() > connection->out.capacity()) {
+          // The socket keeps the rest until flush() catches up.
+          connection->readPaused = true;
+          return;
+        }
+      }
+      iovec free[2];
+      int spans = connection->in.writable(free);
+      if (spans == 0) {
+        // A batch larger than the ring can never complete.
+        close(connection);
+        return;
+      }
+      ssize_t received = ::readv(connection->fd, free, spans);
+      if (received == 0) {
+        close(connection);
+        return;
+      }
+      if (received < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          close(connection);
+        }
+        return;
+      }
+      bytesRead.fetch_add(received, std::memory_order_relaxed);
+      connection->in.produce(received);
+      auto handle = [this, &connection](FrameView frame) {
+        onFrame(connection, frame);
+      };
+      if (!parseRing(connection->in, scratch, handle)) {
+        close(connection);
+        return;
+      }
+    }
+  }
+
+  void onFrame(const std::shared_ptr<NetConnection> &connection,
+               FrameView frame) {
+    if (frame.type() == JoinFrame) {
+      bool seated;
+      {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        seated = connection->matchId >= 0;
+      }
+      if (!seated && frame.first() == NO_ARGUMENT) {
+        joinLobby(connection);
+        return;
+      }
+      // Seats are only handed out by the lobby; a match id asks to spectate.
+      int matchId = static_cast<int>(frame.first());
+      bool watching =
+          !seated && frame.second() == NO_ARGUMENT &&
+          lobby.server.subscribe(matchId, [connection](const SharedBatch &batch) {
+            return broadcast(connection, batch);
+          });
+      {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->matchId = watching ? matchId : connection->matchId;
+        connection->writer.writeJoined(watching ? matchId : -1, -1, 0);
+      }
+      markDirty(connection);
+      return;
+    }
+    if (frame.type() == HashFrame) {
+      // Only a player can disagree with a hash, and once per hash it got.
+      bool counted;
+      {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        counted = connection->seat >= 0 &&
+                  frame.first() > connection->reportedSequence &&
+                  frame.first() <= connection->hashedSequence;
+        if (counted) {
+          connection->reportedSequence = frame.first();
+        }
+      }
+      if (counted) {
+        lobby.server.reportDesync();
+      }
+      return;
+    }
+    if (!frame.isAction()) {
+      return;
+    }
+    Action action = frame.toAction();
+    int matchId;
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      matchId = connection->matchId;
+      if (matchId < 0 || connection->seat < 0) {
+        connection->writer.writeResult(action, false, frame.tag());
+        matchId = -1;
+      } else {
+        // Clients always act for their own seat.
+        action.player = static_cast<std::uint8_t>(connection->seat);
+        connection->tags.push_back(frame.tag());
+      }
+    }
+    if (matchId >= 0 && !lobby.server.submit(matchId, action)) {
+      // The match ended and was removed meanwhile: still answer the tag.
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      if (!connection->tags.empty()) {
+        connection->tags.pop_back();
+      }
+      connection->writer.writeResult(action, false, frame.tag());
+      matchId = -1;
+    }
+    if (matchId < 0) {
+      markDirty(connection);
+    }
+  }
+
+  void joinLobby(const std::shared_ptr<NetConnection> &connection) {
+    std::shared_ptr<NetConnection> opponent;
+    MatchConfig config = lobby.config;
+    {
+      std::lock_guard<std::mutex> lock(lobby.mutex);
+      if (!lobby.waiting || lobby.waiting->closed ||
+          lobby.waiting == connection) {
+        lobby.waiting = connection;
+        return;
+      }
+      opponent.swap(lobby.waiting);
+      config.seed = (config.seed + lobby.created++) & NO_ARGUMENT;
+    }
+    int matchId = lobby.server.createMatch(config);
+    std::shared_ptr<NetConnection> seats[2] = {opponent, connection};
+    // Both listeners are in place before either player learns its seat.
+    for (int seat = 0; seat < 2; ++seat) {
+      std::shared_ptr<NetConnection> player = seats[seat];
+      MatchServer *server = &lobby.server;
+      lobby.server.join(matchId, seat, [player, server](const MatchUpdate &update) {
+        deliver(*server, player, update);
+      });
+    }
+    for (int seat = 0; seat < 2; ++seat) {
+      {
+        std::lock_guard<std::mutex> lock(seats[seat]->mutex);
+        seats[seat]->matchId = matchId;
+        seats[seat]->seat = seat;
+        seats[seat]->writer.writeJoined(matchId, seat, config.seed);
+      }
+      seats[seat]->owner->markDirty(seats[seat]);
+    }
+  }
+
+  /*!
+   * \brief Stages a match update for a player; runs on a match worker.
+   */
+  static void deliver(MatchServer &server,
+                      const std::shared_ptr<NetConnection> &connection,
+                      const MatchUpdate &update) {
+    bool over = update.accepted && update.finished;
+    if (over && connection->seat == 0) {
+      server.closeMatch(update.matchId);
+    }
+    if (connection->closed) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      if (update.forfeited) {
+        connection->writer.writeGameOver(update.winner);
+      } else {
+        std::uint8_t tag = 0;
+        if (update.action.player == connection->seat &&
+            !connection->tags.empty()) {
+          tag = connection->tags.front();
+          connection->tags.pop_front();
+        }
+        connection->writer.writeResult(update.action, update.accepted, tag);
+        if (update.hashed) {
+          connection->writer.writeHash(update.sequence, update.hash);
+          connection->hashedSequence = update.sequence;
+        }
+        if (over) {
+          connection->writer.writeGameOver(update.winner);
+        }
+      }
+      if (connection->stagedBytes() >
+          MAX_STAGED_RINGS * connection->out.capacity()) {
+        // Not even read backpressure slows the updates down; drop it.
+        connection->overflowed = true;
+      }
+    }
+    connection->owner->markDirty(connection);
+  }
+
+  /*!
+   * \brief Queues a spectator batch for a connection; runs on a match worker.
+   * \return False to unsubscribe the connection.
+   */
+  static bool broadcast(const std::shared_ptr<NetConnection> &connection,
+                        const SharedBatch &batch) {
+    if (connection->closed) {
+      return false;
+    }
+    bool keep = true;
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      if (connection->shared.size() >= MAX_SHARED_BATCHES) {
+        // The spectator does not keep up; the reactor drops it.
+        connection->overflowed = true;
+        keep = false;
+      } else {
+        connection->shared.push_back(batch);
+      }
+    }
+    connection->owner->markDirty(connection);
+    return keep;
+  }
+
+  void flushDirty() {
+    {
+      std::lock_guard<std::mutex> lock(dirtyMutex);
+      draining.swap(dirty);
+      for (std::shared_ptr<NetConnection> &connection : draining) {
+        connection->queued = false;
+      }
+    }
+    for (std::shared_ptr<NetConnection> &connection : draining) {
+      if (!connection->closed) {
+        flush(connection);
+      }
+    }
+    draining.clear();
+  }
+
+  /*!
+   * \brief Writes what is pending, then reads again if that lifted the
+   * backpressure.
+   */
+  void flush(const std::shared_ptr<NetConnection> &connection) {
+    write(connection);
+    bool resume = false;
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      if (connection->readPaused &&
+          connection->pendingBytes() <= connection->out.capacity()) {
+        connection->readPaused = false;
+        resume = true;
+      }
+    }
+    if (resume && !connection->closed) {
+      receive(connection);
+    }
+  }
+
+  /*!
+   * \brief Moves staged frames into the write ring and writes it, followed
+   * by the queued shared batches, until EAGAIN.
+   */
+  void write(const std::shared_ptr<NetConnection> &connection) {
+    ByteRing &out = connection->out;
+    while (true) {
+      iovec chunks[MAX_WRITE_CHUNKS];
+      int count = 0;
+      bool overflowed;
+      {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        std::vector<std::uint8_t> &staged = connection->staged;
+        size_t &offset = connection->stagedOffset;
+        if (offset < staged.size()) {
+          connection->writer.flush();
+          offset += out.push(staged.data() + offset, staged.size() - offset);
+          if (offset == staged.size()) {
+            staged.clear();
+            offset = 0;
+          } else if (offset >= staged.size() / 2) {
+            // Compact rarely enough that each byte is moved O(1) times.
+            staged.erase(staged.begin(), staged.begin() + offset);
+            offset = 0;
+          }
+        }
+        overflowed = connection->overflowed;
+        count = out.readable(chunks);
+        // Only this thread pops the queue, so the batches stay alive.
+        size_t skip = connection->sharedOffset;
+        for (size_t k = 0;
+             k < connection->shared.size() && count < MAX_WRITE_CHUNKS; ++k) {
+          const std::vector<std::uint8_t> &batch = *connection->shared[k];
+          chunks[count].iov_base =
+              const_cast<std::uint8_t *>(batch.data()) + skip;
+          chunks[count].iov_len = batch.size() - skip;
+          skip = 0;
+          ++count;
+        }
+      }
+      if (overflowed) {
+        close(connection);
+        return;
+      }
+      if (count == 0) {
+        return;
+      }
+      ssize_t sent = ::writev(connection->fd, chunks, count);
+      if (sent < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          close(connection);
+        }
+        return;
+      }
+      writeCalls.fetch_add(1, std::memory_order_relaxed);
+      bytesWritten.fetch_add(sent, std::memory_order_relaxed);
+      size_t fromRing = std::min(static_cast<size_t>(sent), out.size());
+      out.consume(fromRing);
+      size_t rest = sent - fromRing;
+      if (rest > 0) {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        while (rest > 0) {
+          size_t left = connection->shared.front()->size() -
+                        connection->sharedOffset;
+          if (rest < left) {
+            connection->sharedOffset += rest;
+            break;
+          }
+          rest -= left;
+          connection->shared.pop_front();
+          connection->sharedOffset = 0;
+        }
+      }
+    }
+  }
+
+  void close(const std::shared_ptr<NetConnection> &connection) {
+    if (connection->closed.exchange(true)) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(lobby.mutex);
+      if (lobby.waiting == connection) {
+        lobby.waiting.reset();
+      }
+    }
+    int matchId;
+    int seat;
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      matchId = connection->matchId;
+      seat = connection->seat;
+    }
+    if (matchId >= 0 && seat >= 0) {
+      lobby.server.forfeit(matchId, seat);
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    ::close(connection->fd);
+    byFd[connection->fd].reset();
+    connections.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  static const int MAX_WRITE_CHUNKS = 16;
+  static const size_t MAX_SHARED_BATCHES = 4096;
+  static const size_t MAX_STAGED_RINGS = 64;
+
+  NetLobby &lobby;
+  size_t bufferSize;
+  int listenFd;
+  int epollFd;
+  int wakeFd;
+  std::atomic<bool> running;
+  std::thread thread;
+
+  std::vector<std::shared_ptr<NetConnection>> byFd;
+  std::atomic<size_t> connections;
+  std::atomic<std::uint64_t> bytesRead;
+  std::atomic<std::uint64_t> bytesWritten;
+  std::atomic<std::uint64_t> writeCalls;
+  std::vector<std::uint8_t> scratch;
+
+  std::mutex dirtyMutex;
+  std::vector<std::shared_ptr<NetConnection>> dirty;
+  std::vector<std::shared_ptr<NetConnection>> draining;
+};
+
+/*!
+ * \brief Serves a MatchServer over TCP with one reactor per core.
+ */
+class NetServer {
+public:
+  /*!
+   * \brief Constructor for NetServer with specified parameters.
+   * \param server The server hosting the matches.
+   * \param config The settings of lobby matches.
+   * \param reactors The number of reactor threads, 0 for one per core.
+   * \param bufferSize The size of each connection's read and write ring.
+   */
+  NetServer(MatchServer &server, const MatchConfig &config = MatchConfig(),
+            int reactors = 0, size_t bufferSize = 4096)
+      : lobby(server, config), reactorCount(reactors), bufferSize(bufferSize) {
+    if (reactorCount <= 0) {
+      reactorCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (reactorCount <= 0) {
+      reactorCount = 1;
+    }
+  }
+
+  /*!
+   * \brief Stops the reactors before the lobby goes away.
+   */
+  ~NetServer() { stop(); }
+
+  /*!
+   * \brief Opens the listening sockets and starts the reactors.
+   * \param port The TCP port, 0 for an ephemeral one.
+   * \return True on success, false otherwise.
+   */
+  bool listen(std::uint16_t port) {
+    for (int k = 0; k < reactorCount; ++k) {
+      reactors.emplace_back(new Reactor(lobby, bufferSize));
+      if (!reactors.back()->listen(port)) {
+        reactors.clear();
+        return false;
+      }
+      port = reactors.back()->port();
+    }
+    for (std::unique_ptr<Reactor> &reactor : reactors) {
+      reactor->start();
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Stops the reactors and waits for the match workers.
+   *
+   * After stop() no listener of this server touches a reactor again.
+   */
+  void stop() {
+    for (std::unique_ptr<Reactor> &reactor : reactors) {
+      reactor->stop();
+    }
+    lobby.server.drain();
+    lobby.waiting.reset();
+  }
+
+  /*!
+   * \brief Gets the listening port, 0 before listen().
+   */
+  std::uint16_t port() const {
+    return reactors.empty() ? 0 : reactors.front()->port();
+  }
+
+  /*!
+   * \brief Gets the number of reactor threads.
+   */
+  int getReactorCount() const { return reactorCount; }
+
+  /*!
+   * \brief Gets the number of open client connections.
+   */
+  size_t connectionCount() const {
+    size_t total = 0;
+    for (const std::unique_ptr<Reactor> &reactor : reactors) {
+      total += reactor->connectionCount();
+    }
+    return total;
+  }
+
+  /*!
+   * \brief Gets the number of bytes received since start.
+   */
+  std::uint64_t bytesRead() const {
+    std::uint64_t total = 0;
+    for (const std::unique_ptr<Reactor> &reactor : reactors) {
+      total += reactor->getBytesRead();
+    }
+    return total;
+  }
+
+  /*!
+   * \brief Gets the number of bytes sent since start.
+   */
+  std::uint64_t bytesWritten() const {
+    std::uint64_t total = 0;
+    for (const std::unique_ptr<Reactor> &reactor : reactors) {
+      total += reactor->getBytesWritten();
+    }
+    return total;
+  }
+
+  /*!
+   * \brief Gets the number of writev() calls since start.
+   */
+  std::uint64_t writeCalls() const {
+    std::uint64_t total = 0;
+    for (const std::unique_ptr<Reactor> &reactor : reactors) {
+      total += reactor->getWriteCalls();
+    }
+    return total;
+  }
+
+private:
+  NetLobby lobby;
+  int reactorCount;
+  size_t bufferSize;
+  std::vector<std::unique_ptr<Reactor>> reactors;
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "doctest.h"
+#include "reactor.h"
+
+static int connectTo(std::uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+static void sendFrames(int fd, const std::vector<std::uint8_t> &bytes) {
+    REQUIRE(::send(fd, bytes.data(), bytes.size(), 0) == static_cast<ssize_t>(bytes.size()));
+}
+
+static std::vector<std::uint8_t> readFrames(int fd, size_t count) {
+    // Frames may arrive grouped into any number of batches.
+    std::vector<std::uint8_t> frames;
+    while (frames.size() < count * FRAME_SIZE) {
+        std::uint8_t header[BATCH_HEADER_SIZE];
+        REQUIRE(::recv(fd, header, BATCH_HEADER_SIZE, MSG_WAITALL) == BATCH_HEADER_SIZE);
+        size_t length = (header[2] | header[3] << 8) * FRAME_SIZE;
+        frames.resize(frames.size() + length);
+        REQUIRE(::recv(fd, frames.data() + frames.size() - length, length, MSG_WAITALL) ==
+                static_cast<ssize_t>(length));
+    }
+    REQUIRE(frames.size() == count * FRAME_SIZE);
+    return frames;
+}
+
+TEST_CASE("ByteRing Class: Spans Follow The Wrap Point") {
+    ByteRing ring(10);
+    CHECK(ring.capacity() == 16);
+    std::uint8_t bytes[16];
+    for (int k = 0; k < 16; ++k) {
+        bytes[k] = static_cast<std::uint8_t>(k);
+    }
+    CHECK(ring.push(bytes, 12) == 12);
+    ring.consume(10);
+    CHECK(ring.push(bytes, 16) == 14);
+
+    iovec spans[2];
+    REQUIRE(ring.readable(spans) == 2);
+    CHECK(spans[0].iov_len == 6);
+    CHECK(spans[1].iov_len == 10);
+    CHECK(ring.writable(spans) == 0);
+
+    std::uint8_t linear[16];
+    ring.copyOut(linear);
+    CHECK(linear[0] == 10);
+    CHECK(linear[2] == 0);
+    CHECK(linear[15] == 13);
+    ring.consume(16);
+    CHECK(ring.size() == 0);
+    CHECK(ring.writable(spans) == 1);
+}
+
+TEST_CASE("parseRing Function: Handles Batches Across The Wrap Point") {
+    std::vector<std::uint8_t> bytes;
+    FrameWriter writer(bytes);
+    writer.writeAction(GameState::makeAction(MoveUnit, 1, 0, 5, 6), 3);
+    ByteRing ring(16);
+    std::vector<std::uint8_t> scratch(16);
+    std::uint8_t filler[10] = {};
+    ring.push(filler, 10);
+    ring.consume(9);
+    ring.push(bytes.data(), bytes.size());
+    ring.consume(1);
+
+    int frames = 0;
+    CHECK(parseRing(ring, scratch, [&](FrameView frame) {
+        CHECK(frame.toAction() == GameState::makeAction(MoveUnit, 1, 0, 5, 6));
+        CHECK(frame.tag() == 3);
+        ++frames;
+    }));
+    CHECK(frames == 1);
+    CHECK(ring.size() == 0);
+}
+
+TEST_CASE("NetServer Class: Lobby Pairs Clients Over TCP") {
+    MatchServer server(2);
+    NetServer net(server, MatchConfig(), 2);
+    REQUIRE(net.listen(0));
+    int clients[2] = {connectTo(net.port()), connectTo(net.port())};
+    int seeds[2];
+    int seats[2];
+    int matchIds[2];
+    for (int k = 0; k < 2; ++k) {
+        std::vector<std::uint8_t> join;
+        FrameWriter writer(join);
+        writer.writeJoin(-1, -1);
+        sendFrames(clients[k], join);
+        if (k == 0) {
+            // Make sure the first client waits in the lobby before the second.
+            while (server.matchCount() == 0 && net.connectionCount() < 2) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+    for (int k = 0; k < 2; ++k) {
+        std::vector<std::uint8_t> answer = readFrames(clients[k], 1);
+        FrameView frame(answer.data());
+        REQUIRE(frame.type() == JoinFrame);
+        CHECK(frame.accepted());
+        seats[k] = frame.player();
+        seeds[k] = frame.second();
+        matchIds[k] = frame.first();
+    }
+    CHECK(seats[0] != seats[1]);
+    CHECK(seeds[0] == seeds[1]);
+    CHECK(matchIds[0] == matchIds[1]);
+
+    // Seat 1 places out of its zone: only it hears the rejection.
+    int second = seats[0] == 1 ? clients[0] : clients[1];
+    int first = seats[0] == 0 ? clients[0] : clients[1];
+    std::vector<std::uint8_t> bytes;
+    FrameWriter writer(bytes);
+    writer.writeAction(GameState::makeAction(PlaceUnit, 0, 0, -1, 0), 42);
+    writer.flush();
+    writer.writeAction(GameState::makeAction(PlaceUnit, 0, 1, -1, 7), 43);
+    sendFrames(second, bytes);
+
+    std::vector<std::uint8_t> results = readFrames(second, 3);
+    FrameView rejection(results.data());
+    CHECK(rejection.isResult());
+    CHECK_FALSE(rejection.accepted());
+    CHECK(rejection.tag() == 42);
+    CHECK(rejection.player() == 1);
+
+    FrameView result(results.data() + FRAME_SIZE);
+    CHECK(result.accepted());
+    CHECK(result.tag() == 43);
+    CHECK(result.toAction() == GameState::makeAction(PlaceUnit, 1, 1, -1, 7));
+
+    std::vector<std::uint8_t> broadcast = readFrames(first, 2);
+    FrameView seen(broadcast.data());
+    CHECK(seen.accepted());
+    CHECK(seen.tag() == 0);
+    CHECK(seen.toAction() == GameState::makeAction(PlaceUnit, 1, 1, -1, 7));
+
+    // Each accepted action is followed by the lockstep hash of the result.
+    GameState mirror;
+    mirror.generateTall(seeds[0], MatchConfig().number_of_tall);
+    REQUIRE(mirror.apply(seen.toAction()));
+    FrameView hash(broadcast.data() + FRAME_SIZE);
+    CHECK(hash.type() == HashFrame);
+    CHECK(hash.first() == 1);
+    CHECK(hash.checksum() == foldHash(mirror.hash()));
+    CHECK(FrameView(results.data() + 2 * FRAME_SIZE).checksum() == hash.checksum());
+
+    // A spectator gets the snapshot, then deltas of the following actions.
+    int watcher = connectTo(net.port());
+    std::vector<std::uint8_t> request;
+    FrameWriter spectate(request);
+    spectate.writeJoin(matchIds[0], -1);
+    sendFrames(watcher, request);
+    std::vector<std::uint8_t> expected;
+    StateCodec::encodeSnapshot(mirror, expected);
+    size_t snapshotFrames = 1 + (expected.size() + FRAME_SIZE - 1) / FRAME_SIZE;
+    std::vector<std::uint8_t> joined = readFrames(watcher, 1 + snapshotFrames);
+    CHECK(FrameView(joined.data()).accepted());
+    CHECK(FrameView(joined.data()).unitType() == 1);
+    FrameView snapshot(joined.data() + FRAME_SIZE);
+    REQUIRE(snapshot.type() == PayloadFrame);
+    REQUIRE(snapshot.payloadFrames() == snapshotFrames - 1);
+    GameState view;
+    REQUIRE(StateCodec::decodeSnapshot(snapshot.payload(), snapshot.first(), view));
+    CHECK(view.hash() == mirror.hash());
+
+    bytes.clear();
+    FrameWriter place(bytes);
+    place.writeAction(GameState::makeAction(PlaceUnit, 0, 2, -1, 8), 1);
+    sendFrames(first, bytes);
+    REQUIRE(mirror.apply(GameState::makeAction(PlaceUnit, 0, 2, -1, 8)));
+    expected.clear();
+    StateCodec::encodeDelta(mirror, GameState::makeAction(PlaceUnit, 0, 2, -1, 8), expected);
+    size_t deltaFrames = 1 + (expected.size() + FRAME_SIZE - 1) / FRAME_SIZE;
+    std::vector<std::uint8_t> delta = readFrames(watcher, deltaFrames + 1);
+    FrameView change(delta.data());
+    REQUIRE(change.type() == PayloadFrame);
+    REQUIRE(StateCodec::applyDelta(change.payload(), change.first(), view));
+    CHECK(view.hash() == mirror.hash());
+    FrameView check(delta.data() + deltaFrames * FRAME_SIZE);
+    CHECK(check.type() == HashFrame);
+    CHECK(check.checksum() == foldHash(mirror.hash()));
+
+    ::close(watcher);
+    ::close(clients[0]);
+    ::close(clients[1]);
+    net.stop();
+}
+
+/*!
+ * \brief Seats two clients in a lobby match.
+ * \param clients Receives the sockets of seat 0 and seat 1.
+ */
+static void seatPair(NetServer &net, MatchServer &server, int clients[2]) {
+    int sockets[2] = {connectTo(net.port()), connectTo(net.port())};
+    for (int k = 0; k < 2; ++k) {
+        std::vector<std::uint8_t> join;
+        FrameWriter writer(join);
+        writer.writeJoin(-1, -1);
+        sendFrames(sockets[k], join);
+        while (k == 0 && server.matchCount() == 0 && net.connectionCount() < 2) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    for (int k = 0; k < 2; ++k) {
+        std::vector<std::uint8_t> answer = readFrames(sockets[k], 1);
+        REQUIRE(FrameView(answer.data()).accepted());
+        clients[FrameView(answer.data()).player()] = sockets[k];
+    }
+}
+
+/*!
+ * \brief Sends a placement outside the zone of a seat and reads its rejection.
+ */
+static void rejectedPlacement(int fd, int seat, std::uint8_t tag) {
+    std::vector<std::uint8_t> bytes;
+    int cell = seat == 0 ? MatchConfig().cols - 1 : 0;
+    FrameWriter(bytes).writeAction(GameState::makeAction(PlaceUnit, seat, 0, -1, cell), tag);
+    sendFrames(fd, bytes);
+    std::vector<std::uint8_t> answer = readFrames(fd, 1);
+    CHECK_FALSE(FrameView(answer.data()).accepted());
+    CHECK(FrameView(answer.data()).tag() == tag);
+}
+
+TEST_CASE("NetServer Class: Desync Reports, Backpressure And Forfeits") {
+    MatchServer server(2);
+    NetServer net(server, MatchConfig(), 1, 512);
+    REQUIRE(net.listen(0));
+    int clients[2];
+    seatPair(net, server, clients);
+
+    // Hashes not sent to a player cannot be disputed, nor by outsiders.
+    std::vector<std::uint8_t> dispute;
+    FrameWriter(dispute).writeHash(1, 0x1234);
+    int outsider = connectTo(net.port());
+    sendFrames(outsider, dispute);
+    sendFrames(clients[1], dispute);
+    rejectedPlacement(clients[1], 1, 5);
+    CHECK(server.desyncs() == 0);
+
+    std::vector<std::uint8_t> bytes;
+    FrameWriter(bytes).writeAction(GameState::makeAction(PlaceUnit, 1, 0, -1, 7), 6);
+    sendFrames(clients[1], bytes);
+    CHECK(FrameView(readFrames(clients[1], 2).data()).accepted());
+    readFrames(clients[0], 2);
+    sendFrames(clients[0], dispute);
+    sendFrames(clients[0], dispute);
+    sendFrames(outsider, dispute);
+    rejectedPlacement(clients[0], 0, 8);
+    CHECK(server.desyncs() == 1);
+
+    // A client that sends far more than its rings hold before reading is
+    // slowed down, not dropped, and every action is still answered.
+    const int FLOOD = 20000;
+    std::thread flood([&] {
+        for (int k = 0; k < FLOOD; k += 32) {
+            std::vector<std::uint8_t> batch;
+            FrameWriter writer(batch);
+            for (int j = k; j < k + 32; ++j) {
+                writer.writeAction(GameState::makeAction(PlaceUnit, 1, 0, -1, 0),
+                                   static_cast<std::uint8_t>(j));
+            }
+            sendFrames(clients[1], batch);
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::vector<std::uint8_t> answers = readFrames(clients[1], FLOOD);
+    flood.join();
+    int inOrder = 0;
+    for (int k = 0; k < FLOOD; ++k) {
+        FrameView answer(answers.data() + k * FRAME_SIZE);
+        inOrder += !answer.accepted() && answer.tag() == static_cast<std::uint8_t>(k);
+    }
+    CHECK(inOrder == FLOOD);
+
+    // Seat 0 leaves: seat 1 wins, the match is gone and later actions are
+    // still answered.
+    ::close(clients[0]);
+    std::vector<std::uint8_t> over = readFrames(clients[1], 1);
+    CHECK(FrameView(over.data()).type() == GameOverFrame);
+    CHECK(FrameView(over.data()).second() == 1);
+    CHECK(server.matchCount() == 0);
+    CHECK(server.matchesFinished() == 1);
+    rejectedPlacement(clients[1], 1, 9);
+
+    ::close(outsider);
+    ::close(clients[1]);
+    net.stop();
+}
@@ -0,0 +1,909 @@
+#ifndef SEARCH
+#define SEARCH
+
+#include "evaluation.h"
+#include "game.h"
+#include "neural.h"
+#include "tablebase.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+struct SearchResult;
+
+/*!
+ * \brief When a search has to return.
+ *
+ * A search stops at the first limit reached, or when stop() is called from
+ * another thread. Zero means no limit.
+ */
+struct SearchLimits {
+  /*!
+   * \brief The deepest iteration of alpha-beta, in plies.
+   */
+  int depth = 64;
+  /*!
+   * \brief Alpha-beta nodes, or MCTS playouts.
+   */
+  std::int64_t nodes = 0;
+  std::int64_t milliseconds = 0;
+  /*!
+   * \brief Alpha-beta starts no iteration once this much time has passed,
+   * as the next one would likely not finish within milliseconds.
+   */
+  std::int64_t softMilliseconds = 0;
+  /*!
+   * \brief Alpha-beta searches with no time limit until
+   * AlphaBetaSearch::ponderHit() starts its clock.
+   */
+  bool ponder = false;
+  /*!
+   * \brief Attack-only plies alpha-beta searches past depth, so that an
+   * exchange is not cut in the middle.
+   */
+  int quiescence = 4;
+  /*!
+   * \brief Alpha-beta scores this many best root actions exactly instead of
+   * only the best one, each with its own line.
+   */
+  int multiPv = 1;
+  /*!
+   * \brief Alpha-beta returns as soon as possible once this is set. Unlike
+   * AlphaBetaSearch::stop(), a flag set before the search starts counts.
+   */
+  const std::atomic<bool> *interrupt = nullptr;
+  /*!
+   * \brief Called on the searching thread after every completed alpha-beta
+   * iteration, with the result as search() would return it then.
+   */
+  std::function<void(const SearchResult &)> onIteration;
+};
+
+/*!
+ * \brief A root action with its score and expected continuation.
+ */
+struct SearchLine {
+  Action action = {};
+  int score = 0;
+  std::vector<Action> pv;
+};
+
+/*!
+ * \brief The outcome of a search.
+ */
+struct SearchResult {
+  /*!
+   * \brief False if the position had no legal action to search.
+   */
+  bool found = false;
+  Action best = {};
+  /*!
+   * \brief The score of best for the side to move, in Evaluator units.
+   */
+  int score = 0;
+  /*!
+   * \brief The last completed iteration, or the deepest MCTS path.
+   */
+  int depth = 0;
+  std::int64_t nodes = 0;
+  /*!
+   * \brief The expected continuation, starting with best.
+   */
+  std::vector<Action> pv;
+  /*!
+   * \brief The best root actions of the last completed iteration, best
+   * first; only best unless SearchLimits::multiPv asked for more.
+   */
+  std::vector<SearchLine> lines;
+};
+
+/*!
+ * \brief Checks if a score announces a decided game.
+ * \param score A score from a search.
+ */
+inline bool isWinScore(int score) {
+  return std::abs(score) >= Evaluator::WIN_SCORE - 1024;
+}
+
+/*!
+ * \brief Iterative-deepening negamax with alpha-beta pruning, a
+ * transposition table and an attack-only quiescence search.
+ *
+ * The tree is walked with GameState::make() and unmake() on the caller's
+ * state, which is left as it was. Leaves are scored by an Evaluator, or by
+ * a NeuralEvaluator that follows make() and unmake() incrementally, and
+ * the endings a Tablebase holds when one is set. Faster wins
+ * score higher: a win found at ply p is worth WIN_SCORE - p. The
+ * transposition table is kept between searches, so consecutive searches of
+ * one game profit from each other; clear() forgets it.
+ *
+ * On boards with THREAT_MAP_UNITS units or more, the Evaluator reads its
+ * threat term from a ThreatMap kept in step with the walk instead of
+ * comparing every pair of units at each leaf.
+ *
+ * Searches the battle phase only. Not thread-safe except for stop() and
+ * ponderHit().
+ */
+class AlphaBetaSearch {
+public:
+  /*!
+   * \brief The deepest ply reachable, quiescence included.
+   */
+  static const int MAX_PLY = 96;
+
+  /*!
+   * \brief The number of units from which a ThreatMap costs less through
+   * make() and unmake() than the all-pairs threat term at the leaves.
+   */
+  static const int THREAT_MAP_UNITS = 48;
+
+  /*!
+   * \brief Constructor for AlphaBetaSearch with specified parameters.
+   * \param tableBits The transposition table holds 2^tableBits entries.
+   */
+  explicit AlphaBetaSearch(int tableBits = 16)
+      : table(static_cast<size_t>(1) << tableBits), useNetwork(false),
+        mapped(false), tablebase(nullptr), probing(false), stopping(false),
+        aborted(false), nodes(0), waitingForHit(false), softDeadline(0),
+        hardDeadline(0) {}
+
+  /*!
+   * \brief Scores leaves with a static evaluation.
+   * \param weights The evaluation weights.
+   */
+  void setWeights(const EvalWeights &weights) {
+    evaluator = Evaluator(weights);
+    useNetwork = false;
+  }
+
+  /*!
+   * \brief Scores leaves with a copy of a network.
+   * \param weights A network that fits the boards to search.
+   */
+  void setNetwork(const NeuralEvaluator &weights) {
+    network = weights;
+    useNetwork = true;
+  }
+
+  /*!
+   * \brief Scores the endings of a tablebase exactly.
+   * \param endgames The tablebase, or nullptr; it must outlive the
+   * searches and is only probed on the map it covers.
+   */
+  void setTablebase(const Tablebase *endgames) { tablebase = endgames; }
+
+  /*!
+   * \brief Forgets every transposition.
+   */
+  void clear() {
+    std::memset(table.data(), 0, table.size() * sizeof(TableEntry));
+  }
+
+  /*!
+   * \brief Makes a running search return as soon as possible. Thread-safe.
+   */
+  void stop() { stopping.store(true, std::memory_order_relaxed); }
+
+  /*!
+   * \brief Gives a pondering search its time limits, counted from now.
+   * Thread-safe.
+   * \param softMilliseconds Starts no iteration after this; 0 for none.
+   * \param milliseconds Returns after this; 0 for none.
+   * \return False unless a search with SearchLimits::ponder is running and
+   * has not been hit yet.
+   */
+  bool ponderHit(std::int64_t softMilliseconds, std::int64_t milliseconds) {
+    std::lock_guard<std::mutex> lock(clockLock);
+    if (!waitingForHit) {
+      return false;
+    }
+    waitingForHit = false;
+    startClock(softMilliseconds, milliseconds);
+    return true;
+  }
+
+  /*!
+   * \brief Searches the best action of the side to move.
+   * \param state The position, restored before returning.
+   * \param limits When to return.
+   * \return The best action of the deepest iteration searched. An
+   * interrupted iteration still counts if the first root action, the best
+   * of the iteration before, was fully searched; with several lines, only
+   * completed iterations count.
+   */
+  SearchResult search(GameState &state, const SearchLimits &limits) {
+    TraceScope scope("ai.search");
+    SearchResult result;
+    stopping.store(false, std::memory_order_relaxed);
+    aborted = false;
+    nodes = 0;
+    active = limits;
+    {
+      std::lock_guard<std::mutex> lock(clockLock);
+      waitingForHit = limits.ponder;
+      if (limits.ponder) {
+        startClock(0, 0);
+      } else {
+        startClock(limits.softMilliseconds, limits.milliseconds);
+      }
+    }
+    searchAndWalk(state, result);
+    std::lock_guard<std::mutex> lock(clockLock);
+    waitingForHit = false;
+    return result;
+  }
+
+private:
+  static const int INFINITE = Evaluator::WIN_SCORE + 1;
+
+  enum Bound : std::uint8_t {
+    NoBound = 0,
+    ExactBound,
+    LowerBound,
+    UpperBound
+  };
+
+  /*!
+   * \brief A stored node; value-initialized (all zero) means empty.
+   */
+  struct TableEntry {
+    std::uint64_t key;
+    Action best;
+    std::int32_t score;
+    std::int16_t depth;
+    std::uint8_t bound;
+  };
+
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /*!
+   * \brief Sets the deadlines, 0 meaning none; callers hold clockLock.
+   */
+  void startClock(std::int64_t softMilliseconds, std::int64_t milliseconds) {
+    std::int64_t start = now();
+    softDeadline.store(
+        softMilliseconds > 0 ? start + softMilliseconds * 1000000 : 0,
+        std::memory_order_relaxed);
+    hardDeadline.store(milliseconds > 0 ? start + milliseconds * 1000000 : 0,
+                       std::memory_order_relaxed);
+  }
+
+  static bool passed(const std::atomic<std::int64_t> &deadline) {
+    std::int64_t when = deadline.load(std::memory_order_relaxed);
+    return when != 0 && now() >= when;
+  }
+
+  /*!
+   * \brief The body of search(), between the clock updates.
+   */
+  void searchAndWalk(GameState &state, SearchResult &result) {
+    if (state.isPlacement() || state.isFinished()) {
+      return;
+    }
+    int units = static_cast<int>(state.getUnits(0).size() +
+                                 state.getUnits(1).size());
+    mapped = !useNetwork && units >= THREAT_MAP_UNITS;
+    if (useNetwork) {
+      network.refresh(state);
+    } else if (mapped) {
+      threats.rebuild(state);
+    }
+    probing = tablebase != nullptr && tablebase->covers(state);
+    std::vector<Action> &root = moves[0];
+    state.generateActions(root);
+    if (root.empty()) {
+      return;
+    }
+    result.found = true;
+    result.best = root[0];
+    ranking.clear();
+    int deepest = std::min(active.depth, MAX_PLY - 1);
+    for (int depth = 1; depth <= deepest; ++depth) {
+      TraceScope iteration("ai.iteration");
+      rootDone = false;
+      int score = active.multiPv > 1
+                      ? searchRoot(state, depth)
+                      : negamax(state, depth, -INFINITE, INFINITE, 0);
+      if (!aborted || rootDone) {
+        result.pv.assign(lines[0], lines[0] + lineLength[0]);
+      }
+      if (aborted) {
+        if (rootDone) {
+          result.best = rootBest;
+          result.score = rootScore;
+        }
+        break;
+      }
+      result.best = rootBest;
+      result.score = score;
+      result.depth = depth;
+      if (active.multiPv > 1) {
+        result.lines = ranking;
+      }
+      if (active.onIteration) {
+        SearchResult completed = result;
+        finishLines(state, completed);
+        active.onIteration(completed);
+      }
+      if (isWinScore(score) || passed(softDeadline)) {
+        break;
+      }
+    }
+    finishLines(state, result);
+  }
+
+  /*!
+   * \brief Fills in the node count and the lines of a result, extending
+   * every principal variation from the transposition table.
+   */
+  void finishLines(GameState &state, SearchResult &result) {
+    result.nodes = nodes;
+    followLine(state, result.best, result.pv);
+    if (result.lines.empty()) {
+      result.lines.push_back(SearchLine{result.best, result.score, result.pv});
+    } else {
+      for (SearchLine &line : result.lines) {
+        followLine(state, line.action, line.pv);
+      }
+    }
+  }
+
+  /*!
+   * \brief Searches every root action of one iteration, keeping the
+   * SearchLimits::multiPv best in ranking. Actions ranked by the iteration
+   * before go first; the others only need to beat the worst line kept.
+   * \return The score of the best line, or 0 if aborted.
+   */
+  int searchRoot(GameState &state, int depth) {
+    std::vector<Action> &list = moves[0];
+    if (ranking.empty()) {
+      order(state, list, nullptr, 0);
+    }
+    size_t front = 0;
+    for (const SearchLine &line : ranking) {
+      auto found = std::find(list.begin() + front, list.end(), line.action);
+      if (found != list.end()) {
+        std::rotate(list.begin() + front, found, found + 1);
+        ++front;
+      }
+    }
+    size_t wanted = std::min(static_cast<size_t>(active.multiPv), list.size());
+    std::vector<SearchLine> &kept = rankingNext;
+    kept.clear();
+    for (const Action &action : list) {
+      int alpha = kept.size() < wanted ? -INFINITE : kept.back().score;
+      makeMove(state, action, undos[0]);
+      int score = -negamax(state, depth - 1, -INFINITE, -alpha, 1);
+      unmakeMove(state, undos[0]);
+      if (aborted) {
+        return 0;
+      }
+      if (kept.size() == wanted && score <= alpha) {
+        continue;
+      }
+      // Above alpha the score is exact and lines[1] is its continuation.
+      SearchLine line{action, score, std::vector<Action>(1, action)};
+      line.pv.insert(line.pv.end(), lines[1], lines[1] + lineLength[1]);
+      auto place = std::upper_bound(
+          kept.begin(), kept.end(), score,
+          [](int value, const SearchLine &other) {
+            return value > other.score;
+          });
+      kept.insert(place, std::move(line));
+      if (kept.size() > wanted) {
+        kept.pop_back();
+      }
+    }
+    ranking.swap(kept);
+    const SearchLine &best = ranking[0];
+    std::uint64_t key = state.hash();
+    TableEntry &entry = table[key & (table.size() - 1)];
+    entry.key = key;
+    entry.best = best.action;
+    entry.score = toTable(best.score, 0);
+    entry.depth = static_cast<std::int16_t>(depth);
+    entry.bound = ExactBound;
+    rootBest = best.action;
+    lineLength[0] = static_cast<int>(best.pv.size());
+    std::copy(best.pv.begin(), best.pv.end(), lines[0]);
+    return best.score;
+  }
+
+  /*!
+   * \brief Win scores count plies from the root; the table keeps them
+   * counted from the stored node.
+   */
+  static int toTable(int score, int ply) {
+    return isWinScore(score) ? score + (score > 0 ? ply : -ply) : score;
+  }
+
+  static int fromTable(int score, int ply) {
+    return isWinScore(score) ? score - (score > 0 ? ply : -ply) : score;
+  }
+
+  bool checkAbort() {
+    ++nodes;
+    if (active.nodes > 0 && nodes >= active.nodes) {
+      aborted = true;
+    } else if ((nodes & 1023) == 0) {
+      if (stopping.load(std::memory_order_relaxed) ||
+          (active.interrupt != nullptr &&
+           active.interrupt->load(std::memory_order_relaxed))) {
+        aborted = true;
+      } else if (passed(hardDeadline)) {
+        aborted = true;
+      }
+    }
+    return aborted;
+  }
+
+  /*!
+   * \brief Scores a position from the tablebase, wins counted from the
+   * root like found wins.
+   */
+  bool probe(const GameState &state, int ply, int &score) const {
+    TablebaseEntry entry;
+    if (!probing || !tablebase->probe(state, entry)) {
+      return false;
+    }
+    score = entry.outcome * (Evaluator::WIN_SCORE - ply - entry.plies);
+    return true;
+  }
+
+  int leaf(const GameState &state) {
+    if (useNetwork) {
+      return network.evaluate(state);
+    }
+    return mapped ? evaluator.evaluate(state, threats)
+                  : evaluator.evaluate(state);
+  }
+
+  void makeMove(GameState &state, const Action &action, ActionUndo &undo) {
+    state.make(action, undo);
+    if (useNetwork) {
+      network.update(state, undo);
+    } else if (mapped) {
+      threats.update(state, undo);
+    }
+  }
+
+  void unmakeMove(GameState &state, const ActionUndo &undo) {
+    state.unmake(undo);
+    if (useNetwork) {
+      network.revert(state, undo);
+    } else if (mapped) {
+      threats.revert(state, undo);
+    }
+  }
+
+  /*!
+   * \brief Sorts the table action first, then attacks that kill, then
+   * other attacks by damage, then moves.
+   */
+  void order(const GameState &state, std::vector<Action> &list,
+             const Action *first, int ply) {
+    std::vector<int> &keys = orderKeys[ply];
+    keys.resize(list.size());
+    int side = state.getSideToMove();
+    for (size_t k = 0; k < list.size(); ++k) {
+      const Action &action = list[k];
+      int key = 0;
+      if (first != nullptr && action == *first) {
+        key = 1 << 20;
+      } else if (action.kind == AttackUnit) {
+        const std::vector<Unit> &own = state.getUnits(side);
+        const std::vector<Unit> &enemy = state.getUnits(1 - side);
+        int damage =
+            state.statsOf(own[state.unitIndexAt(action.from)]).attack;
+        int hp = enemy[state.unitIndexAt(action.to)].HP;
+        key = (damage >= hp ? 1 << 16 : 1 << 8) + damage;
+      }
+      keys[k] = key;
+    }
+    // Insertion sort: lists are short and mostly moves.
+    for (size_t k = 1; k < list.size(); ++k) {
+      Action action = list[k];
+      int key = keys[k];
+      size_t j = k;
+      while (j > 0 && keys[j - 1] < key) {
+        list[j] = list[j - 1];
+        keys[j] = keys[j - 1];
+        --j;
+      }
+      list[j] = action;
+      keys[j] = key;
+    }
+  }
+
+  /*!
+   * \brief Sets the line of a node to an action followed by the line of
+   * the child it leads to.
+   */
+  void extendLine(int ply, const Action &action) {
+    lines[ply][0] = action;
+    int length = ply + 1 < MAX_PLY ? lineLength[ply + 1] : 0;
+    std::copy(lines[ply + 1], lines[ply + 1] + length, lines[ply] + 1);
+    lineLength[ply] = length + 1;
+  }
+
+  int negamax(GameState &state, int depth, int alpha, int beta, int ply) {
+    lineLength[ply] = 0;
+    if (state.isFinished()) {
+      // The player who just acted took the last enemy unit.
+      return -(Evaluator::WIN_SCORE - ply);
+    }
+    if (depth <= 0 || ply >= MAX_PLY - 1) {
+      return quiesce(state, alpha, beta, ply, active.quiescence);
+    }
+    if (checkAbort()) {
+      return 0;
+    }
+    int known;
+    if (ply > 0 && probe(state, ply, known)) {
+      return known;
+    }
+    int alphaStart = alpha;
+    std::uint64_t key = state.hash();
+    TableEntry &entry = table[key & (table.size() - 1)];
+    const Action *hashMove = nullptr;
+    if (entry.bound != NoBound && entry.key == key) {
+      hashMove = &entry.best;
+      int score = fromTable(entry.score, ply);
+      if (ply > 0 && entry.depth >= depth &&
+          (entry.bound == ExactBound ||
+           (entry.bound == LowerBound && score >= beta) ||
+           (entry.bound == UpperBound && score <= alpha))) {
+        return score;
+      }
+    }
+    std::vector<Action> &list = moves[ply];
+    state.generateActions(list);
+    if (list.empty()) {
+      return 0;
+    }
+    Action hashAction = hashMove != nullptr ? *hashMove : Action();
+    order(state, list, hashMove != nullptr ? &hashAction : nullptr, ply);
+    int best = -INFINITE;
+    Action bestAction = list[0];
+    for (const Action &action : list) {
+      makeMove(state, action, undos[ply]);
+      int score = -negamax(state, depth - 1, -beta, -alpha, ply + 1);
+      unmakeMove(state, undos[ply]);
+      if (aborted) {
+        return 0;
+      }
+      if (score > best) {
+        best = score;
+        bestAction = action;
+        if (ply == 0) {
+          rootBest = action;
+          rootScore = score;
+          rootDone = true;
+        }
+      }
+      if (score > alpha) {
+        extendLine(ply, action);
+      }
+      alpha = std::max(alpha, score);
+      if (alpha >= beta) {
+        break;
+      }
+    }
+    entry.key = key;
+    entry.best = bestAction;
+    entry.score = toTable(best, ply);
+    entry.depth = static_cast<std::int16_t>(depth);
+    entry.bound = best <= alphaStart ? UpperBound
+                                     : (best >= beta ? LowerBound : ExactBound);
+    return best;
+  }
+
+  int quiesce(GameState &state, int alpha, int beta, int ply, int left) {
+    lineLength[ply] = 0;
+    if (checkAbort()) {
+      return 0;
+    }
+    int best;
+    if (probe(state, ply, best)) {
+      return best;
+    }
+    best = leaf(state);
+    if (left <= 0 || ply >= MAX_PLY - 1 || best >= beta) {
+      return best;
+    }
+    alpha = std::max(alpha, best);
+    std::vector<Action> &list = moves[ply];
+    state.generateActions(list);
+    list.erase(std::remove_if(list.begin(), list.end(),
+                              [](const Action &action) {
+                                return action.kind != AttackUnit;
+                              }),
+               list.end());
+    order(state, list, nullptr, ply);
+    for (const Action &action : list) {
+      makeMove(state, action, undos[ply]);
+      int score = state.isFinished()
+                      ? Evaluator::WIN_SCORE - ply - 1
+                      : -quiesce(state, -beta, -alpha, ply + 1, left - 1);
+      unmakeMove(state, undos[ply]);
+      if (aborted) {
+        return 0;
+      }
+      best = std::max(best, score);
+      alpha = std::max(alpha, score);
+      if (alpha >= beta) {
+        break;
+      }
+    }
+    return best;
+  }
+
+  /*!
+   * \brief Follows the line the search backed up, then the table moves,
+   * as far as they are legal. Table entries alone may be overwritten
+   * before the search ends.
+   * \param first The root action the line starts with.
+   * \param pv The backed-up line, replaced by the extended one.
+   */
+  void followLine(GameState &state, const Action &first,
+                  std::vector<Action> &pv) {
+    std::vector<ActionUndo> path;
+    std::vector<Action> line;
+    line.swap(pv);
+    if (!line.empty() && !(line[0] == first)) {
+      line.clear();
+    }
+    Action next = first;
+    while (static_cast<int>(path.size()) < MAX_PLY) {
+      ActionUndo undo;
+      if (!state.make(next, undo)) {
+        break;
+      }
+      path.push_back(undo);
+      pv.push_back(next);
+      if (path.size() < line.size()) {
+        next = line[path.size()];
+        continue;
+      }
+      const TableEntry &entry = table[state.hash() & (table.size() - 1)];
+      if (state.isFinished() || entry.bound == NoBound ||
+          entry.key != state.hash()) {
+        break;
+      }
+      next = entry.best;
+    }
+    while (!path.empty()) {
+      state.unmake(path.back());
+      path.pop_back();
+    }
+  }
+
+  std::vector<TableEntry> table;
+  Evaluator evaluator;
+  ThreatMap threats;
+  NeuralEvaluator network;
+  bool useNetwork;
+  bool mapped;
+  const Tablebase *tablebase;
+  bool probing;
+  std::atomic<bool> stopping;
+  bool aborted;
+  std::int64_t nodes;
+  SearchLimits active;
+  std::mutex clockLock;
+  bool waitingForHit;
+  /*!
+   * \brief steady_clock nanoseconds; 0 for no deadline.
+   */
+  std::atomic<std::int64_t> softDeadline;
+  std::atomic<std::int64_t> hardDeadline;
+  std::vector<Action> moves[MAX_PLY];
+  std::vector<int> orderKeys[MAX_PLY];
+  ActionUndo undos[MAX_PLY];
+  /*!
+   * \brief The best line found below each ply of the current iteration.
+   */
+  Action lines[MAX_PLY][MAX_PLY];
+  int lineLength[MAX_PLY];
+  /*!
+   * \brief The lines kept by the last iteration with several lines, and
+   * those of the running one.
+   */
+  std::vector<SearchLine> ranking;
+  std::vector<SearchLine> rankingNext;
+  Action rootBest = {};
+  int rootScore = 0;
+  bool rootDone = false;
+};
+
+/*!
+ * \brief Monte Carlo tree search with UCT selection.
+ *
+ * Instead of random playouts, which rarely end within a useful number of
+ * turns here, each new leaf is scored by the static evaluation squashed to
+ * a winning probability, sigmoid(score / EVAL_SCALE). The search runs for
+ * limits.nodes playouts, DEFAULT_PLAYOUTS when neither nodes nor time are
+ * limited, and plays the most visited root action.
+ */
+class MctsSearch {
+public:
+  static constexpr int DEFAULT_PLAYOUTS = 2000;
+
+  /*!
+   * \brief Evaluation units per factor e of winning odds.
+   */
+  static constexpr double EVAL_SCALE = 100.0;
+
+  static constexpr double EXPLORATION = 1.4;
+
+  /*!
+   * \brief Constructor for MctsSearch with specified parameters.
+   * \param weights The weights of the leaf evaluation.
+   */
+  explicit MctsSearch(const EvalWeights &weights = defaultEvalWeights())
+      : evaluator(weights), stopping(false) {}
+
+  /*!
+   * \brief Makes a running search return as soon as possible. Thread-safe.
+   */
+  void stop() { stopping.store(true, std::memory_order_relaxed); }
+
+  /*!
+   * \brief Searches the best action of the side to move.
+   * \param state The position, restored before returning.
+   * \param limits When to return; depth and quiescence are ignored.
+   */
+  SearchResult search(GameState &state, const SearchLimits &limits) {
+    TraceScope scope("ai.mcts");
+    SearchResult result;
+    stopping.store(false, std::memory_order_relaxed);
+    if (state.isPlacement() || state.isFinished()) {
+      return result;
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::int64_t playouts = limits.nodes;
+    if (playouts <= 0 && limits.milliseconds <= 0) {
+      playouts = DEFAULT_PLAYOUTS;
+    }
+    std::vector<Action> actions;
+    state.generateActions(actions);
+    if (actions.empty()) {
+      return result;
+    }
+    tree.clear();
+    tree.push_back(Node());
+    std::vector<ActionUndo> path;
+    std::int64_t done = 0;
+    while (playouts <= 0 || done < playouts) {
+      if ((done & 63) == 0 && done > 0 &&
+          (stopping.load(std::memory_order_relaxed) ||
+           (limits.milliseconds > 0 &&
+            std::chrono::steady_clock::now() - started >=
+                std::chrono::milliseconds(limits.milliseconds)))) {
+        break;
+      }
+      // Selection.
+      int node = 0;
+      while (tree[node].children > 0) {
+        node = select(node);
+        path.emplace_back();
+        state.make(tree[node].action, path.back());
+      }
+      // Expansion, once a leaf is reached the second time.
+      if (!state.isFinished() && (tree[node].visits > 0 || node == 0)) {
+        state.generateActions(actions);
+        if (!actions.empty()) {
+          int first = static_cast<int>(tree.size());
+          tree[node].firstChild = first;
+          tree[node].children = static_cast<int>(actions.size());
+          for (const Action &action : actions) {
+            Node child;
+            child.action = action;
+            child.parent = node;
+            tree.push_back(child);
+          }
+          node = first;
+          path.emplace_back();
+          state.make(tree[node].action, path.back());
+        }
+      }
+      result.depth = std::max(result.depth, static_cast<int>(path.size()));
+      // Simulation: the chance the side to move wins from the leaf.
+      double win = state.isFinished()
+                       ? 0.0
+                       : 1 / (1 + std::exp(-evaluator.evaluate(state) /
+                                           EVAL_SCALE));
+      // Backpropagation, each node counted for the player who entered it.
+      while (node != 0) {
+        win = 1 - win;
+        tree[node].visits += 1;
+        tree[node].value += win;
+        node = tree[node].parent;
+        state.unmake(path.back());
+        path.pop_back();
+      }
+      tree[0].visits += 1;
+      ++done;
+    }
+
+    result.found = true;
+    result.nodes = done;
+    int node = 0;
+    while (tree[node].children > 0) {
+      node = mostVisited(node);
+      if (tree[node].visits == 0) {
+        break;
+      }
+      result.pv.push_back(tree[node].action);
+    }
+    int best = mostVisited(0);
+    result.best = tree[best].action;
+    double win = tree[best].visits > 0 ? tree[best].value / tree[best].visits
+                                       : 0.5;
+    win = std::min(std::max(win, 1e-6), 1 - 1e-6);
+    result.score = static_cast<int>(std::lround(EVAL_SCALE *
+                                                std::log(win / (1 - win))));
+    return result;
+  }
+
+private:
+  struct Node {
+    Action action = {};
+    int parent = -1;
+    int firstChild = -1;
+    int children = 0;
+    int visits = 0;
+    /*!
+     * \brief Sum of the results of the player who played action.
+     */
+    double value = 0;
+  };
+
+  int select(int node) const {
+    const Node &parent = tree[node];
+    double logVisits = std::log(static_cast<double>(parent.visits));
+    int best = parent.firstChild;
+    double bestValue = -1;
+    for (int k = 0; k < parent.children; ++k) {
+      const Node &child = tree[parent.firstChild + k];
+      if (child.visits == 0) {
+        return parent.firstChild + k;
+      }
+      double value = child.value / child.visits +
+                     EXPLORATION * std::sqrt(logVisits / child.visits);
+      if (value > bestValue) {
+        bestValue = value;
+        best = parent.firstChild + k;
+      }
+    }
+    return best;
+  }
+
+  int mostVisited(int node) const {
+    const Node &parent = tree[node];
+    int best = parent.firstChild;
+    for (int k = 1; k < parent.children; ++k) {
+      if (tree[parent.firstChild + k].visits > tree[best].visits) {
+        best = parent.firstChild + k;
+      }
+    }
+    return best;
+  }
+
+  Evaluator evaluator;
+  std::atomic<bool> stopping;
+  std::vector<Node> tree;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "doctest.h"
+#include "search.h"
+
+/*!
+ * \brief Plays random placements and battle turns from a seed.
+ */
+static GameState randomPosition(std::uint32_t seed, int turns) {
+    GameState state(8, 8, 3);
+    state.generateTall(seed, 4);
+    std::mt19937 rng(seed);
+    std::vector<Action> actions;
+    while (state.isPlacement()) {
+        state.generateActions(actions);
+        size_t places = actions.size() - (actions.back().kind == FinishPlacement);
+        state.apply(places > 0 ? actions[rng() % places] : actions.back());
+    }
+    while (!state.isFinished() && state.getTurn() < turns) {
+        state.generateActions(actions);
+        state.apply(actions[rng() % actions.size()]);
+    }
+    return state;
+}
+
+/*!
+ * \brief Plain negamax with the scoring rules of AlphaBetaSearch.
+ */
+static int minimax(GameState &state, Evaluator &evaluator, int depth, int ply) {
+    if (state.isFinished()) {
+        return -(Evaluator::WIN_SCORE - ply);
+    }
+    if (depth == 0) {
+        return evaluator.evaluate(state);
+    }
+    std::vector<Action> actions;
+    state.generateActions(actions);
+    if (actions.empty()) {
+        return 0;
+    }
+    int best = -Evaluator::WIN_SCORE - 1;
+    for (const Action &action : actions) {
+        ActionUndo undo;
+        state.make(action, undo);
+        best = std::max(best, -minimax(state, evaluator, depth - 1, ply + 1));
+        state.unmake(undo);
+    }
+    return best;
+}
+
+TEST_CASE("AlphaBetaSearch Class: Scores Match Plain Minimax") {
+    Evaluator evaluator;
+    for (std::uint32_t seed = 0; seed < 12; ++seed) {
+        GameState state = randomPosition(seed, 20 + seed);
+        if (state.isFinished()) {
+            continue;
+        }
+        std::uint64_t hash = state.hash();
+        for (int depth = 1; depth <= 3; ++depth) {
+            AlphaBetaSearch search;
+            SearchLimits limits;
+            limits.depth = depth;
+            limits.quiescence = 0;
+            SearchResult result = search.search(state, limits);
+            REQUIRE(result.found);
+            CHECK(result.score == minimax(state, evaluator, depth, 0));
+            CHECK(state.hash() == hash);
+            REQUIRE_FALSE(result.pv.empty());
+            CHECK(result.pv[0] == result.best);
+        }
+    }
+}
+
+TEST_CASE("AlphaBetaSearch Class: Finds The Winning Attack") {
+    std::vector<Unit> armies[2];
+    GameState state(8, 8, 3);
+    armies[0].push_back(Unit{0, 50, state.cellIndex(3, 3)});
+    armies[0].push_back(Unit{1, 30, state.cellIndex(6, 1)});
+    armies[1].push_back(Unit{1, 15, state.cellIndex(3, 4)});
+    state.restore(armies, 0, false, 10);
+    AlphaBetaSearch search;
+    SearchLimits limits;
+    limits.depth = 4;
+    SearchResult result = search.search(state, limits);
+    CHECK(result.best.kind == AttackUnit);
+    CHECK(result.best.to == state.cellIndex(3, 4));
+    CHECK(result.score == Evaluator::WIN_SCORE - 1);
+    CHECK(isWinScore(result.score));
+}
+
+TEST_CASE("AlphaBetaSearch Class: Limits And Networks") {
+    GameState state = randomPosition(5, 10);
+    REQUIRE_FALSE(state.isFinished());
+    AlphaBetaSearch search;
+    SearchLimits limits;
+    limits.nodes = 500;
+    SearchResult result = search.search(state, limits);
+    CHECK(result.found);
+    CHECK(result.nodes <= 500);
+    CHECK(state.isLegal(result.best));
+
+    // The network follows the tree incrementally and ends where it began.
+    NeuralEvaluator network;
+    network.randomize(8, 8, 32, 3);
+    search.setNetwork(network);
+    search.clear();
+    limits.nodes = 0;
+    limits.depth = 3;
+    result = search.search(state, limits);
+    CHECK(result.depth == 3);
+    CHECK(state.isLegal(result.best));
+
+    GameState placing(8, 8, 3);
+    CHECK_FALSE(search.search(placing, limits).found);
+}
+
+TEST_CASE("MctsSearch Class: Prefers The Winning Attack") {
+    std::vector<Unit> armies[2];
+    GameState state(8, 8, 3);
+    armies[0].push_back(Unit{0, 50, state.cellIndex(3, 3)});
+    armies[1].push_back(Unit{1, 15, state.cellIndex(3, 4)});
+    armies[1].push_back(Unit{0, 50, state.cellIndex(0, 7)});
+    armies[1].push_back(Unit{2, 40, state.cellIndex(7, 7)});
+    state.restore(armies, 0, false, 10);
+    std::uint64_t hash = state.hash();
+    MctsSearch search;
+    SearchLimits limits;
+    limits.nodes = 800;
+    SearchResult result = search.search(state, limits);
+    CHECK(result.found);
+    CHECK(result.nodes == 800);
+    CHECK(result.best.kind == AttackUnit);
+    CHECK(result.best.to == state.cellIndex(3, 4));
+    CHECK(state.hash() == hash);
+    REQUIRE_FALSE(result.pv.empty());
+    CHECK(result.pv[0] == result.best);
+}
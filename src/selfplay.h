@@ -0,0 +1,474 @@
+#ifndef SELFPLAY
+#define SELFPLAY
+
+#include "evaluation.h"
+#include "game.h"
+#include "mapped_file.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Outcomes stored with a training position, for the side to move.
+ */
+enum TrainingResult : std::uint8_t {
+  ResultLoss = 0,
+  ResultDraw = 1,
+  ResultWin = 2
+};
+
+/*!
+ * \brief The layout of training shard files.
+ *
+ * A shard is a 32-byte header followed by fixed-size records, so a mapped
+ * file is indexed directly. Header, little-endian: "SPD1", u16 rows, cols,
+ * units per player and record size, u32 reserved, u64 record count, 8
+ * reserved bytes. Record: u8 side to move, u8 TrainingResult, u16 turn, u8
+ * unit count of each player, 2 reserved bytes, the tall hexes as a bitmap
+ * of (rows * cols + 7) / 8 bytes, then units-per-player slots for player 0
+ * and for player 1 of u16 hex, u8 type, u8 HP (capped at 255).
+ */
+struct ShardFormat {
+  static const size_t HEADER_SIZE = 32;
+  static const size_t RECORD_HEADER_SIZE = 8;
+  static const size_t UNIT_SIZE = 4;
+
+  static size_t tallBytes(int rows, int cols) {
+    return (static_cast<size_t>(rows) * cols + 7) / 8;
+  }
+
+  static size_t recordSize(int rows, int cols, int maxUnits) {
+    return RECORD_HEADER_SIZE + tallBytes(rows, cols) +
+           2 * maxUnits * UNIT_SIZE;
+  }
+};
+
+/*!
+ * \brief Writes sampled positions of whole games to numbered shard files.
+ *
+ * Positions are held until the game ends, since their label is the final
+ * result, then appended with buffered writes. A shard is closed once it
+ * holds positionsPerShard records. Several writers may fill one directory:
+ * writer t of n numbers its shards t, t + n, t + 2n...
+ */
+class ShardWriter {
+public:
+  /*!
+   * \brief Constructor for ShardWriter with specified parameters.
+   * \param directory The directory of the shards, created if missing.
+   * \param prefix The file name prefix; shards are prefix-00000.spd...
+   * \param rows The number of board rows of every position.
+   * \param cols The number of board columns of every position.
+   * \param maxUnits The largest number of units of a player.
+   * \param positionsPerShard The number of records per shard.
+   * \param firstShard The number of the first shard.
+   * \param shardStride The step between shard numbers.
+   *
+   * Boards whose records would exceed 64 KiB are refused: every write fails.
+   */
+  ShardWriter(const std::string &directory, const std::string &prefix,
+              int rows, int cols, int maxUnits,
+              size_t positionsPerShard = 1 << 20, int firstShard = 0,
+              int shardStride = 1)
+      : directory(directory), prefix(prefix), rows(rows), cols(cols),
+        maxUnits(maxUnits),
+        recordBytes(ShardFormat::recordSize(rows, cols, maxUnits)),
+        perShard(std::max<size_t>(positionsPerShard, 1)),
+        nextShard(firstShard),
+        stride(std::max(shardStride, 1)), file(nullptr), inShard(0),
+        written(0), failed(recordBytes > 0xFFFF) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+  }
+
+  ShardWriter(const ShardWriter &) = delete;
+  ShardWriter &operator=(const ShardWriter &) = delete;
+
+  /*!
+   * \brief Completes the current shard.
+   */
+  ~ShardWriter() { close(); }
+
+  /*!
+   * \brief Records a position of the running game.
+   * \param state The position; its board must match the writer.
+   */
+  void add(const GameState &state) {
+    size_t offset = pending.size();
+    pending.resize(offset + recordBytes, 0);
+    std::uint8_t *record = pending.data() + offset;
+    record[0] = static_cast<std::uint8_t>(state.getSideToMove());
+    putLE(record + 2, std::min(state.getTurn(), 0xFFFF), 2);
+    std::uint8_t *tall = record + ShardFormat::RECORD_HEADER_SIZE;
+    for (int cell = 0; cell < rows * cols; ++cell) {
+      if (state.isTall(cell)) {
+        tall[cell >> 3] |= static_cast<std::uint8_t>(1u << (cell & 7));
+      }
+    }
+    std::uint8_t *slot = tall + ShardFormat::tallBytes(rows, cols);
+    for (int player = 0; player < 2; ++player) {
+      const std::vector<Unit> &units = state.getUnits(player);
+      int count = std::min(static_cast<int>(units.size()), maxUnits);
+      record[4 + player] = static_cast<std::uint8_t>(count);
+      for (int k = 0; k < count; ++k) {
+        std::uint8_t *unit = slot + (player * maxUnits + k) *
+                                        ShardFormat::UNIT_SIZE;
+        putLE(unit, static_cast<std::uint64_t>(units[k].cell), 2);
+        unit[2] = static_cast<std::uint8_t>(units[k].type);
+        unit[3] = static_cast<std::uint8_t>(std::min(units[k].HP, 255));
+      }
+    }
+  }
+
+  /*!
+   * \brief Labels the positions added since the last game and writes them.
+   * \param winner The winner (0 or 1), or -1 for a draw.
+   * \return False if a write failed.
+   */
+  bool finishGame(int winner) {
+    for (size_t offset = 0; offset < pending.size(); offset += recordBytes) {
+      std::uint8_t *record = pending.data() + offset;
+      record[1] = winner == -1          ? ResultDraw
+                  : winner == record[0] ? ResultWin
+                                        : ResultLoss;
+    }
+    for (size_t offset = 0; offset < pending.size() && !failed;) {
+      if (file == nullptr && !openShard()) {
+        break;
+      }
+      size_t records = std::min(perShard - inShard,
+                                (pending.size() - offset) / recordBytes);
+      size_t bytes = records * recordBytes;
+      if (std::fwrite(pending.data() + offset, 1, bytes, file) != bytes) {
+        failed = true;
+        break;
+      }
+      offset += bytes;
+      inShard += records;
+      written += records;
+      if (inShard == perShard) {
+        closeShard();
+      }
+    }
+    pending.clear();
+    return !failed;
+  }
+
+  /*!
+   * \brief Drops the positions of an unfinished game.
+   */
+  void discardGame() { pending.clear(); }
+
+  /*!
+   * \brief Writes the header of the current shard and closes it.
+   * \return False if any write failed.
+   */
+  bool close() {
+    if (file != nullptr) {
+      closeShard();
+    }
+    return !failed;
+  }
+
+  /*!
+   * \brief Gets the number of positions written to shards.
+   */
+  std::uint64_t positionsWritten() const { return written; }
+
+  /*!
+   * \brief Gets the paths of the shards written so far.
+   */
+  const std::vector<std::string> &getShards() const { return shards; }
+
+private:
+  bool openShard() {
+    char name[32];
+    std::snprintf(name, sizeof(name), "-%05d.spd", nextShard);
+    std::string path = (std::filesystem::path(directory) / (prefix + name))
+                           .string();
+    nextShard += stride;
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      failed = true;
+      return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    shards.push_back(path);
+    inShard = 0;
+    return writeHeader();
+  }
+
+  bool writeHeader() {
+    std::uint8_t header[ShardFormat::HEADER_SIZE] = {'S', 'P', 'D', '1'};
+    putLE(header + 4, rows, 2);
+    putLE(header + 6, cols, 2);
+    putLE(header + 8, maxUnits, 2);
+    putLE(header + 10, recordBytes, 2);
+    putLE(header + 16, inShard, 8);
+    if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+      failed = true;
+    }
+    return !failed;
+  }
+
+  void closeShard() {
+    if (std::fseek(file, 0, SEEK_SET) != 0 || !writeHeader()) {
+      failed = true;
+    }
+    if (std::fclose(file) != 0) {
+      failed = true;
+    }
+    file = nullptr;
+  }
+
+  std::string directory;
+  std::string prefix;
+  int rows;
+  int cols;
+  int maxUnits;
+  size_t recordBytes;
+  size_t perShard;
+  int nextShard;
+  int stride;
+  std::FILE *file;
+  size_t inShard;
+  std::uint64_t written;
+  bool failed;
+  std::vector<std::uint8_t> pending;
+  std::vector<std::string> shards;
+};
+
+/*!
+ * \brief Read-only access to the records of one shard.
+ *
+ * On POSIX systems the file is mapped, so opening costs nothing and only
+ * the records read are paged in; elsewhere it is read into memory.
+ */
+class ShardReader {
+public:
+  ShardReader()
+      : rows(0), cols(0), maxUnits(0), recordBytes(0), count(0) {}
+
+  ShardReader(const ShardReader &) = delete;
+  ShardReader &operator=(const ShardReader &) = delete;
+
+  ~ShardReader() { close(); }
+
+  /*!
+   * \brief Lists the shards of a directory in name order.
+   * \param directory The directory of the shards.
+   * \param prefix The file name prefix given to ShardWriter.
+   * \return The paths of the shards.
+   */
+  static std::vector<std::string> listShards(const std::string &directory,
+                                             const std::string &prefix) {
+    std::vector<std::string> paths;
+    std::error_code error;
+    for (std::filesystem::directory_iterator entry(directory, error), end;
+         !error && entry != end; entry.increment(error)) {
+      std::string name = entry->path().filename().string();
+      if (name.rfind(prefix + "-", 0) == 0 && name.size() > 4 &&
+          name.compare(name.size() - 4, 4, ".spd") == 0) {
+        paths.push_back(entry->path().string());
+      }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  }
+
+  /*!
+   * \brief Opens a shard.
+   * \param path The path of the shard.
+   * \return False if the file is missing, malformed or truncated.
+   */
+  bool open(const std::string &path) {
+    close();
+    return file.open(path) && readHeader();
+  }
+
+  /*!
+   * \brief Releases the shard.
+   */
+  void close() {
+    file.close();
+    count = 0;
+  }
+
+  /*!
+   * \brief Gets the number of records.
+   */
+  size_t size() const { return count; }
+
+  int getRows() const { return rows; }
+
+  int getCols() const { return cols; }
+
+  int getMaxUnits() const { return maxUnits; }
+
+  /*!
+   * \brief Gets the raw bytes of a record, laid out as in ShardFormat.
+   * \param index The index of the record, below size().
+   */
+  const std::uint8_t *record(size_t index) const {
+    return file.data() + ShardFormat::HEADER_SIZE + index * recordBytes;
+  }
+
+  /*!
+   * \brief Gets the label of a record.
+   * \param index The index of the record, below size().
+   * \return The result for the side to move.
+   */
+  TrainingResult result(size_t index) const {
+    return static_cast<TrainingResult>(record(index)[1]);
+  }
+
+  /*!
+   * \brief Rebuilds the position of a record, terrain included.
+   * \param index The index of the record, below size().
+   * \param state Receives the battle position; its board must have the
+   * shard's size and room for the units.
+   * \return False if the record does not fit the state.
+   */
+  bool read(size_t index, GameState &state) const {
+    if (state.getRows() != rows || state.getCols() != cols) {
+      return false;
+    }
+    const std::uint8_t *data = record(index);
+    const std::uint8_t *tall = data + ShardFormat::RECORD_HEADER_SIZE;
+    for (int cell = 0; cell < rows * cols; ++cell) {
+      state.setTall(cell, (tall[cell >> 3] >> (cell & 7)) & 1);
+    }
+    const std::uint8_t *slot = tall + ShardFormat::tallBytes(rows, cols);
+    std::vector<Unit> armies[2];
+    for (int player = 0; player < 2; ++player) {
+      int units = std::min<int>(data[4 + player], maxUnits);
+      for (int k = 0; k < units; ++k) {
+        const std::uint8_t *unit =
+            slot + (player * maxUnits + k) * ShardFormat::UNIT_SIZE;
+        armies[player].push_back(
+            Unit{unit[2], unit[3],
+                 static_cast<int>(getLE(unit, 2))});
+      }
+    }
+    return state.restore(armies, data[0], false,
+                         static_cast<int>(getLE(data + 2, 2)));
+  }
+
+private:
+  bool readHeader() {
+    const std::uint8_t *base = file.data();
+    size_t size = file.size();
+    if (size < ShardFormat::HEADER_SIZE || std::memcmp(base, "SPD1", 4) != 0) {
+      close();
+      return false;
+    }
+    rows = static_cast<int>(getLE(base + 4, 2));
+    cols = static_cast<int>(getLE(base + 6, 2));
+    maxUnits = static_cast<int>(getLE(base + 8, 2));
+    recordBytes = static_cast<size_t>(getLE(base + 10, 2));
+    std::uint64_t records = getLE(base + 16, 8);
+    if (rows <= 0 || cols <= 0 ||
+        recordBytes != ShardFormat::recordSize(rows, cols, maxUnits) ||
+        records > (size - ShardFormat::HEADER_SIZE) / recordBytes) {
+      close();
+      return false;
+    }
+    count = static_cast<size_t>(records);
+    return true;
+  }
+
+  MappedFile file;
+  int rows;
+  int cols;
+  int maxUnits;
+  size_t recordBytes;
+  size_t count;
+};
+
+/*!
+ * \brief The settings of self-play data generation.
+ */
+struct SelfPlayConfig {
+  int rows = 8;
+  int cols = 8;
+  int maxNPC = 3;
+  int number_of_tall = 4;
+  int maxTurns = 300;
+  /*!
+   * \brief Every sampleEvery-th battle position is recorded.
+   */
+  int sampleEvery = 1;
+  /*!
+   * \brief Percentage of moves chosen by one-ply Evaluator search instead of
+   * uniformly at random, so that outcomes follow the positions more closely.
+   */
+  int greedyPercent = 0;
+};
+
+/*!
+ * \brief Plays one game and records its sampled battle positions.
+ *
+ * Placement is random as in simulateRandomGame(); a game that hits
+ * maxTurns or has no legal action is a draw.
+ * \param config The game and sampling settings.
+ * \param seed The seed of the game.
+ * \param writer Receives the positions with the final result.
+ * \param evaluator Scores the children for greedy moves.
+ * \return The winner (0 or 1), or -1 for a draw.
+ */
+inline int playTrainingGame(const SelfPlayConfig &config, std::uint32_t seed,
+                            ShardWriter &writer, Evaluator &evaluator) {
+  TraceScope scope("selfplay.game");
+  GameState state(config.rows, config.cols, config.maxNPC);
+  state.generateTall(seed, config.number_of_tall);
+  std::mt19937 rng(seed);
+  std::vector<Action> actions;
+  while (state.isPlacement()) {
+    state.generateActions(actions);
+    if (actions.empty()) {
+      writer.discardGame();
+      return -1;
+    }
+    size_t places = actions.size();
+    if (actions.back().kind == FinishPlacement) {
+      places -= 1;
+    }
+    state.apply(places > 0 ? actions[rng() % places] : actions.back());
+  }
+  int sampleEvery = std::max(config.sampleEvery, 1);
+  ActionUndo undo;
+  while (!state.isFinished() && state.getTurn() < config.maxTurns) {
+    state.generateActions(actions);
+    if (actions.empty()) {
+      break;
+    }
+    if (state.getTurn() % sampleEvery == 0) {
+      writer.add(state);
+    }
+    size_t choice = rng() % actions.size();
+    if (static_cast<int>(rng() % 100) < config.greedyPercent) {
+      int best = -Evaluator::WIN_SCORE - 1;
+      for (size_t k = 0; k < actions.size(); ++k) {
+        state.make(actions[k], undo);
+        int score = -evaluator.evaluate(state);
+        state.unmake(undo);
+        if (score > best) {
+          best = score;
+          choice = k;
+        }
+      }
+    }
+    state.apply(actions[choice]);
+  }
+  int winner = state.getWinner();
+  writer.finishGame(winner);
+  return winner;
+}
+
+#endif
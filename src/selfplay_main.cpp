@@ -0,0 +1,120 @@
+/*!
+ * \file selfplay_main.cpp
+ * \brief Generates labeled training positions from self-play games
+ *
+ * Each thread plays its share of the games and writes its own shards:
+ *   strateg_selfplay --games=100000 --threads=8 --out=data --shard-size=1000000
+ *
+ * --greedy=PERCENT picks that share of moves by one-ply search with the
+ * static evaluation instead of at random. With STRATEG_TRACE=path set, the
+ * games are saved there as a Chrome trace.
+ */
+
+#include "selfplay.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char **argv) {
+  int games = 10000;
+  int threads = 0;
+  std::string out = "selfplay";
+  std::string prefix = "selfplay";
+  size_t shardSize = 1 << 20;
+  std::uint32_t seed = 1;
+  SelfPlayConfig config;
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string text = arg.substr(arg.find('=') + 1);
+    int value = std::atoi(text.c_str());
+    if (arg.rfind("--games=", 0) == 0) {
+      games = value;
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = value;
+    } else if (arg.rfind("--out=", 0) == 0) {
+      out = text;
+    } else if (arg.rfind("--prefix=", 0) == 0) {
+      prefix = text;
+    } else if (arg.rfind("--shard-size=", 0) == 0) {
+      shardSize = static_cast<size_t>(std::atoll(text.c_str()));
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      seed = static_cast<std::uint32_t>(value);
+    } else if (arg.rfind("--rows=", 0) == 0) {
+      config.rows = value;
+    } else if (arg.rfind("--cols=", 0) == 0) {
+      config.cols = value;
+    } else if (arg.rfind("--max-npc=", 0) == 0) {
+      config.maxNPC = value;
+    } else if (arg.rfind("--tall=", 0) == 0) {
+      config.number_of_tall = value;
+    } else if (arg.rfind("--max-turns=", 0) == 0) {
+      config.maxTurns = value;
+    } else if (arg.rfind("--sample-every=", 0) == 0) {
+      config.sampleEvery = value;
+    } else if (arg.rfind("--greedy=", 0) == 0) {
+      config.greedyPercent = value;
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+  if (threads <= 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::atomic<int> nextGame(0);
+  std::atomic<std::uint64_t> positions(0);
+  std::atomic<int> results[3] = {{0}, {0}, {0}};
+  std::atomic<bool> failed(false);
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  const char *tracePath = std::getenv("STRATEG_TRACE");
+  if (tracePath != nullptr) {
+    Trace::enable();
+  }
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      if (tracePath != nullptr) {
+        Trace::setThreadName("selfplay-" + std::to_string(t));
+      }
+      ShardWriter writer(out, prefix, config.rows, config.cols, config.maxNPC,
+                         shardSize, t, threads);
+      Evaluator evaluator;
+      for (int game = nextGame++; game < games; game = nextGame++) {
+        int winner = playTrainingGame(config, seed + game, writer, evaluator);
+        results[winner + 1] += 1;
+      }
+      if (!writer.close()) {
+        failed = true;
+      }
+      positions += writer.positionsWritten();
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  if (tracePath != nullptr && !Trace::writeChromeTrace(tracePath)) {
+    std::cerr << "Cannot write the trace to " << tracePath << std::endl;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "Games: " << games << " on " << threads << " threads (Player 1: "
+            << results[1] << ", Player 2: " << results[2]
+            << ", draws: " << results[0] << ")" << std::endl;
+  std::cout << "Positions: " << positions << " in " << elapsed.count()
+            << " s (" << positions / elapsed.count() * 60
+            << " positions/min)" << std::endl;
+  std::cout << "Record size: "
+            << ShardFormat::recordSize(config.rows, config.cols, config.maxNPC)
+            << " bytes" << std::endl;
+  if (failed) {
+    std::cerr << "Error writing shards to " << out << std::endl;
+    return 1;
+  }
+  return 0;
+}
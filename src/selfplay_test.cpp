@@ -0,0 +1,108 @@
+#include "doctest.h"
+#include "selfplay.h"
+#include <fstream>
+
+static const char *TEST_DIR = "selfplay_test_data";
+
+TEST_CASE("ShardWriter Class: Positions Round Trip Through Shards") {
+    std::filesystem::remove_all(TEST_DIR);
+    std::vector<GameState> expected;
+    std::vector<int> results;
+    {
+        ShardWriter writer(TEST_DIR, "games", 9, 7, 4, 50);
+        for (std::uint32_t seed = 0; seed < 6; ++seed) {
+            GameState state(9, 7, 4);
+            state.generateTall(seed, 10);
+            std::mt19937 rng(seed);
+            std::vector<Action> actions;
+            while (state.isPlacement()) {
+                state.generateActions(actions);
+                size_t places = actions.size() - (actions.back().kind == FinishPlacement);
+                state.apply(places > 0 ? actions[rng() % places] : actions.back());
+            }
+            size_t first = expected.size();
+            while (!state.isFinished() && state.getTurn() < 40) {
+                state.generateActions(actions);
+                if (actions.empty()) {
+                    break;
+                }
+                writer.add(state);
+                expected.push_back(state);
+                state.apply(actions[rng() % actions.size()]);
+            }
+            int winner = seed == 5 ? 1 : state.getWinner();
+            for (size_t k = first; k < expected.size(); ++k) {
+                results.push_back(winner == -1 ? ResultDraw
+                                  : winner == expected[k].getSideToMove() ? ResultWin
+                                                                          : ResultLoss);
+            }
+            REQUIRE(writer.finishGame(winner));
+        }
+        // An abandoned game leaves nothing behind.
+        writer.add(expected.front());
+        writer.discardGame();
+        REQUIRE(writer.close());
+        CHECK(writer.positionsWritten() == expected.size());
+        CHECK(writer.getShards().size() == (expected.size() + 49) / 50);
+    }
+
+    std::vector<std::string> shards = ShardReader::listShards(TEST_DIR, "games");
+    REQUIRE(shards.size() == (expected.size() + 49) / 50);
+    size_t index = 0;
+    GameState state(9, 7, 4);
+    for (const std::string &path : shards) {
+        ShardReader reader;
+        REQUIRE(reader.open(path));
+        CHECK(reader.getRows() == 9);
+        CHECK(reader.getCols() == 7);
+        CHECK(reader.size() <= 50);
+        for (size_t k = 0; k < reader.size(); ++k, ++index) {
+            REQUIRE(index < expected.size());
+            REQUIRE(reader.read(k, state));
+            CHECK(reader.result(k) == results[index]);
+            const GameState &original = expected[index];
+            CHECK(state.hash() == original.hash());
+            CHECK(state.getSideToMove() == original.getSideToMove());
+            CHECK(state.getTurn() == original.getTurn());
+        }
+    }
+    CHECK(index == expected.size());
+    std::filesystem::remove_all(TEST_DIR);
+}
+
+TEST_CASE("ShardReader Class: Rejects Damaged Shards") {
+    std::filesystem::remove_all(TEST_DIR);
+    std::string path;
+    {
+        ShardWriter writer(TEST_DIR, "damaged", 8, 8, 3);
+        Evaluator evaluator;
+        SelfPlayConfig config;
+        playTrainingGame(config, 3, writer, evaluator);
+        REQUIRE(writer.close());
+        REQUIRE(writer.positionsWritten() > 0);
+        path = writer.getShards()[0];
+    }
+    ShardReader reader;
+    REQUIRE(reader.open(path));
+    size_t records = reader.size();
+    reader.close();
+
+    // A truncated shard, e.g. from a crashed writer, is refused.
+    std::uintmax_t size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, size - 1);
+    CHECK_FALSE(reader.open(path));
+    std::filesystem::resize_file(path, size);
+    REQUIRE(reader.open(path));
+    CHECK(reader.size() == records);
+    GameState wrongSize(9, 9, 3);
+    CHECK_FALSE(reader.read(0, wrongSize));
+    reader.close();
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(0);
+        file.put('X');
+    }
+    CHECK_FALSE(reader.open(path));
+    CHECK_FALSE(reader.open(std::string(TEST_DIR) + "/missing.spd"));
+    std::filesystem::remove_all(TEST_DIR);
+}
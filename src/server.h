@@ -0,0 +1,791 @@
+#ifndef SERVER
+#define SERVER
+
+#include "game.h"
+#include "mapped_file.h"
+#include "protocol.h"
+#include "snapshot.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
+/*!
+ * \brief The settings of a hosted match.
+ */
+struct MatchConfig {
+  int rows = 8;
+  int cols = 8;
+  int maxNPC = 3;
+  int number_of_tall = 4;
+  std::uint32_t seed = 0;
+  int maxTurns = 1000;
+  int hashInterval = 1;
+};
+
+/*!
+ * \brief The result of one submitted action, sent to the match listeners.
+ *
+ * Accepted actions go to every listener of the match, rejected ones only to
+ * the seat that sent them. Every hashInterval-th accepted action carries the
+ * hash of the resulting state so that lockstep clients, which only replay
+ * actions, can verify their copy.
+ */
+struct MatchUpdate {
+  int matchId;
+  std::uint32_t sequence;
+  Action action;
+  bool accepted;
+  bool finished;
+  int winner;
+  bool hashed;
+  std::uint64_t hash;
+  /*!
+   * \brief True for the last update of a match a seated player left; only
+   * finished and winner count then, action names the player who left.
+   */
+  bool forfeited;
+};
+
+/*!
+ * \brief An encoded batch shared read-only by every spectator of a match.
+ */
+typedef std::shared_ptr<const std::vector<std::uint8_t>> SharedBatch;
+
+/*!
+ * \brief Hosts many independent matches in one process.
+ *
+ * Each match owns its GameState and a queue of submitted actions. A match with
+ * queued actions is handed to the worker pool as one task, and only one
+ * worker processes a given match at a time, so actions are applied in
+ * submission order without a lock per action. Hosting cost therefore grows
+ * with the number of busy matches and cores, not with the number of matches.
+ */
+class MatchServer {
+public:
+  typedef std::function<void(const MatchUpdate &)> Listener;
+  typedef std::function<bool(const SharedBatch &)> FeedListener;
+
+  /*!
+   * \brief Constructor for MatchServer with specified parameters.
+   * \param workers The number of worker threads, 0 for one per core.
+   */
+  explicit MatchServer(int workers = 0)
+      : nextId(0), processed(0), finishedMatches(0), desyncCount(0),
+        feedEncodes(0), pool(workers) {}
+
+  /*!
+   * \brief Waits for the queued work before the matches are destroyed.
+   */
+  ~MatchServer() { pool.wait(); }
+
+  /*!
+   * \brief Creates a match in its deployment phase.
+   * \param config The settings of the match.
+   * \return The id of the new match.
+   */
+  int createMatch(const MatchConfig &config) {
+    std::shared_ptr<Match> match(new Match(config));
+    match->state.generateTall(config.seed, config.number_of_tall);
+    std::unique_lock<std::shared_mutex> lock(tableMutex);
+    match->id = nextId++;
+    matches[match->id] = match;
+    return match->id;
+  }
+
+  /*!
+   * \brief Registers a listener for the updates of a match.
+   *
+   * Listeners run on the worker processing the match and may call submit(),
+   * but not join() or copyState() for the same match.
+   * \param matchId The id of the match.
+   * \param player The seat (0 or 1), or -1 for a spectator.
+   * \param listener The function receiving updates.
+   * \param state If not null, receives the state the first update applies to.
+   * \return True if the match exists, false otherwise.
+   */
+  bool join(int matchId, int player, Listener listener,
+            GameState *state = nullptr) {
+    std::shared_ptr<Match> match = find(matchId);
+    if (!match) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(match->stateMutex);
+    if (state != nullptr) {
+      *state = match->state;
+    }
+    if (player == 0 || player == 1) {
+      match->seats[player] = std::move(listener);
+    } else {
+      match->spectators.push_back(std::move(listener));
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Subscribes to the wire-format spectator feed of a match.
+   *
+   * The listener first receives a snapshot batch, then one delta batch per
+   * accepted action (with the lockstep hash and the game over notice when
+   * due). Each batch is encoded once and handed to every subscriber, so the
+   * cost per spectator is a pointer copy. Snapshots are cached until the
+   * next action, so a crowd joining at once shares one encode as well.
+   * \param matchId The id of the match.
+   * \param listener Called on the match worker; returning false unsubscribes.
+   * \return False if the match does not exist or its snapshot is larger
+   * than a payload.
+   */
+  bool subscribe(int matchId, FeedListener listener) {
+    std::shared_ptr<Match> match = find(matchId);
+    if (!match) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(match->stateMutex);
+    if (!match->snapshot || match->snapshotSequence != match->sequence) {
+      std::shared_ptr<std::vector<std::uint8_t>> batch(
+          new std::vector<std::uint8_t>());
+      thread_local std::vector<std::uint8_t> payload;
+      payload.clear();
+      StateCodec::encodeSnapshot(match->state, payload);
+      FrameWriter writer(*batch);
+      if (!writer.writePayload(SnapshotPayload, match->sequence,
+                               payload.data(), payload.size())) {
+        return false;
+      }
+      if (match->finished) {
+        writer.writeGameOver(match->state.getWinner());
+      }
+      match->snapshot = batch;
+      match->snapshotSequence = match->sequence;
+      feedEncodes.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (listener(match->snapshot)) {
+      match->feed.push_back(std::move(listener));
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Queues an action for a match.
+   * \param matchId The id of the match.
+   * \param action The action, with player set to the sender's seat.
+   * \return True if the match exists, false otherwise.
+   */
+  bool submit(int matchId, const Action &action) {
+    std::shared_ptr<Match> match = find(matchId);
+    if (!match) {
+      return false;
+    }
+    bool schedule = false;
+    {
+      std::lock_guard<std::mutex> lock(match->queueMutex);
+      if (match->detached) {
+        return false;
+      }
+      match->queue.push_back(action);
+      if (!match->scheduled) {
+        match->scheduled = true;
+        schedule = true;
+      }
+    }
+    if (schedule) {
+      pool.post([this, match] { run(match); });
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Copies the current state of a match.
+   * \param matchId The id of the match.
+   * \param out Receives the state.
+   * \return True if the match exists, false otherwise.
+   */
+  bool copyState(int matchId, GameState &out) const {
+    std::shared_ptr<Match> match = find(matchId);
+    if (!match) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(match->stateMutex);
+    out = match->state;
+    return true;
+  }
+
+  /*!
+   * \brief Serializes a match so that another process can resume it.
+   *
+   * The checkpoint is a protocol batch: a PayloadFrame of kind
+   * CheckpointPayload whose second argument is the sequence, followed by one
+   * action frame per queued action. Its payload holds rows, cols, maxNPC and
+   * number_of_tall as 16-bit little-endian, seed, maxTurns and hashInterval
+   * as 32-bit little-endian, a finished byte and a StateCodec snapshot. The
+   * rules are deterministic, so the seed is the only random state.
+   *
+   * With detach the match is removed in the same step: no action is accepted
+   * after the checkpoint, and later submits fail.
+   * \param matchId The id of the match.
+   * \param out The buffer the checkpoint is appended to.
+   * \param detach Whether to remove the match.
+   * \return False if the match does not exist, is detached, or its state
+   * is larger than a payload.
+   */
+  bool checkpoint(int matchId, std::vector<std::uint8_t> &out,
+                  bool detach = false) {
+    std::shared_ptr<Match> match = find(matchId);
+    if (!match) {
+      return false;
+    }
+    if (detach) {
+      closeMatch(matchId);
+    }
+    // Workers take the queue under stateMutex, so an action is either in the
+    // state or still queued here.
+    std::lock_guard<std::mutex> stateLock(match->stateMutex);
+    std::lock_guard<std::mutex> queueLock(match->queueMutex);
+    if (match->detached) {
+      return false;
+    }
+    match->detached = detach;
+    thread_local std::vector<std::uint8_t> payload;
+    payload.clear();
+    const MatchConfig &config = match->config;
+    const std::uint32_t settings[] = {
+        static_cast<std::uint32_t>(config.rows),
+        static_cast<std::uint32_t>(config.cols),
+        static_cast<std::uint32_t>(config.maxNPC),
+        static_cast<std::uint32_t>(config.number_of_tall)};
+    for (std::uint32_t value : settings) {
+      appendLE(payload, value, 2);
+    }
+    appendLE(payload, config.seed, 4);
+    appendLE(payload, static_cast<std::uint32_t>(config.maxTurns), 4);
+    appendLE(payload, static_cast<std::uint32_t>(config.hashInterval), 4);
+    payload.push_back(match->finished ? 1 : 0);
+    StateCodec::encodeSnapshot(match->state, payload);
+
+    FrameWriter writer(out);
+    if (!writer.writePayload(CheckpointPayload, match->sequence,
+                             payload.data(), payload.size())) {
+      // Too large for a batch: the match stays here.
+      match->detached = false;
+      if (detach) {
+        std::unique_lock<std::shared_mutex> lock(tableMutex);
+        matches[matchId] = match;
+      }
+      return false;
+    }
+    for (const Action &action : match->queue) {
+      writer.writeAction(action, 0);
+    }
+    if (detach) {
+      match->queue.clear();
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Creates a match from a checkpoint and processes its queued
+   * actions.
+   *
+   * Clients join the new match as usual; join() hands them the restored
+   * state.
+   * \param data The checkpoint bytes.
+   * \param size The number of bytes.
+   * \return The id of the new match, -1 if the checkpoint is malformed.
+   */
+  int restoreMatch(const std::uint8_t *data, size_t size) {
+    const std::uint8_t *payload = nullptr;
+    size_t payloadSize = 0;
+    std::uint32_t sequence = 0;
+    std::vector<Action> queue;
+    bool valid = true;
+    bool error = false;
+    size_t used = parseBatches(data, size, [&](FrameView frame) {
+      if (payload == nullptr && frame.type() == PayloadFrame &&
+          frame.tag() == CheckpointPayload) {
+        payload = frame.payload();
+        payloadSize = frame.first();
+        sequence = frame.second();
+      } else if (payload != nullptr && frame.isAction()) {
+        queue.push_back(frame.toAction());
+      } else {
+        valid = false;
+      }
+    }, error);
+    if (error || !valid || used != size || payload == nullptr ||
+        payloadSize < CHECKPOINT_SETTINGS_SIZE) {
+      return -1;
+    }
+    MatchConfig config;
+    config.rows = static_cast<int>(getLE(payload, 2));
+    config.cols = static_cast<int>(getLE(payload + 2, 2));
+    config.maxNPC = static_cast<int>(getLE(payload + 4, 2));
+    config.number_of_tall = static_cast<int>(getLE(payload + 6, 2));
+    config.seed = static_cast<std::uint32_t>(getLE(payload + 8, 4));
+    config.maxTurns = static_cast<int>(getLE(payload + 12, 4));
+    config.hashInterval = static_cast<int>(getLE(payload + 16, 4));
+    std::shared_ptr<Match> match(new Match(config));
+    if (!StateCodec::decodeSnapshot(payload + CHECKPOINT_SETTINGS_SIZE,
+                                    payloadSize - CHECKPOINT_SETTINGS_SIZE,
+                                    match->state) ||
+        match->state.getRows() != config.rows ||
+        match->state.getCols() != config.cols) {
+      return -1;
+    }
+    match->sequence = sequence;
+    match->finished = payload[CHECKPOINT_SETTINGS_SIZE - 1] != 0;
+    match->queue.swap(queue);
+    match->scheduled = !match->queue.empty();
+    int id;
+    {
+      std::unique_lock<std::shared_mutex> lock(tableMutex);
+      id = match->id = nextId++;
+      matches[id] = match;
+    }
+    if (match->scheduled) {
+      pool.post([this, match] { run(match); });
+    }
+    return id;
+  }
+
+  /*!
+   * \brief Gets the ids of the hosted matches.
+   */
+  std::vector<int> matchIds() const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    std::vector<int> ids;
+    ids.reserve(matches.size());
+    for (const std::pair<const int, std::shared_ptr<Match>> &entry : matches) {
+      ids.push_back(entry.first);
+    }
+    return ids;
+  }
+
+  /*!
+   * \brief Ends a match because a seated player left, and removes it.
+   *
+   * Unless the match already has a result, the other player wins: the
+   * listeners receive a forfeited update and the feed a game over notice.
+   * Actions still queued are rejected.
+   * \param matchId The id of the match.
+   * \param player The seat of the player who left.
+   * \return True if the match exists, false otherwise.
+   */
+  bool forfeit(int matchId, int player) {
+    std::shared_ptr<Match> match = find(matchId);
+    if (!match) {
+      return false;
+    }
+    closeMatch(matchId);
+    std::lock_guard<std::mutex> lock(match->stateMutex);
+    if (match->finished) {
+      return true;
+    }
+    match->finished = true;
+    finishedMatches.fetch_add(1, std::memory_order_relaxed);
+    MatchUpdate update;
+    update.matchId = match->id;
+    update.sequence = match->sequence;
+    update.action = GameState::makeAction(FinishPlacement, player, 0, -1, -1);
+    update.accepted = false;
+    update.finished = true;
+    update.winner = 1 - player;
+    update.hashed = false;
+    update.hash = 0;
+    update.forfeited = true;
+    for (int seat = 0; seat < 2; ++seat) {
+      if (match->seats[seat]) {
+        match->seats[seat](update);
+      }
+    }
+    for (const Listener &spectator : match->spectators) {
+      spectator(update);
+    }
+    if (!match->feed.empty()) {
+      std::shared_ptr<std::vector<std::uint8_t>> batch(
+          new std::vector<std::uint8_t>());
+      FrameWriter(*batch).writeGameOver(update.winner);
+      feedEncodes.fetch_add(1, std::memory_order_relaxed);
+      send(*match, batch);
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Records that a client's copy of a match diverged from the server.
+   */
+  void reportDesync() {
+    desyncCount.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /*!
+   * \brief Removes a match. Queued actions of the match are dropped.
+   * \param matchId The id of the match.
+   */
+  void closeMatch(int matchId) {
+    std::unique_lock<std::shared_mutex> lock(tableMutex);
+    matches.erase(matchId);
+  }
+
+  /*!
+   * \brief Blocks until no match has queued actions.
+   */
+  void drain() { pool.wait(); }
+
+  /*!
+   * \brief Gets the number of hosted matches.
+   */
+  size_t matchCount() const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    return matches.size();
+  }
+
+  /*!
+   * \brief Gets the number of actions processed since start.
+   */
+  std::uint64_t actionsProcessed() const { return processed.load(); }
+
+  /*!
+   * \brief Gets the number of matches that reached a result.
+   */
+  std::uint64_t matchesFinished() const { return finishedMatches.load(); }
+
+  /*!
+   * \brief Gets the number of desyncs reported by clients.
+   */
+  std::uint64_t desyncs() const { return desyncCount.load(); }
+
+  /*!
+   * \brief Gets the number of spectator batches encoded since start.
+   */
+  std::uint64_t feedBatches() const { return feedEncodes.load(); }
+
+  /*!
+   * \brief Gets the number of worker threads.
+   */
+  int workerCount() const { return pool.size(); }
+
+private:
+  struct Match {
+    explicit Match(const MatchConfig &config)
+        : id(-1), config(config),
+          state(config.rows, config.cols, config.maxNPC), scheduled(false),
+          detached(false), sequence(0), finished(false), snapshotSequence(0) {}
+
+    int id;
+    MatchConfig config;
+    GameState state;
+
+    std::mutex queueMutex;
+    std::vector<Action> queue;
+    bool scheduled;
+    bool detached;
+
+    std::mutex stateMutex;
+    Listener seats[2];
+    std::vector<Listener> spectators;
+    std::uint32_t sequence;
+    bool finished;
+
+    std::vector<FeedListener> feed;
+    SharedBatch snapshot;
+    std::uint32_t snapshotSequence;
+  };
+
+  std::shared_ptr<Match> find(int matchId) const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    std::unordered_map<int, std::shared_ptr<Match>>::const_iterator found =
+        matches.find(matchId);
+    return found == matches.end() ? std::shared_ptr<Match>() : found->second;
+  }
+
+  /*!
+   * \brief Processes the actions queued for a match, then reschedules it if
+   * more arrived meanwhile.
+   */
+  void run(const std::shared_ptr<Match> &match) {
+    TraceScope scope("server.match");
+    thread_local std::vector<Action> batch;
+    {
+      std::lock_guard<std::mutex> lock(match->stateMutex);
+      {
+        std::lock_guard<std::mutex> queueLock(match->queueMutex);
+        batch.swap(match->queue);
+      }
+      for (const Action &action : batch) {
+        process(*match, action);
+      }
+    }
+    processed.fetch_add(batch.size(), std::memory_order_relaxed);
+    batch.clear();
+
+    bool again = false;
+    {
+      std::lock_guard<std::mutex> lock(match->queueMutex);
+      if (match->queue.empty()) {
+        match->scheduled = false;
+      } else {
+        again = true;
+      }
+    }
+    if (again) {
+      pool.post([this, match] { run(match); });
+    }
+  }
+
+  /*!
+   * \brief Applies one action and notifies the listeners.
+   */
+  void process(Match &match, const Action &action) {
+    MatchUpdate update;
+    update.matchId = match.id;
+    update.action = action;
+    update.accepted = !match.finished && match.state.apply(action);
+    if (update.accepted) {
+      ++match.sequence;
+      if (match.state.isFinished() || isDrawn(match)) {
+        match.finished = true;
+        finishedMatches.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    update.sequence = match.sequence;
+    update.finished = match.finished;
+    update.winner = match.state.getWinner();
+    update.hashed = update.accepted && match.config.hashInterval > 0 &&
+                    match.sequence % match.config.hashInterval == 0;
+    update.hash = update.hashed ? match.state.hash() : 0;
+    update.forfeited = false;
+
+    if (!update.accepted) {
+      if (action.player < 2 && match.seats[action.player]) {
+        match.seats[action.player](update);
+      }
+      return;
+    }
+    for (int seat = 0; seat < 2; ++seat) {
+      if (match.seats[seat]) {
+        match.seats[seat](update);
+      }
+    }
+    for (const Listener &spectator : match.spectators) {
+      spectator(update);
+    }
+    if (!match.feed.empty()) {
+      publish(match, update);
+    }
+  }
+
+  /*!
+   * \brief Encodes the delta of an accepted action once and hands the same
+   * batch to every feed subscriber.
+   */
+  void publish(Match &match, const MatchUpdate &update) {
+    std::shared_ptr<std::vector<std::uint8_t>> batch(
+        new std::vector<std::uint8_t>());
+    thread_local std::vector<std::uint8_t> payload;
+    payload.clear();
+    StateCodec::encodeDelta(match.state, update.action, payload);
+    FrameWriter writer(*batch);
+    writer.writePayload(DeltaPayload, update.sequence, payload.data(),
+                        payload.size());
+    if (update.hashed) {
+      writer.writeHash(update.sequence, update.hash);
+    }
+    if (update.finished) {
+      writer.writeGameOver(update.winner);
+    }
+    feedEncodes.fetch_add(1, std::memory_order_relaxed);
+    send(match, batch);
+  }
+
+  /*!
+   * \brief Hands a batch to every feed subscriber, dropping those that
+   * unsubscribe.
+   */
+  static void send(Match &match, const SharedBatch &shared) {
+    size_t kept = 0;
+    for (size_t k = 0; k < match.feed.size(); ++k) {
+      if (match.feed[k](shared)) {
+        if (kept != k) {
+          match.feed[kept] = std::move(match.feed[k]);
+        }
+        ++kept;
+      }
+    }
+    match.feed.resize(kept);
+  }
+
+  /*!
+   * \brief Checks the server-side draw rules: the turn limit was reached or
+   * the side to move has no legal action.
+   */
+  static bool isDrawn(const Match &match) {
+    const GameState &state = match.state;
+    if (state.isPlacement()) {
+      return false;
+    }
+    if (state.getTurn() >= match.config.maxTurns) {
+      return true;
+    }
+    thread_local std::vector<Action> actions;
+    state.generateActions(actions);
+    return actions.empty();
+  }
+
+  static const size_t CHECKPOINT_SETTINGS_SIZE = 21;
+
+  mutable std::shared_mutex tableMutex;
+  std::unordered_map<int, std::shared_ptr<Match>> matches;
+  int nextId;
+  std::atomic<std::uint64_t> processed;
+  std::atomic<std::uint64_t> finishedMatches;
+  std::atomic<std::uint64_t> desyncCount;
+  std::atomic<std::uint64_t> feedEncodes;
+  ThreadPool pool;
+};
+
+/*!
+ * \brief Picks a random legal action for a seat of a match.
+ *
+ * During deployment seat 0 also starts the battle once both armies are
+ * complete; other seats never send FinishPlacement.
+ * \param state The client's copy of the match.
+ * \param player The seat (0 or 1).
+ * \param rng The random engine.
+ * \param scratch Reused storage for the generated actions.
+ * \param out Receives the chosen action.
+ * \return True if the seat has an action, false otherwise.
+ */
+inline bool chooseSeatAction(const GameState &state, int player,
+                             std::mt19937 &rng, std::vector<Action> &scratch,
+                             Action &out) {
+  state.generateActions(scratch);
+  size_t count = 0;
+  for (const Action &candidate : scratch) {
+    bool mine = candidate.player == player;
+    if (state.isPlacement() && candidate.kind == FinishPlacement) {
+      mine = player == 0 &&
+             static_cast<int>(state.getUnits(0).size()) == state.getMaxNPC() &&
+             static_cast<int>(state.getUnits(1).size()) == state.getMaxNPC();
+    }
+    if (mine) {
+      scratch[count++] = candidate;
+    }
+  }
+  if (count == 0) {
+    return false;
+  }
+  out = scratch[rng() % count];
+  return true;
+}
+
+/*!
+ * \brief An in-process client that plays random legal actions for one seat.
+ *
+ * It mirrors the match from the accepted updates and submits its next action
+ * as soon as it is allowed to act, keeping at most one action in flight.
+ */
+class LoopbackClient {
+public:
+  /*!
+   * \brief Constructor for LoopbackClient with specified parameters.
+   * \param server The server hosting the match.
+   * \param matchId The id of the match.
+   * \param player The seat to play (0 or 1).
+   * \param seed The seed of the client's random choices.
+   */
+  LoopbackClient(MatchServer &server, int matchId, int player,
+                 std::uint32_t seed)
+      : server(server), matchId(matchId), player(player), rng(seed),
+        pending(false), finished(false), winner(-1), desyncs(0) {}
+
+  /*!
+   * \brief Takes the seat and submits the first action.
+   * \return True if the match exists, false otherwise.
+   */
+  bool start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!server.join(matchId, player,
+                     [this](const MatchUpdate &update) { onUpdate(update); },
+                     &mirror)) {
+      return false;
+    }
+    act();
+    return true;
+  }
+
+  /*!
+   * \brief Checks if the client saw the end of the match.
+   */
+  bool isFinished() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return finished;
+  }
+
+  /*!
+   * \brief Gets the winner reported by the server, -1 for a draw.
+   */
+  int getWinner() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return winner;
+  }
+
+  /*!
+   * \brief Gets the number of state hashes that did not match the mirror.
+   */
+  int getDesyncs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return desyncs;
+  }
+
+private:
+  void onUpdate(const MatchUpdate &update) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (update.accepted) {
+      mirror.apply(update.action);
+    }
+    if (update.hashed && update.hash != mirror.hash()) {
+      ++desyncs;
+      server.reportDesync();
+    }
+    if (update.action.player == player) {
+      pending = false;
+    }
+    if (update.finished) {
+      finished = true;
+      winner = update.winner;
+      return;
+    }
+    act();
+  }
+
+  /*!
+   * \brief Submits the next action if the client is allowed to act.
+   */
+  void act() {
+    if (pending || finished) {
+      return;
+    }
+    Action action;
+    if (!chooseSeatAction(mirror, player, rng, actions, action)) {
+      return;
+    }
+    pending = true;
+    server.submit(matchId, action);
+  }
+
+  MatchServer &server;
+  int matchId;
+  int player;
+  GameState mirror;
+  std::mt19937 rng;
+  std::vector<Action> actions;
+  mutable std::mutex mutex;
+  bool pending;
+  bool finished;
+  int winner;
+  int desyncs;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*!
+ * \file server_main.cpp
+ * \brief Headless server hosting many matches in one process
+ *
+ * Without a network listener the server plays every match with loopback
+ * clients, which doubles as a capacity self-test:
+ *   strateg_server --matches=2000 --workers=8
+ *
+ * With --port it serves TCP clients until interrupted (Linux only):
+ *   strateg_server --port=7777 --reactors=4 --workers=4
+ */
+
+#include "server.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#ifdef __linux__
+#include "reactor.h"
+#include <csignal>
+#include <time.h>
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void onSignal(int) { interrupted = 1; }
+
+/*!
+ * \brief Serves lobby matches over TCP until SIGINT or SIGTERM.
+ */
+static int serve(int port, int reactors, int workers,
+                 const MatchConfig &config) {
+  MatchServer server(workers);
+  NetServer net(server, config, reactors);
+  if (!net.listen(static_cast<std::uint16_t>(port))) {
+    std::cerr << "Error with port " << port << std::endl;
+    return 2;
+  }
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::cout << "Listening on port " << net.port() << " with "
+            << net.getReactorCount() << " reactors and "
+            << server.workerCount() << " workers" << std::endl;
+  for (int tick = 1; !interrupted; ++tick) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    if (tick % 25 != 0) {
+      continue;
+    }
+    std::cout << "Connections: " << net.connectionCount()
+              << ", matches: " << server.matchCount()
+              << ", finished: " << server.matchesFinished()
+              << ", actions: " << server.actionsProcessed()
+              << ", desyncs: " << server.desyncs() << std::endl;
+    if (server.matchesFinished() > 0) {
+      timespec cpu;
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+      std::cout << "CPU per finished match: "
+                << (cpu.tv_sec * 1e3 + cpu.tv_nsec * 1e-6) /
+                       server.matchesFinished()
+                << " ms" << std::endl;
+    }
+  }
+  net.stop();
+  std::cout << "Sent " << net.bytesWritten() << " bytes in "
+            << net.writeCalls() << " writev calls" << std::endl;
+  return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+  int matchCount = 1000;
+  int workers = 0;
+  int port = -1;
+  int reactors = 0;
+  MatchConfig config;
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    int value = std::atoi(arg.substr(arg.find('=') + 1).c_str());
+    if (arg.rfind("--matches=", 0) == 0) {
+      matchCount = value;
+    } else if (arg.rfind("--workers=", 0) == 0) {
+      workers = value;
+    } else if (arg.rfind("--port=", 0) == 0) {
+      port = value;
+    } else if (arg.rfind("--reactors=", 0) == 0) {
+      reactors = value;
+    } else if (arg.rfind("--rows=", 0) == 0) {
+      config.rows = value;
+    } else if (arg.rfind("--cols=", 0) == 0) {
+      config.cols = value;
+    } else if (arg.rfind("--max-npc=", 0) == 0) {
+      config.maxNPC = value;
+    } else if (arg.rfind("--max-turns=", 0) == 0) {
+      config.maxTurns = value;
+    } else if (arg.rfind("--hash-interval=", 0) == 0) {
+      config.hashInterval = value;
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  if (port >= 0) {
+#ifdef __linux__
+    return serve(port, reactors, workers, config);
+#else
+    std::cerr << "--port needs Linux" << std::endl;
+    return 2;
+#endif
+  }
+
+  MatchServer server(workers);
+  std::vector<std::unique_ptr<LoopbackClient>> clients;
+  for (int k = 0; k < matchCount; ++k) {
+    MatchConfig match = config;
+    match.seed = k;
+    int id = server.createMatch(match);
+    for (int player = 0; player < 2; ++player) {
+      clients.emplace_back(
+          new LoopbackClient(server, id, player, k * 2 + player));
+    }
+  }
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (std::unique_ptr<LoopbackClient> &client : clients) {
+    client->start();
+  }
+  server.drain();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  int wins[3] = {0, 0, 0};
+  for (size_t k = 0; k < clients.size(); k += 2) {
+    wins[clients[k]->getWinner() + 1] += 1;
+  }
+  std::cout << "Matches: " << server.matchCount() << " on "
+            << server.workerCount() << " workers" << std::endl;
+  std::cout << "Finished: " << server.matchesFinished() << " (Player 1: "
+            << wins[1] << ", Player 2: " << wins[2] << ", draws: " << wins[0]
+            << ")" << std::endl;
+  std::cout << "Actions: " << server.actionsProcessed() << " in "
+            << elapsed.count() << " s ("
+            << server.actionsProcessed() / elapsed.count() << " actions/s)"
+            << std::endl;
+  std::cout << "Desyncs: " << server.desyncs() << std::endl;
+  return server.matchesFinished() == static_cast<std::uint64_t>(matchCount) &&
+                 server.desyncs() == 0
+             ? 0
+             : 1;
+}
@@ -0,0 +1,306 @@
+#include "doctest.h"
+#include "server.h"
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+TEST_CASE("MatchServer Class: Loopback Clients Finish Every Match") {
+    MatchServer server(4);
+    std::vector<std::unique_ptr<LoopbackClient>> clients;
+    for (int k = 0; k < 500; ++k) {
+        MatchConfig config;
+        config.seed = k;
+        int id = server.createMatch(config);
+        for (int player = 0; player < 2; ++player) {
+            clients.emplace_back(new LoopbackClient(server, id, player, k * 2 + player));
+        }
+    }
+    for (std::unique_ptr<LoopbackClient> &client : clients) {
+        REQUIRE(client->start());
+    }
+    server.drain();
+
+    CHECK(server.matchCount() == 500);
+    CHECK(server.matchesFinished() == 500);
+    for (size_t k = 0; k < clients.size(); k += 2) {
+        REQUIRE(clients[k]->isFinished());
+        REQUIRE(clients[k]->getWinner() == clients[k + 1]->getWinner());
+        REQUIRE(clients[k]->getDesyncs() == 0);
+    }
+    CHECK(server.desyncs() == 0);
+}
+
+TEST_CASE("MatchServer Class: Rejections Only Reach The Sender") {
+    MatchServer server(2);
+    int id = server.createMatch(MatchConfig());
+    std::vector<MatchUpdate> seat0;
+    std::vector<MatchUpdate> seat1;
+    std::vector<MatchUpdate> spectator;
+    REQUIRE(server.join(id, 0, [&](const MatchUpdate &update) { seat0.push_back(update); }));
+    REQUIRE(server.join(id, 1, [&](const MatchUpdate &update) { seat1.push_back(update); }));
+    REQUIRE(server.join(id, -1, [&](const MatchUpdate &update) { spectator.push_back(update); }));
+    CHECK_FALSE(server.submit(id + 1, Action()));
+
+    server.submit(id, GameState::makeAction(PlaceUnit, 0, 0, -1, 8));
+    server.submit(id, GameState::makeAction(PlaceUnit, 1, 0, -1, 9));
+    server.submit(id, GameState::makeAction(PlaceUnit, 1, 1, -1, 15));
+    server.drain();
+
+    REQUIRE(seat0.size() == 2);
+    REQUIRE(seat1.size() == 3);
+    REQUIRE(spectator.size() == 2);
+    CHECK_FALSE(seat1[1].accepted);
+    CHECK(seat1[2].accepted);
+    CHECK(seat1[2].sequence == 2);
+
+    GameState state;
+    REQUIRE(server.copyState(id, state));
+    CHECK(state.ownerAt(8) == 0);
+    CHECK(state.ownerAt(15) == 1);
+
+    server.closeMatch(id);
+    CHECK(server.matchCount() == 0);
+    CHECK_FALSE(server.copyState(id, state));
+}
+
+TEST_CASE("MatchServer Class: Spectator Feed Is Encoded Once Per Action") {
+    MatchServer server(2);
+    MatchConfig config;
+    config.seed = 3;
+    int id = server.createMatch(config);
+    const int spectators = 1000;
+    std::vector<std::vector<SharedBatch>> received(spectators);
+    for (int k = 0; k < spectators; ++k) {
+        std::vector<SharedBatch> *inbox = &received[k];
+        REQUIRE(server.subscribe(id, [inbox](const SharedBatch &batch) {
+            inbox->push_back(batch);
+            return true;
+        }));
+    }
+    CHECK(server.feedBatches() == 1);
+
+    LoopbackClient first(server, id, 0, 1);
+    LoopbackClient second(server, id, 1, 2);
+    REQUIRE(first.start());
+    REQUIRE(second.start());
+    server.drain();
+    REQUIRE(first.isFinished());
+
+    // One snapshot plus one delta per accepted action, shared by everyone.
+    CHECK(server.feedBatches() == received[0].size());
+    for (int k = 1; k < spectators; ++k) {
+        REQUIRE(received[k].size() == received[0].size());
+        REQUIRE(received[k].back().get() == received[0].back().get());
+    }
+
+    GameState view;
+    GameState final;
+    REQUIRE(server.copyState(id, final));
+    bool over = false;
+    bool error = false;
+    for (const SharedBatch &batch : received[spectators - 1]) {
+        parseBatches(batch->data(), batch->size(), [&](FrameView frame) {
+            if (frame.type() == PayloadFrame && frame.tag() == SnapshotPayload) {
+                REQUIRE(StateCodec::decodeSnapshot(frame.payload(), frame.first(), view));
+            } else if (frame.type() == PayloadFrame) {
+                REQUIRE(StateCodec::applyDelta(frame.payload(), frame.first(), view));
+            } else if (frame.type() == HashFrame) {
+                REQUIRE(frame.checksum() == foldHash(view.hash()));
+            } else if (frame.type() == GameOverFrame) {
+                over = true;
+            }
+        }, error);
+    }
+    CHECK_FALSE(error);
+    CHECK(over);
+    CHECK(view.hash() == final.hash());
+
+    // A late spectator gets a single snapshot of the final state.
+    std::vector<SharedBatch> late;
+    server.subscribe(id, [&late](const SharedBatch &batch) {
+        late.push_back(batch);
+        return false;
+    });
+    REQUIRE(late.size() == 1);
+    CHECK(server.feedBatches() == received[0].size() + 1);
+}
+
+TEST_CASE("MatchServer Class: Checkpoints Keep State, Sequence And Queue") {
+    MatchServer server(1);
+    MatchConfig config;
+    config.seed = 11;
+    config.maxTurns = 77;
+    int id = server.createMatch(config);
+    server.submit(id, GameState::makeAction(PlaceUnit, 0, 0, -1, 8));
+    server.drain();
+    std::vector<std::uint8_t> bytes;
+    REQUIRE(server.checkpoint(id, bytes));
+    CHECK(server.matchCount() == 1);
+
+    int copy = server.restoreMatch(bytes.data(), bytes.size());
+    REQUIRE(copy >= 0);
+    GameState original;
+    GameState restored;
+    REQUIRE(server.copyState(id, original));
+    REQUIRE(server.copyState(copy, restored));
+    CHECK(restored.hash() == original.hash());
+    CHECK(restored.hash() == restored.computeHash());
+
+    // The restored match continues the sequence of the original.
+    std::vector<MatchUpdate> updates;
+    REQUIRE(server.join(copy, 1, [&](const MatchUpdate &update) { updates.push_back(update); }));
+    server.submit(copy, GameState::makeAction(PlaceUnit, 1, 0, -1, 15));
+    server.drain();
+    REQUIRE(updates.size() == 1);
+    CHECK(updates[0].accepted);
+    CHECK(updates[0].sequence == 2);
+
+    CHECK(server.restoreMatch(bytes.data(), bytes.size() - 1) == -1);
+    bytes[BATCH_HEADER_SIZE + FRAME_SIZE] ^= 0xFF;
+    CHECK(server.restoreMatch(bytes.data(), bytes.size()) == -1);
+
+    bytes.clear();
+    REQUIRE(server.checkpoint(id, bytes, true));
+    CHECK_FALSE(server.checkpoint(id, bytes, true));
+    CHECK_FALSE(server.submit(id, Action()));
+    CHECK(server.matchCount() == 1);
+}
+
+#ifdef __linux__
+static bool writeAll(int fd, const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *data, size_t size) {
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t received = ::read(fd, bytes, size);
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+/*!
+ * \brief The receiving process: restores every checkpoint, reports the
+ * resumed hashes and plays the matches to the end.
+ */
+static int resumeMatches(int in, int out) {
+    std::uint32_t count = 0;
+    if (!readAll(in, &count, sizeof(count))) {
+        return 2;
+    }
+    MatchServer server(2);
+    std::vector<int> ids;
+    for (std::uint32_t k = 0; k < count; ++k) {
+        std::uint32_t size = 0;
+        std::vector<std::uint8_t> bytes;
+        if (!readAll(in, &size, sizeof(size))) {
+            return 2;
+        }
+        bytes.resize(size);
+        if (!readAll(in, bytes.data(), size)) {
+            return 2;
+        }
+        ids.push_back(server.restoreMatch(bytes.data(), bytes.size()));
+    }
+    server.drain();
+    std::vector<std::unique_ptr<LoopbackClient>> clients;
+    for (int id : ids) {
+        GameState state;
+        std::uint64_t hash = server.copyState(id, state) ? state.hash() : 0;
+        if (!writeAll(out, &hash, sizeof(hash))) {
+            return 2;
+        }
+        if (state.isFinished()) {
+            continue;
+        }
+        for (int player = 0; player < 2; ++player) {
+            clients.emplace_back(new LoopbackClient(server, id, player, id * 2 + player));
+            clients.back()->start();
+        }
+    }
+    server.drain();
+    for (const std::unique_ptr<LoopbackClient> &client : clients) {
+        if (!client->isFinished() || client->getDesyncs() != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+TEST_CASE("MatchServer Class: Matches Move To Another Process") {
+    // Fork before any thread of this test starts.
+    int toChild[2];
+    int fromChild[2];
+    REQUIRE(::pipe(toChild) == 0);
+    REQUIRE(::pipe(fromChild) == 0);
+    pid_t child = ::fork();
+    REQUIRE(child >= 0);
+    if (child == 0) {
+        ::close(toChild[1]);
+        ::close(fromChild[0]);
+        ::_exit(resumeMatches(toChild[0], fromChild[1]));
+    }
+    ::close(toChild[0]);
+    ::close(fromChild[1]);
+
+    const int count = 40;
+    MatchServer server(2);
+    std::vector<GameState> expected;
+    std::vector<int> ids;
+    std::mt19937 rng(9);
+    std::vector<Action> actions;
+    for (int k = 0; k < count; ++k) {
+        MatchConfig config;
+        config.seed = k;
+        ids.push_back(server.createMatch(config));
+        expected.emplace_back(config.rows, config.cols, config.maxNPC);
+        expected.back().generateTall(config.seed, config.number_of_tall);
+        // Some actions are still queued when the match is detached.
+        for (int step = 0; step < 5 + k && !expected.back().isFinished(); ++step) {
+            expected.back().generateActions(actions);
+            REQUIRE_FALSE(actions.empty());
+            Action action = actions[rng() % actions.size()];
+            REQUIRE(expected.back().apply(action));
+            REQUIRE(server.submit(ids.back(), action));
+        }
+    }
+
+    std::uint32_t total = count;
+    REQUIRE(writeAll(toChild[1], &total, sizeof(total)));
+    for (int id : ids) {
+        std::vector<std::uint8_t> bytes;
+        REQUIRE(server.checkpoint(id, bytes, true));
+        std::uint32_t size = static_cast<std::uint32_t>(bytes.size());
+        REQUIRE(writeAll(toChild[1], &size, sizeof(size)));
+        REQUIRE(writeAll(toChild[1], bytes.data(), bytes.size()));
+    }
+    ::close(toChild[1]);
+    CHECK(server.matchCount() == 0);
+
+    for (int k = 0; k < count; ++k) {
+        std::uint64_t hash = 0;
+        REQUIRE(readAll(fromChild[0], &hash, sizeof(hash)));
+        CHECK(hash == expected[k].hash());
+    }
+    ::close(fromChild[0]);
+    int status = 0;
+    REQUIRE(::waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+}
+#endif
@@ -0,0 +1,297 @@
+#ifndef SNAPSHOT
+#define SNAPSHOT
+
+#include "game.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief The kinds of state payloads: spectator snapshots and deltas, and
+ * match checkpoints moved between server processes.
+ */
+enum PayloadKind : std::uint8_t {
+  SnapshotPayload = 0,
+  DeltaPayload = 1,
+  CheckpointPayload = 2
+};
+
+/*!
+ * \brief Encodes match states for spectators as a snapshot followed by deltas.
+ *
+ * Both start with the turn status: a flags byte (bit 0: deployment phase,
+ * bit 1: side to move) and the battle turn as 32-bit little-endian.
+ *
+ * Snapshot: rows, cols and maxNPC as 16-bit little-endian, the status, a
+ * bitmask of tall hexes, a bitmask of occupied hexes and the content of every
+ * occupied hex.
+ *
+ * Delta: the status, a bitmask of the hexes the action changed and their new
+ * content.
+ *
+ * Hex content is one byte, 0 for empty or 1 + player + 2 * unit type,
+ * followed by the unit's HP as 16-bit little-endian if occupied. Bitmasks
+ * have one bit per hex in cell index order, least significant bit first.
+ */
+class StateCodec {
+public:
+  /*!
+   * \brief Encodes the complete state of a match.
+   * \param state The state.
+   * \param out The buffer the snapshot is appended to.
+   */
+  static void encodeSnapshot(const GameState &state,
+                             std::vector<std::uint8_t> &out) {
+    write16(out, state.getRows());
+    write16(out, state.getCols());
+    write16(out, state.getMaxNPC());
+    writeStatus(state, out);
+    int cells = state.getRows() * state.getCols();
+    size_t tallMask = out.size();
+    out.resize(out.size() + maskBytes(cells), 0);
+    for (int cell = 0; cell < cells; ++cell) {
+      if (state.isTall(cell)) {
+        out[tallMask + (cell >> 3)] |= static_cast<std::uint8_t>(1 << (cell & 7));
+      }
+    }
+    size_t occupiedMask = out.size();
+    out.resize(out.size() + maskBytes(cells), 0);
+    for (int player = 0; player < 2; ++player) {
+      for (const Unit &unit : state.getUnits(player)) {
+        out[occupiedMask + (unit.cell >> 3)] |=
+            static_cast<std::uint8_t>(1 << (unit.cell & 7));
+      }
+    }
+    writeContents(state, out, occupiedMask, cells);
+  }
+
+  /*!
+   * \brief Encodes the change an applied action made.
+   *
+   * Only the hexes named by the action can change, so the cost does not
+   * depend on the number of units.
+   * \param state The state after the action.
+   * \param action The applied action.
+   * \param out The buffer the delta is appended to.
+   */
+  static void encodeDelta(const GameState &state, const Action &action,
+                          std::vector<std::uint8_t> &out) {
+    writeStatus(state, out);
+    int cells = state.getRows() * state.getCols();
+    size_t mask = out.size();
+    out.resize(out.size() + maskBytes(cells), 0);
+    int changed[2] = {-1, -1};
+    if (action.kind == PlaceUnit || action.kind == AttackUnit) {
+      changed[0] = action.to;
+    } else if (action.kind == MoveUnit) {
+      changed[0] = std::min(action.from, action.to);
+      changed[1] = std::max(action.from, action.to);
+    }
+    for (int cell : changed) {
+      if (cell >= 0 && cell < cells) {
+        out[mask + (cell >> 3)] |= static_cast<std::uint8_t>(1 << (cell & 7));
+      }
+    }
+    for (int cell : changed) {
+      if (cell >= 0 && cell < cells) {
+        writeContent(state, cell, out);
+      }
+    }
+  }
+
+  /*!
+   * \brief Rebuilds a state from a snapshot.
+   * \param data The snapshot bytes.
+   * \param size The number of bytes.
+   * \param out Receives the state.
+   * \return False if the snapshot is malformed.
+   */
+  static bool decodeSnapshot(const std::uint8_t *data, size_t size,
+                             GameState &out) {
+    Reader reader(data, size);
+    int rows = reader.read16();
+    int cols = reader.read16();
+    int maxNPC = reader.read16();
+    Status status = readStatus(reader);
+    if (rows <= 0 || cols <= 0 ||
+        static_cast<std::int64_t>(rows) * cols > (1 << 24)) {
+      return false;
+    }
+    int cells = rows * cols;
+    const std::uint8_t *tall = reader.skip(maskBytes(cells));
+    const std::uint8_t *occupied = reader.skip(maskBytes(cells));
+    if (!reader.ok) {
+      return false;
+    }
+    GameState state(rows, cols, maxNPC);
+    std::vector<Unit> armies[2];
+    for (int cell = 0; cell < cells; ++cell) {
+      state.setTall(cell, (tall[cell >> 3] >> (cell & 7)) & 1);
+      if ((occupied[cell >> 3] >> (cell & 7)) & 1) {
+        readContent(reader, cell, armies);
+      }
+    }
+    if (!reader.ok || reader.remaining() != 0 ||
+        !state.restore(armies, status.side, status.placement, status.turn)) {
+      return false;
+    }
+    out = state;
+    return true;
+  }
+
+  /*!
+   * \brief Applies a delta to the state it was encoded against.
+   *
+   * Unit order may differ from the server's, which hash() ignores.
+   * \param data The delta bytes.
+   * \param size The number of bytes.
+   * \param state The state to update.
+   * \return False if the delta is malformed.
+   */
+  static bool applyDelta(const std::uint8_t *data, size_t size,
+                         GameState &state) {
+    Reader reader(data, size);
+    Status status = readStatus(reader);
+    int cells = state.getRows() * state.getCols();
+    const std::uint8_t *mask = reader.skip(maskBytes(cells));
+    if (!reader.ok) {
+      return false;
+    }
+    std::vector<Unit> armies[2];
+    for (int player = 0; player < 2; ++player) {
+      for (const Unit &unit : state.getUnits(player)) {
+        if (!((mask[unit.cell >> 3] >> (unit.cell & 7)) & 1)) {
+          armies[player].push_back(unit);
+        }
+      }
+    }
+    for (size_t byte = 0; byte < maskBytes(cells); ++byte) {
+      for (int bits = mask[byte]; bits != 0; bits &= bits - 1) {
+        int cell = static_cast<int>(byte * 8) + ctz(bits);
+        if (cell >= cells) {
+          return false;
+        }
+        readContent(reader, cell, armies);
+      }
+    }
+    return reader.ok && reader.remaining() == 0 &&
+           state.restore(armies, status.side, status.placement, status.turn);
+  }
+
+private:
+  struct Status {
+    bool placement;
+    int side;
+    int turn;
+  };
+
+  /*!
+   * \brief Bounds-checked little-endian reads; ok turns false on overrun.
+   */
+  struct Reader {
+    Reader(const std::uint8_t *data, size_t size)
+        : data(data), size(size), pos(0), ok(true) {}
+
+    const std::uint8_t *skip(size_t count) {
+      if (size - pos < count) {
+        ok = false;
+        pos = size;
+        return nullptr;
+      }
+      pos += count;
+      return data + pos - count;
+    }
+
+    std::uint32_t read8() {
+      const std::uint8_t *p = skip(1);
+      return p ? p[0] : 0;
+    }
+
+    std::uint32_t read16() {
+      const std::uint8_t *p = skip(2);
+      return p ? p[0] | p[1] << 8 : 0;
+    }
+
+    std::uint32_t read32() {
+      std::uint32_t low = read16();
+      return low | read16() << 16;
+    }
+
+    size_t remaining() const { return size - pos; }
+
+    const std::uint8_t *data;
+    size_t size;
+    size_t pos;
+    bool ok;
+  };
+
+  static size_t maskBytes(int cells) { return (cells + 7) / 8; }
+
+  static int ctz(int bits) {
+    int index = 0;
+    while (!((bits >> index) & 1)) {
+      ++index;
+    }
+    return index;
+  }
+
+  static void write16(std::vector<std::uint8_t> &out, std::uint32_t value) {
+    out.push_back(static_cast<std::uint8_t>(value & 0xFF));
+    out.push_back(static_cast<std::uint8_t>((value >> 8) & 0xFF));
+  }
+
+  static void writeStatus(const GameState &state,
+                          std::vector<std::uint8_t> &out) {
+    out.push_back(static_cast<std::uint8_t>((state.isPlacement() ? 1 : 0) |
+                                            state.getSideToMove() << 1));
+    std::uint32_t turn = static_cast<std::uint32_t>(state.getTurn());
+    write16(out, turn & 0xFFFF);
+    write16(out, turn >> 16);
+  }
+
+  static Status readStatus(Reader &reader) {
+    Status status;
+    std::uint32_t flags = reader.read8();
+    status.placement = (flags & 1) != 0;
+    status.side = (flags >> 1) & 1;
+    status.turn = static_cast<int>(reader.read32());
+    return status;
+  }
+
+  static void writeContent(const GameState &state, int cell,
+                           std::vector<std::uint8_t> &out) {
+    int owner = state.ownerAt(cell);
+    if (owner < 0) {
+      out.push_back(0);
+      return;
+    }
+    const Unit &unit = state.getUnits(owner)[state.unitIndexAt(cell)];
+    out.push_back(static_cast<std::uint8_t>(1 + owner + 2 * unit.type));
+    write16(out, static_cast<std::uint32_t>(unit.HP) & 0xFFFF);
+  }
+
+  static void writeContents(const GameState &state,
+                            std::vector<std::uint8_t> &out, size_t mask,
+                            int cells) {
+    for (int cell = 0; cell < cells; ++cell) {
+      if ((out[mask + (cell >> 3)] >> (cell & 7)) & 1) {
+        writeContent(state, cell, out);
+      }
+    }
+  }
+
+  static void readContent(Reader &reader, int cell,
+                          std::vector<Unit> armies[2]) {
+    std::uint32_t code = reader.read8();
+    if (code == 0) {
+      return;
+    }
+    Unit unit;
+    unit.type = static_cast<int>((code - 1) >> 1);
+    unit.HP = static_cast<std::int16_t>(reader.read16());
+    unit.cell = cell;
+    armies[(code - 1) & 1].push_back(unit);
+  }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "doctest.h"
+#include "snapshot.h"
+
+TEST_CASE("StateCodec Class: Snapshot And Deltas Follow A Game") {
+    GameState state(8, 8, 3);
+    state.generateTall(4, 4);
+    std::vector<std::uint8_t> bytes;
+    StateCodec::encodeSnapshot(state, bytes);
+    GameState spectator;
+    REQUIRE(StateCodec::decodeSnapshot(bytes.data(), bytes.size(), spectator));
+    CHECK(spectator.hash() == state.hash());
+
+    std::mt19937 rng(4);
+    std::vector<Action> actions;
+    size_t largest = 0;
+    while (!state.isFinished() && state.getTurn() < 300) {
+        state.generateActions(actions);
+        if (actions.empty()) {
+            break;
+        }
+        Action action = actions[rng() % actions.size()];
+        REQUIRE(state.apply(action));
+        bytes.clear();
+        StateCodec::encodeDelta(state, action, bytes);
+        largest = std::max(largest, bytes.size());
+        REQUIRE(StateCodec::applyDelta(bytes.data(), bytes.size(), spectator));
+        REQUIRE(spectator.hash() == state.hash());
+        CHECK(spectator.isPlacement() == state.isPlacement());
+        CHECK(spectator.getTurn() == state.getTurn());
+        CHECK(spectator.getWinner() == state.getWinner());
+    }
+    // Status, an 8-byte cell mask and at most two changed hexes.
+    CHECK(largest <= 5 + 8 + 6);
+
+    // A spectator joining mid-game starts from a fresh snapshot.
+    bytes.clear();
+    StateCodec::encodeSnapshot(state, bytes);
+    GameState late;
+    REQUIRE(StateCodec::decodeSnapshot(bytes.data(), bytes.size(), late));
+    CHECK(late.hash() == state.hash());
+    CHECK(late.getUnits(0).size() == state.getUnits(0).size());
+    CHECK(late.getUnits(1).size() == state.getUnits(1).size());
+}
+
+TEST_CASE("StateCodec Class: Rejects Malformed Data") {
+    GameState state(4, 4, 2);
+    std::vector<std::uint8_t> bytes;
+    StateCodec::encodeSnapshot(state, bytes);
+    GameState out;
+    CHECK_FALSE(StateCodec::decodeSnapshot(bytes.data(), bytes.size() - 1, out));
+    bytes.push_back(0);
+    CHECK_FALSE(StateCodec::decodeSnapshot(bytes.data(), bytes.size(), out));
+
+    // Two units claimed on a board that allows one each, in bad cells.
+    std::vector<std::uint8_t> delta = {0, 0, 0, 0, 0, 0x03, 0x00, 1, 10, 0, 1, 10, 0};
+    GameState small(4, 4, 1);
+    CHECK_FALSE(StateCodec::applyDelta(delta.data(), delta.size(), small));
+    CHECK_FALSE(StateCodec::applyDelta(delta.data(), 4, small));
+}
@@ -0,0 +1,1054 @@
+#ifndef TABLEBASE
+#define TABLEBASE
+
+#include "game.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*!
+ * \brief The value of a tablebase position for the side to move.
+ */
+struct TablebaseEntry {
+  /*!
+   * \brief 1 for a win, 0 for a draw, -1 for a loss.
+   */
+  int outcome;
+  /*!
+   * \brief Plies to the end with best play, the killing attack included;
+   * 0 for draws. Saturates at Tablebase::MAX_DISTANCE.
+   */
+  int plies;
+};
+
+/*!
+ * \brief The layout of tablebase files.
+ *
+ * Positions of one unit per side are indexed by the types, hexes and
+ * remaining hits of the unit to move and of the other unit. Hits, not HP:
+ * with a single enemy a unit dies after ceil(HP / enemy attack) blows
+ * whatever its exact HP, which keeps the table small.
+ *
+ * Positions of two units against one, with either side to move, are
+ * indexed by the type of the lone unit and the types of the pair in
+ * ascending order, then by the hexes and hits of the pair and the HP of the
+ * lone unit. Its attackers differ, so it keeps its HP, as an index into its
+ * HP levels: every HP that blows of any unit type can leave it with.
+ *
+ * Values are one byte: 0 draw, n in [1, 127] win in n plies, 128 + n loss
+ * in n plies. They are stored in blocks of BLOCK values; a block keeps its
+ * distinct values in a palette and 0, 1, 2 or 4-bit codes, or the raw
+ * bytes when it has more than 16, so a probe reads one block header and
+ * one byte.
+ *
+ * File, little-endian: "STB1", u16 rows, cols, unit types, units (0 or 2
+ * for one against one only, 3 with two against one), u32 block count, u32
+ * data size; per unit type u16 HP, range, attack, then 2 reserved bytes;
+ * per (mover type, other type) pair u8 mover hits, u8 other hits, u16
+ * reserved, u32 first block; with 3 units, per (side to move, 0 for the
+ * pair, lone type, first pair type, second pair type) u8 hits of the first,
+ * u8 hits of the second, u8 HP levels, u8 reserved, u32 first block; the
+ * tall hexes as a bitmap padded to 8 bytes; per block u32 data offset, u8
+ * code bits, u8 palette size, u16 reserved; then the palettes and codes.
+ */
+struct TablebaseFormat {
+  static constexpr int BLOCK = 64;
+  static constexpr size_t HEADER_SIZE = 20;
+  static constexpr size_t STATS_SIZE = 6 * UNIT_TYPES + 2;
+  static constexpr size_t PAIRS_SIZE = 8 * UNIT_TYPES * UNIT_TYPES;
+  static constexpr size_t TRIOS_SIZE =
+      16 * UNIT_TYPES * UNIT_TYPES * UNIT_TYPES;
+  static constexpr size_t BLOCK_HEADER_SIZE = 8;
+
+  static size_t triosSize(int units) { return units == 3 ? TRIOS_SIZE : 0; }
+
+  static size_t tallBytes(int rows, int cols) {
+    return (static_cast<size_t>(rows) * cols + 63) / 64 * 8;
+  }
+
+  static size_t blocksStart(int rows, int cols, int units) {
+    return HEADER_SIZE + STATS_SIZE + PAIRS_SIZE + triosSize(units) +
+           tallBytes(rows, cols);
+  }
+};
+
+/*!
+ * \brief Exact values of every position with one unit per side on one map,
+ * and optionally of every position with two units against one.
+ *
+ * build() solves the positions by retrograde analysis; open() maps a file
+ * written with save(), and probe() answers in constant time. A tablebase
+ * only covers the board size, tall hexes and unit statistics it was built
+ * for; probe() checks them. Draws include positions where the side to
+ * move cannot act, which search scores as draws too.
+ */
+class Tablebase {
+public:
+  static constexpr int MAX_DISTANCE = 127;
+
+  Tablebase()
+      : rows(0), cols(0), units(2), blocks(nullptr), data(nullptr) {}
+
+  Tablebase(const Tablebase &) = delete;
+  Tablebase &operator=(const Tablebase &) = delete;
+
+  ~Tablebase() { close(); }
+
+  /*!
+   * \brief Solves every one-against-one position of a map, and on request
+   * every two-against-one position.
+   *
+   * Each pair of unit types, with its mirror pair, is solved by a pool
+   * task: positions with a killing attack are wins in 1, then level by
+   * level a position is a win once one action reaches a loss of the
+   * opponent, and a loss once all its actions reach wins of the opponent.
+   * What is left is drawn. Two against one is solved the same way once one
+   * against one is, a task per lone type and pair of types; a kill of one
+   * unit of the pair leads into the one-against-one values.
+   *
+   * Two against one takes about rows^3 * cols^3 * 2.5 KB while it is
+   * solved, some 650 MB on 8 x 8.
+   * \param board The map and unit statistics; its units are ignored.
+   * \param pool The workers.
+   * \param out Receives the file contents.
+   * \param units The most units a covered position holds: 2, or 3 to add
+   * two against one.
+   */
+  static void build(const GameState &board, ThreadPool &pool,
+                    std::vector<std::uint8_t> &out, int units = 2) {
+    Solver solver(board, units == 3 ? 3 : 2);
+    for (int a = 0; a < UNIT_TYPES; ++a) {
+      for (int b = a; b < UNIT_TYPES; ++b) {
+        pool.post([&solver, a, b] { solver.solve(a, b); });
+      }
+    }
+    pool.wait();
+    if (units == 3) {
+      for (int lone = 0; lone < UNIT_TYPES; ++lone) {
+        for (int a = 0; a < UNIT_TYPES; ++a) {
+          for (int b = a; b < UNIT_TYPES; ++b) {
+            pool.post([&solver, lone, a, b] { solver.solveTrio(lone, a, b); });
+          }
+        }
+      }
+      pool.wait();
+    }
+    solver.write(out);
+  }
+
+  /*!
+   * \brief Writes built contents to a file.
+   * \param bytes The contents from build().
+   * \param path The path of the file.
+   * \return False if the file cannot be written.
+   */
+  static bool save(const std::vector<std::uint8_t> &bytes,
+                   const std::string &path) {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    bool written =
+        std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && written;
+  }
+
+  /*!
+   * \brief Maps a tablebase file.
+   * \param path The path of the file.
+   * \return False if the file is missing or malformed.
+   */
+  bool open(const std::string &path) {
+    close();
+    return file.open(path) && readHeader();
+  }
+
+  /*!
+   * \brief Uses contents held in memory, e.g. straight from build().
+   * \param bytes The contents.
+   * \return False if they are malformed.
+   */
+  bool assign(std::vector<std::uint8_t> bytes) {
+    close();
+    file.assign(std::move(bytes));
+    return readHeader();
+  }
+
+  /*!
+   * \brief Releases the tablebase.
+   */
+  void close() {
+    file.close();
+    rows = 0;
+    cols = 0;
+    units = 2;
+  }
+
+  /*!
+   * \brief Gets the size of the contents in bytes.
+   */
+  size_t bytes() const { return file.size(); }
+
+  /*!
+   * \brief Gets the most units a covered position holds: 2 or 3.
+   */
+  int maxUnits() const { return units; }
+
+  /*!
+   * \brief Gets the number of indexed positions, impossible ones included.
+   */
+  size_t positions() const {
+    size_t total = 0;
+    for (int a = 0; a < UNIT_TYPES; ++a) {
+      for (int b = 0; b < UNIT_TYPES; ++b) {
+        total += pairSize(a, b);
+        for (int lone = 0; lone < UNIT_TYPES; ++lone) {
+          total += trioSize(trios[0][lone][a][b]) +
+                   trioSize(trios[1][lone][a][b]);
+        }
+      }
+    }
+    return total;
+  }
+
+  /*!
+   * \brief Checks if a state is played on the map and with the unit
+   * statistics of the tablebase.
+   */
+  bool covers(const GameState &state) const {
+    if (file.data() == nullptr || state.getRows() != rows ||
+        state.getCols() != cols) {
+      return false;
+    }
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+      const UnitStats &own = state.getUnitStats(type);
+      if (own.HP != stats[type].HP ||
+          own.attack_diapason != stats[type].attack_diapason ||
+          own.attack != stats[type].attack) {
+        return false;
+      }
+    }
+    const std::uint32_t *bits = state.getTallBits();
+    for (size_t k = 0; k < tall.size(); ++k) {
+      // The sentinel hex is never tall.
+      if (bits[k] != tall[k]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Looks a battle position up.
+   * \param state A position the tablebase covers().
+   * \param entry Receives the value for the side to move.
+   * \return False unless each side has exactly one unit, or one side two
+   * and the tablebase holds two against one.
+   */
+  bool probe(const GameState &state, TablebaseEntry &entry) const {
+    if (state.isPlacement() || state.isFinished() || file.data() == nullptr) {
+      return false;
+    }
+    int side = state.getSideToMove();
+    const std::vector<Unit> &own = state.getUnits(side);
+    const std::vector<Unit> &enemy = state.getUnits(1 - side);
+    if (own.size() + enemy.size() == 3 && !own.empty() && !enemy.empty() &&
+        units == 3) {
+      return probeTrio(own, enemy, entry);
+    }
+    if (own.size() != 1 || enemy.size() != 1) {
+      return false;
+    }
+    const Unit &mover = own[0];
+    const Unit &other = enemy[0];
+    int moverHits = hitsOf(mover.HP, stats[other.type].attack);
+    int otherHits = hitsOf(other.HP, stats[mover.type].attack);
+    const Pair &pair = pairs[mover.type][other.type];
+    if (moverHits > pair.moverHits || otherHits > pair.otherHits) {
+      return false;
+    }
+    size_t index = positionIndex(pair, mover.cell, other.cell, moverHits,
+                                 otherHits);
+    decode(value(pair.firstBlock, index), entry);
+    return true;
+  }
+
+private:
+  struct Pair {
+    int moverHits = 0;
+    int otherHits = 0;
+    size_t firstBlock = 0;
+  };
+
+  /*!
+   * \brief The layout of the two-against-one positions of a lone type and
+   * pair of types with one side to move; empty for unordered pairs.
+   */
+  struct Trio {
+    int firstHits = 0;
+    int secondHits = 0;
+    int levels = 0;
+    size_t firstBlock = 0;
+  };
+
+  static int hitsOf(int hp, int attack) {
+    return (hp + attack - 1) / std::max(attack, 1);
+  }
+
+  /*!
+   * \brief Lists the HP a unit of a type can be left with by any blows,
+   * full HP included, in ascending order.
+   */
+  static std::vector<int> hpLevels(const UnitStats stats[UNIT_TYPES],
+                                   int type) {
+    int full = std::max(stats[type].HP, 0);
+    std::vector<bool> reached(full + 1, false);
+    if (full > 0) {
+      reached[full] = true;
+    }
+    for (int hp = full; hp > 0; --hp) {
+      for (int attacker = 0; attacker < UNIT_TYPES && reached[hp];
+           ++attacker) {
+        int left = hp - stats[attacker].attack;
+        if (stats[attacker].attack > 0 && left > 0) {
+          reached[left] = true;
+        }
+      }
+    }
+    std::vector<int> levels;
+    for (int hp = 1; hp <= full; ++hp) {
+      if (reached[hp]) {
+        levels.push_back(hp);
+      }
+    }
+    return levels;
+  }
+
+  size_t trioSize(const Trio &trio) const {
+    size_t cells = static_cast<size_t>(rows) * cols;
+    return cells * cells * cells * trio.firstHits * trio.secondHits *
+           trio.levels;
+  }
+
+  size_t trioIndex(const Trio &trio, int first, int second, int lone,
+                   int firstHits, int secondHits, int level) const {
+    size_t cells = static_cast<size_t>(rows) * cols;
+    return ((((first * cells + second) * cells + lone) * trio.firstHits +
+             (firstHits - 1)) *
+                trio.secondHits +
+            (secondHits - 1)) *
+               trio.levels +
+           level;
+  }
+
+  bool probeTrio(const std::vector<Unit> &own, const std::vector<Unit> &enemy,
+                 TablebaseEntry &entry) const {
+    int mover = own.size() == 2 ? 0 : 1;
+    const std::vector<Unit> &pair = mover == 0 ? own : enemy;
+    const Unit &lone = mover == 0 ? enemy[0] : own[0];
+    const Unit *first = &pair[0];
+    const Unit *second = &pair[1];
+    if (first->type > second->type) {
+      std::swap(first, second);
+    }
+    const Trio &trio = trios[mover][lone.type][first->type][second->type];
+    int attack = stats[lone.type].attack;
+    int firstHits = hitsOf(first->HP, attack);
+    int secondHits = hitsOf(second->HP, attack);
+    const std::vector<int> &level = levelOf[lone.type];
+    if (firstHits > trio.firstHits || secondHits > trio.secondHits ||
+        lone.HP >= static_cast<int>(level.size()) || level[lone.HP] < 0) {
+      return false;
+    }
+    size_t index = trioIndex(trio, first->cell, second->cell, lone.cell,
+                             firstHits, secondHits, level[lone.HP]);
+    decode(value(trio.firstBlock, index), entry);
+    return true;
+  }
+
+  size_t pairSize(int a, int b) const {
+    return static_cast<size_t>(rows * cols) * (rows * cols) *
+           pairs[a][b].moverHits * pairs[a][b].otherHits;
+  }
+
+  size_t positionIndex(const Pair &pair, int moverCell, int otherCell,
+                       int moverHits, int otherHits) const {
+    size_t cells = static_cast<size_t>(rows) * cols;
+    return ((moverCell * cells + otherCell) * pair.moverHits +
+            (moverHits - 1)) *
+               pair.otherHits +
+           (otherHits - 1);
+  }
+
+  static void decode(std::uint8_t byte, TablebaseEntry &entry) {
+    if (byte == 0) {
+      entry = TablebaseEntry{0, 0};
+    } else if (byte <= MAX_DISTANCE) {
+      entry = TablebaseEntry{1, byte};
+    } else {
+      entry = TablebaseEntry{-1, byte - 128};
+    }
+  }
+
+  std::uint8_t value(size_t firstBlock, size_t index) const {
+    const std::uint8_t *header =
+        blocks + (firstBlock + index / TablebaseFormat::BLOCK) *
+                     TablebaseFormat::BLOCK_HEADER_SIZE;
+    const std::uint8_t *block =
+        data + getLE(header, 4);
+    int bits = header[4];
+    int palette = header[5];
+    size_t slot = index % TablebaseFormat::BLOCK;
+    if (bits == 8) {
+      return block[slot];
+    }
+    if (bits == 0) {
+      return block[0];
+    }
+    size_t bit = slot * bits;
+    int code = (block[palette + bit / 8] >> (bit % 8)) & ((1 << bits) - 1);
+    return block[code];
+  }
+
+  /*!
+   * \brief Checks that the blocks of a table lie in the file: a probe then
+   * never reads past the data, whatever the codes say.
+   */
+  bool blocksFit(size_t firstBlock, size_t values, size_t blockCount,
+                 size_t dataSize) const {
+    using F = TablebaseFormat;
+    size_t count = (values + F::BLOCK - 1) / F::BLOCK;
+    if (firstBlock > blockCount || count > blockCount - firstBlock) {
+      return false;
+    }
+    const std::uint8_t *header =
+        file.data() + F::blocksStart(rows, cols, units) +
+        firstBlock * F::BLOCK_HEADER_SIZE;
+    for (size_t k = 0; k < count; ++k, header += F::BLOCK_HEADER_SIZE) {
+      size_t offset = getLE(header, 4);
+      int bits = header[4];
+      size_t palette = header[5];
+      size_t needed;
+      if (bits == 8) {
+        needed = std::min<size_t>(F::BLOCK, values - k * F::BLOCK);
+      } else if (bits == 0 || bits == 1 || bits == 2 || bits == 4) {
+        // Codes index the palette, so it must hold every code.
+        if (palette == 0 || palette > (1u << bits)) {
+          return false;
+        }
+        needed = palette + F::BLOCK * bits / 8;
+      } else {
+        return false;
+      }
+      if (offset > dataSize || needed > dataSize - offset) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool readHeader() {
+    using F = TablebaseFormat;
+    const std::uint8_t *base = file.data();
+    if (file.size() < F::HEADER_SIZE ||
+        std::memcmp(base, "STB1", 4) != 0 ||
+        getLE(base + 8, 2) != UNIT_TYPES) {
+      close();
+      return false;
+    }
+    rows = static_cast<int>(getLE(base + 4, 2));
+    cols = static_cast<int>(getLE(base + 6, 2));
+    units = static_cast<int>(getLE(base + 10, 2));
+    units = units == 0 ? 2 : units;
+    size_t blockCount = getLE(base + 12, 4);
+    size_t dataSize = getLE(base + 16, 4);
+    size_t start = F::blocksStart(rows, cols, units);
+    if (rows <= 0 || cols <= 0 || (units != 2 && units != 3) ||
+        file.size() != start + blockCount * F::BLOCK_HEADER_SIZE + dataSize) {
+      close();
+      return false;
+    }
+    const std::uint8_t *field = base + F::HEADER_SIZE;
+    for (int type = 0; type < UNIT_TYPES; ++type, field += 6) {
+      stats[type].HP = static_cast<int>(getLE(field, 2));
+      stats[type].attack_diapason = static_cast<int>(getLE(field + 2, 2));
+      stats[type].attack = static_cast<int>(getLE(field + 4, 2));
+      stats[type].healAmount = 0;
+    }
+    field = base + F::HEADER_SIZE + F::STATS_SIZE;
+    bool valid = true;
+    for (int a = 0; a < UNIT_TYPES; ++a) {
+      for (int b = 0; b < UNIT_TYPES; ++b, field += 8) {
+        Pair &pair = pairs[a][b];
+        pair.moverHits = field[0];
+        pair.otherHits = field[1];
+        pair.firstBlock = getLE(field + 4, 4);
+        valid = valid && blocksFit(pair.firstBlock, pairSize(a, b),
+                                   blockCount, dataSize);
+      }
+    }
+    for (int type = 0; type < UNIT_TYPES; ++type) {
+      std::vector<int> levels = hpLevels(stats, type);
+      levelOf[type].assign(std::max(stats[type].HP, 0) + 1, -1);
+      for (size_t k = 0; k < levels.size(); ++k) {
+        levelOf[type][levels[k]] = static_cast<int>(k);
+      }
+    }
+    for (int mover = 0; mover < 2; ++mover) {
+      for (int lone = 0; lone < UNIT_TYPES; ++lone) {
+        for (int a = 0; a < UNIT_TYPES; ++a) {
+          for (int b = 0; b < UNIT_TYPES; ++b) {
+            Trio &trio = trios[mover][lone][a][b];
+            trio = Trio();
+            if (units != 3) {
+              continue;
+            }
+            trio.firstHits = field[0];
+            trio.secondHits = field[1];
+            trio.levels = field[2];
+            trio.firstBlock = getLE(field + 4, 4);
+            field += 8;
+            // Probes look levels up from the statistics: they must agree.
+            valid = valid && (trioSize(trio) == 0 ||
+                              trio.levels == static_cast<int>(
+                                  hpLevels(stats, lone).size())) &&
+                    blocksFit(trio.firstBlock, trioSize(trio), blockCount,
+                              dataSize);
+          }
+        }
+      }
+    }
+    if (!valid) {
+      close();
+      return false;
+    }
+    tall.assign((rows * cols + 1 + 31) / 32, 0);
+    for (int cell = 0; cell < rows * cols; ++cell) {
+      if (field[cell / 8] >> (cell % 8) & 1) {
+        tall[cell / 32] |= 1u << (cell % 32);
+      }
+    }
+    blocks = base + start;
+    data = blocks + blockCount * F::BLOCK_HEADER_SIZE;
+    return true;
+  }
+
+  /*!
+   * \brief The retrograde analysis behind build().
+   */
+  class Solver {
+  public:
+    Solver(const GameState &board, int units)
+        : board(board), cells(board.getRows() * board.getCols()),
+          units(units) {
+      for (int type = 0; type < UNIT_TYPES; ++type) {
+        stats[type] = board.getUnitStats(type);
+      }
+      for (int type = 0; type < UNIT_TYPES; ++type) {
+        levels[type] = hpLevels(stats, type);
+        levelOf[type].assign(std::max(stats[type].HP, 0) + 1, -1);
+        for (size_t k = 0; k < levels[type].size(); ++k) {
+          levelOf[type][levels[type][k]] = static_cast<int>(k);
+        }
+      }
+      for (int a = 0; a < UNIT_TYPES; ++a) {
+        for (int b = 0; b < UNIT_TYPES; ++b) {
+          moverHits[a][b] = hitsOf(stats[a].HP, stats[b].attack);
+        }
+      }
+      for (int a = 0; a < UNIT_TYPES; ++a) {
+        for (int b = 0; b < UNIT_TYPES; ++b) {
+          values[a][b].assign(size(a, b), 0);
+        }
+      }
+      // Neighbors and ranges are looked up constantly; compute them once.
+      adjacent.resize(cells);
+      for (int cell = 0; cell < cells; ++cell) {
+        int out[6];
+        int count = board.neighbors(cell, out);
+        adjacent[cell].assign(out, out + count);
+      }
+      for (int type = 0; type < UNIT_TYPES; ++type) {
+        reach[type].assign(static_cast<size_t>(cells) * cells, 0);
+        for (int from = 0; from < cells; ++from) {
+          for (int to = 0; to < cells; ++to) {
+            reach[type][from * cells + to] = withinRange(
+                board.rowOf(from), board.colOf(from), board.rowOf(to),
+                board.colOf(to), stats[type].attack_diapason);
+          }
+        }
+      }
+    }
+
+    /*!
+     * \brief Solves the positions of a type pair and its mirror pair.
+     */
+    void solve(int a, int b) {
+      std::vector<std::uint8_t> remaining[2];
+      std::vector<Position> level;
+      int types[2][2] = {{a, b}, {b, a}};
+      int mirrors = a == b ? 1 : 2;
+      for (int m = 0; m < mirrors; ++m) {
+        int mover = types[m][0];
+        int other = types[m][1];
+        remaining[m].assign(size(mover, other), 0);
+        std::vector<std::uint8_t> &value = values[mover][other];
+        for (int from = 0; from < cells; ++from) {
+          for (int at = 0; at < cells; ++at) {
+            if (from == at) {
+              continue;
+            }
+            int steps = 0;
+            for (int to : adjacent[from]) {
+              steps += to != at && board.canStep(from, to);
+            }
+            bool attack = reach[mover][from * cells + at] != 0;
+            for (int hm = 1; hm <= moverHits[mover][other]; ++hm) {
+              for (int ho = 1; ho <= moverHits[other][mover]; ++ho) {
+                size_t index = indexOf(mover, other, from, at, hm, ho);
+                remaining[m][index] =
+                    static_cast<std::uint8_t>(steps + attack);
+                if (attack && ho == 1) {
+                  value[index] = 1;
+                  level.push_back(Position{mover, other, from, at, hm, ho});
+                }
+              }
+            }
+          }
+        }
+      }
+
+      std::vector<Position> next;
+      for (int distance = 1; !level.empty(); ++distance) {
+        int stored = std::min(distance + 1, MAX_DISTANCE);
+        next.clear();
+        for (const Position &p : level) {
+          bool lost = values[p.mover][p.other][indexOf(p)] > 128;
+          // The previous mover was the unit of type p.other at p.at.
+          int prevMover = p.other;
+          int prevOther = p.mover;
+          int slot = prevMover == a && prevOther == b ? 0 : 1;
+          std::vector<std::uint8_t> &value = values[prevMover][prevOther];
+          auto reached = [&](const Position &q) {
+            size_t index = indexOf(q);
+            if (value[index] != 0) {
+              return;
+            }
+            if (lost) {
+              value[index] = static_cast<std::uint8_t>(stored);
+              next.push_back(q);
+            } else if (--remaining[slot][index] == 0) {
+              value[index] = static_cast<std::uint8_t>(128 + stored);
+              next.push_back(q);
+            }
+          };
+          // It stepped to p.at.
+          for (int from : adjacent[p.at]) {
+            if (from != p.from && board.canStep(from, p.at)) {
+              reached(Position{prevMover, prevOther, from, p.from, p.otherHits,
+                               p.moverHits});
+            }
+          }
+          // Or it hit the unit to move from p.at.
+          if (p.moverHits < moverHits[p.mover][p.other] &&
+              reach[prevMover][p.at * cells + p.from]) {
+            reached(Position{prevMover, prevOther, p.at, p.from, p.otherHits,
+                             p.moverHits + 1});
+          }
+        }
+        level.swap(next);
+      }
+    }
+
+    /*!
+     * \brief Solves the two-against-one positions of a lone type against a
+     * pair of types, with either side to move; needs the one-against-one
+     * values.
+     *
+     * A kill of a unit of the pair leaves a one-against-one position of
+     * known value: it is fed in at the level of its distance, as if it
+     * were a solved two-against-one position.
+     */
+    void solveTrio(int lone, int a, int b) {
+      int types[2] = {a, b};
+      const std::vector<int> &hp = levels[lone];
+      size_t count = trioSize(lone, a, b);
+      std::vector<std::uint8_t> remaining[2];
+      std::vector<std::uint8_t> *value[2];
+      for (int side = 0; side < 2; ++side) {
+        value[side] = &trioValues[side][lone][a][b];
+        value[side]->assign(count, 0);
+        remaining[side].assign(count, 0);
+      }
+      // Positions are kept as 2 * index + side.
+      std::vector<size_t> level;
+      std::vector<size_t> exits[2][MAX_DISTANCE + 1];
+      for (int x = 0; x < cells; ++x) {
+        for (int y = 0; y < cells; ++y) {
+          for (int z = 0; z < cells; ++z) {
+            if (x == y || x == z || y == z) {
+              continue;
+            }
+            int at[2] = {x, y};
+            int pairSteps = 0;
+            for (int u = 0; u < 2; ++u) {
+              for (int to : adjacent[at[u]]) {
+                pairSteps += to != at[1 - u] && to != z &&
+                             board.canStep(at[u], to);
+              }
+            }
+            int loneSteps = 0;
+            for (int to : adjacent[z]) {
+              loneSteps += to != x && to != y && board.canStep(z, to);
+            }
+            bool hits[2] = {reach[a][x * cells + z] != 0,
+                            reach[b][y * cells + z] != 0};
+            bool hit[2] = {reach[lone][z * cells + x] != 0,
+                           reach[lone][z * cells + y] != 0};
+            TrioPosition p{0, x, y, z, 1, 1, 0};
+            for (p.firstHits = 1; p.firstHits <= moverHits[a][lone];
+                 ++p.firstHits) {
+              for (p.secondHits = 1; p.secondHits <= moverHits[b][lone];
+                   ++p.secondHits) {
+                for (p.level = 0; p.level < static_cast<int>(hp.size());
+                     ++p.level) {
+                  size_t index = trioIndexOf(lone, a, b, p);
+                  remaining[0][index] =
+                      static_cast<std::uint8_t>(pairSteps + hits[0] + hits[1]);
+                  if ((hits[0] && hp[p.level] <= stats[a].attack) ||
+                      (hits[1] && hp[p.level] <= stats[b].attack)) {
+                    (*value[0])[index] = 1;
+                    level.push_back(2 * index);
+                  }
+                  remaining[1][index] =
+                      static_cast<std::uint8_t>(loneSteps + hit[0] + hit[1]);
+                  int pairHits[2] = {p.firstHits, p.secondHits};
+                  for (int u = 0; u < 2; ++u) {
+                    if (!hit[u] || pairHits[u] != 1) {
+                      continue;
+                    }
+                    int type = types[1 - u];
+                    std::uint8_t child = values[type][lone][indexOf(
+                        type, lone, at[1 - u], z, pairHits[1 - u],
+                        hitsOf(hp[p.level], stats[type].attack))];
+                    if (child != 0) {
+                      // A loss of the survivor is a win of the lone unit.
+                      bool won = child > 128;
+                      exits[won][won ? child - 128 : child].push_back(
+                          2 * index + 1);
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+
+      std::vector<size_t> next;
+      for (int distance = 1; !level.empty() || distance <= MAX_DISTANCE;
+           ++distance) {
+        int stored = std::min(distance + 1, MAX_DISTANCE);
+        next.clear();
+        auto reached = [&](int side, size_t index, bool lost) {
+          std::uint8_t &known = (*value[side])[index];
+          if (known != 0) {
+            return;
+          }
+          if (lost) {
+            known = static_cast<std::uint8_t>(stored);
+            next.push_back(2 * index + side);
+          } else if (--remaining[side][index] == 0) {
+            known = static_cast<std::uint8_t>(128 + stored);
+            next.push_back(2 * index + side);
+          }
+        };
+        if (distance <= MAX_DISTANCE) {
+          for (int won = 0; won < 2; ++won) {
+            for (size_t code : exits[won][distance]) {
+              reached(1, code / 2, won != 0);
+            }
+            std::vector<size_t>().swap(exits[won][distance]);
+          }
+        }
+        for (size_t code : level) {
+          int side = static_cast<int>(code % 2);
+          bool lost = (*value[side])[code / 2] > 128;
+          TrioPosition p = trioPositionOf(lone, a, b, code / 2);
+          int at[2] = {p.first, p.second};
+          int pairHits[2] = {p.firstHits, p.secondHits};
+          TrioPosition q = p;
+          q.side = 1 - side;
+          if (side == 1) {
+            // The pair moved last: one of its units stepped or hit.
+            for (int u = 0; u < 2; ++u) {
+              for (int from : adjacent[at[u]]) {
+                if (from != at[1 - u] && from != p.lone &&
+                    board.canStep(from, at[u])) {
+                  (u == 0 ? q.first : q.second) = from;
+                  reached(0, trioIndexOf(lone, a, b, q), lost);
+                }
+              }
+              q.first = p.first;
+              q.second = p.second;
+              int before = hp[p.level] + stats[types[u]].attack;
+              if (reach[types[u]][at[u] * cells + p.lone] &&
+                  before < static_cast<int>(levelOf[lone].size()) &&
+                  levelOf[lone][before] >= 0) {
+                q.level = levelOf[lone][before];
+                reached(0, trioIndexOf(lone, a, b, q), lost);
+                q.level = p.level;
+              }
+            }
+          } else {
+            // The lone unit moved last: it stepped or hit.
+            for (int from : adjacent[p.lone]) {
+              if (from != p.first && from != p.second &&
+                  board.canStep(from, p.lone)) {
+                q.lone = from;
+                reached(1, trioIndexOf(lone, a, b, q), lost);
+              }
+            }
+            q.lone = p.lone;
+            for (int u = 0; u < 2; ++u) {
+              if (reach[lone][p.lone * cells + at[u]] &&
+                  pairHits[u] < moverHits[types[u]][lone]) {
+                (u == 0 ? q.firstHits : q.secondHits) = pairHits[u] + 1;
+                reached(1, trioIndexOf(lone, a, b, q), lost);
+                q.firstHits = p.firstHits;
+                q.secondHits = p.secondHits;
+              }
+            }
+          }
+        }
+        level.swap(next);
+      }
+    }
+
+    /*!
+     * \brief Compresses the solved values into the file layout.
+     */
+    void write(std::vector<std::uint8_t> &out) const {
+      using F = TablebaseFormat;
+      int rows = board.getRows();
+      int cols = board.getCols();
+      std::vector<std::uint8_t> headers;
+      std::vector<std::uint8_t> packed;
+      std::uint8_t pairFields[F::PAIRS_SIZE] = {};
+      std::uint8_t trioFields[F::TRIOS_SIZE] = {};
+      size_t blockCount = 0;
+      auto pack = [&](const std::vector<std::uint8_t> &value) {
+        for (size_t first = 0; first < value.size(); first += F::BLOCK) {
+          size_t count = std::min<size_t>(F::BLOCK, value.size() - first);
+          packBlock(value.data() + first, count, headers, packed);
+          ++blockCount;
+        }
+      };
+      for (int a = 0; a < UNIT_TYPES; ++a) {
+        for (int b = 0; b < UNIT_TYPES; ++b) {
+          std::uint8_t *field = pairFields + 8 * (a * UNIT_TYPES + b);
+          field[0] = static_cast<std::uint8_t>(moverHits[a][b]);
+          field[1] = static_cast<std::uint8_t>(moverHits[b][a]);
+          putLE(field + 4, blockCount, 4);
+          pack(values[a][b]);
+        }
+      }
+      std::uint8_t *field = trioFields;
+      for (int side = 0; side < 2 && units == 3; ++side) {
+        for (int lone = 0; lone < UNIT_TYPES; ++lone) {
+          for (int a = 0; a < UNIT_TYPES; ++a) {
+            for (int b = 0; b < UNIT_TYPES; ++b, field += 8) {
+              if (a <= b) {
+                field[0] = static_cast<std::uint8_t>(moverHits[a][lone]);
+                field[1] = static_cast<std::uint8_t>(moverHits[b][lone]);
+                field[2] = static_cast<std::uint8_t>(levels[lone].size());
+              }
+              putLE(field + 4, blockCount, 4);
+              pack(trioValues[side][lone][a][b]);
+            }
+          }
+        }
+      }
+      size_t start = F::blocksStart(rows, cols, units);
+      out.assign(start, 0);
+      std::memcpy(out.data(), "STB1", 4);
+      putLE(out.data() + 4, rows, 2);
+      putLE(out.data() + 6, cols, 2);
+      putLE(out.data() + 8, UNIT_TYPES, 2);
+      putLE(out.data() + 10, units, 2);
+      putLE(out.data() + 12, blockCount, 4);
+      putLE(out.data() + 16, packed.size(), 4);
+      field = out.data() + F::HEADER_SIZE;
+      for (int type = 0; type < UNIT_TYPES; ++type, field += 6) {
+        putLE(field, stats[type].HP, 2);
+        putLE(field + 2, stats[type].attack_diapason, 2);
+        putLE(field + 4, stats[type].attack, 2);
+      }
+      std::memcpy(out.data() + F::HEADER_SIZE + F::STATS_SIZE, pairFields,
+                  sizeof(pairFields));
+      std::memcpy(out.data() + F::HEADER_SIZE + F::STATS_SIZE + F::PAIRS_SIZE,
+                  trioFields, F::triosSize(units));
+      std::uint8_t *tallMap = out.data() + F::HEADER_SIZE + F::STATS_SIZE +
+                              F::PAIRS_SIZE + F::triosSize(units);
+      for (int cell = 0; cell < cells; ++cell) {
+        if (board.isTall(cell)) {
+          tallMap[cell / 8] |= static_cast<std::uint8_t>(1 << (cell % 8));
+        }
+      }
+      out.insert(out.end(), headers.begin(), headers.end());
+      out.insert(out.end(), packed.begin(), packed.end());
+    }
+
+  private:
+    struct Position {
+      int mover;
+      int other;
+      int from;
+      int at;
+      int moverHits;
+      int otherHits;
+    };
+
+    size_t size(int a, int b) const {
+      return static_cast<size_t>(cells) * cells * moverHits[a][b] *
+             moverHits[b][a];
+    }
+
+    size_t indexOf(int a, int b, int from, int at, int hm, int ho) const {
+      return ((static_cast<size_t>(from) * cells + at) * moverHits[a][b] +
+              (hm - 1)) *
+                 moverHits[b][a] +
+             (ho - 1);
+    }
+
+    size_t indexOf(const Position &p) const {
+      return indexOf(p.mover, p.other, p.from, p.at, p.moverHits,
+                     p.otherHits);
+    }
+
+    /*!
+     * \brief A two-against-one position: the hexes and hits of the pair,
+     * the hex and HP level of the lone unit, and the side to move.
+     */
+    struct TrioPosition {
+      int side;
+      int first;
+      int second;
+      int lone;
+      int firstHits;
+      int secondHits;
+      int level;
+    };
+
+    size_t trioSize(int lone, int a, int b) const {
+      return static_cast<size_t>(cells) * cells * cells *
+             moverHits[a][lone] * moverHits[b][lone] * levels[lone].size();
+    }
+
+    size_t trioIndexOf(int lone, int a, int b, const TrioPosition &p) const {
+      size_t hexes =
+          (static_cast<size_t>(p.first) * cells + p.second) * cells + p.lone;
+      return ((hexes * moverHits[a][lone] + (p.firstHits - 1)) *
+                  moverHits[b][lone] +
+              (p.secondHits - 1)) *
+                 levels[lone].size() +
+             p.level;
+    }
+
+    TrioPosition trioPositionOf(int lone, int a, int b, size_t index) const {
+      TrioPosition p;
+      size_t count = levels[lone].size();
+      p.level = static_cast<int>(index % count);
+      index /= count;
+      p.secondHits = static_cast<int>(index % moverHits[b][lone]) + 1;
+      index /= moverHits[b][lone];
+      p.firstHits = static_cast<int>(index % moverHits[a][lone]) + 1;
+      index /= moverHits[a][lone];
+      p.lone = static_cast<int>(index % cells);
+      index /= cells;
+      p.second = static_cast<int>(index % cells);
+      p.first = static_cast<int>(index / cells);
+      p.side = 0;
+      return p;
+    }
+
+    static void packBlock(const std::uint8_t *value, size_t count,
+                          std::vector<std::uint8_t> &headers,
+                          std::vector<std::uint8_t> &packed) {
+      std::vector<std::uint8_t> palette;
+      for (size_t k = 0; k < count; ++k) {
+        if (std::find(palette.begin(), palette.end(), value[k]) ==
+            palette.end()) {
+          palette.push_back(value[k]);
+        }
+      }
+      int bits = palette.size() == 1   ? 0
+                 : palette.size() <= 2  ? 1
+                 : palette.size() <= 4  ? 2
+                 : palette.size() <= 16 ? 4
+                                        : 8;
+      std::uint8_t header[TablebaseFormat::BLOCK_HEADER_SIZE] = {};
+      putLE(header, packed.size(), 4);
+      header[4] = static_cast<std::uint8_t>(bits);
+      if (bits == 8) {
+        packed.insert(packed.end(), value, value + count);
+      } else {
+        header[5] = static_cast<std::uint8_t>(palette.size());
+        packed.insert(packed.end(), palette.begin(), palette.end());
+        size_t codes = packed.size();
+        packed.resize(codes + (TablebaseFormat::BLOCK * bits + 7) / 8, 0);
+        for (size_t k = 0; bits > 0 && k < count; ++k) {
+          int code = static_cast<int>(
+              std::find(palette.begin(), palette.end(), value[k]) -
+              palette.begin());
+          size_t bit = k * bits;
+          packed[codes + bit / 8] |=
+              static_cast<std::uint8_t>(code << (bit % 8));
+        }
+      }
+      headers.insert(headers.end(), header, header + sizeof(header));
+    }
+
+    const GameState &board;
+    int cells;
+    int units;
+    UnitStats stats[UNIT_TYPES];
+    std::vector<int> levels[UNIT_TYPES];
+    /*!
+     * \brief The index of every HP in levels, -1 for HP not in them.
+     */
+    std::vector<int> levelOf[UNIT_TYPES];
+    /*!
+     * \brief Blows a unit of type a survives against a unit of type b.
+     */
+    int moverHits[UNIT_TYPES][UNIT_TYPES];
+    std::vector<std::uint8_t> values[UNIT_TYPES][UNIT_TYPES];
+    /*!
+     * \brief Two against one by side to move, lone type and pair types.
+     */
+    std::vector<std::uint8_t>
+        trioValues[2][UNIT_TYPES][UNIT_TYPES][UNIT_TYPES];
+    std::vector<std::vector<int>> adjacent;
+    std::vector<std::uint8_t> reach[UNIT_TYPES];
+  };
+
+  MappedFile file;
+  int rows;
+  int cols;
+  int units;
+  UnitStats stats[UNIT_TYPES];
+  Pair pairs[UNIT_TYPES][UNIT_TYPES];
+  Trio trios[2][UNIT_TYPES][UNIT_TYPES][UNIT_TYPES];
+  std::vector<int> levelOf[UNIT_TYPES];
+  std::vector<std::uint32_t> tall;
+  const std::uint8_t *blocks;
+  const std::uint8_t *data;
+};
+
+#endif
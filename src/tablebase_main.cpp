@@ -0,0 +1,111 @@
+/*!
+ * \file tablebase_main.cpp
+ * \brief Builds the endgame tablebase of a map
+ *
+ * The map is the one GameState::generateTall() raises for a seed, as in a
+ * game started with that seed:
+ *   strateg_tablebase --seed=42 --tall=4 --out=map42.stb --threads=6
+ * Alpha-beta agents probe the file with "ab:tb=map42.stb". The file holds
+ * one against one; --units=3 adds two against one, on boards of up to 64
+ * hexes since solving those takes some 650 MB on 8 x 8.
+ */
+
+#include "tablebase.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+  int rows = 8;
+  int cols = 8;
+  int tall = 4;
+  std::uint32_t seed = 1;
+  int threads = 0;
+  int units = 2;
+  std::string out = "endgames.stb";
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string text = arg.substr(arg.find('=') + 1);
+    int value = std::atoi(text.c_str());
+    if (arg.rfind("--rows=", 0) == 0) {
+      rows = value;
+    } else if (arg.rfind("--cols=", 0) == 0) {
+      cols = value;
+    } else if (arg.rfind("--tall=", 0) == 0) {
+      tall = value;
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      seed = static_cast<std::uint32_t>(value);
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = value;
+    } else if (arg.rfind("--units=", 0) == 0) {
+      units = value;
+    } else if (arg.rfind("--out=", 0) == 0) {
+      out = text;
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+  if (rows <= 0 || cols <= 0 || rows * cols > 1024) {
+    std::cerr << "Boards of 1 to 1024 hexes only" << std::endl;
+    return 2;
+  }
+  if ((units != 2 && units != 3) || (units == 3 && rows * cols > 64)) {
+    std::cerr << "2 units, or 3 on boards of up to 64 hexes" << std::endl;
+    return 2;
+  }
+
+  GameState board(rows, cols, units - 1);
+  board.generateTall(seed, tall);
+  ThreadPool pool(threads);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::uint8_t> bytes;
+  Tablebase::build(board, pool, bytes, units);
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  if (!Tablebase::save(bytes, out)) {
+    std::cerr << "Cannot write " << out << std::endl;
+    return 1;
+  }
+  Tablebase tablebase;
+  if (!tablebase.open(out)) {
+    std::cerr << "Cannot read back " << out << std::endl;
+    return 1;
+  }
+
+  // Tally the possible positions by outcome.
+  std::size_t outcomes[3] = {};
+  int longest = 0;
+  int cells = rows * cols;
+  GameState state = board;
+  std::vector<Unit> armies[2];
+  for (int mover = 0; mover < UNIT_TYPES; ++mover) {
+    for (int other = 0; other < UNIT_TYPES; ++other) {
+      for (int from = 0; from < cells; ++from) {
+        for (int at = 0; at < cells; ++at) {
+          if (from == at) {
+            continue;
+          }
+          armies[0].assign(1, Unit{mover, board.getUnitStats(mover).HP, from});
+          armies[1].assign(1, Unit{other, board.getUnitStats(other).HP, at});
+          state.restore(armies, 0, false, 0);
+          TablebaseEntry entry;
+          if (tablebase.probe(state, entry)) {
+            outcomes[entry.outcome + 1] += 1;
+            longest = std::max(longest, entry.plies);
+          }
+        }
+      }
+    }
+  }
+  std::cout << "Built " << out << " in " << seconds << " s on "
+            << pool.size() << " threads: " << tablebase.positions()
+            << " positions in " << tablebase.bytes() << " bytes"
+            << std::endl;
+  std::cout << "Full-health starts for the side to move: " << outcomes[2]
+            << " wins, " << outcomes[1] << " draws, " << outcomes[0]
+            << " losses; longest " << longest << " plies" << std::endl;
+  return 0;
+}
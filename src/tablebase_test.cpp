@@ -0,0 +1,302 @@
+#include "doctest.h"
+#include "search.h"
+#include "tablebase.h"
+#include <cstdio>
+#include <random>
+
+static const char *TEST_FILE = "tablebase_test.stb";
+
+static GameState smallBoard(int units = 1) {
+    GameState board(4, 5, units);
+    board.setTall(board.cellIndex(1, 2), true);
+    board.setTall(board.cellIndex(2, 1), true);
+    return board;
+}
+
+/*!
+ * \brief Places one unit per side with the given hits left.
+ */
+static bool setUp(GameState &state, int mover, int other, int from, int at,
+                  int moverHits, int otherHits) {
+    std::vector<Unit> armies[2];
+    int moverHP = std::min(state.getUnitStats(mover).HP,
+                           moverHits * state.getUnitStats(other).attack);
+    int otherHP = std::min(state.getUnitStats(other).HP,
+                           otherHits * state.getUnitStats(mover).attack);
+    armies[0].push_back(Unit{mover, moverHP, from});
+    armies[1].push_back(Unit{other, otherHP, at});
+    return state.restore(armies, 0, false, 0);
+}
+
+/*!
+ * \brief Encodes an entry so that better values for the side to move
+ * compare greater: quick wins, then slow wins, draws, slow losses.
+ */
+static int rank(const TablebaseEntry &entry) {
+    return entry.outcome == 0 ? 0 : entry.outcome * (1000 - entry.plies);
+}
+
+TEST_CASE("Tablebase Class: Values Agree With Every Successor") {
+    GameState board = smallBoard();
+    ThreadPool pool(3);
+    std::vector<std::uint8_t> bytes;
+    Tablebase::build(board, pool, bytes);
+    Tablebase tablebase;
+    REQUIRE(tablebase.assign(bytes));
+    REQUIRE(tablebase.covers(board));
+    CHECK(tablebase.bytes() < tablebase.positions());
+
+    int cells = board.getRows() * board.getCols();
+    int counts[3] = {};
+    std::vector<Action> actions;
+    GameState state = board;
+    for (int mover = 0; mover < UNIT_TYPES; ++mover) {
+        for (int other = 0; other < UNIT_TYPES; ++other) {
+            int moverMax = (state.getUnitStats(mover).HP + state.getUnitStats(other).attack - 1) /
+                           state.getUnitStats(other).attack;
+            int otherMax = (state.getUnitStats(other).HP + state.getUnitStats(mover).attack - 1) /
+                           state.getUnitStats(mover).attack;
+            for (int from = 0; from < cells; ++from) {
+                for (int at = 0; at < cells; ++at) {
+                    for (int hm = 1; hm <= moverMax; ++hm) {
+                        for (int ho = 1; ho <= otherMax; ++ho) {
+                            if (from == at) {
+                                continue;
+                            }
+                            REQUIRE(setUp(state, mover, other, from, at, hm, ho));
+                            TablebaseEntry entry;
+                            REQUIRE(tablebase.probe(state, entry));
+                            counts[entry.outcome + 1] += 1;
+
+                            // The best successor, seen from the side to move.
+                            state.generateActions(actions);
+                            int best = actions.empty() ? 0 : -1000000;
+                            for (const Action &action : actions) {
+                                ActionUndo undo;
+                                state.make(action, undo);
+                                TablebaseEntry child;
+                                int value;
+                                if (state.isFinished()) {
+                                    value = 1000 - 1;
+                                } else {
+                                    REQUIRE(tablebase.probe(state, child));
+                                    value = child.outcome == 0
+                                                ? 0
+                                                : -child.outcome * (1000 - child.plies - 1);
+                                }
+                                state.unmake(undo);
+                                best = std::max(best, value);
+                            }
+                            REQUIRE(rank(entry) == best);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    CHECK(counts[0] > 0);
+    CHECK(counts[1] > 0);
+    CHECK(counts[2] > 0);
+}
+
+TEST_CASE("Tablebase Class: Two Against One Agrees With Every Successor") {
+    GameState board = smallBoard(2);
+    ThreadPool pool(3);
+    std::vector<std::uint8_t> bytes;
+    Tablebase::build(board, pool, bytes, 3);
+    Tablebase tablebase;
+    REQUIRE(tablebase.assign(bytes));
+    CHECK(tablebase.maxUnits() == 3);
+
+    int cells = board.getRows() * board.getCols();
+    int counts[3] = {};
+    std::vector<Action> actions;
+    GameState state = board;
+    std::mt19937 rng(11);
+    for (int k = 0; k < 20000; ++k) {
+        int cell[3];
+        cell[0] = static_cast<int>(rng() % cells);
+        do {
+            cell[1] = static_cast<int>(rng() % cells);
+        } while (cell[1] == cell[0]);
+        do {
+            cell[2] = static_cast<int>(rng() % cells);
+        } while (cell[2] == cell[0] || cell[2] == cell[1]);
+        // The lone unit is worn down by blows of any type, the pair is not.
+        std::vector<Unit> armies[2];
+        for (int u = 0; u < 2; ++u) {
+            int type = static_cast<int>(rng() % UNIT_TYPES);
+            int hp = 1 + static_cast<int>(rng() % state.getUnitStats(type).HP);
+            armies[0].push_back(Unit{type, hp, cell[u]});
+        }
+        int lone = static_cast<int>(rng() % UNIT_TYPES);
+        int hp = state.getUnitStats(lone).HP;
+        for (int blows = static_cast<int>(rng() % 4); blows > 0; --blows) {
+            int attack = state.getUnitStats(static_cast<int>(rng() % UNIT_TYPES)).attack;
+            hp = hp > attack ? hp - attack : hp;
+        }
+        armies[1].push_back(Unit{lone, hp, cell[2]});
+        REQUIRE(state.restore(armies, static_cast<int>(rng() % 2), false, 0));
+        TablebaseEntry entry;
+        REQUIRE(tablebase.probe(state, entry));
+        counts[entry.outcome + 1] += 1;
+
+        state.generateActions(actions);
+        int best = actions.empty() ? 0 : -1000000;
+        for (const Action &action : actions) {
+            ActionUndo undo;
+            state.make(action, undo);
+            int value;
+            if (state.isFinished()) {
+                value = 1000 - 1;
+            } else {
+                TablebaseEntry child;
+                REQUIRE(tablebase.probe(state, child));
+                value = child.outcome == 0 ? 0 : -child.outcome * (1000 - child.plies - 1);
+            }
+            state.unmake(undo);
+            best = std::max(best, value);
+        }
+        REQUIRE(rank(entry) == best);
+    }
+    CHECK(counts[0] > 0);
+    CHECK(counts[1] > 0);
+    CHECK(counts[2] > 0);
+
+    // A one-against-one tablebase answers nothing for three units.
+    Tablebase pairsOnly;
+    std::vector<std::uint8_t> smaller;
+    Tablebase::build(board, pool, smaller);
+    REQUIRE(pairsOnly.assign(smaller));
+    CHECK(pairsOnly.maxUnits() == 2);
+    CHECK(pairsOnly.positions() < tablebase.positions());
+    TablebaseEntry entry;
+    CHECK_FALSE(pairsOnly.probe(state, entry));
+}
+
+TEST_CASE("Tablebase Class: Block Headers Must Lie In The File") {
+    GameState board = smallBoard();
+    ThreadPool pool(2);
+    std::vector<std::uint8_t> bytes;
+    Tablebase::build(board, pool, bytes);
+    Tablebase tablebase;
+    REQUIRE(tablebase.assign(bytes));
+    size_t blocks = getLE(bytes.data() + 12, 4);
+    size_t dataSize = getLE(bytes.data() + 16, 4);
+    size_t start = TablebaseFormat::blocksStart(board.getRows(), board.getCols(), 2);
+    REQUIRE(blocks > 2);
+
+    // The last block read, its offset, code width and palette in turn.
+    std::uint8_t *last = bytes.data() + start + (blocks - 1) * TablebaseFormat::BLOCK_HEADER_SIZE;
+    std::vector<std::uint8_t> corrupt = bytes;
+    putLE(corrupt.data() + (last - bytes.data()), dataSize, 4);
+    CHECK_FALSE(tablebase.assign(corrupt));
+    corrupt = bytes;
+    corrupt[last - bytes.data() + 4] = 3;
+    CHECK_FALSE(tablebase.assign(corrupt));
+    corrupt = bytes;
+    corrupt[last - bytes.data() + 4] = 8;
+    putLE(corrupt.data() + (last - bytes.data()), dataSize - 1, 4);
+    CHECK_FALSE(tablebase.assign(corrupt));
+    corrupt = bytes;
+    corrupt[last - bytes.data() + 4] = 1;
+    corrupt[last - bytes.data() + 5] = 0;
+    CHECK_FALSE(tablebase.assign(corrupt));
+
+    // A pair whose blocks run past the block count.
+    corrupt = bytes;
+    putLE(corrupt.data() + TablebaseFormat::HEADER_SIZE + TablebaseFormat::STATS_SIZE + 4,
+          blocks - 1, 4);
+    CHECK_FALSE(tablebase.assign(corrupt));
+    REQUIRE(tablebase.assign(bytes));
+}
+
+TEST_CASE("Tablebase Class: Files Map And Check Their Map") {
+    GameState board(8, 8, 2);
+    board.generateTall(3, 4);
+    ThreadPool pool(2);
+    std::vector<std::uint8_t> bytes;
+    Tablebase::build(board, pool, bytes);
+    REQUIRE(Tablebase::save(bytes, TEST_FILE));
+    Tablebase built;
+    REQUIRE(built.assign(bytes));
+    Tablebase mapped;
+    REQUIRE(mapped.open(TEST_FILE));
+    CHECK(mapped.bytes() == bytes.size());
+    CHECK(mapped.covers(board));
+
+    GameState state = board;
+    std::mt19937 rng(7);
+    for (int k = 0; k < 2000; ++k) {
+        int mover = static_cast<int>(rng() % UNIT_TYPES);
+        int other = static_cast<int>(rng() % UNIT_TYPES);
+        int from = static_cast<int>(rng() % 64);
+        int at = static_cast<int>(rng() % 64);
+        if (from == at) {
+            continue;
+        }
+        REQUIRE(setUp(state, mover, other, from, at, 1 + rng() % 2, 1 + rng() % 2));
+        TablebaseEntry a;
+        TablebaseEntry b;
+        REQUIRE(built.probe(state, a));
+        REQUIRE(mapped.probe(state, b));
+        CHECK(a.outcome == b.outcome);
+        CHECK(a.plies == b.plies);
+    }
+
+    GameState otherMap(8, 8, 2);
+    otherMap.generateTall(4, 4);
+    CHECK_FALSE(mapped.covers(otherMap));
+    GameState otherStats = board;
+    UnitStats knight = defaultUnitStats(0);
+    knight.attack += 1;
+    otherStats.setUnitStats(0, knight);
+    CHECK_FALSE(mapped.covers(otherStats));
+
+    std::vector<Unit> armies[2];
+    armies[0].push_back(Unit{0, 50, state.cellIndex(3, 1)});
+    armies[0].push_back(Unit{1, 30, state.cellIndex(4, 1)});
+    armies[1].push_back(Unit{2, 40, state.cellIndex(3, 6)});
+    state.restore(armies, 0, false, 0);
+    TablebaseEntry entry;
+    CHECK_FALSE(mapped.probe(state, entry));
+
+    CHECK_FALSE(mapped.open("missing.stb"));
+    bytes[0] = 'X';
+    CHECK_FALSE(built.assign(bytes));
+    std::remove(TEST_FILE);
+}
+
+TEST_CASE("AlphaBetaSearch Class: Probes The Tablebase") {
+    GameState board(8, 8, 1);
+    board.generateTall(9, 4);
+    ThreadPool pool(2);
+    std::vector<std::uint8_t> bytes;
+    Tablebase::build(board, pool, bytes);
+    Tablebase tablebase;
+    REQUIRE(tablebase.assign(bytes));
+
+    // A knight chasing a wounded archer from a distance.
+    GameState state = board;
+    REQUIRE(setUp(state, 0, 1, state.cellIndex(2, 1), state.cellIndex(5, 5), 3, 1));
+    TablebaseEntry entry;
+    REQUIRE(tablebase.probe(state, entry));
+    AlphaBetaSearch search;
+    search.setTablebase(&tablebase);
+    SearchLimits limits;
+    limits.depth = 1;
+    SearchResult result = search.search(state, limits);
+    REQUIRE(result.found);
+    if (entry.outcome == 0) {
+        CHECK(result.score == 0);
+    } else {
+        CHECK(result.score == entry.outcome * (Evaluator::WIN_SCORE - entry.plies));
+    }
+    ActionUndo undo;
+    REQUIRE(state.make(result.best, undo));
+    TablebaseEntry after;
+    if (!state.isFinished()) {
+        REQUIRE(tablebase.probe(state, after));
+        CHECK(after.outcome == -entry.outcome);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief A fixed set of worker threads running posted tasks in FIFO order.
+ */
+class ThreadPool {
+public:
+  /*!
+   * \brief Constructor for ThreadPool, starts the workers.
+   * \param threads The number of workers, 0 for one per hardware thread.
+   */
+  explicit ThreadPool(int threads = 0) : stopping(false), busy(0) {
+    if (threads <= 0) {
+      threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    if (threads <= 0) {
+      threads = 1;
+    }
+    for (int k = 0; k < threads; ++k) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /*!
+   * \brief Runs the queued tasks and joins the workers.
+   */
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    available.notify_all();
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  /*!
+   * \brief Queues a task for the next free worker.
+   * \param task The task to run.
+   */
+  void post(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(task));
+    }
+    available.notify_one();
+  }
+
+  /*!
+   * \brief Blocks until every queued task has finished.
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && busy == 0; });
+  }
+
+  /*!
+   * \brief Gets the number of workers.
+   * \return The number of threads in the pool.
+   */
+  int size() const { return static_cast<int>(workers.size()); }
+
+private:
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty()) {
+          return;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+        ++busy;
+      }
+      task();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        --busy;
+        if (tasks.empty() && busy == 0) {
+          idle.notify_all();
+        }
+      }
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable available;
+  std::condition_variable idle;
+  bool stopping;
+  int busy;
+};
+
+#endif
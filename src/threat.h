@@ -0,0 +1,184 @@
+#ifndef THREAT
+#define THREAT
+
+#include "game.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * \brief Per-hex influence of both players, kept in step with a GameState.
+ *
+ * influence(p)[cell] is the total attack of the units of player p that have
+ * the hex within their attack_diapason, attackers(p)[cell] their number. The
+ * danger to a unit of player p is therefore influence(1 - p) at its hex.
+ *
+ * A unit's footprint only depends on its range and the parity of its row, so
+ * it is computed once per range, as one run of columns per row that the
+ * stamp clips to the board and adds in a tight loop. After an action only the
+ * footprints of the unit that was placed, moved or killed are updated;
+ * damage changes neither attack nor range.
+ */
+class ThreatMap {
+public:
+  /*!
+   * \brief Recomputes both maps from every unit of a state.
+   * \param state The state to follow.
+   */
+  void rebuild(const GameState &state) {
+    rows = state.getRows();
+    cols = state.getCols();
+    for (int player = 0; player < 2; ++player) {
+      total[player].assign(rows * cols, 0);
+      count[player].assign(rows * cols, 0);
+      for (const Unit &unit : state.getUnits(player)) {
+        stamp(state, player, unit.type, unit.cell, 1);
+      }
+    }
+  }
+
+  /*!
+   * \brief Follows an action performed with GameState::make().
+   * \param state The state after the action.
+   * \param undo The record make() filled.
+   */
+  void update(const GameState &state, const ActionUndo &undo) {
+    const Action &action = undo.action;
+    if (action.kind == PlaceUnit) {
+      stamp(state, action.player, action.unitType, action.to, 1);
+    } else if (action.kind == MoveUnit) {
+      int type = unitTypeAt(state, undo.sideToMove, action.to);
+      stamp(state, undo.sideToMove, type, action.from, -1);
+      stamp(state, undo.sideToMove, type, action.to, 1);
+    } else if (action.kind == AttackUnit && undo.killed) {
+      stamp(state, 1 - undo.sideToMove, undo.victim.type, undo.victim.cell,
+            -1);
+    }
+  }
+
+  /*!
+   * \brief Follows an action taken back with GameState::unmake().
+   * \param state The state after unmake().
+   * \param undo The record of the reverted action.
+   */
+  void revert(const GameState &state, const ActionUndo &undo) {
+    const Action &action = undo.action;
+    if (action.kind == PlaceUnit) {
+      stamp(state, action.player, action.unitType, action.to, -1);
+    } else if (action.kind == MoveUnit) {
+      int type = unitTypeAt(state, undo.sideToMove, action.from);
+      stamp(state, undo.sideToMove, type, action.to, -1);
+      stamp(state, undo.sideToMove, type, action.from, 1);
+    } else if (action.kind == AttackUnit && undo.killed) {
+      stamp(state, 1 - undo.sideToMove, undo.victim.type, undo.victim.cell,
+            1);
+    }
+  }
+
+  /*!
+   * \brief Gets the summed attack a player brings to every hex.
+   * \param player The player (0 or 1).
+   * \return One value per cell index.
+   */
+  const std::int32_t *influence(int player) const {
+    return total[player].data();
+  }
+
+  /*!
+   * \brief Gets the number of units of a player that reach every hex.
+   * \param player The player (0 or 1).
+   * \return One value per cell index.
+   */
+  const std::int32_t *attackers(int player) const {
+    return count[player].data();
+  }
+
+  /*!
+   * \brief Gets the damage the enemy of a player can deal on a hex this turn.
+   * \param player The player whose unit would stand there.
+   * \param cell The index of the hex.
+   */
+  int dangerAt(int player, int cell) const { return total[1 - player][cell]; }
+
+private:
+  /*!
+   * \brief The cells within a range of a hex, as runs of column offsets
+   * [first, last] per row offset dr, for even and odd rows.
+   */
+  struct Footprint {
+    std::vector<int> dr[2];
+    std::vector<int> first[2];
+    std::vector<int> last[2];
+  };
+
+  static int unitTypeAt(const GameState &state, int player, int cell) {
+    return state.getUnits(player)[state.unitIndexAt(cell)].type;
+  }
+
+  const Footprint &footprint(int diapason) {
+    if (diapason >= static_cast<int>(footprints.size())) {
+      footprints.resize(diapason + 1);
+    }
+    Footprint &shape = footprints[diapason];
+    if (shape.dr[0].empty()) {
+      // Rows are offset by an even amount so that parities stay positive.
+      int base = 2 * (diapason + 1);
+      // A hex range is convex, so the cells in reach on a row are a run.
+      for (int parity = 0; parity < 2; ++parity) {
+        for (int dr = -diapason; dr <= diapason; ++dr) {
+          for (int dc = -diapason; dc <= diapason; ++dc) {
+            if (!withinRange(base + parity, 0, base + parity + dr, dc,
+                             diapason)) {
+              continue;
+            }
+            if (shape.dr[parity].empty() || shape.dr[parity].back() != dr) {
+              shape.dr[parity].push_back(dr);
+              shape.first[parity].push_back(dc);
+              shape.last[parity].push_back(dc);
+            }
+            shape.last[parity].back() = dc;
+          }
+        }
+      }
+    }
+    return shape;
+  }
+
+  void stamp(const GameState &state, int player, int type, int cell,
+             int sign) {
+    Unit unit;
+    unit.type = type;
+    unit.HP = 1;
+    unit.cell = cell;
+    UnitStats stats = state.statsOf(unit);
+    const Footprint &shape = footprint(stats.attack_diapason);
+    int row = cell / cols;
+    int col = cell % cols;
+    int parity = row & 1;
+    std::int32_t attack = sign * stats.attack;
+    std::int32_t *sum = total[player].data();
+    std::int32_t *number = count[player].data();
+    for (size_t k = 0; k < shape.dr[parity].size(); ++k) {
+      int i = row + shape.dr[parity][k];
+      if (i < 0 || i >= rows) {
+        continue;
+      }
+      int from = std::max(col + shape.first[parity][k], 0);
+      int to = std::min(col + shape.last[parity][k], cols - 1);
+      std::int32_t *sumRow = sum + i * cols;
+      std::int32_t *numberRow = number + i * cols;
+      for (int j = from; j <= to; ++j) {
+        sumRow[j] += attack;
+        numberRow[j] += sign;
+      }
+    }
+  }
+
+  int rows = 0;
+  int cols = 0;
+  std::vector<std::int32_t> total[2];
+  std::vector<std::int32_t> count[2];
+  std::vector<Footprint> footprints;
+};
+
+#endif
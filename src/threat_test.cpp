@@ -0,0 +1,71 @@
+#include "doctest.h"
+#include "threat.h"
+
+static void checkAgainstRebuild(const GameState &state, const ThreatMap &map) {
+    ThreatMap fresh;
+    fresh.rebuild(state);
+    int cells = state.getRows() * state.getCols();
+    for (int player = 0; player < 2; ++player) {
+        for (int cell = 0; cell < cells; ++cell) {
+            REQUIRE(map.influence(player)[cell] == fresh.influence(player)[cell]);
+            REQUIRE(map.attackers(player)[cell] == fresh.attackers(player)[cell]);
+        }
+    }
+}
+
+TEST_CASE("ThreatMap Class: Influence Sums Attacks In Range") {
+    GameState state(10, 10, 3);
+    REQUIRE(state.apply(GameState::makeAction(PlaceUnit, 0, 0, -1, state.cellIndex(4, 1))));
+    REQUIRE(state.apply(GameState::makeAction(PlaceUnit, 0, 1, -1, state.cellIndex(5, 0))));
+    ThreatMap map;
+    map.rebuild(state);
+    int cells = state.getRows() * state.getCols();
+    for (int cell = 0; cell < cells; ++cell) {
+        int expected = 0;
+        int number = 0;
+        for (const Unit &unit : state.getUnits(0)) {
+            UnitStats stats = state.statsOf(unit);
+            if (withinRange(state.rowOf(unit.cell), state.colOf(unit.cell), state.rowOf(cell),
+                            state.colOf(cell), stats.attack_diapason)) {
+                expected += stats.attack;
+                ++number;
+            }
+        }
+        REQUIRE(map.influence(0)[cell] == expected);
+        REQUIRE(map.attackers(0)[cell] == number);
+        REQUIRE(map.influence(1)[cell] == 0);
+        REQUIRE(map.dangerAt(1, cell) == expected);
+    }
+    // The knight reaches its neighbors, the archer much further.
+    CHECK(map.attackers(0)[state.cellIndex(4, 2)] == 2);
+    CHECK(map.attackers(0)[state.cellIndex(5, 5)] == 1);
+}
+
+TEST_CASE("ThreatMap Class: Incremental Updates Match Rebuild") {
+    for (std::uint32_t seed = 0; seed < 10; ++seed) {
+        GameState state(12, 12, 5);
+        state.generateTall(seed, 10);
+        ThreatMap map;
+        map.rebuild(state);
+        std::mt19937 rng(seed);
+        std::vector<Action> actions;
+        std::vector<ActionUndo> history;
+        while (!state.isFinished() && state.getTurn() < 150) {
+            state.generateActions(actions);
+            if (actions.empty()) {
+                break;
+            }
+            history.emplace_back();
+            REQUIRE(state.make(actions[rng() % actions.size()], history.back()));
+            map.update(state, history.back());
+            checkAgainstRebuild(state, map);
+        }
+        CHECK(history.size() > 10);
+        while (!history.empty()) {
+            state.unmake(history.back());
+            map.revert(state, history.back());
+            history.pop_back();
+            checkAgainstRebuild(state, map);
+        }
+    }
+}
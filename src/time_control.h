@@ -0,0 +1,280 @@
+#ifndef TIME_CONTROL
+#define TIME_CONTROL
+
+#include "search.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <string>
+
+/*!
+ * \brief A chess-clock time control: a base time, and an increment added
+ * after each action of the player.
+ */
+struct TimeControl {
+  std::int64_t baseMs = 0;
+  std::int64_t incrementMs = 0;
+
+  /*!
+   * \brief Checks if the player is on a clock at all.
+   */
+  bool enabled() const { return baseMs > 0; }
+};
+
+/*!
+ * \brief Parses a time control written "base+increment" in milliseconds,
+ * e.g. "60000+500", or "base" alone.
+ * \param text The description.
+ * \param control Receives the time control.
+ * \return False if the text is malformed.
+ */
+inline bool parseTimeControl(const std::string &text, TimeControl &control) {
+  long long base = 0;
+  long long increment = 0;
+  char extra = 0;
+  int read = std::sscanf(text.c_str(), "%lld+%lld%c", &base, &increment,
+                         &extra);
+  if (read < 1 || read > 2 || base <= 0 || increment < 0 ||
+      (read == 1 && text.find('+') != std::string::npos)) {
+    return false;
+  }
+  control.baseMs = base;
+  control.incrementMs = increment;
+  return true;
+}
+
+/*!
+ * \brief The clocks of both players of a game.
+ */
+class GameClock {
+public:
+  /*!
+   * \brief Constructor for GameClock with specified parameters.
+   * \param first The time control of player 0.
+   * \param second The time control of player 1.
+   */
+  GameClock(const TimeControl &first, const TimeControl &second)
+      : controls{first, second}, left{first.baseMs, second.baseMs} {}
+
+  const TimeControl &control(int player) const { return controls[player]; }
+
+  /*!
+   * \brief Gets the time a player has left, in milliseconds.
+   */
+  std::int64_t remaining(int player) const { return left[player]; }
+
+  /*!
+   * \brief Charges a player for an action, then adds the increment.
+   * \param player The player who acted.
+   * \param usedMs The time the action took.
+   * \return False if the player ran out of time; players without a time
+   * control never do.
+   */
+  bool punch(int player, std::int64_t usedMs) {
+    if (!controls[player].enabled()) {
+      return true;
+    }
+    left[player] -= usedMs;
+    if (left[player] < 0) {
+      return false;
+    }
+    left[player] += controls[player].incrementMs;
+    return true;
+  }
+
+private:
+  TimeControl controls[2];
+  std::int64_t left[2];
+};
+
+/*!
+ * \brief The time to spend on one action.
+ */
+struct TimeBudget {
+  /*!
+   * \brief No search iteration starts after this.
+   */
+  std::int64_t softMs;
+  /*!
+   * \brief The search returns after this whatever it is doing.
+   */
+  std::int64_t hardMs;
+};
+
+/*!
+ * \brief Splits the time left between the actions still to play.
+ *
+ * A game is assumed to last MOVES_TO_GO more actions of the player, and
+ * three quarters of the increment is spent on top; a single action never
+ * gets more than four times its share nor a third of what is left, and a
+ * safety margin covers the time outside the search.
+ * \param remainingMs The time left on the clock.
+ * \param incrementMs The increment of the time control.
+ */
+inline TimeBudget allocateTime(std::int64_t remainingMs,
+                               std::int64_t incrementMs) {
+  const std::int64_t MOVES_TO_GO = 40;
+  const std::int64_t MARGIN_MS = 50;
+  std::int64_t usable =
+      std::max<std::int64_t>(remainingMs - std::min(MARGIN_MS,
+                                                    remainingMs / 10),
+                             1);
+  std::int64_t soft = usable / MOVES_TO_GO + incrementMs * 3 / 4;
+  std::int64_t hard = std::min(soft * 4, usable / 3);
+  hard = std::max<std::int64_t>(hard, 1);
+  return TimeBudget{std::max<std::int64_t>(std::min(soft, hard), 1), hard};
+}
+
+/*!
+ * \brief An alpha-beta player that keeps searching on the opponent's time.
+ *
+ * After the player's action, ponder() takes the reply the principal
+ * variation expects and searches the position after it on a background
+ * thread. When the opponent plays that reply, think() gives the running
+ * search the time of the action, and answers at once if the pondering
+ * already took that long; otherwise it stops the background search and
+ * starts a timed one, which still profits from the transposition table
+ * the pondering filled.
+ *
+ * One thread drives a PonderingSearch; engine() may only be configured
+ * while it is not pondering.
+ */
+class PonderingSearch {
+public:
+  /*!
+   * \brief Constructor for PonderingSearch with specified parameters.
+   * \param tableBits The transposition table holds 2^tableBits entries.
+   */
+  explicit PonderingSearch(int tableBits = 16)
+      : search(tableBits), guessed(1, 1, 1), guessedKey(0), hitCount(0),
+        missCount(0), lastHit(false) {}
+
+  PonderingSearch(const PonderingSearch &) = delete;
+  PonderingSearch &operator=(const PonderingSearch &) = delete;
+
+  ~PonderingSearch() { cancel(); }
+
+  /*!
+   * \brief Gets the search, to set its evaluation or tablebase.
+   */
+  AlphaBetaSearch &engine() { return search; }
+
+  /*!
+   * \brief Searches the best action of the side to move within a budget.
+   * \param state The position, restored before returning.
+   * \param limits Depth, node and quiescence limits; the time limits come
+   * from the budget.
+   * \param budget The time of the action.
+   * \return The result of the pondered search on a hit, else of a new one.
+   */
+  SearchResult think(GameState &state, const SearchLimits &limits,
+                     const TimeBudget &budget) {
+    active = limits;
+    active.ponder = false;
+    active.softMilliseconds = budget.softMs;
+    active.milliseconds = budget.hardMs;
+    lastHit = false;
+    if (pondering.valid()) {
+      if (state.hash() == guessedKey) {
+        std::int64_t pondered =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - ponderStart)
+                .count();
+        if (pondered >= budget.softMs) {
+          last = stopPondering();
+        } else {
+          // The search may not have started yet: retry until it has, or
+          // has ended on its own.
+          while (!search.ponderHit(budget.softMs - pondered, budget.hardMs) &&
+                 pondering.wait_for(std::chrono::microseconds(100)) !=
+                     std::future_status::ready) {
+          }
+          last = pondering.get();
+        }
+        lastHit = true;
+        ++hitCount;
+        return last;
+      }
+      stopPondering();
+      ++missCount;
+    }
+    last = search.search(state, active);
+    return last;
+  }
+
+  /*!
+   * \brief Starts searching the expected reply on a background thread.
+   * \param state The position after the action of the last think(),
+   * opponent to move.
+   * \return False if the last search expected no reply, or the game is
+   * over after it; nothing is pondered then.
+   */
+  bool ponder(const GameState &state) {
+    cancel();
+    if (!last.found || last.pv.size() < 2 || state.isFinished()) {
+      return false;
+    }
+    guessed = state;
+    if (!guessed.apply(last.pv[1]) || guessed.isFinished()) {
+      return false;
+    }
+    // The background search walks guessed: read nothing of it meanwhile.
+    guessedKey = guessed.hash();
+    SearchLimits limits = active;
+    limits.ponder = true;
+    limits.nodes = 0;
+    ponderStart = std::chrono::steady_clock::now();
+    pondering = std::async(std::launch::async, [this, limits] {
+      return search.search(guessed, limits);
+    });
+    return true;
+  }
+
+  /*!
+   * \brief Stops pondering, e.g. when the game ends.
+   */
+  void cancel() {
+    if (pondering.valid()) {
+      stopPondering();
+    }
+  }
+
+  /*!
+   * \brief Checks if a background search is running or waiting for think().
+   */
+  bool isPondering() const { return pondering.valid(); }
+
+  /*!
+   * \brief Checks if the last think() continued the pondered search.
+   */
+  bool wasHit() const { return lastHit; }
+
+  int hits() const { return hitCount; }
+
+  int misses() const { return missCount; }
+
+private:
+  SearchResult stopPondering() {
+    // A stop() issued before the search starts is cleared by it: repeat.
+    do {
+      search.stop();
+    } while (pondering.wait_for(std::chrono::microseconds(100)) !=
+             std::future_status::ready);
+    return pondering.get();
+  }
+
+  AlphaBetaSearch search;
+  SearchLimits active;
+  SearchResult last;
+  GameState guessed;
+  std::uint64_t guessedKey;
+  std::future<SearchResult> pondering;
+  std::chrono::steady_clock::time_point ponderStart;
+  int hitCount;
+  int missCount;
+  bool lastHit;
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "doctest.h"
+#include "time_control.h"
+#include "tournament.h"
+#include <thread>
+
+/*!
+ * \brief Deploys both players randomly and plays a few random turns.
+ */
+static GameState openPosition(std::uint32_t seed) {
+    GameState state(8, 8, 3);
+    state.generateTall(seed, 4);
+    std::mt19937 rng(seed);
+    std::vector<Action> actions;
+    while (state.isPlacement()) {
+        state.generateActions(actions);
+        size_t places = actions.size() - (actions.back().kind == FinishPlacement);
+        state.apply(places > 0 ? actions[rng() % places] : actions.back());
+    }
+    for (int turn = 0; turn < 6 && !state.isFinished(); ++turn) {
+        state.generateActions(actions);
+        state.apply(actions[rng() % actions.size()]);
+    }
+    return state;
+}
+
+static std::int64_t millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+TEST_CASE("TimeControl Functions: Parse, Allocate And Punch") {
+    TimeControl control;
+    REQUIRE(parseTimeControl("60000+500", control));
+    CHECK(control.baseMs == 60000);
+    CHECK(control.incrementMs == 500);
+    REQUIRE(parseTimeControl("2000", control));
+    CHECK(control.incrementMs == 0);
+    CHECK_FALSE(parseTimeControl("2000+", control));
+    CHECK_FALSE(parseTimeControl("0+100", control));
+    CHECK_FALSE(parseTimeControl("fast", control));
+    CHECK_FALSE(parseTimeControl("100+10s", control));
+
+    TimeBudget plain = allocateTime(60000, 0);
+    CHECK(plain.softMs > 0);
+    CHECK(plain.softMs <= plain.hardMs);
+    CHECK(plain.hardMs < 60000 / 3 + 1);
+    TimeBudget increment = allocateTime(60000, 1000);
+    CHECK(increment.softMs > plain.softMs);
+    TimeBudget low = allocateTime(30, 1000);
+    CHECK(low.hardMs <= 10);
+    CHECK(low.softMs >= 1);
+
+    TimeControl none;
+    GameClock clock(TimeControl{1000, 100}, none);
+    CHECK(clock.punch(0, 300));
+    CHECK(clock.remaining(0) == 800);
+    CHECK(clock.punch(1, 1000000));
+    CHECK_FALSE(clock.punch(0, 801));
+}
+
+TEST_CASE("AlphaBetaSearch Class: Soft Limits And Ponder Hits") {
+    GameState state = openPosition(3);
+    AlphaBetaSearch search;
+    SearchLimits limits;
+    limits.softMilliseconds = 1;
+    limits.milliseconds = 10000;
+    auto start = std::chrono::steady_clock::now();
+    SearchResult result = search.search(state, limits);
+    REQUIRE(result.found);
+    CHECK(millisecondsSince(start) < 5000);
+    CHECK(result.depth >= 1);
+
+    // Not pondering: there is nothing to hit.
+    CHECK_FALSE(search.ponderHit(10, 20));
+
+    limits = SearchLimits();
+    limits.ponder = true;
+    limits.milliseconds = 1;
+    SearchResult pondered;
+    std::thread worker([&] { pondered = search.search(state, limits); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    start = std::chrono::steady_clock::now();
+    while (!search.ponderHit(5, 20)) {
+        std::this_thread::yield();
+    }
+    worker.join();
+    CHECK(millisecondsSince(start) < 2000);
+    REQUIRE(pondered.found);
+    CHECK(pondered.depth >= 1);
+}
+
+TEST_CASE("PonderingSearch Class: Continues On A Hit, Restarts On A Miss") {
+    GameState state = openPosition(5);
+    PonderingSearch player;
+    SearchLimits limits;
+    TimeBudget budget{40, 400};
+    SearchResult mine = player.think(state, limits, budget);
+    REQUIRE(mine.found);
+    CHECK_FALSE(player.wasHit());
+    REQUIRE(mine.pv.size() >= 2);
+    REQUIRE(state.apply(mine.best));
+    REQUIRE(player.ponder(state));
+    CHECK(player.isPondering());
+
+    // The expected reply, after more pondering than the action would get.
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    REQUIRE(state.apply(mine.pv[1]));
+    auto start = std::chrono::steady_clock::now();
+    SearchResult answer = player.think(state, limits, TimeBudget{40, 5000});
+    CHECK(millisecondsSince(start) < 1000);
+    CHECK(player.wasHit());
+    CHECK(player.hits() == 1);
+    REQUIRE(answer.found);
+    CHECK(state.isLegal(answer.best));
+    CHECK_FALSE(player.isPondering());
+
+    // Another reply than expected.
+    REQUIRE(state.apply(answer.best));
+    if (player.ponder(state)) {
+        std::vector<Action> replies;
+        state.generateActions(replies);
+        const Action *other = nullptr;
+        for (const Action &reply : replies) {
+            if (!(reply == answer.pv[1])) {
+                other = &reply;
+                break;
+            }
+        }
+        REQUIRE(other != nullptr);
+        REQUIRE(state.apply(*other));
+        SearchResult fresh = player.think(state, limits, budget);
+        CHECK_FALSE(player.wasHit());
+        CHECK(player.misses() == 1);
+        REQUIRE(fresh.found);
+        CHECK(state.isLegal(fresh.best));
+    }
+    player.ponder(state);
+    player.cancel();
+    CHECK_FALSE(player.isPondering());
+}
+
+TEST_CASE("playMatchGame Function: Clocks Time Agents And Flag Them") {
+    AgentConfig config[2];
+    REQUIRE(parseAgent("ab:depth=64,tc=400+20,ponder=1", config[0]));
+    CHECK(config[0].clock.baseMs == 400);
+    CHECK(config[0].ponder);
+    REQUIRE(parseAgent("ab:depth=2", config[1]));
+    CHECK_FALSE(parseAgent("ab:tc=fast", config[1]));
+    REQUIRE(parseAgent("ab:depth=2", config[1]));
+    Agent first(config[0]);
+    Agent second(config[1]);
+    Agent *players[2] = {&first, &second};
+    MatchSettings settings;
+    settings.maxTurns = 40;
+    auto start = std::chrono::steady_clock::now();
+    int winner = playMatchGame(settings, 11, players);
+    CHECK(winner >= -1);
+    CHECK(winner <= 1);
+    // 20 timed actions cannot spend more than the base and increments.
+    CHECK(millisecondsSince(start) < 400 + 20 * 20 + 2000);
+}
@@ -0,0 +1,637 @@
+#ifndef TOURNAMENT
+#define TOURNAMENT
+
+#include "neural.h"
+#include "placement_book.h"
+#include "search.h"
+#include "thread_pool.h"
+#include "time_control.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief The ways an agent picks its actions.
+ */
+enum AgentKind {
+  RandomAgent = 0,
+  GreedyAgent = 1,
+  AlphaBetaAgent = 2,
+  MctsAgent = 3
+};
+
+/*!
+ * \brief The configuration of a tournament agent.
+ */
+struct AgentConfig {
+  std::string name;
+  AgentKind kind = AlphaBetaAgent;
+  /*!
+   * \brief The limits of each search. Tournaments should limit depth or
+   * nodes rather than time, so that results can be reproduced.
+   */
+  SearchLimits limits;
+  EvalWeights weights = defaultEvalWeights();
+  /*!
+   * \brief A NeuralEvaluator weights file for alpha-beta leaves; the static
+   * evaluation when empty.
+   */
+  std::string network;
+  /*!
+   * \brief A tablebase file alpha-beta probes on the map it covers; none
+   * when empty.
+   */
+  std::string tablebase;
+  /*!
+   * \brief A placement book file the agent deploys from; a random
+   * deployment when empty or when the book has no entry for the map.
+   */
+  std::string book;
+  /*!
+   * \brief The agent's clock; when enabled, searches are timed by it and
+   * the agent loses on time.
+   */
+  TimeControl clock;
+  /*!
+   * \brief Alpha-beta keeps searching the expected reply on the
+   * opponent's time.
+   */
+  bool ponder = false;
+};
+
+/*!
+ * \brief Parses an agent description such as "ab:depth=3,nodes=20000",
+ * "mcts:nodes=800", "greedy" or "random".
+ *
+ * Keys: depth, nodes, ms, quiescence, net (weights file), tb (tablebase
+ * file), book (placement book file), tc (time control "base+increment"
+ * in milliseconds), ponder (0 or 1) and name; the name defaults to the
+ * description itself.
+ * \param spec The description.
+ * \param config Receives the configuration.
+ * \return False if the kind or a key is unknown.
+ */
+inline bool parseAgent(const std::string &spec, AgentConfig &config) {
+  config = AgentConfig();
+  config.name = spec;
+  size_t colon = spec.find(':');
+  std::string kind = spec.substr(0, colon);
+  if (kind == "random") {
+    config.kind = RandomAgent;
+  } else if (kind == "greedy") {
+    config.kind = GreedyAgent;
+  } else if (kind == "ab") {
+    config.kind = AlphaBetaAgent;
+    config.limits.depth = 3;
+  } else if (kind == "mcts") {
+    config.kind = MctsAgent;
+    config.limits.nodes = MctsSearch::DEFAULT_PLAYOUTS;
+  } else {
+    return false;
+  }
+  size_t start = colon == std::string::npos ? spec.size() : colon + 1;
+  while (start < spec.size()) {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos) {
+      end = spec.size();
+    }
+    std::string option = spec.substr(start, end - start);
+    start = end + 1;
+    size_t equals = option.find('=');
+    if (equals == std::string::npos) {
+      return false;
+    }
+    std::string key = option.substr(0, equals);
+    std::string text = option.substr(equals + 1);
+    long long value = std::atoll(text.c_str());
+    if (key == "depth") {
+      config.limits.depth = static_cast<int>(value);
+    } else if (key == "nodes") {
+      config.limits.nodes = value;
+    } else if (key == "ms") {
+      config.limits.milliseconds = value;
+    } else if (key == "quiescence") {
+      config.limits.quiescence = static_cast<int>(value);
+    } else if (key == "net") {
+      config.network = text;
+    } else if (key == "tb") {
+      config.tablebase = text;
+    } else if (key == "book") {
+      config.book = text;
+    } else if (key == "tc") {
+      if (!parseTimeControl(text, config.clock)) {
+        return false;
+      }
+    } else if (key == "ponder") {
+      config.ponder = value != 0;
+    } else if (key == "name") {
+      config.name = text;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * \brief A player of tournament games.
+ *
+ * An Agent owns its searches and is not thread-safe: each tournament task
+ * builds its own.
+ */
+class Agent {
+public:
+  /*!
+   * \brief Constructor for Agent with specified parameters.
+   * \param config The configuration; a network, tablebase or placement
+   * book that fails to load leaves the agent not ready.
+   */
+  explicit Agent(const AgentConfig &config)
+      : config(config), evaluator(config.weights), ready(true) {
+    if (config.kind == AlphaBetaAgent) {
+      alphaBeta.reset(new PonderingSearch());
+      AlphaBetaSearch &engine = alphaBeta->engine();
+      engine.setWeights(config.weights);
+      if (!config.network.empty()) {
+        NeuralEvaluator network;
+        ready = network.load(config.network);
+        engine.setNetwork(network);
+      }
+      if (!config.tablebase.empty()) {
+        endgames.reset(new Tablebase());
+        ready = endgames->open(config.tablebase) && ready;
+        engine.setTablebase(endgames.get());
+      }
+    } else if (config.kind == MctsAgent) {
+      mcts.reset(new MctsSearch(config.weights));
+    }
+    if (!config.book.empty()) {
+      openings.reset(new PlacementBook());
+      ready = openings->open(config.book) && ready;
+    }
+  }
+
+  /*!
+   * \brief Checks if the agent could be built as configured.
+   */
+  bool isReady() const { return ready; }
+
+  /*!
+   * \brief Gets the configuration of the agent.
+   */
+  const AgentConfig &getConfig() const { return config; }
+
+  /*!
+   * \brief Forgets everything learned in earlier games, so that a game
+   * plays the same whatever was played before it.
+   * \param seed The seed of the random choices of the game.
+   */
+  void newGame(std::uint32_t seed) {
+    rng.seed(seed);
+    if (alphaBeta) {
+      alphaBeta->cancel();
+      alphaBeta->engine().clear();
+    }
+  }
+
+  /*!
+   * \brief Stops thinking on the opponent's time once a game is over.
+   */
+  void endGame() {
+    if (alphaBeta) {
+      alphaBeta->cancel();
+    }
+  }
+
+  /*!
+   * \brief Deploys the army of a player from the agent's placement book.
+   * \param state A deployment-phase position where the player has no unit
+   * yet.
+   * \param player The player to deploy.
+   * \return False if the book has no entry, leaving the state unchanged.
+   */
+  bool deploy(GameState &state, int player) {
+    BookEntry entry;
+    if (!openings || !openings->lookup(state, player, entry)) {
+      return false;
+    }
+    std::vector<ActionUndo> undos(entry.actions.size());
+    for (size_t k = 0; k < entry.actions.size(); ++k) {
+      if (!state.make(entry.actions[k], undos[k])) {
+        while (k > 0) {
+          state.unmake(undos[--k]);
+        }
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*!
+   * \brief Picks an action for the side to move in the battle phase.
+   * \param state The position, restored before returning.
+   * \param action Receives the action.
+   * \param remainingMs The time left on the agent's clock, if it has one.
+   * \return False if the side to move has no legal action.
+   */
+  bool choose(GameState &state, Action &action,
+              std::int64_t remainingMs = 0) {
+    if (alphaBeta || mcts) {
+      SearchResult result;
+      if (config.clock.enabled()) {
+        TimeBudget budget =
+            allocateTime(remainingMs, config.clock.incrementMs);
+        SearchLimits limits = config.limits;
+        limits.milliseconds = budget.hardMs;
+        result = alphaBeta ? alphaBeta->think(state, config.limits, budget)
+                           : mcts->search(state, limits);
+      } else {
+        result = alphaBeta ? alphaBeta->engine().search(state, config.limits)
+                           : mcts->search(state, config.limits);
+      }
+      action = result.best;
+      return result.found;
+    }
+    state.generateActions(actions);
+    if (actions.empty()) {
+      return false;
+    }
+    size_t choice = rng() % actions.size();
+    if (config.kind == GreedyAgent) {
+      ActionUndo undo;
+      int best = -Evaluator::WIN_SCORE - 1;
+      for (size_t k = 0; k < actions.size(); ++k) {
+        state.make(actions[k], undo);
+        int score = -evaluator.evaluate(state);
+        state.unmake(undo);
+        if (score > best) {
+          best = score;
+          choice = k;
+        }
+      }
+    }
+    action = actions[choice];
+    return true;
+  }
+
+  /*!
+   * \brief Lets the agent ponder after its action was played.
+   * \param state The position after the action.
+   */
+  void acted(const GameState &state) {
+    if (alphaBeta && config.ponder && config.clock.enabled()) {
+      alphaBeta->ponder(state);
+    }
+  }
+
+private:
+  AgentConfig config;
+  Evaluator evaluator;
+  std::unique_ptr<PonderingSearch> alphaBeta;
+  std::unique_ptr<MctsSearch> mcts;
+  std::unique_ptr<Tablebase> endgames;
+  std::unique_ptr<PlacementBook> openings;
+  std::mt19937 rng;
+  std::vector<Action> actions;
+  bool ready;
+};
+
+/*!
+ * \brief The settings of a tournament.
+ */
+struct MatchSettings {
+  int rows = 8;
+  int cols = 8;
+  int maxNPC = 3;
+  int number_of_tall = 4;
+  /*!
+   * \brief The number of battle turns after which a game is drawn.
+   */
+  int maxTurns = 200;
+  /*!
+   * \brief The most game pairs a pairing plays; pair k uses seed + k.
+   */
+  int pairs = 100;
+  /*!
+   * \brief The number of pairs a pool task plays; SPRT is checked after
+   * every round of tasks.
+   */
+  int batch = 4;
+  std::uint32_t seed = 1;
+};
+
+/*!
+ * \brief Wins, draws and losses of one side of a match.
+ */
+struct MatchScore {
+  int wins = 0;
+  int draws = 0;
+  int losses = 0;
+
+  int games() const { return wins + draws + losses; }
+
+  /*!
+   * \brief Gets the mean score, a win counting 1 and a draw 1/2.
+   */
+  double score() const {
+    return games() > 0 ? (wins + 0.5 * draws) / games() : 0.5;
+  }
+
+  /*!
+   * \brief Gets the score of the other side.
+   */
+  MatchScore reversed() const { return MatchScore{losses, draws, wins}; }
+
+  void add(const MatchScore &other) {
+    wins += other.wins;
+    draws += other.draws;
+    losses += other.losses;
+  }
+};
+
+/*!
+ * \brief Converts a mean score to an Elo difference.
+ */
+inline double eloFromScore(double score) {
+  score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+  return -400 * std::log10(1 / score - 1);
+}
+
+/*!
+ * \brief Converts an Elo difference to an expected mean score.
+ */
+inline double scoreFromElo(double elo) {
+  return 1 / (1 + std::pow(10.0, -elo / 400));
+}
+
+/*!
+ * \brief Gets the variance of the score of one game of a match.
+ */
+inline double scoreVariance(const MatchScore &match) {
+  if (match.games() == 0) {
+    return 0;
+  }
+  double mean = match.score();
+  return (match.wins * (1 - mean) * (1 - mean) +
+          match.draws * (0.5 - mean) * (0.5 - mean) +
+          match.losses * mean * mean) /
+         match.games();
+}
+
+/*!
+ * \brief Gets the half width of the 95% confidence interval of the Elo
+ * difference of a match.
+ */
+inline double eloMargin(const MatchScore &match) {
+  if (match.games() == 0) {
+    return 0;
+  }
+  double error = std::sqrt(scoreVariance(match) / match.games());
+  double mean = match.score();
+  return (eloFromScore(mean + 1.96 * error) -
+          eloFromScore(mean - 1.96 * error)) /
+         2;
+}
+
+/*!
+ * \brief The settings of a sequential probability ratio test between H0:
+ * the Elo difference is elo0 and H1: it is elo1.
+ */
+struct SprtSettings {
+  bool enabled = false;
+  double elo0 = 0;
+  double elo1 = 10;
+  double alpha = 0.05;
+  double beta = 0.05;
+};
+
+/*!
+ * \brief The state of a pairing's test.
+ */
+enum SprtDecision { SprtContinue = 0, SprtAcceptH0 = 1, SprtAcceptH1 = 2 };
+
+/*!
+ * \brief Gets the log-likelihood ratio of H1 against H0, with the normal
+ * approximation of the score distribution used by engine testing
+ * frameworks.
+ */
+inline double sprtLlr(const MatchScore &match, double elo0, double elo1) {
+  double variance = scoreVariance(match);
+  if (match.games() == 0 || variance <= 0) {
+    return 0;
+  }
+  double s0 = scoreFromElo(elo0);
+  double s1 = scoreFromElo(elo1);
+  return (s1 - s0) * (2 * match.score() - s0 - s1) * match.games() /
+         (2 * variance);
+}
+
+/*!
+ * \brief Compares a log-likelihood ratio with the bounds of a test.
+ */
+inline SprtDecision sprtDecision(double llr, const SprtSettings &sprt) {
+  if (llr >= std::log((1 - sprt.beta) / sprt.alpha)) {
+    return SprtAcceptH1;
+  }
+  if (llr <= std::log(sprt.beta / (1 - sprt.alpha))) {
+    return SprtAcceptH0;
+  }
+  return SprtContinue;
+}
+
+/*!
+ * \brief Deploys the army of a player on random free hexes of its zone.
+ * \param state A deployment-phase position.
+ * \param player The player to deploy.
+ * \param rng The random generator.
+ */
+inline void deployRandomly(GameState &state, int player, std::mt19937 &rng) {
+  std::vector<Action> actions;
+  while (static_cast<int>(state.getUnits(player).size()) <
+         state.getMaxNPC()) {
+    state.generateActions(actions);
+    actions.erase(std::remove_if(actions.begin(), actions.end(),
+                                 [player](const Action &action) {
+                                   return action.kind != PlaceUnit ||
+                                          action.player != player;
+                                 }),
+                  actions.end());
+    if (actions.empty()) {
+      return;
+    }
+    state.apply(actions[rng() % actions.size()]);
+  }
+}
+
+/*!
+ * \brief Plays one tournament game.
+ *
+ * Terrain is drawn from the seed. Player 0 deploys first, then player 1
+ * seeing it, each from its agent's placement book or else randomly from
+ * the seed; without books the two games of a pair start from the same
+ * position with the agents swapping sides. Agents with a time control
+ * lose when their clock runs out; pondering agents think on the
+ * opponent's time.
+ * \param settings The tournament settings.
+ * \param seed The seed of the game.
+ * \param players The agents of player 0 and player 1.
+ * \return The winner (0 or 1), or -1 for a draw.
+ */
+inline int playMatchGame(const MatchSettings &settings, std::uint32_t seed,
+                         Agent *players[2]) {
+  GameState state(settings.rows, settings.cols, settings.maxNPC);
+  state.generateTall(seed, settings.number_of_tall);
+  for (int player = 0; player < 2; ++player) {
+    if (!players[player]->deploy(state, player)) {
+      std::mt19937 rng(2 * seed + player);
+      deployRandomly(state, player, rng);
+    }
+  }
+  if (!state.apply(GameState::makeAction(FinishPlacement, 0, 0, -1, -1))) {
+    return -1;
+  }
+  for (int player = 0; player < 2; ++player) {
+    players[player]->newGame(2 * seed + player);
+  }
+  GameClock clock(players[0]->getConfig().clock,
+                  players[1]->getConfig().clock);
+  Action action;
+  int winner = -1;
+  while (!state.isFinished() && state.getTurn() < settings.maxTurns) {
+    int side = state.getSideToMove();
+    auto start = std::chrono::steady_clock::now();
+    if (!players[side]->choose(state, action, clock.remaining(side))) {
+      break;
+    }
+    std::int64_t used = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    if (!clock.punch(side, used)) {
+      winner = 1 - side;
+      break;
+    }
+    state.apply(action);
+    players[side]->acted(state);
+  }
+  for (int player = 0; player < 2; ++player) {
+    players[player]->endGame();
+  }
+  return winner != -1 ? winner : state.getWinner();
+}
+
+/*!
+ * \brief The games of two agents against each other.
+ */
+struct Pairing {
+  int first = 0;
+  int second = 0;
+  /*!
+   * \brief The score of the first agent.
+   */
+  MatchScore score;
+  int pairsPlayed = 0;
+  double llr = 0;
+  SprtDecision decision = SprtContinue;
+};
+
+/*!
+ * \brief Plays every agent against every other on a thread pool.
+ *
+ * Each pairing plays up to settings.pairs pairs of games, the agents
+ * swapping sides within a pair. Pairs are played in tasks of
+ * settings.batch; with SPRT enabled, a pairing stops once its test
+ * decides, checked between rounds of tasks. Agents are rebuilt per task
+ * and reset per game, so the results do not depend on the number of
+ * workers when the agents are limited by depth or nodes.
+ * \param agents The agents.
+ * \param settings The tournament settings.
+ * \param sprt The early stopping test.
+ * \param pool The workers.
+ * \return One pairing per pair of agents, first < second.
+ */
+inline std::vector<Pairing> playRoundRobin(
+    const std::vector<AgentConfig> &agents, const MatchSettings &settings,
+    const SprtSettings &sprt, ThreadPool &pool) {
+  std::vector<Pairing> pairings;
+  for (int a = 0; a < static_cast<int>(agents.size()); ++a) {
+    for (int b = a + 1; b < static_cast<int>(agents.size()); ++b) {
+      Pairing pairing;
+      pairing.first = a;
+      pairing.second = b;
+      pairings.push_back(pairing);
+    }
+  }
+  int batch = std::max(settings.batch, 1);
+  std::mutex mutex;
+  bool running = true;
+  while (running) {
+    running = false;
+    for (Pairing &pairing : pairings) {
+      if (pairing.decision != SprtContinue ||
+          pairing.pairsPlayed >= settings.pairs) {
+        continue;
+      }
+      running = true;
+      int first = pairing.pairsPlayed;
+      int last = std::min(first + batch, settings.pairs);
+      pairing.pairsPlayed = last;
+      Pairing *target = &pairing;
+      pool.post([&, target, first, last] {
+        Agent one(agents[target->first]);
+        Agent two(agents[target->second]);
+        MatchScore local;
+        for (int pair = first; pair < last; ++pair) {
+          std::uint32_t seed =
+              settings.seed + static_cast<std::uint32_t>(pair);
+          for (int swap = 0; swap < 2; ++swap) {
+            TraceScope scope("tournament.game");
+            Agent *players[2] = {swap ? &two : &one, swap ? &one : &two};
+            int winner = playMatchGame(settings, seed, players);
+            if (winner == -1) {
+              local.draws += 1;
+            } else if ((winner == 0) != (swap == 1)) {
+              local.wins += 1;
+            } else {
+              local.losses += 1;
+            }
+          }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        target->score.add(local);
+      });
+    }
+    pool.wait();
+    for (Pairing &pairing : pairings) {
+      pairing.llr = sprtLlr(pairing.score, sprt.elo0, sprt.elo1);
+      if (sprt.enabled && pairing.decision == SprtContinue) {
+        pairing.decision = sprtDecision(pairing.llr, sprt);
+      }
+    }
+  }
+  return pairings;
+}
+
+/*!
+ * \brief Sums the scores of every agent over its pairings.
+ * \param pairings The pairings of a round robin.
+ * \param agents The number of agents.
+ * \return The score of each agent against the field.
+ */
+inline std::vector<MatchScore> standings(const std::vector<Pairing> &pairings,
+                                         int agents) {
+  std::vector<MatchScore> totals(agents);
+  for (const Pairing &pairing : pairings) {
+    totals[pairing.first].add(pairing.score);
+    totals[pairing.second].add(pairing.score.reversed());
+  }
+  return totals;
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*!
+ * \file tournament_main.cpp
+ * \brief Plays AI agents against each other and rates them
+ *
+ * Every agent meets every other over mirrored pairs of seeded games; the
+ * output gives each pairing's score, Elo difference with its 95% interval
+ * and SPRT state, then the standings:
+ *   strateg_tournament --agent=ab:depth=3 --agent=ab:depth=2
+ *       --agent=mcts:nodes=800 --pairs=200 --threads=8
+ * With --sprt=elo0:elo1 a pairing stops as soon as the test decides:
+ *   strateg_tournament --agent=ab:depth=3 --agent=ab:depth=2 --sprt=0:20
+ * Agents on a clock ("tc=base+increment" in milliseconds) lose on time; a
+ * pondering agent uses a second thread while its opponent thinks:
+ *   strateg_tournament --agent=ab:depth=64,tc=10000+100,ponder=1
+ *       --agent=ab:depth=64,tc=10000+100 --threads=4
+ * With STRATEG_TRACE=path set, the games and searches are saved there as a
+ * Chrome trace.
+ */
+
+#include "tournament.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+static const char *decisionName(SprtDecision decision) {
+  if (decision == SprtAcceptH1) {
+    return "H1 accepted";
+  } else if (decision == SprtAcceptH0) {
+    return "H0 accepted";
+  }
+  return "undecided";
+}
+
+int main(int argc, char **argv) {
+  std::vector<AgentConfig> agents;
+  MatchSettings settings;
+  SprtSettings sprt;
+  int threads = 0;
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string text = arg.substr(arg.find('=') + 1);
+    int value = std::atoi(text.c_str());
+    if (arg.rfind("--agent=", 0) == 0) {
+      AgentConfig config;
+      if (!parseAgent(text, config)) {
+        std::cerr << "Bad agent " << text << std::endl;
+        return 2;
+      }
+      agents.push_back(config);
+    } else if (arg.rfind("--pairs=", 0) == 0) {
+      settings.pairs = value;
+    } else if (arg.rfind("--batch=", 0) == 0) {
+      settings.batch = value;
+    } else if (arg.rfind("--threads=", 0) == 0) {
+      threads = value;
+    } else if (arg.rfind("--rows=", 0) == 0) {
+      settings.rows = value;
+    } else if (arg.rfind("--cols=", 0) == 0) {
+      settings.cols = value;
+    } else if (arg.rfind("--units=", 0) == 0) {
+      settings.maxNPC = value;
+    } else if (arg.rfind("--max-turns=", 0) == 0) {
+      settings.maxTurns = value;
+    } else if (arg.rfind("--seed=", 0) == 0) {
+      settings.seed = static_cast<std::uint32_t>(value);
+    } else if (arg.rfind("--sprt=", 0) == 0) {
+      if (std::sscanf(text.c_str(), "%lf:%lf", &sprt.elo0, &sprt.elo1) != 2) {
+        std::cerr << "Expected --sprt=elo0:elo1" << std::endl;
+        return 2;
+      }
+      sprt.enabled = true;
+    } else if (arg.rfind("--alpha=", 0) == 0) {
+      sprt.alpha = std::atof(text.c_str());
+    } else if (arg.rfind("--beta=", 0) == 0) {
+      sprt.beta = std::atof(text.c_str());
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+  if (agents.size() < 2) {
+    std::cerr << "Give at least two --agent=kind[:key=value,...], kinds "
+                 "ab, mcts, greedy and random"
+              << std::endl;
+    return 2;
+  }
+  for (const AgentConfig &config : agents) {
+    if (!Agent(config).isReady()) {
+      std::cerr << "Cannot load the files of " << config.name << std::endl;
+      return 1;
+    }
+  }
+
+  const char *tracePath = std::getenv("STRATEG_TRACE");
+  if (tracePath != nullptr) {
+    Trace::enable();
+  }
+  ThreadPool pool(threads);
+  std::vector<Pairing> pairings = playRoundRobin(agents, settings, sprt, pool);
+  if (tracePath != nullptr && !Trace::writeChromeTrace(tracePath)) {
+    std::cerr << "Cannot write the trace to " << tracePath << std::endl;
+  }
+  std::cout << std::fixed << std::setprecision(1);
+  for (const Pairing &pairing : pairings) {
+    const MatchScore &score = pairing.score;
+    std::cout << agents[pairing.first].name << " vs "
+              << agents[pairing.second].name << ": +" << score.wins << " ="
+              << score.draws << " -" << score.losses << "  Elo "
+              << eloFromScore(score.score()) << " +- " << eloMargin(score);
+    if (sprt.enabled) {
+      std::cout << std::setprecision(2) << "  LLR " << pairing.llr << " "
+                << decisionName(pairing.decision) << std::setprecision(1);
+    }
+    std::cout << std::endl;
+  }
+
+  std::vector<MatchScore> totals =
+      standings(pairings, static_cast<int>(agents.size()));
+  std::vector<int> order(agents.size());
+  for (size_t k = 0; k < order.size(); ++k) {
+    order[k] = static_cast<int>(k);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return totals[a].score() > totals[b].score();
+  });
+  std::cout << "Standings (Elo against the field):" << std::endl;
+  for (int agent : order) {
+    const MatchScore &score = totals[agent];
+    std::cout << "  " << std::setw(24) << std::left << agents[agent].name
+              << std::right << std::setw(8)
+              << eloFromScore(score.score()) << " +- " << eloMargin(score)
+              << "  (" << score.games() << " games, "
+              << 100 * score.score() << "%)" << std::endl;
+  }
+  return 0;
+}
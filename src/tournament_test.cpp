@@ -0,0 +1,91 @@
+#include "doctest.h"
+#include "tournament.h"
+
+TEST_CASE("Elo Functions: Convert Scores And Bound Tests") {
+    CHECK(eloFromScore(0.5) == doctest::Approx(0));
+    CHECK(eloFromScore(0.75) == doctest::Approx(190.85).epsilon(0.001));
+    CHECK(scoreFromElo(eloFromScore(0.3)) == doctest::Approx(0.3));
+
+    MatchScore even{50, 20, 50};
+    CHECK(even.games() == 120);
+    CHECK(even.score() == doctest::Approx(0.5));
+    CHECK(eloMargin(even) > 0);
+    CHECK(eloMargin(MatchScore{500, 200, 500}) < eloMargin(even));
+    CHECK(even.reversed().score() == doctest::Approx(0.5));
+
+    SprtSettings sprt;
+    sprt.elo0 = 0;
+    sprt.elo1 = 50;
+    CHECK(sprtLlr(MatchScore{80, 10, 30}, 0, 50) > 0);
+    CHECK(sprtLlr(MatchScore{30, 10, 80}, 0, 50) < 0);
+    CHECK(sprtDecision(sprtLlr(MatchScore{300, 50, 100}, 0, 50), sprt) == SprtAcceptH1);
+    CHECK(sprtDecision(sprtLlr(MatchScore{100, 50, 300}, 0, 50), sprt) == SprtAcceptH0);
+    CHECK(sprtDecision(sprtLlr(MatchScore{5, 2, 5}, 0, 50), sprt) == SprtContinue);
+}
+
+TEST_CASE("parseAgent Function: Reads Kinds And Options") {
+    AgentConfig config;
+    REQUIRE(parseAgent("ab:depth=4,nodes=1000,quiescence=2,name=deep", config));
+    CHECK(config.kind == AlphaBetaAgent);
+    CHECK(config.limits.depth == 4);
+    CHECK(config.limits.nodes == 1000);
+    CHECK(config.limits.quiescence == 2);
+    CHECK(config.name == "deep");
+    REQUIRE(parseAgent("mcts", config));
+    CHECK(config.kind == MctsAgent);
+    CHECK(config.limits.nodes == MctsSearch::DEFAULT_PLAYOUTS);
+    REQUIRE(parseAgent("random", config));
+    CHECK(config.name == "random");
+    CHECK_FALSE(parseAgent("minimax", config));
+    CHECK_FALSE(parseAgent("ab:width=3", config));
+    REQUIRE(parseAgent("ab:net=missing.snn", config));
+    CHECK_FALSE(Agent(config).isReady());
+}
+
+TEST_CASE("playRoundRobin Function: Results Do Not Depend On Threads") {
+    std::vector<AgentConfig> agents(3);
+    REQUIRE(parseAgent("ab:depth=1", agents[0]));
+    REQUIRE(parseAgent("mcts:nodes=60", agents[1]));
+    REQUIRE(parseAgent("random", agents[2]));
+    MatchSettings settings;
+    settings.pairs = 6;
+    settings.batch = 2;
+    settings.maxTurns = 60;
+    ThreadPool one(1);
+    ThreadPool three(3);
+    std::vector<Pairing> a = playRoundRobin(agents, settings, SprtSettings(), one);
+    std::vector<Pairing> b = playRoundRobin(agents, settings, SprtSettings(), three);
+    REQUIRE(a.size() == 3);
+    REQUIRE(b.size() == 3);
+    for (size_t k = 0; k < a.size(); ++k) {
+        CHECK(a[k].score.games() == 12);
+        CHECK(a[k].score.wins == b[k].score.wins);
+        CHECK(a[k].score.draws == b[k].score.draws);
+    }
+    std::vector<MatchScore> totals = standings(a, 3);
+    CHECK(totals[0].games() == 24);
+    int decisive = 0;
+    for (const Pairing &pairing : a) {
+        decisive += pairing.score.wins + pairing.score.losses;
+    }
+    CHECK(totals[0].wins + totals[1].wins + totals[2].wins == decisive);
+}
+
+TEST_CASE("playRoundRobin Function: SPRT Stops A Lopsided Pairing") {
+    std::vector<AgentConfig> agents(2);
+    REQUIRE(parseAgent("ab:depth=2", agents[0]));
+    REQUIRE(parseAgent("random", agents[1]));
+    MatchSettings settings;
+    settings.pairs = 200;
+    settings.batch = 4;
+    SprtSettings sprt;
+    sprt.enabled = true;
+    sprt.elo0 = 0;
+    sprt.elo1 = 100;
+    ThreadPool pool(2);
+    std::vector<Pairing> pairings = playRoundRobin(agents, settings, sprt, pool);
+    REQUIRE(pairings.size() == 1);
+    CHECK(pairings[0].decision == SprtAcceptH1);
+    CHECK(pairings[0].pairsPlayed < 200);
+    CHECK(pairings[0].score.games() == 2 * pairings[0].pairsPlayed);
+}
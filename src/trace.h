@@ -0,0 +1,239 @@
+#ifndef TRACE
+#define TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Records timed scopes into per-thread ring buffers and exports them
+ * as a Chrome trace-event JSON file (loadable in Perfetto or chrome://tracing).
+ *
+ * Recording is off until enable() is called; while off a scope costs one
+ * relaxed atomic load. Each thread writes only to its own buffer, so the hot
+ * path takes no lock. When a buffer is full the oldest events are overwritten.
+ * Export should run while the recording threads are idle or joined.
+ */
+class Trace {
+public:
+  /*!
+   * \brief A single completed scope.
+   */
+  struct Event {
+    const char *name;
+    std::int64_t startNs;
+    std::int64_t durationNs;
+  };
+
+  /*!
+   * \brief Starts recording on every thread.
+   * \param eventsPerThread The ring buffer capacity, rounded up to a power of 2.
+   */
+  static void enable(size_t eventsPerThread = 1 << 16) {
+    Trace &trace = instance();
+    size_t capacity = 1;
+    while (capacity < eventsPerThread) {
+      capacity <<= 1;
+    }
+    trace.capacity.store(capacity, std::memory_order_relaxed);
+    trace.enabled.store(true, std::memory_order_release);
+  }
+
+  /*!
+   * \brief Stops recording. Already recorded events are kept for export.
+   */
+  static void disable() {
+    instance().enabled.store(false, std::memory_order_release);
+  }
+
+  /*!
+   * \brief Checks if scopes are currently recorded.
+   * \return True if recording is on, false otherwise.
+   */
+  static bool isEnabled() {
+    return instance().enabled.load(std::memory_order_relaxed);
+  }
+
+  /*!
+   * \brief Gets the current time on the trace clock.
+   * \return Nanoseconds since the trace epoch.
+   */
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - instance().epoch)
+        .count();
+  }
+
+  /*!
+   * \brief Returns a copy of a name with a stable address for the whole run.
+   * \param name The name to keep.
+   * \return A pointer that stays valid until the program exits.
+   */
+  static const char *intern(const std::string &name) {
+    Trace &trace = instance();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    for (const std::string &known : trace.names) {
+      if (known == name) {
+        return known.c_str();
+      }
+    }
+    trace.names.push_back(name);
+    return trace.names.back().c_str();
+  }
+
+  /*!
+   * \brief Names the calling thread in the exported trace.
+   * \param name The thread name, e.g. "ai-worker-2".
+   */
+  static void setThreadName(const std::string &name) {
+    Buffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(instance().mutex);
+    buffer.threadName = name;
+  }
+
+  /*!
+   * \brief Records a completed scope on the calling thread.
+   * \param name An interned or string-literal name of the scope.
+   * \param startNs The start of the scope on the trace clock.
+   * \param endNs The end of the scope on the trace clock.
+   */
+  static void record(const char *name, std::int64_t startNs,
+                     std::int64_t endNs) {
+    Buffer &buffer = threadBuffer();
+    std::uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head & (buffer.events.size() - 1)] =
+        Event{name, startNs, endNs - startNs};
+    buffer.head.store(head + 1, std::memory_order_release);
+  }
+
+  /*!
+   * \brief Writes every buffered event as Chrome trace-event JSON.
+   * \param path The path of the file to write.
+   * \return True if the file was written, false otherwise.
+   */
+  static bool writeChromeTrace(const std::string &path) {
+    std::ofstream out(path);
+    if (!out) {
+      return false;
+    }
+    Trace &trace = instance();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (size_t tid = 0; tid < trace.buffers.size(); ++tid) {
+      const Buffer &buffer = *trace.buffers[tid];
+      if (!buffer.threadName.empty()) {
+        out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << tid << ",\"name\":\"thread_name\",\"args\":{\"name\":\""
+            << buffer.threadName << "\"}}";
+        first = false;
+      }
+
+      std::uint64_t head = buffer.head.load(std::memory_order_acquire);
+      std::uint64_t size = buffer.events.size();
+      std::uint64_t begin = head > size ? head - size : 0;
+      for (std::uint64_t k = begin; k < head; ++k) {
+        const Event &event = buffer.events[k & (size - 1)];
+        std::string name = event.name;
+        out << (first ? "" : ",") << "\n{\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << tid << ",\"name\":\"" << name << "\",\"cat\":\""
+            << name.substr(0, name.find('.')) << "\",\"ts\":"
+            << event.startNs / 1000.0 << ",\"dur\":"
+            << event.durationNs / 1000.0 << "}";
+        first = false;
+      }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+  }
+
+  /*!
+   * \brief Drops every buffered event, keeping the thread buffers.
+   */
+  static void clear() {
+    Trace &trace = instance();
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    for (std::unique_ptr<Buffer> &buffer : trace.buffers) {
+      buffer->head.store(0, std::memory_order_release);
+    }
+  }
+
+private:
+  struct Buffer {
+    std::vector<Event> events;
+    std::atomic<std::uint64_t> head{0};
+    std::string threadName;
+  };
+
+  Trace() : enabled(false), capacity(1 << 16),
+            epoch(std::chrono::steady_clock::now()) {}
+
+  static Trace &instance() {
+    static Trace trace;
+    return trace;
+  }
+
+  /*!
+   * \brief Gets the calling thread's buffer, creating it on first use.
+   *
+   * Buffers are owned by the Trace singleton so that events of finished
+   * threads can still be exported.
+   */
+  static Buffer &threadBuffer() {
+    thread_local Buffer *buffer = nullptr;
+    if (buffer == nullptr) {
+      Trace &trace = instance();
+      std::lock_guard<std::mutex> lock(trace.mutex);
+      trace.buffers.emplace_back(new Buffer());
+      buffer = trace.buffers.back().get();
+      buffer->events.resize(trace.capacity.load(std::memory_order_relaxed));
+    }
+    return *buffer;
+  }
+
+  std::atomic<bool> enabled;
+  std::atomic<size_t> capacity;
+  std::chrono::steady_clock::time_point epoch;
+  std::mutex mutex;
+  std::deque<std::string> names;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+/*!
+ * \brief Records the lifetime of a scope in the trace when tracing is on.
+ *
+ * Used directly by code that has no Profiler (AI search, simulation workers);
+ * the game loop gets the same events through ScopedTimer.
+ */
+class TraceScope {
+public:
+  /*!
+   * \brief Constructor for TraceScope, starts measuring.
+   * \param name A string literal or interned name such as "ai.search".
+   */
+  explicit TraceScope(const char *name)
+      : name(Trace::isEnabled() ? name : nullptr),
+        start(this->name != nullptr ? Trace::now() : 0) {}
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  ~TraceScope() {
+    if (name != nullptr) {
+      Trace::record(name, start, Trace::now());
+    }
+  }
+
+private:
+  const char *name;
+  std::int64_t start;
+};
+
+#endif
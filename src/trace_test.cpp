@@ -0,0 +1,99 @@
+#include "doctest.h"
+#include "profiler.h"
+#include "search.h"
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <thread>
+
+/*!
+ * \brief Exports the trace to a temporary file and reads it back, leaving
+ * nothing behind.
+ */
+static std::string readTrace() {
+    std::string path =
+        (std::filesystem::temp_directory_path() / "strateg_trace_test.json").string();
+    bool written = Trace::writeChromeTrace(path);
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    in.close();
+    std::remove(path.c_str());
+    REQUIRE(written);
+    return content.str();
+}
+
+TEST_CASE("Trace Class: Disabled Scopes Are Not Recorded") {
+    Trace::disable();
+    Trace::clear();
+    {
+        TraceScope scope("ai.hidden");
+    }
+    REQUIRE(readTrace().find("ai.hidden") == std::string::npos);
+}
+
+TEST_CASE("Trace Class: Scopes From Several Threads Are Exported") {
+    Trace::clear();
+    Trace::enable();
+    Profiler profiler;
+    int rules = profiler.section("rules.attack");
+    {
+        ScopedTimer timer(profiler, rules);
+    }
+    std::thread worker([] {
+        Trace::setThreadName("ai-worker");
+        TraceScope scope("ai.search");
+    });
+    worker.join();
+    Trace::disable();
+
+    std::string json = readTrace();
+    CHECK(json.find("\"traceEvents\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"rules.attack\",\"cat\":\"rules\"") !=
+          std::string::npos);
+    CHECK(json.find("\"name\":\"ai.search\",\"cat\":\"ai\"") !=
+          std::string::npos);
+    CHECK(json.find("\"ai-worker\"") != std::string::npos);
+    CHECK(profiler.sampleCount(rules) == 1);
+}
+
+TEST_CASE("Trace Class: Full Buffers Keep The Newest Events") {
+    Trace::clear();
+    Trace::enable();
+    std::thread worker([] {
+        for (int k = 0; k < (1 << 16) + 10; ++k) {
+            TraceScope scope(k < 10 ? "sim.old" : "sim.new");
+        }
+    });
+    worker.join();
+    Trace::disable();
+
+    std::string json = readTrace();
+    CHECK(json.find("sim.old") == std::string::npos);
+    CHECK(json.find("sim.new") != std::string::npos);
+}
+
+TEST_CASE("Trace Class: Searches Record Their Iterations") {
+    GameState state(8, 8, 3);
+    state.generateTall(3, 4);
+    std::vector<Action> actions;
+    while (state.isPlacement()) {
+        state.generateActions(actions);
+        state.apply(actions.front());
+    }
+    Trace::clear();
+    Trace::enable();
+    AlphaBetaSearch alphaBeta;
+    SearchLimits limits;
+    limits.depth = 2;
+    alphaBeta.search(state, limits);
+    MctsSearch mcts;
+    limits.nodes = 50;
+    mcts.search(state, limits);
+    Trace::disable();
+
+    std::string json = readTrace();
+    CHECK(json.find("\"name\":\"ai.search\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"ai.iteration\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"ai.mcts\"") != std::string::npos);
+}
@@ -0,0 +1,154 @@
+/*!
+ * \file tune_main.cpp
+ * \brief Fits the static evaluation weights to self-play outcomes
+ *
+ * Reads the shards written by strateg_selfplay and minimizes the squared
+ * error between sigmoid(evaluation / SCALE) and the game results (Texel
+ * tuning); the evaluation is linear in its weights, so plain gradient
+ * descent on the feature differences suffices:
+ *   strateg_tune --data=data --limit=2000000 --epochs=300
+ */
+
+#include "selfplay.h"
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/*!
+ * \brief Evaluation units per factor e of winning odds.
+ */
+static const double SCALE = 100.0;
+
+/*!
+ * \brief The features of the evaluation: HP per unit type, mobility, threat
+ * and tall control, each as side to move minus enemy.
+ */
+static const int FEATURES = UNIT_TYPES + 3;
+
+static double meanError(const std::vector<float> &features,
+                        const std::vector<float> &targets,
+                        const double weights[FEATURES]) {
+  double sum = 0;
+  for (size_t k = 0; k < targets.size(); ++k) {
+    double eval = 0;
+    for (int f = 0; f < FEATURES; ++f) {
+      eval += weights[f] * features[k * FEATURES + f];
+    }
+    double error = 1 / (1 + std::exp(-eval / SCALE)) - targets[k];
+    sum += error * error;
+  }
+  return targets.empty() ? 0 : sum / targets.size();
+}
+
+int main(int argc, char **argv) {
+  std::string data = "selfplay";
+  std::string prefix = "selfplay";
+  size_t limit = 1000000;
+  int epochs = 300;
+  for (int k = 1; k < argc; ++k) {
+    std::string arg = argv[k];
+    std::string text = arg.substr(arg.find('=') + 1);
+    if (arg.rfind("--data=", 0) == 0) {
+      data = text;
+    } else if (arg.rfind("--prefix=", 0) == 0) {
+      prefix = text;
+    } else if (arg.rfind("--limit=", 0) == 0) {
+      limit = static_cast<size_t>(std::atoll(text.c_str()));
+    } else if (arg.rfind("--epochs=", 0) == 0) {
+      epochs = std::atoi(text.c_str());
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  // Material comes from the units; the other terms from Evaluator.
+  std::vector<float> features;
+  std::vector<float> targets;
+  EvalWeights plain = defaultEvalWeights();
+  Evaluator evaluator(plain);
+  std::vector<std::string> shards = ShardReader::listShards(data, prefix);
+  for (const std::string &path : shards) {
+    ShardReader reader;
+    if (!reader.open(path)) {
+      std::cerr << "Skipping unreadable shard " << path << std::endl;
+      continue;
+    }
+    GameState state(reader.getRows(), reader.getCols(), reader.getMaxUnits());
+    for (size_t k = 0; k < reader.size() && targets.size() < limit; ++k) {
+      if (!reader.read(k, state)) {
+        continue;
+      }
+      int side = state.getSideToMove();
+      float row[FEATURES] = {};
+      for (int player = 0; player < 2; ++player) {
+        float sign = player == side ? 1.f : -1.f;
+        for (const Unit &unit : state.getUnits(player)) {
+          row[unit.type] += sign * unit.HP;
+        }
+      }
+      EvalTerms terms;
+      evaluator.measure(state, terms);
+      row[UNIT_TYPES] = terms.mobility[side] - terms.mobility[1 - side];
+      row[UNIT_TYPES + 1] = terms.threat[side] - terms.threat[1 - side];
+      row[UNIT_TYPES + 2] = terms.tall[side] - terms.tall[1 - side];
+      features.insert(features.end(), row, row + FEATURES);
+      targets.push_back(reader.result(k) * 0.5f);
+    }
+  }
+  if (targets.empty()) {
+    std::cerr << "No positions in " << data << std::endl;
+    return 1;
+  }
+
+  double weights[FEATURES];
+  for (int type = 0; type < UNIT_TYPES; ++type) {
+    weights[type] = plain.unitValue[type];
+  }
+  weights[UNIT_TYPES] = plain.mobility;
+  weights[UNIT_TYPES + 1] = plain.threat;
+  weights[UNIT_TYPES + 2] = plain.tall;
+  double before = meanError(features, targets, weights);
+
+  // Step each weight by the inverse of its feature's second moment, so
+  // features of very different ranges converge together.
+  double moment[FEATURES] = {};
+  for (size_t k = 0; k < targets.size(); ++k) {
+    for (int f = 0; f < FEATURES; ++f) {
+      double value = features[k * FEATURES + f];
+      moment[f] += value * value / targets.size();
+    }
+  }
+  for (int epoch = 0; epoch < epochs; ++epoch) {
+    double gradient[FEATURES] = {};
+    for (size_t k = 0; k < targets.size(); ++k) {
+      const float *row = features.data() + k * FEATURES;
+      double eval = 0;
+      for (int f = 0; f < FEATURES; ++f) {
+        eval += weights[f] * row[f];
+      }
+      double p = 1 / (1 + std::exp(-eval / SCALE));
+      double slope = (p - targets[k]) * p * (1 - p) / SCALE;
+      for (int f = 0; f < FEATURES; ++f) {
+        gradient[f] += slope * row[f];
+      }
+    }
+    for (int f = 0; f < FEATURES; ++f) {
+      weights[f] -= 4 * SCALE * SCALE * gradient[f] / targets.size() /
+                    std::max(moment[f], 1e-9);
+    }
+  }
+  double after = meanError(features, targets, weights);
+
+  std::cout << "Positions: " << targets.size() << " from " << shards.size()
+            << " shards" << std::endl;
+  std::cout << "Mean squared error: " << before << " with the defaults, "
+            << after << " tuned" << std::endl;
+  std::cout << "EvalWeights{{" << std::lround(weights[0]) << ", "
+            << std::lround(weights[1]) << ", " << std::lround(weights[2])
+            << "}, " << std::lround(weights[UNIT_TYPES]) << ", "
+            << std::lround(weights[UNIT_TYPES + 1]) << ", "
+            << std::lround(weights[UNIT_TYPES + 2]) << "}" << std::endl;
+  return after <= before ? 0 : 1;
+}